@@ -0,0 +1,107 @@
+#include "BenchmarkUtils.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+std::atomic<size_t> s_liveBytes(0);
+std::atomic<size_t> s_peakBytes(0);
+std::atomic<size_t> s_allocationCount(0);
+std::atomic<size_t> s_allocatedBytes(0);
+
+// Every block carries its size in front of it, so that the unsized delete can account for it
+constexpr size_t kHeaderSize = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+void* TrackedAllocate(size_t size) {
+	void* block = std::malloc(size + kHeaderSize);
+	if (block == nullptr) {
+		return nullptr;
+	}
+	*static_cast<size_t*>(block) = size;
+	size_t live = s_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = s_peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+	s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	return static_cast<char*>(block) + kHeaderSize;
+}
+
+void TrackedFree(void* pointer) {
+	if (pointer == nullptr) {
+		return;
+	}
+	void* block = static_cast<char*>(pointer) - kHeaderSize;
+	s_liveBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+	std::free(block);
+}
+
+}
+
+void* operator new(size_t size) {
+	void* pointer = TrackedAllocate(size);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+void* operator new[](size_t size) {
+	void* pointer = TrackedAllocate(size);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size); }
+void operator delete(void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+
+namespace Benchmark {
+
+HeapScope::HeapScope() {
+	s_peakBytes.store(s_liveBytes.load());
+	_baseline = { s_liveBytes.load(), s_peakBytes.load(), s_allocationCount.load(), s_allocatedBytes.load() };
+}
+
+HeapStats HeapScope::GetStats() const {
+	size_t live = s_liveBytes.load();
+	return {
+		live > _baseline.liveBytes ? live - _baseline.liveBytes : 0,
+		s_peakBytes.load() - _baseline.peakBytes,
+		s_allocationCount.load() - _baseline.allocationCount,
+		s_allocatedBytes.load() - _baseline.allocatedBytes
+	};
+}
+
+Osm::OsmTagFilter CreateFeatureTagFilter() {
+	std::vector<std::string_view> keys;
+	for (uint32_t key = 0; key < Osm::kWellKnownTagCount; ++key) {
+		keys.push_back(Osm::GetTagDictionary().GetString(key));
+	}
+	return Osm::OsmTagFilter(keys, true);
+}
+
+bool ReadFile(const std::string& path, std::string& content) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	content = stream.str();
+	return true;
+}
+
+void PrintRow(const char* label, double seconds, size_t inputBytes, const HeapStats& heap) {
+	const double megabyte = 1024.0 * 1024.0;
+	printf("%-36s %9.3f s %9.1f MB/s  peak heap %9.1f MB  %10zu allocations\n",
+		label, seconds, seconds > 0 ? inputBytes / megabyte / seconds : 0.0, heap.peakBytes / megabyte, heap.allocationCount);
+}
+
+}
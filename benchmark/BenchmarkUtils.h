@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "OsmParserUtils.h"
+
+namespace Benchmark {
+
+class Stopwatch {
+public:
+	Stopwatch() : _start(std::chrono::steady_clock::now()) {}
+	void Restart() { _start = std::chrono::steady_clock::now(); }
+	double GetElapsedSeconds() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+	}
+private:
+	std::chrono::steady_clock::time_point _start;
+};
+
+// Heap usage as seen by the global operator new/delete of the benchmark executable
+struct HeapStats {
+	size_t liveBytes;
+	size_t peakBytes;
+	size_t allocationCount;
+	size_t allocatedBytes;
+};
+
+// Measures the heap usage from its construction on. Scopes must not overlap, they share the process wide peak.
+class HeapScope {
+public:
+	HeapScope();
+	HeapStats GetStats() const;
+private:
+	HeapStats _baseline;
+};
+
+bool ReadFile(const std::string& path, std::string& content);
+// The tag filter the OSM entry points use by default
+Osm::OsmTagFilter CreateFeatureTagFilter();
+void PrintRow(const char* label, double seconds, size_t inputBytes, const HeapStats& heap);
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Each benchmark receives the arguments following its name on the command line
+int RunOsmIngestBenchmark(int argc, char** argv);
+int RunInputCopyBenchmark(int argc, char** argv);
+int RunPbfIngestBenchmark(int argc, char** argv);
+int RunCoordinateParseBenchmark(int argc, char** argv);
+int RunIdIndexBenchmark(int argc, char** argv);
+int RunProcessOsmBenchmark(int argc, char** argv);
+int RunTagStorageBenchmark(int argc, char** argv);
+int RunFeatureBuildBenchmark(int argc, char** argv);
+int RunTilePyramidBenchmark(int argc, char** argv);
+int RunOsmSnapshotBenchmark(int argc, char** argv);
+int RunMultipolygonBenchmark(int argc, char** argv);
+int RunLineLayoutBenchmark(int argc, char** argv);
+int RunRingAreaBenchmark(int argc, char** argv);
+int RunLanduseAssignBenchmark(int argc, char** argv);
+int RunBuildingNeighborhoodBenchmark(int argc, char** argv);
+int RunPointInShapeBenchmark(int argc, char** argv);
+
+// Regression checks, they return non-zero on failure
+int RunInflateCheck(int argc, char** argv);
+int RunRelationCheck(int argc, char** argv);
+int RunClipCheck(int argc, char** argv);
+int RunChangeCheck(int argc, char** argv);
+int RunQuantizeCheck(int argc, char** argv);
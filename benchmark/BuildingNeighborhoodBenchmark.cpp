@@ -0,0 +1,223 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "ShapeUtils.h"
+#include "TileBuildingDataUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr int kQueryCount = 1000;
+// Brute force queries are only run on this many of them
+static constexpr int kCheckedQueryCount = 100;
+// A building on every this many square meters, like a dense city
+static constexpr double kSquareMetersPerBuilding = 400.0;
+
+// Queries through the C API, parsing the data for each of them only for a few
+static constexpr int kApiQueryCount = 200;
+static constexpr int kApiParsedQueryCount = 10;
+// Degrees between the buildings of the document, 22 m north and 15 m east
+static constexpr double kBuildingSpacing = 0.0002;
+
+static void AddSquareWay(std::string& document, uint64_t wayId, uint64_t& nodeId, double latitude, double longitude, const char* tags) {
+	char text[160];
+	uint64_t firstNodeId = nodeId;
+	for (int corner = 0; corner < 4; ++corner) {
+		snprintf(text, sizeof(text), "<node id=\"%llu\" lat=\"%.7f\" lon=\"%.7f\"/>", static_cast<unsigned long long>(nodeId++),
+			latitude + (corner == 1 || corner == 2 ? 0.0001 : 0), longitude + (corner >= 2 ? 0.0001 : 0));
+		document += text;
+	}
+	snprintf(text, sizeof(text), "<way id=\"%llu\">", static_cast<unsigned long long>(wayId));
+	document += text;
+	for (int corner = 0; corner <= 4; ++corner) {
+		snprintf(text, sizeof(text), "<nd ref=\"%llu\"/>", static_cast<unsigned long long>(firstNodeId + corner % 4));
+		document += text;
+	}
+	document += tags;
+	document += "</way>";
+}
+
+// Square buildings on a grid, way i + 1 is building i. The relation 1 is a building as well, half a spacing west of
+// the way 1, so the two share an id and are the parts of one building for the C API.
+static std::string CreateBuildingDocument(int buildingCount) {
+	std::string document = "<osm>";
+	int side = static_cast<int>(std::sqrt(static_cast<double>(buildingCount))) + 1;
+	uint64_t nodeId = 1;
+	for (int i = 0; i < buildingCount; ++i) {
+		AddSquareWay(document, i + 1, nodeId, 47.5 + (i / side) * kBuildingSpacing, 19.0 + (i % side) * kBuildingSpacing,
+			"<tag k=\"building\" v=\"yes\"/>");
+	}
+	AddSquareWay(document, buildingCount + 1, nodeId, 47.5, 19.0 - kBuildingSpacing / 2, "");
+	char text[160];
+	snprintf(text, sizeof(text), "<relation id=\"1\"><member type=\"way\" ref=\"%d\" role=\"outer\"/>", buildingCount + 1);
+	document += text;
+	document += "<tag k=\"type\" v=\"multipolygon\"/><tag k=\"building\" v=\"yes\"/></relation></osm>";
+	return document;
+}
+
+static bool IsSameEnvironment(const BuildingEnvironmentData& a, const BuildingEnvironmentData& b) {
+	return a.buildingArea == b.buildingArea && a.buildingCountNearby == b.buildingCountNearby && a.averageBuildingAreaNearby == b.averageBuildingAreaNearby &&
+		a.medianBuildingAreaNearby == b.medianBuildingAreaNearby && a.totalBuildingAreaNearby == b.totalBuildingAreaNearby &&
+		a.nearestBuildingDistance == b.nearestBuildingDistance;
+}
+
+// Two pairs of buildings a spacing apart east to west, one on the equator and one at 60 degrees north, so that the
+// center of the data is far from both. Fails if the nearest building at 60 degrees is not at the spacing measured
+// there, or if a missing building is reported as found.
+static size_t CheckBuildingApiFarFromCenter() {
+	std::string document = "<osm>";
+	uint64_t nodeId = 1;
+	AddSquareWay(document, 1, nodeId, 0.0, 19.0, "<tag k=\"building\" v=\"yes\"/>");
+	AddSquareWay(document, 2, nodeId, 0.0, 19.0 + kBuildingSpacing, "<tag k=\"building\" v=\"yes\"/>");
+	AddSquareWay(document, 3, nodeId, 60.0, 19.0, "<tag k=\"building\" v=\"yes\"/>");
+	AddSquareWay(document, 4, nodeId, 60.0, 19.0 + kBuildingSpacing, "<tag k=\"building\" v=\"yes\"/>");
+	document += "</osm>";
+	size_t failureCount = 0;
+	BuildingEnvironment* environment = create_building_environment(document.c_str());
+	BuildingEnvironmentData data = query_building_environment(environment, 3, 0);
+	double spacing = kBuildingSpacing * 6378137.0 * 3.14159265358979 / 180.0 * std::cos(60.0 * 3.14159265358979 / 180.0);
+	if (!data.isBuildingFound || std::abs(data.nearestBuildingDistance - spacing) > 0.01 * spacing) {
+		printf("FAIL the nearest building at 60 degrees is %.2f m away instead of %.2f m\n", data.nearestBuildingDistance, spacing);
+		++failureCount;
+	}
+	data = query_building_environment(environment, 5, 0);
+	if (data.isBuildingFound || data.buildingCountNearby != -1 || data.nearestBuildingDistance != -1) {
+		printf("FAIL a missing building is reported with %d buildings nearby\n", data.buildingCountNearby);
+		++failureCount;
+	}
+	destroy_building_environment(environment);
+	return failureCount;
+}
+
+// Queries the buildings of documents of growing size through the C API, parsing the document for every query and
+// parsing it once for all of them. Fails if the two differ, or if the nearest building of the way 1 is its other part.
+static size_t RunBuildingApiBenchmark(double radius) {
+	const int buildingCounts[] = { 1000, 10000 };
+	std::mt19937 random(7);
+	size_t failureCount = 0;
+	for (int buildingCount : buildingCounts) {
+		std::string document = CreateBuildingDocument(buildingCount);
+		std::vector<int64_t> queries(kApiQueryCount);
+		queries[0] = 1;
+		for (int i = 1; i < kApiQueryCount; ++i) {
+			queries[i] = 1 + static_cast<int64_t>(random() % buildingCount);
+		}
+		std::vector<BuildingEnvironmentData> parsed(kApiParsedQueryCount);
+		Benchmark::Stopwatch stopwatch;
+		for (int i = 0; i < kApiParsedQueryCount; ++i) {
+			parsed[i] = get_building_environment_data_in_radius(document.c_str(), queries[i], radius);
+		}
+		double parsedSeconds = stopwatch.GetElapsedSeconds() / kApiParsedQueryCount;
+
+		std::vector<BuildingEnvironmentData> kept(kApiQueryCount);
+		stopwatch.Restart();
+		BuildingEnvironment* environment = create_building_environment(document.c_str());
+		double createSeconds = stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (int i = 0; i < kApiQueryCount; ++i) {
+			kept[i] = query_building_environment(environment, queries[i], radius);
+		}
+		double querySeconds = stopwatch.GetElapsedSeconds() / kApiQueryCount;
+		destroy_building_environment(environment);
+
+		printf("%8d buildings  C API parsing per query %8.2f ms  parsed once %8.2f ms, then %7.2f us per query\n", buildingCount,
+			parsedSeconds * 1000.0, createSeconds * 1000.0, querySeconds * 1e6);
+		for (int i = 0; i < kApiParsedQueryCount; ++i) {
+			if (!IsSameEnvironment(parsed[i], kept[i])) {
+				printf("MISMATCH building %lld: %d nearby parsing per query, %d parsed once\n", static_cast<long long>(queries[i]),
+					parsed[i].buildingCountNearby, kept[i].buildingCountNearby);
+				++failureCount;
+				break;
+			}
+		}
+		// The relation 1 is half a spacing away, the nearest other building a whole one to the east
+		double spacing = kBuildingSpacing * 6378137.0 * 3.14159265358979 / 180.0 * std::cos(47.5 * 3.14159265358979 / 180.0);
+		if (!(kept[0].nearestBuildingDistance > spacing * 0.9)) {
+			printf("FAIL the nearest building of the way 1 is %.2f m away, closer than the %.2f m to the next building\n",
+				kept[0].nearestBuildingDistance, spacing);
+			++failureCount;
+		}
+	}
+	failureCount += CheckBuildingApiFarFromCenter();
+	return failureCount;
+}
+
+// Finds the buildings around random buildings of a city through the grid over their centroids and by testing every
+// building, for cities of growing size, then through the C API. Fails if the two give different buildings within the
+// radius or a different nearest distance.
+int RunBuildingNeighborhoodBenchmark(int argc, char** argv) {
+	double radius = argc >= 1 ? std::atof(argv[0]) : 200.0;
+	const int buildingCounts[] = { 10000, 100000, 1000000, 4000000 };
+	std::mt19937 random(42);
+	size_t failureCount = 0;
+	for (int buildingCount : buildingCounts) {
+		// Half of the buildings are in dense blocks, the others spread evenly, on a square city in meters
+		double side = std::sqrt(buildingCount * kSquareMetersPerBuilding);
+		std::uniform_real_distribution<double> position(0.0, side);
+		std::normal_distribution<double> blockOffset(0.0, 50.0);
+		std::vector<VECTOR2D> centroids(buildingCount);
+		for (int i = 0; i < buildingCount; ++i) {
+			if (i % 2 == 1) {
+				centroids[i] = VECTOR2D(centroids[i - 1].X + blockOffset(random), centroids[i - 1].Y + blockOffset(random));
+			}
+			else {
+				centroids[i] = VECTOR2D(position(random), position(random));
+			}
+		}
+
+		Benchmark::Stopwatch stopwatch;
+		ShapeUtils::PointGrid grid;
+		grid.Build(centroids.data(), buildingCount);
+		double buildSeconds = stopwatch.GetElapsedSeconds();
+		std::vector<int> queries(kQueryCount);
+		for (int& query : queries) {
+			query = static_cast<int>(random() % buildingCount);
+		}
+		std::vector<std::vector<int>> nearby(kQueryCount);
+		std::vector<double> nearestDistances(kQueryCount);
+		size_t nearbyCount = 0;
+		stopwatch.Restart();
+		for (int i = 0; i < kQueryCount; ++i) {
+			grid.FindPointsInRadius(centroids[queries[i]], radius, nearby[i]);
+			grid.FindNearestPoint(centroids[queries[i]], queries[i], &nearestDistances[i]);
+			nearbyCount += nearby[i].size();
+		}
+		double querySeconds = stopwatch.GetElapsedSeconds();
+
+		stopwatch.Restart();
+		for (int i = 0; i < kCheckedQueryCount; ++i) {
+			VECTOR2D center = centroids[queries[i]];
+			std::vector<int> expected;
+			double nearestDistance = std::numeric_limits<double>::infinity();
+			for (int j = 0; j < buildingCount; ++j) {
+				double dx = centroids[j].X - center.X;
+				double dy = centroids[j].Y - center.Y;
+				double distance = dx * dx + dy * dy;
+				if (distance <= radius * radius) {
+					expected.push_back(j);
+				}
+				if (j != queries[i]) {
+					nearestDistance = std::min(nearestDistance, distance);
+				}
+			}
+			std::sort(nearby[i].begin(), nearby[i].end());
+			if (nearby[i] != expected || nearestDistances[i] != std::sqrt(nearestDistance)) {
+				printf("MISMATCH building %d: %zu within %.0f m by the grid, %zu by testing all, nearest at %.3f m, %.3f m\n", queries[i],
+					nearby[i].size(), radius, expected.size(), nearestDistances[i], std::sqrt(nearestDistance));
+				++failureCount;
+				break;
+			}
+		}
+		double bruteSeconds = stopwatch.GetElapsedSeconds() / kCheckedQueryCount;
+		printf("%8d buildings  grid build %8.2f ms  query %7.2f us for %5.1f buildings within %.0f m  testing all %9.2f us\n", buildingCount,
+			buildSeconds * 1000.0, querySeconds * 1e6 / kQueryCount, static_cast<double>(nearbyCount) / kQueryCount, radius, bruteSeconds * 1e6);
+	}
+	failureCount += RunBuildingApiBenchmark(radius);
+	return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include "Benchmarks.h"
+
+#include "MapDataUtils.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Tiles at zoom 16 are about 0.0055 degrees wide, the features are spread over a few of them. Building 20 stays as it
+// is, building 21 is stretched into the tiles east of it, path 22 is deleted, landuse 23 changes its kind, the
+// multipolygon 30 moves with a node of its outer way and building 44 is new.
+const char kBaseDocument[] =
+	"<osm>"
+	"<node id=\"1\" lat=\"0.001\" lon=\"0.001\"/><node id=\"2\" lat=\"0.0015\" lon=\"0.001\"/>"
+	"<node id=\"3\" lat=\"0.0015\" lon=\"0.0015\"/><node id=\"4\" lat=\"0.001\" lon=\"0.0015\"/>"
+	"<node id=\"5\" lat=\"0.012\" lon=\"0.012\"/><node id=\"6\" lat=\"0.0125\" lon=\"0.012\"/>"
+	"<node id=\"7\" lat=\"0.0125\" lon=\"0.0125\"/><node id=\"8\" lat=\"0.012\" lon=\"0.0125\"/>"
+	"<node id=\"9\" lat=\"0.004\" lon=\"0.007\"/><node id=\"10\" lat=\"0.004\" lon=\"0.009\"/>"
+	"<node id=\"11\" lat=\"0.015\" lon=\"0.001\"/><node id=\"12\" lat=\"0.017\" lon=\"0.001\"/>"
+	"<node id=\"13\" lat=\"0.017\" lon=\"0.003\"/><node id=\"14\" lat=\"0.015\" lon=\"0.003\"/>"
+	"<node id=\"15\" lat=\"0.001\" lon=\"0.015\"/><node id=\"16\" lat=\"0.002\" lon=\"0.015\"/>"
+	"<node id=\"17\" lat=\"0.002\" lon=\"0.016\"/><node id=\"18\" lat=\"0.001\" lon=\"0.016\"/>"
+	"<way id=\"20\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"4\"/><nd ref=\"1\"/><tag k=\"building\" v=\"yes\"/></way>"
+	"<way id=\"21\"><nd ref=\"5\"/><nd ref=\"6\"/><nd ref=\"7\"/><nd ref=\"8\"/><nd ref=\"5\"/><tag k=\"building\" v=\"house\"/></way>"
+	"<way id=\"22\"><nd ref=\"9\"/><nd ref=\"10\"/><tag k=\"highway\" v=\"service\"/></way>"
+	"<way id=\"23\"><nd ref=\"11\"/><nd ref=\"12\"/><nd ref=\"13\"/><nd ref=\"14\"/><nd ref=\"11\"/><tag k=\"landuse\" v=\"grass\"/></way>"
+	"<way id=\"24\"><nd ref=\"15\"/><nd ref=\"16\"/><nd ref=\"17\"/><nd ref=\"18\"/><nd ref=\"15\"/></way>"
+	"<relation id=\"30\"><member type=\"way\" ref=\"24\" role=\"outer\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"</osm>";
+
+const char kChangeDocument[] =
+	"<osmChange version=\"0.6\">"
+	"<create>"
+	"<node id=\"40\" lat=\"0.008\" lon=\"0.008\"/><node id=\"41\" lat=\"0.0085\" lon=\"0.008\"/>"
+	"<node id=\"42\" lat=\"0.0085\" lon=\"0.0085\"/>"
+	"<way id=\"44\"><nd ref=\"40\"/><nd ref=\"41\"/><nd ref=\"42\"/><nd ref=\"40\"/><tag k=\"building\" v=\"shed\"/></way>"
+	"</create>"
+	"<modify>"
+	"<node id=\"8\" lat=\"0.012\" lon=\"0.019\"/><node id=\"7\" lat=\"0.0125\" lon=\"0.019\"/>"
+	"<node id=\"16\" lat=\"0.003\" lon=\"0.015\"/>"
+	"<way id=\"23\"><nd ref=\"11\"/><nd ref=\"12\"/><nd ref=\"13\"/><nd ref=\"14\"/><nd ref=\"11\"/><tag k=\"landuse\" v=\"forest\"/></way>"
+	"</modify>"
+	"<delete>"
+	"<way id=\"22\"/><node id=\"9\"/><node id=\"10\"/>"
+	"</delete>"
+	"</osmChange>";
+
+// The base document with the change applied by hand
+const char kChangedDocument[] =
+	"<osm>"
+	"<node id=\"1\" lat=\"0.001\" lon=\"0.001\"/><node id=\"2\" lat=\"0.0015\" lon=\"0.001\"/>"
+	"<node id=\"3\" lat=\"0.0015\" lon=\"0.0015\"/><node id=\"4\" lat=\"0.001\" lon=\"0.0015\"/>"
+	"<node id=\"5\" lat=\"0.012\" lon=\"0.012\"/><node id=\"6\" lat=\"0.0125\" lon=\"0.012\"/>"
+	"<node id=\"7\" lat=\"0.0125\" lon=\"0.019\"/><node id=\"8\" lat=\"0.012\" lon=\"0.019\"/>"
+	"<node id=\"11\" lat=\"0.015\" lon=\"0.001\"/><node id=\"12\" lat=\"0.017\" lon=\"0.001\"/>"
+	"<node id=\"13\" lat=\"0.017\" lon=\"0.003\"/><node id=\"14\" lat=\"0.015\" lon=\"0.003\"/>"
+	"<node id=\"15\" lat=\"0.001\" lon=\"0.015\"/><node id=\"16\" lat=\"0.003\" lon=\"0.015\"/>"
+	"<node id=\"17\" lat=\"0.002\" lon=\"0.016\"/><node id=\"18\" lat=\"0.001\" lon=\"0.016\"/>"
+	"<node id=\"40\" lat=\"0.008\" lon=\"0.008\"/><node id=\"41\" lat=\"0.0085\" lon=\"0.008\"/>"
+	"<node id=\"42\" lat=\"0.0085\" lon=\"0.0085\"/>"
+	"<way id=\"20\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"4\"/><nd ref=\"1\"/><tag k=\"building\" v=\"yes\"/></way>"
+	"<way id=\"21\"><nd ref=\"5\"/><nd ref=\"6\"/><nd ref=\"7\"/><nd ref=\"8\"/><nd ref=\"5\"/><tag k=\"building\" v=\"house\"/></way>"
+	"<way id=\"23\"><nd ref=\"11\"/><nd ref=\"12\"/><nd ref=\"13\"/><nd ref=\"14\"/><nd ref=\"11\"/><tag k=\"landuse\" v=\"forest\"/></way>"
+	"<way id=\"24\"><nd ref=\"15\"/><nd ref=\"16\"/><nd ref=\"17\"/><nd ref=\"18\"/><nd ref=\"15\"/></way>"
+	"<way id=\"44\"><nd ref=\"40\"/><nd ref=\"41\"/><nd ref=\"42\"/><nd ref=\"40\"/><tag k=\"building\" v=\"shed\"/></way>"
+	"<relation id=\"30\"><member type=\"way\" ref=\"24\" role=\"outer\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"</osm>";
+
+// Relation 50 refers to way 60 before any change adds it, the next change adds the way
+const char kUnresolvedChangeDocument[] =
+	"<osmChange version=\"0.6\"><create>"
+	"<relation id=\"50\"><member type=\"way\" ref=\"60\" role=\"outer\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"</create></osmChange>";
+
+const char kResolvingChangeDocument[] =
+	"<osmChange version=\"0.6\"><create>"
+	"<node id=\"61\" lat=\"0.03\" lon=\"0.03\"/><node id=\"62\" lat=\"0.031\" lon=\"0.03\"/>"
+	"<node id=\"63\" lat=\"0.031\" lon=\"0.031\"/>"
+	"<way id=\"60\"><nd ref=\"61\"/><nd ref=\"62\"/><nd ref=\"63\"/><nd ref=\"61\"/></way>"
+	"</create></osmChange>";
+
+// Moves a node of the outer way of multipolygon 30 and one of building 20 back and forth
+const char* const kMovingChangeDocuments[] = {
+	"<osmChange version=\"0.6\"><modify><node id=\"16\" lat=\"0.0025\" lon=\"0.015\"/><node id=\"2\" lat=\"0.0016\" lon=\"0.001\"/></modify></osmChange>",
+	"<osmChange version=\"0.6\"><modify><node id=\"16\" lat=\"0.003\" lon=\"0.015\"/><node id=\"2\" lat=\"0.0015\" lon=\"0.001\"/></modify></osmChange>",
+};
+
+const int32_t kMovingChangeCount = 200;
+
+const int32_t kZoom = 16;
+
+bool AreLinesEqual(const FLine* left, const FLine* right) {
+	if (left == nullptr || right == nullptr) {
+		return left == right;
+	}
+	if (left->GetVertexCount() != right->GetVertexCount()) {
+		return false;
+	}
+	for (int i = 0; i < left->GetVertexCount(); ++i) {
+		if (!left->GetGlobalPosition(i).Equals(right->GetGlobalPosition(i))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename T>
+bool AreElementsEqual(const ARRAY<T*>& left, const ARRAY<T*>& right) {
+	if (SIZE(left) != SIZE(right)) {
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(left); ++i) {
+		if (left[i]->id != right[i]->id || !AreLinesEqual(left[i]->geometry->GetMainSegment(), right[i]->geometry->GetMainSegment())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AreTilesEqual(const FTileMapData* left, const FTileMapData* right) {
+	if (left == nullptr || right == nullptr) {
+		return left == right;
+	}
+	if (!AreElementsEqual(left->paths, right->paths) || !AreElementsEqual(left->buildings, right->buildings) ||
+		!AreElementsEqual(left->landuse, right->landuse)) {
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(left->landuse); ++i) {
+		if (left->landuse[i]->kind != right->landuse[i]->kind) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const FTileMapData* FindTile(const ARRAY<PartitionedTile>& tiles, int32_t x, int32_t y) {
+	for (const PartitionedTile& tile : tiles) {
+		if (tile.key.x == x && tile.key.y == y) {
+			return tile.data.get();
+		}
+	}
+	return nullptr;
+}
+
+bool IsDirty(const ARRAY<TileKey>& dirtyTiles, int32_t x, int32_t y) {
+	for (const TileKey& tile : dirtyTiles) {
+		if (tile.x == x && tile.y == y) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ReadCache(const char* document, Osm::OsmCache& osmCache, const MapDataParseOptions& options) {
+	Osm::OsmXmlReader reader(document, strlen(document));
+	std::vector<std::string_view> keys(options.tagKeys.begin(), options.tagKeys.end());
+	return Osm::ReadOsmCache(reader, osmCache, Osm::OsmTagFilter(keys, options.isFeatureOnly));
+}
+
+}
+
+// Regression cases for applying an OsmChange to a resident cache. The changed cache must give the same tiles as the
+// changed document read from scratch, and every tile whose output changed must be reported dirty, the ones that did
+// not change must not be. Returns non-zero on failure.
+int RunChangeCheck(int /*argc*/, char** /*argv*/) {
+	MapDataParseOptions options;
+	options.isClippingToTile = true;
+	options.threadCount = 1;
+	Osm::OsmCache osmCache;
+	Osm::OsmCache expectedCache;
+	if (!ReadCache(kBaseDocument, osmCache, options) || !ReadCache(kChangedDocument, expectedCache, options)) {
+		printf("FAIL the documents could not be read\n");
+		return 1;
+	}
+	ARRAY<PartitionedTile> baseTiles;
+	MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, kZoom, baseTiles, options);
+
+	size_t failureCount = 0;
+	ARRAY<TileKey> dirtyTiles;
+	const char kMalformed[] = "<osmChange><modify><node id=\"1\" lat=\"5\" lon=\"5\"/></modify><delete><way id=\"20\"></osmChange>";
+	if (MapDataUtils::ApplyOsmChange(kMalformed, strlen(kMalformed), osmCache, kZoom, dirtyTiles, options) ||
+		osmCache.FindNode(1)->coordinate != Osm::FixedLatLong(10000, 10000)) {
+		printf("FAIL a malformed change must not be applied\n");
+		++failureCount;
+	}
+	if (!MapDataUtils::ApplyOsmChange(kChangeDocument, strlen(kChangeDocument), osmCache, kZoom, dirtyTiles, options)) {
+		printf("FAIL the change could not be applied\n");
+		return 1;
+	}
+	ARRAY<PartitionedTile> changedTiles;
+	ARRAY<PartitionedTile> expectedTiles;
+	MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, kZoom, changedTiles, options);
+	MapDataUtils::ProcessMapDataTilesFromOsmCache(expectedCache, kZoom, expectedTiles, options);
+
+	// Every tile with features before or after the change
+	ARRAY<TileKey> tiles;
+	for (const ARRAY<PartitionedTile>* tileSet : { &baseTiles, &changedTiles, &expectedTiles }) {
+		for (const PartitionedTile& tile : *tileSet) {
+			if (!IsDirty(tiles, tile.key.x, tile.key.y)) {
+				ADD(tiles, tile.key);
+			}
+		}
+	}
+	size_t changedTileCount = 0;
+	for (const TileKey& tile : tiles) {
+		const FTileMapData* changed = FindTile(changedTiles, tile.x, tile.y);
+		if (!AreTilesEqual(changed, FindTile(expectedTiles, tile.x, tile.y))) {
+			printf("FAIL tile %d/%d of the changed cache differs from the one of the changed document\n", tile.x, tile.y);
+			++failureCount;
+		}
+		bool isChanged = !AreTilesEqual(changed, FindTile(baseTiles, tile.x, tile.y));
+		changedTileCount += isChanged ? 1 : 0;
+		if (isChanged != IsDirty(dirtyTiles, tile.x, tile.y)) {
+			printf("FAIL tile %d/%d %s but is %sreported dirty\n", tile.x, tile.y, isChanged ? "changed" : "did not change",
+				IsDirty(dirtyTiles, tile.x, tile.y) ? "" : "not ");
+			++failureCount;
+		}
+	}
+	if (changedTileCount == 0 || changedTileCount == SIZE(tiles)) {
+		printf("FAIL the change must affect some of the %zu tiles but not all, it affected %zu\n", static_cast<size_t>(SIZE(tiles)), changedTileCount);
+		++failureCount;
+	}
+
+	// A member whose entity is missing is kept until a later change adds it
+	bool isApplied = MapDataUtils::ApplyOsmChange(kUnresolvedChangeDocument, strlen(kUnresolvedChangeDocument), osmCache, kZoom, dirtyTiles, options);
+	if (!isApplied || osmCache.unresolvedMembers.size() != 1 || osmCache.FindRelation(50)->outerRingCount != 0) {
+		printf("FAIL the member of relation 50 must wait for way 60\n");
+		++failureCount;
+	}
+	dirtyTiles.clear();
+	isApplied = MapDataUtils::ApplyOsmChange(kResolvingChangeDocument, strlen(kResolvingChangeDocument), osmCache, kZoom, dirtyTiles, options);
+	const Osm::OsmRelation* relation = osmCache.FindRelation(50);
+	if (!isApplied || !osmCache.unresolvedMembers.empty() || relation->memberCount != 1 || !relation->members[0].handle.IsValid() ||
+		osmCache.GetComponent(relation->members[0].handle).id != 60 || relation->outerRingCount != 1 || EMPTY(dirtyTiles)) {
+		printf("FAIL relation 50 must get way 60 as its outer ring once a change adds it\n");
+		++failureCount;
+	}
+
+	// Changes that move nodes only chain the multipolygons of the nodes again, and keep their rings if they come out
+	// the same, so the arena does not grow
+	size_t usedBytes = 0;
+	for (int32_t i = 0; i < kMovingChangeCount; ++i) {
+		const char* document = kMovingChangeDocuments[i % 2];
+		dirtyTiles.clear();
+		if (!MapDataUtils::ApplyOsmChange(document, strlen(document), osmCache, kZoom, dirtyTiles, options) || EMPTY(dirtyTiles)) {
+			printf("FAIL moving change %d could not be applied\n", i);
+			++failureCount;
+			break;
+		}
+		usedBytes = i == 0 ? osmCache.arena.GetUsedBytes() : usedBytes;
+	}
+	if (osmCache.arena.GetUsedBytes() != usedBytes) {
+		printf("FAIL the arena grew from %zu to %zu bytes over %d changes that only move nodes\n", usedBytes, osmCache.arena.GetUsedBytes(),
+			kMovingChangeCount);
+		++failureCount;
+	}
+	printf("%zu change checks failed\n", failureCount);
+	return failureCount == 0 ? 0 : 1;
+}
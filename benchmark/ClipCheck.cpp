@@ -0,0 +1,157 @@
+#include "Benchmarks.h"
+
+#include "MapDataUtils.h"
+#include "TileUtils.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// The tile 8192/8191 at zoom 14 spans about 0.022 degrees north and east of 0/0. Building 10 is inside it, building 11
+// far away, landuse 12 crosses its west border, path 13 crosses the whole tile and path 14 leaves and comes back.
+const char kClipDocument[] =
+	"<osm>"
+	"<node id=\"1\" lat=\"0.005\" lon=\"0.005\"/>"
+	"<node id=\"2\" lat=\"0.006\" lon=\"0.005\"/>"
+	"<node id=\"3\" lat=\"0.006\" lon=\"0.006\"/>"
+	"<node id=\"4\" lat=\"1.005\" lon=\"0.005\"/>"
+	"<node id=\"5\" lat=\"1.006\" lon=\"0.005\"/>"
+	"<node id=\"6\" lat=\"1.006\" lon=\"0.006\"/>"
+	"<node id=\"7\" lat=\"0.005\" lon=\"-0.01\"/>"
+	"<node id=\"8\" lat=\"0.015\" lon=\"-0.01\"/>"
+	"<node id=\"9\" lat=\"0.015\" lon=\"0.01\"/>"
+	"<node id=\"10\" lat=\"0.005\" lon=\"0.01\"/>"
+	"<node id=\"11\" lat=\"0.01\" lon=\"-0.01\"/>"
+	"<node id=\"12\" lat=\"0.01\" lon=\"0.03\"/>"
+	"<node id=\"13\" lat=\"0.01\" lon=\"0.005\"/>"
+	"<node id=\"14\" lat=\"0.015\" lon=\"0.03\"/>"
+	"<node id=\"15\" lat=\"0.015\" lon=\"0.005\"/>"
+	"<way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"1\"/><tag k=\"building\" v=\"yes\"/></way>"
+	"<way id=\"11\"><nd ref=\"4\"/><nd ref=\"5\"/><nd ref=\"6\"/><nd ref=\"4\"/><tag k=\"building\" v=\"yes\"/></way>"
+	"<way id=\"12\"><nd ref=\"7\"/><nd ref=\"8\"/><nd ref=\"9\"/><nd ref=\"10\"/><nd ref=\"7\"/><tag k=\"landuse\" v=\"grass\"/></way>"
+	"<way id=\"13\"><nd ref=\"11\"/><nd ref=\"12\"/><tag k=\"highway\" v=\"residential\"/></way>"
+	"<way id=\"14\"><nd ref=\"13\"/><nd ref=\"12\"/><nd ref=\"14\"/><nd ref=\"15\"/><tag k=\"highway\" v=\"service\"/></way>"
+	"</osm>";
+
+const int32_t kTileX = 8192;
+const int32_t kTileY = 8191;
+const int32_t kZoom = 14;
+
+bool IsLineInside(const FLine* line, double buffer) {
+	for (int i = 0; i < line->GetVertexCount(); ++i) {
+		const double tolerance = 1e-9;
+		VECTOR2D localPosition = line->GetLocalPosition(i);
+		if (localPosition.X < -buffer - tolerance || localPosition.X > 1 + buffer + tolerance ||
+			localPosition.Y < -buffer - tolerance || localPosition.Y > 1 + buffer + tolerance) {
+			return false;
+		}
+	}
+	return line->GetVertexCount() > 0;
+}
+
+bool ParseClipDocument(FTileMapData& mapData, bool isClipping, double buffer, bool isSharingVertices = false) {
+	MapDataParseOptions options;
+	options.isClippingToTile = isClipping;
+	options.clipBuffer = buffer;
+	options.isSharingVertices = isSharingVertices;
+	return MapDataUtils::ProcessMapDataFromOsm(kClipDocument, strlen(kClipDocument), &mapData, kTileX, kTileY, kZoom, options);
+}
+
+// The vertex of the pool the node is, kNoVertex if it is not in the pool
+uint32_t FindNodeVertex(const FVertexPool& pool, int64_t nodeId) {
+	for (int i = 0; i < pool.GetVertexCount(); ++i) {
+		if (pool.nodeIds[i] == nodeId) {
+			return i;
+		}
+	}
+	return FVertexPool::kNoVertex;
+}
+
+}
+
+// Regression cases for clipping the output to the tile. Features outside of it must be dropped, the geometry of the
+// others cut at the border, and the buffer must keep what is near the tile. Returns non-zero on failure.
+int RunClipCheck(int /*argc*/, char** /*argv*/) {
+	size_t failureCount = 0;
+
+	FTileMapData unclipped;
+	if (!ParseClipDocument(unclipped, false, 0) || SIZE(unclipped.buildings) != 2 || SIZE(unclipped.paths) != 2 || SIZE(unclipped.landuse) != 1) {
+		printf("FAIL without clipping every feature must be kept\n");
+		++failureCount;
+	}
+
+	FTileMapData clipped;
+	if (!ParseClipDocument(clipped, true, 0)) {
+		printf("FAIL the document could not be read\n");
+		return 1;
+	}
+	if (SIZE(clipped.buildings) != 1 || clipped.buildings[0]->id != 10) {
+		printf("FAIL only building 10 is in the tile, got %zu buildings\n", static_cast<size_t>(SIZE(clipped.buildings)));
+		++failureCount;
+	}
+	else if (clipped.buildings[0]->geometry->GetMainSegment()->GetVertexCount() != 4) {
+		printf("FAIL building 10 is inside the tile and must not be changed\n");
+		++failureCount;
+	}
+	if (SIZE(clipped.landuse) != 1 || !IsLineInside(clipped.landuse[0]->geometry->GetMainSegment(), 0)) {
+		printf("FAIL landuse 12 must be cut at the west border of the tile\n");
+		++failureCount;
+	}
+	if (SIZE(clipped.paths) != 2) {
+		printf("FAIL both paths cross the tile, got %zu paths\n", static_cast<size_t>(SIZE(clipped.paths)));
+		++failureCount;
+	}
+	else {
+		const FMapGeometry* crossing = clipped.paths[0]->geometry;
+		if (crossing->GetComponentCount() != 1 || !IsLineInside(crossing->GetMainSegment(), 0)) {
+			printf("FAIL path 13 must be cut to a single piece inside the tile\n");
+			++failureCount;
+		}
+		const FMapGeometry* returning = clipped.paths[1]->geometry;
+		if (returning->GetComponentCount() != 2) {
+			printf("FAIL path 14 must be cut into 2 pieces, got %d\n", returning->GetComponentCount());
+			++failureCount;
+		}
+		for (int i = 0; i < returning->GetComponentCount(); ++i) {
+			if (!IsLineInside(returning->GetComponent(i)->GetMainSegment(), 0)) {
+				printf("FAIL piece %d of path 14 is outside of the tile\n", i);
+				++failureCount;
+			}
+		}
+	}
+
+	// Half a tile of buffer reaches past the west end of landuse 12 and the east turn of path 14
+	FTileMapData buffered;
+	if (!ParseClipDocument(buffered, true, 0.5) || SIZE(buffered.landuse) != 1 || SIZE(buffered.paths) != 2 ||
+		buffered.landuse[0]->geometry->GetMainSegment()->GetVertexCount() != 5 || buffered.paths[1]->geometry->GetComponentCount() != 1) {
+		printf("FAIL the buffer must keep the features near the tile whole\n");
+		++failureCount;
+	}
+	// Paths 13 and 14 meet at node 12, which is east of the tile. Clipping leaves the node out of the pool, the pieces
+	// of the paths end in vertices made on the border instead.
+	FTileMapData shared;
+	if (!ParseClipDocument(shared, false, 0, true) || SIZE(shared.paths) != 2) {
+		printf("FAIL the document could not be read with shared vertices\n");
+		++failureCount;
+	}
+	else {
+		uint32_t crossing = FindNodeVertex(shared.vertexPool, 12);
+		uint32_t corner = FindNodeVertex(shared.vertexPool, 1);
+		const FLine* path = shared.paths[0]->geometry->GetMainSegment();
+		if (crossing == FVertexPool::kNoVertex || !shared.vertexPool.IsShared(crossing) || corner == FVertexPool::kNoVertex ||
+			shared.vertexPool.IsShared(corner) || SIZE(path->vertexIndices) != 2 || path->vertexIndices[1] != crossing) {
+			printf("FAIL paths 13 and 14 must share the vertex of node 12, building 10 none\n");
+			++failureCount;
+		}
+	}
+	FTileMapData sharedClipped;
+	if (!ParseClipDocument(sharedClipped, true, 0, true) || SIZE(sharedClipped.paths) != 2 || FindNodeVertex(sharedClipped.vertexPool, 12) != FVertexPool::kNoVertex ||
+		FindNodeVertex(sharedClipped.vertexPool, 13) == FVertexPool::kNoVertex ||
+		sharedClipped.paths[0]->geometry->GetMainSegment()->vertexIndices[0] != FVertexPool::kNoVertex) {
+		printf("FAIL clipping must leave the nodes outside of the tile out of the pool\n");
+		++failureCount;
+	}
+	printf("%zu clip checks failed\n", failureCount);
+	return failureCount == 0 ? 0 : 1;
+}
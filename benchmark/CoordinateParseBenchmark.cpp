@@ -0,0 +1,66 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "OsmParserUtils.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the fixed-point degree decoder of the node store with the double parsers it replaced, on coordinates with
+// the 7 decimals OSM writes. Fails if the converted fixed-point value is not the double std::stod returns.
+int RunCoordinateParseBenchmark(int argc, char** argv) {
+	size_t count = argc >= 1 ? static_cast<size_t>(std::strtoull(argv[0], nullptr, 10)) : 2000000;
+	std::mt19937_64 random(42);
+	std::uniform_int_distribution<int32_t> distribution(-1800000000, 1800000000);
+	std::vector<std::string> texts;
+	texts.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		int32_t fixed = distribution(random);
+		char text[32];
+		snprintf(text, sizeof(text), "%s%d.%07d", fixed < 0 ? "-" : "", std::abs(fixed / 10000000), std::abs(fixed % 10000000));
+		texts.emplace_back(text);
+	}
+
+	double checksum = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (const std::string& text : texts) {
+			checksum += std::stod(text);
+		}
+		printf("%-28s %8.1f ns per coordinate\n", "std::stod", stopwatch.GetElapsedSeconds() * 1e9 / count);
+	}
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (const std::string& text : texts) {
+			double value = 0;
+			std::from_chars(text.data(), text.data() + text.size(), value);
+			checksum += value;
+		}
+		printf("%-28s %8.1f ns per coordinate\n", "std::from_chars (double)", stopwatch.GetElapsedSeconds() * 1e9 / count);
+	}
+	int64_t fixedChecksum = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (const std::string& text : texts) {
+			int32_t value = 0;
+			Osm::ParseFixedDegrees(text, value);
+			fixedChecksum += value;
+		}
+		printf("%-28s %8.1f ns per coordinate\n", "Osm::ParseFixedDegrees", stopwatch.GetElapsedSeconds() * 1e9 / count);
+	}
+
+	size_t mismatchCount = 0;
+	for (const std::string& text : texts) {
+		int32_t value = 0;
+		if (!Osm::ParseFixedDegrees(text, value) || value / Osm::FixedLatLong::kScale != std::stod(text)) {
+			++mismatchCount;
+		}
+	}
+	printf("Coordinate storage per node: %zu bytes fixed-point, %zu bytes as LatLong\n", sizeof(Osm::FixedLatLong), sizeof(LatLong));
+	printf("%zu of %zu coordinates differ from std::stod (checksums %.3f, %lld)\n", mismatchCount, count, checksum, static_cast<long long>(fixedChecksum));
+	return mismatchCount == 0 ? 0 : 1;
+}
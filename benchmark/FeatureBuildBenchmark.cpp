@@ -0,0 +1,225 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+#include "ThreadUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static bool AreLinesEqual(const FLine* left, const FLine* right) {
+	if (left == nullptr || right == nullptr) {
+		return left == right;
+	}
+	if (left->GetVertexCount() != right->GetVertexCount() || left->isClockwise != right->isClockwise) {
+		return false;
+	}
+	// Through the accessors, since the positions of a pooled line are those of the pool
+	for (int i = 0; i < left->GetVertexCount(); ++i) {
+		LatLong leftGlobal = left->GetGlobalPosition(i);
+		LatLong rightGlobal = right->GetGlobalPosition(i);
+		VECTOR2D leftLocal = left->GetLocalPosition(i);
+		VECTOR2D rightLocal = right->GetLocalPosition(i);
+		if (leftGlobal.latitude != rightGlobal.latitude || leftGlobal.longitude != rightGlobal.longitude ||
+			leftLocal.X != rightLocal.X || leftLocal.Y != rightLocal.Y) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool AreGeometriesEqual(const FMapGeometry* left, const FMapGeometry* right) {
+	if (left == nullptr || right == nullptr) {
+		return left == right;
+	}
+	if (left->GetComponentCount() != right->GetComponentCount()) {
+		return false;
+	}
+	for (int i = 0; i < left->GetComponentCount(); ++i) {
+		const FMapGeometry* leftComponent = left->GetComponent(i);
+		const FMapGeometry* rightComponent = right->GetComponent(i);
+		FLineSpan leftHoles = leftComponent->GetHoleSegments();
+		FLineSpan rightHoles = rightComponent->GetHoleSegments();
+		if (!AreLinesEqual(leftComponent->GetMainSegment(), rightComponent->GetMainSegment()) || leftHoles.count != rightHoles.count) {
+			return false;
+		}
+		for (int j = 0; j < leftHoles.count; ++j) {
+			if (!AreLinesEqual(leftHoles[j], rightHoles[j])) {
+				return false;
+			}
+		}
+	}
+	const FCoordinate* leftCoordinate = dynamic_cast<const FCoordinate*>(left);
+	const FCoordinate* rightCoordinate = dynamic_cast<const FCoordinate*>(right);
+	if ((leftCoordinate == nullptr) != (rightCoordinate == nullptr)) {
+		return false;
+	}
+	return leftCoordinate == nullptr || (leftCoordinate->globalPosition.latitude == rightCoordinate->globalPosition.latitude &&
+		leftCoordinate->globalPosition.longitude == rightCoordinate->globalPosition.longitude);
+}
+
+static bool ReportMismatch(const char* kind, size_t index, int64_t id) {
+	printf("MISMATCH %s %zu (id %lld) differs between the serial and the parallel output\n", kind, index, static_cast<long long>(id));
+	return false;
+}
+
+// The parallel output must be the serial one, element by element and in the same order
+static bool AreOutputsEqual(const FTileMapData& serial, const FTileMapData& parallel) {
+	if (SIZE(serial.paths) != SIZE(parallel.paths) || SIZE(serial.buildings) != SIZE(parallel.buildings) ||
+		SIZE(serial.landuse) != SIZE(parallel.landuse)) {
+		printf("MISMATCH element counts differ between the serial and the parallel output\n");
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(serial.paths); ++i) {
+		const FPathData* left = serial.paths[i];
+		const FPathData* right = parallel.paths[i];
+		if (left->id != right->id || left->pathType != right->pathType || left->surfaceMaterial != right->surfaceMaterial ||
+			!AreGeometriesEqual(left->geometry, right->geometry)) {
+			return ReportMismatch("path", i, left->id);
+		}
+	}
+	for (size_t i = 0; i < SIZE(serial.landuse); ++i) {
+		const FLanduseData* left = serial.landuse[i];
+		const FLanduseData* right = parallel.landuse[i];
+		if (left->id != right->id || left->kind != right->kind || !AreGeometriesEqual(left->geometry, right->geometry)) {
+			return ReportMismatch("landuse", i, left->id);
+		}
+	}
+	for (size_t i = 0; i < SIZE(serial.buildings); ++i) {
+		const FBuildingData* left = serial.buildings[i];
+		const FBuildingData* right = parallel.buildings[i];
+		bool isLanduseEqual = (left->belongingLanduse == nullptr) == (right->belongingLanduse == nullptr) &&
+			(left->belongingLanduse == nullptr || left->belongingLanduse->id == right->belongingLanduse->id);
+		if (left->id != right->id || left->kind != right->kind || left->height != right->height || left->levels != right->levels ||
+			left->roofShape != right->roofShape || left->buildingColor != right->buildingColor || left->roofColor != right->roofColor ||
+			!isLanduseEqual || !AreGeometriesEqual(left->geometry, right->geometry)) {
+			return ReportMismatch("building", i, left->id);
+		}
+	}
+	return true;
+}
+
+static double BuildFeatures(const Osm::OsmCache& osmCache, int32_t threadCount, int32_t repeatCount, FTileMapData& mapData, bool isSharingVertices = false) {
+	MapDataParseOptions options;
+	options.threadCount = threadCount;
+	options.isSharingVertices = isSharingVertices;
+	double bestSeconds = 0.0;
+	for (int32_t i = 0; i < repeatCount; ++i) {
+		mapData.Reset();
+		Benchmark::Stopwatch stopwatch;
+		MapDataUtils::ProcessMapDataFromOsmCache(osmCache, &mapData, 0, 0, 14, options);
+		double seconds = stopwatch.GetElapsedSeconds();
+		bestSeconds = i == 0 ? seconds : std::min(bestSeconds, seconds);
+	}
+	return bestSeconds;
+}
+
+// Every vertex of the lines must be the one of the pool it refers to. Counts the vertices of the lines, the vertices
+// of the pool that several lines share and the bytes that hold the vertices of the lines, the pool included.
+static bool AreVerticesPooled(const FTileMapData& mapData, size_t& lineVertexCount, size_t& sharedVertexCount, size_t& vertexBytes) {
+	const FVertexPool& pool = mapData.vertexPool;
+	lineVertexCount = 0;
+	vertexBytes = 0;
+	auto isLinePooled = [&](const FLine* line) {
+		lineVertexCount += line->GetVertexCount();
+		vertexBytes += SIZE(line->vertexIndices) * sizeof(uint32_t) + (line->IsPooled() ? 0 : line->GetVertexCount() * 4 * sizeof(double));
+		if (static_cast<int>(SIZE(line->vertexIndices)) != line->GetVertexCount()) {
+			return false;
+		}
+		for (int i = 0; i < line->GetVertexCount(); ++i) {
+			uint32_t vertexIndex = line->vertexIndices[i];
+			if (vertexIndex >= static_cast<uint32_t>(pool.GetVertexCount()) || pool.lineCounts[vertexIndex] == 0 ||
+				!pool.GetGlobalPosition(vertexIndex).Equals(line->GetGlobalPosition(i)) ||
+				pool.localX[vertexIndex] != line->GetLocalPosition(i).X || pool.localY[vertexIndex] != line->GetLocalPosition(i).Y) {
+				return false;
+			}
+		}
+		return true;
+	};
+	bool isPooled = true;
+	auto checkGeometry = [&](const FMapGeometry* geometry) {
+		for (int i = 0; i < geometry->GetComponentCount(); ++i) {
+			const FLine* line = geometry->GetComponent(i)->GetMainSegment();
+			isPooled = isPooled && (line == nullptr || isLinePooled(line));
+			for (const FLine* hole : geometry->GetComponent(i)->GetHoleSegments()) {
+				isPooled = isPooled && isLinePooled(hole);
+			}
+		}
+	};
+	for (const FPathData* path : mapData.paths) {
+		checkGeometry(path->geometry);
+	}
+	for (const FBuildingData* building : mapData.buildings) {
+		checkGeometry(building->geometry);
+	}
+	for (const FLanduseData* landuse : mapData.landuse) {
+		checkGeometry(landuse->geometry);
+	}
+	vertexBytes += pool.GetVertexCount() * (sizeof(int64_t) + 4 * sizeof(double) + sizeof(uint32_t));
+	sharedVertexCount = 0;
+	for (int i = 0; i < pool.GetVertexCount(); ++i) {
+		sharedVertexCount += pool.IsShared(i) ? 1 : 0;
+	}
+	return isPooled;
+}
+
+// Times building the output features from an already read cache on one thread and on several, and fails if the
+// parallel output differs from the serial one in anything, including the order of the elements. The thread count
+// defaults to one per core but can be set higher, so that the merge is also checked on machines with few cores.
+int RunFeatureBuildBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	int32_t threadCount = argc >= 2 ? std::atoi(argv[1]) : ThreadUtils::GetHardwareThreadCount();
+	int32_t repeatCount = argc >= 3 ? std::atoi(argv[2]) : 3;
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path.c_str())) {
+		printf("Could not open %s\n", path.c_str());
+		return 1;
+	}
+	Osm::OsmCache osmCache;
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	if (!Osm::ReadOsmCache(reader, osmCache)) {
+		printf("Could not parse %s\n", path.c_str());
+		return 1;
+	}
+
+	FTileMapData serial;
+	double serialSeconds = BuildFeatures(osmCache, 1, repeatCount, serial);
+	printf("%-40s %9.2f ms  %zu paths, %zu buildings, %zu landuse areas\n", "Features, 1 thread", serialSeconds * 1000.0,
+		static_cast<size_t>(SIZE(serial.paths)), static_cast<size_t>(SIZE(serial.buildings)), static_cast<size_t>(SIZE(serial.landuse)));
+
+	FTileMapData shared;
+	double sharedSeconds = BuildFeatures(osmCache, threadCount, repeatCount, shared, true);
+	std::string sharedLabel = "Features, shared vertices, " + std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+	size_t lineVertexCount = 0;
+	size_t sharedVertexCount = 0;
+	size_t vertexBytes = 0;
+	bool isPooled = AreVerticesPooled(shared, lineVertexCount, sharedVertexCount, vertexBytes);
+	printf("%-40s %9.2f ms  %zu line vertices, %d pool vertices, %zu shared, %.1f bytes per line vertex instead of %zu\n", sharedLabel.c_str(),
+		sharedSeconds * 1000.0, lineVertexCount, shared.vertexPool.GetVertexCount(), sharedVertexCount,
+		lineVertexCount == 0 ? 0.0 : static_cast<double>(vertexBytes) / lineVertexCount, 4 * sizeof(double));
+	if (!isPooled || !AreOutputsEqual(serial, shared)) {
+		printf("MISMATCH the lines do not match the vertex pool\n");
+		return 1;
+	}
+	if (threadCount <= 1) {
+		return 0;
+	}
+	FTileMapData parallel;
+	double parallelSeconds = BuildFeatures(osmCache, threadCount, repeatCount, parallel);
+	std::string label = "Features, " + std::to_string(threadCount) + " threads";
+	printf("%-40s %9.2f ms  %.2fx on %d hardware threads\n", label.c_str(), parallelSeconds * 1000.0, serialSeconds / parallelSeconds,
+		ThreadUtils::GetHardwareThreadCount());
+	if (!AreOutputsEqual(serial, parallel)) {
+		return 1;
+	}
+	printf("  identical to the serial output\n");
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "OsmIdIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Compares the flat id index of the cache with the std::unordered_map it replaced: build time, lookups of present and
+// of missing ids in random order, and heap bytes per entry. Ids are increasing with gaps, like the node ids of an
+// extract. Fails if the two disagree on any lookup.
+int RunIdIndexBenchmark(int argc, char** argv) {
+	size_t count = argc >= 1 ? static_cast<size_t>(std::strtoull(argv[0], nullptr, 10)) : 2000000;
+	std::mt19937_64 random(42);
+	std::vector<uint64_t> ids(count);
+	uint64_t id = 20000000;
+	for (uint64_t& value : ids) {
+		id += 1 + random() % 8;
+		value = id;
+	}
+	std::vector<uint64_t> hits = ids;
+	std::shuffle(hits.begin(), hits.end(), random);
+	std::vector<uint64_t> misses(count);
+	for (uint64_t& value : misses) {
+		value = id + 1 + random() % (id * 4);
+	}
+
+	std::unordered_map<uint64_t, uint32_t> map;
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < count; ++i) {
+			map[ids[i]] = static_cast<uint32_t>(i);
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+		printf("%-28s build %6.1f ns per id, %5.1f bytes per entry\n", "std::unordered_map", seconds * 1e9 / count,
+			static_cast<double>(heap.GetStats().liveBytes) / count);
+	}
+	Osm::OsmIdIndex index;
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < count; ++i) {
+			index.Insert(ids[i], static_cast<uint32_t>(i));
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+		printf("%-28s build %6.1f ns per id, %5.1f bytes per entry\n", "Osm::OsmIdIndex", seconds * 1e9 / count,
+			static_cast<double>(heap.GetStats().liveBytes) / count);
+	}
+
+	uint64_t mapChecksum = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (uint64_t hit : hits) {
+			mapChecksum += map.find(hit)->second;
+		}
+		double hitSeconds = stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (uint64_t miss : misses) {
+			mapChecksum += map.find(miss) == map.end() ? 1 : 0;
+		}
+		printf("%-28s hit %6.1f ns, miss %6.1f ns per lookup\n", "std::unordered_map", hitSeconds * 1e9 / count,
+			stopwatch.GetElapsedSeconds() * 1e9 / count);
+	}
+	uint64_t indexChecksum = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (uint64_t hit : hits) {
+			indexChecksum += index.Find(hit);
+		}
+		double hitSeconds = stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (uint64_t miss : misses) {
+			indexChecksum += index.Find(miss) == Osm::OsmIdIndex::kInvalidIndex ? 1 : 0;
+		}
+		printf("%-28s hit %6.1f ns, miss %6.1f ns per lookup\n", "Osm::OsmIdIndex", hitSeconds * 1e9 / count,
+			stopwatch.GetElapsedSeconds() * 1e9 / count);
+	}
+
+	bool isEqual = mapChecksum == indexChecksum && index.GetSize() == map.size();
+	printf("%zu ids, checksums %s\n", count, isEqual ? "equal" : "DIFFER");
+	return isEqual ? 0 : 1;
+}
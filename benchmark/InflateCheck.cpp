@@ -0,0 +1,103 @@
+#include "Benchmarks.h"
+
+#include "ZlibUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct InflateCase {
+	const char* name;
+	std::vector<uint8_t> input;
+	size_t outputSize;
+	bool isValid;
+	// The text a valid stream must give, not compared if null
+	const char* output = nullptr;
+};
+
+const char kHelloText[] = "hello hello hello hello, hello world";
+// Long enough for zlib to pick a dynamic Huffman block, like the blobs of PBF files
+const char kTagText[] = "way node relation member way node tag building landuse highway residential way node tag name way relation member outer "
+	"inner node way";
+
+bool RunCase(const InflateCase& inflateCase) {
+	// The input is copied into an exactly sized heap block, so that a sanitizer catches any read past its end
+	std::vector<uint8_t> input(inflateCase.input);
+	std::vector<uint8_t> output(inflateCase.outputSize);
+	bool isValid = ZlibUtils::Uncompress(input.data(), input.size(), output.data(), output.size());
+	if (isValid != inflateCase.isValid) {
+		printf("FAIL %s: expected %s\n", inflateCase.name, inflateCase.isValid ? "success" : "failure");
+		return false;
+	}
+	if (isValid && inflateCase.output != nullptr && memcmp(output.data(), inflateCase.output, output.size()) != 0) {
+		printf("FAIL %s: wrong output\n", inflateCase.name);
+		return false;
+	}
+	return true;
+}
+
+}
+
+// Regression cases for ZlibUtils::Uncompress on valid, truncated and corrupt streams. Returns non-zero on failure.
+int RunInflateCheck(int /*argc*/, char** /*argv*/) {
+	const size_t helloSize = sizeof(kHelloText) - 1;
+	const size_t tagSize = sizeof(kTagText) - 1;
+	const std::vector<uint8_t> fixedHuffman = { 0x78, 0xda, 0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x27, 0x75, 0xa0, 0x9c,
+		0xf2, 0xfc, 0xa2, 0x9c, 0x14, 0x00, 0xf6, 0xbc, 0x0d, 0x59 };
+	const uint8_t storedHeader[] = { 0x78, 0x01, 0x01, 0x24, 0x00, 0xdb, 0xff };
+	const uint8_t helloChecksum[] = { 0xf6, 0xbc, 0x0d, 0x59 };
+	std::vector<uint8_t> stored;
+	stored.reserve(sizeof(storedHeader) + helloSize + sizeof(helloChecksum));
+	stored.insert(stored.end(), storedHeader, storedHeader + sizeof(storedHeader));
+	stored.insert(stored.end(), kHelloText, kHelloText + helloSize);
+	stored.insert(stored.end(), helloChecksum, helloChecksum + sizeof(helloChecksum));
+	// kTagText compressed by zlib 1.2.13 at level 9, a single final block of BTYPE 2
+	const std::vector<uint8_t> dynamicHuffman = { 0x78, 0xda, 0x55, 0xcc, 0x51, 0x0a, 0xc0, 0x20, 0x0c, 0x03, 0xd0, 0xab, 0xf4, 0x6a,
+		0x95, 0x16, 0x2d, 0xd4, 0x08, 0x5a, 0x91, 0xdd, 0x7e, 0x6e, 0x63, 0x1f, 0xfe, 0xe4, 0x27, 0x2f, 0x59, 0x7c, 0x11, 0x9a, 0x28,
+		0x75, 0x75, 0x0e, 0x6b, 0xa0, 0xaa, 0x35, 0x69, 0xa7, 0xf5, 0x17, 0xc1, 0x99, 0xd2, 0x34, 0x17, 0x43, 0x26, 0x67, 0xc8, 0x1c,
+		0x4a, 0xc5, 0x72, 0x79, 0x44, 0xd7, 0x61, 0xa2, 0x08, 0x63, 0x3f, 0x17, 0xe0, 0xaa, 0xf4, 0x89, 0xf3, 0xb7, 0xcd, 0xd8, 0x69,
+		0xc0, 0xce, 0x57, 0x6f, 0x74, 0x03, 0xfe, 0x69, 0x31, 0x9d };
+	// "hello" in a non-final stored block, followed by an empty final stored block
+	const std::vector<uint8_t> twoStoredBlocks = { 0x78, 0x01, 0x00, 0x05, 0x00, 0xfa, 0xff, 'h', 'e', 'l', 'l', 'o',
+		0x01, 0x00, 0x00, 0xff, 0xff, 0x06, 0x2c, 0x02, 0x15 };
+
+	std::vector<InflateCase> cases = {
+		{ "fixed huffman", fixedHuffman, helloSize, true, kHelloText },
+		{ "stored", stored, helloSize, true, kHelloText },
+		{ "dynamic huffman", dynamicHuffman, tagSize, true, kTagText },
+		{ "two stored blocks", twoStoredBlocks, 5, true },
+		{ "output larger than the stream", fixedHuffman, helloSize + 1, false },
+		{ "output smaller than the stream", stored, helloSize - 1, false },
+		// A non-final empty stored block, the stream ends right after it
+		{ "truncated after a stored block", { 0x78, 0x01, 0x00, 0x00, 0x00, 0xff, 0xff }, 16, false },
+		{ "stored length complement mismatch", { 0x78, 0x01, 0x01, 0x05, 0x00, 0xfa, 0xfe, 'h', 'e', 'l', 'l', 'o', 0, 0, 0, 0 }, 5, false },
+		{ "reserved block type", { 0x78, 0x01, 0x07, 0x00, 0x00, 0x00, 0x00 }, 1, false },
+		{ "bad header checksum", { 0x78, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01 }, 0, false },
+	};
+	std::vector<uint8_t> badChecksum = fixedHuffman;
+	badChecksum.back() ^= 1;
+	cases.push_back({ "adler32 mismatch", badChecksum, helloSize, false });
+	// A flipped bit in the header of the dynamic block, where its code lengths are
+	std::vector<uint8_t> badCodeLengths = dynamicHuffman;
+	badCodeLengths[3] ^= 0x10;
+	cases.push_back({ "corrupt dynamic huffman header", badCodeLengths, tagSize, false });
+	// Every truncation of a valid stream must fail without reading past the end
+	const std::vector<uint8_t>* validStreams[] = { &fixedHuffman, &stored, &twoStoredBlocks, &dynamicHuffman };
+	for (const std::vector<uint8_t>* stream : validStreams) {
+		size_t outputSize = stream == &twoStoredBlocks ? 5 : stream == &dynamicHuffman ? tagSize : helloSize;
+		for (size_t size = 0; size < stream->size(); ++size) {
+			cases.push_back({ "truncated stream", std::vector<uint8_t>(stream->begin(), stream->begin() + size), outputSize, false });
+		}
+	}
+
+	size_t failureCount = 0;
+	for (const InflateCase& inflateCase : cases) {
+		if (!RunCase(inflateCase)) {
+			++failureCount;
+		}
+	}
+	printf("%zu of %zu inflate cases passed\n", cases.size() - failureCount, cases.size());
+	return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Shows how many bytes the input handling of each entry point allocates on top of the parse itself.
+int RunInputCopyBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	const double megabyte = 1024.0 * 1024.0;
+
+	std::string content;
+	if (!Benchmark::ReadFile(path, content)) {
+		printf("Could not read %s\n", path.c_str());
+		return 1;
+	}
+
+	Benchmark::HeapStats stringStats;
+	{
+		// What the C API used to do: wrap the caller's null-terminated buffer into a string, then copy it again
+		Benchmark::HeapScope heap;
+		FTileMapData mapData;
+		std::string osmDataStr(content.c_str());
+		MapDataUtils::ProcessMapDataFromOsm(std::string(osmDataStr), &mapData);
+		stringStats = heap.GetStats();
+	}
+	Benchmark::HeapStats spanStats;
+	{
+		Benchmark::HeapScope heap;
+		FTileMapData mapData;
+		MapDataUtils::ProcessMapDataFromOsm(content.c_str(), strlen(content.c_str()), &mapData);
+		spanStats = heap.GetStats();
+	}
+	Benchmark::HeapStats fileStats;
+	{
+		// Compared to reading the file into a string first
+		Benchmark::HeapScope heap;
+		FTileMapData mapData;
+		std::string fileContent;
+		Benchmark::ReadFile(path, fileContent);
+		MapDataUtils::ProcessMapDataFromOsm(fileContent, &mapData);
+		fileStats = heap.GetStats();
+	}
+	Benchmark::HeapStats mappedStats;
+	{
+		Benchmark::HeapScope heap;
+		FTileMapData mapData;
+		MapDataUtils::ProcessMapDataFromOsmFile(path, &mapData);
+		mappedStats = heap.GetStats();
+	}
+
+	printf("Input size %.1f MB\n", content.size() / megabyte);
+	printf("%-40s allocated %9.1f MB  peak heap %9.1f MB\n", "std::string copies (previous C API)", stringStats.allocatedBytes / megabyte, stringStats.peakBytes / megabyte);
+	printf("%-40s allocated %9.1f MB  peak heap %9.1f MB\n", "ProcessMapDataFromOsm(const char*, size)", spanStats.allocatedBytes / megabyte, spanStats.peakBytes / megabyte);
+	printf("  saved %.1f MB\n", (double(stringStats.allocatedBytes) - double(spanStats.allocatedBytes)) / megabyte);
+	printf("%-40s allocated %9.1f MB  peak heap %9.1f MB\n", "file read into std::string", fileStats.allocatedBytes / megabyte, fileStats.peakBytes / megabyte);
+	printf("%-40s allocated %9.1f MB  peak heap %9.1f MB\n", "ProcessMapDataFromOsmFile (mmap)", mappedStats.allocatedBytes / megabyte, mappedStats.peakBytes / megabyte);
+	printf("  saved %.1f MB\n", (double(fileStats.allocatedBytes) - double(mappedStats.allocatedBytes)) / megabyte);
+	return 0;
+}
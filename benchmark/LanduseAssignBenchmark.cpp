@@ -0,0 +1,104 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MemoryArena.h"
+#include "ShapeUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// The linear scan is quadratic, it is not run on more pairs
+static constexpr double kMaxLinearPairCount = 2e10;
+
+// A star shaped ring around a random point of the area, closed like the ways of buildings and landuse areas
+static FLine* CreateRing(MemoryArena& arena, double x, double y, double radius, int vertexCount, std::mt19937& random) {
+	std::uniform_real_distribution<double> scale(0.5, 1.0);
+	FLine* ring = arena.New<FLine>();
+	ring->ReserveVertices(vertexCount + 1);
+	for (int i = 0; i < vertexCount; ++i) {
+		double angle = 2.0 * 3.14159265358979 * i / vertexCount;
+		double r = radius * scale(random);
+		ring->AddVertex(LatLong(0, 0), VECTOR2D(x + r * std::cos(angle), y + r * std::sin(angle)));
+	}
+	ring->AddVertex(ring->GetGlobalPosition(0), ring->GetLocalPosition(0));
+	ring->isClosed = true;
+	return ring;
+}
+
+// The assignment the grid replaced: every building against every landuse area in order
+static void AssignLinear(const std::vector<const FLine*>& buildings, const std::vector<const FLine*>& landuse, std::vector<int>& result) {
+	for (size_t i = 0; i < buildings.size(); ++i) {
+		result[i] = -1;
+		for (size_t j = 0; j < landuse.size(); ++j) {
+			if (ShapeUtils::IsPointInShape(landuse[j], buildings[i]->GetLocalPosition(0))) {
+				result[i] = static_cast<int>(j);
+				break;
+			}
+		}
+	}
+}
+
+// Assigns buildings to the first landuse area their first vertex is in, through the grid of landuse boxes and by
+// testing every area, on areas that grow like a city: one landuse area per the given number of buildings, overlapping
+// and of very different sizes, a few covering most of the area. Fails if the two give a different area for a building.
+int RunLanduseAssignBenchmark(int argc, char** argv) {
+	size_t buildingsPerLanduse = argc >= 1 ? std::max<size_t>(std::strtoull(argv[0], nullptr, 10), 1) : 40;
+	const size_t buildingCounts[] = { 1000, 10000, 100000, 1000000 };
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0.0, 1.0);
+	size_t failureCount = 0;
+	for (size_t buildingCount : buildingCounts) {
+		size_t landuseCount = std::max<size_t>(buildingCount / buildingsPerLanduse, 1);
+		// Landuse areas are as large as a few hundred buildings, some of them as large as a district or the whole area
+		double side = std::sqrt(static_cast<double>(landuseCount));
+		MemoryArena arena;
+		std::vector<const FLine*> landuse(landuseCount);
+		for (size_t i = 0; i < landuseCount; ++i) {
+			int kind = random() % 100;
+			double radius = (kind < 1 ? 0.3 : kind < 10 ? 4.0 / side : 1.0 / side) * (0.5 + position(random));
+			landuse[i] = CreateRing(arena, position(random), position(random), radius, 8 + random() % 120, random);
+		}
+		std::vector<const FLine*> buildings(buildingCount);
+		for (size_t i = 0; i < buildingCount; ++i) {
+			buildings[i] = CreateRing(arena, position(random), position(random), 0.02 / side, 4, random);
+		}
+		// Some buildings share their first node with the border of a landuse area, where rounding decides
+		for (size_t i = 0; i < buildingCount; i += 10) {
+			const FLine* area = landuse[random() % landuseCount];
+			FLine* building = arena.New<FLine>();
+			building->AddVertex(LatLong(0, 0), area->GetLocalPosition(random() % area->GetVertexCount()));
+			buildings[i] = building;
+		}
+
+		std::vector<int> gridResult(buildingCount);
+		Benchmark::Stopwatch stopwatch;
+		ShapeUtils::ShapeGrid grid;
+		grid.Build(landuse.data(), static_cast<int>(landuseCount));
+		double buildSeconds = stopwatch.GetElapsedSeconds();
+		for (size_t i = 0; i < buildingCount; ++i) {
+			gridResult[i] = grid.FindFirstContainingShape(buildings[i]->GetLocalPosition(0));
+		}
+		double gridSeconds = stopwatch.GetElapsedSeconds();
+		size_t assignedCount = std::count_if(gridResult.begin(), gridResult.end(), [](int landuseIndex) { return landuseIndex >= 0; });
+		printf("%8zu buildings, %6zu landuse areas, %5.1f%% assigned  grid %9.2f ms (%.1f ns per building, %.2f ms to build)", buildingCount,
+			landuseCount, 100.0 * assignedCount / buildingCount, gridSeconds * 1000.0, gridSeconds * 1e9 / buildingCount, buildSeconds * 1000.0);
+		if (static_cast<double>(buildingCount) * landuseCount <= kMaxLinearPairCount) {
+			std::vector<int> linearResult(buildingCount);
+			stopwatch.Restart();
+			AssignLinear(buildings, landuse, linearResult);
+			double linearSeconds = stopwatch.GetElapsedSeconds();
+			printf("  linear scan %9.2f ms", linearSeconds * 1000.0);
+			if (linearResult != gridResult) {
+				size_t mismatch = std::mismatch(linearResult.begin(), linearResult.end(), gridResult.begin()).first - linearResult.begin();
+				printf("\nMISMATCH building %zu is in landuse %d by the linear scan, %d by the grid", mismatch, linearResult[mismatch], gridResult[mismatch]);
+				++failureCount;
+			}
+		}
+		printf("\n");
+	}
+	return failureCount == 0 ? 0 : 1;
+}
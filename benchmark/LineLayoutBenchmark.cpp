@@ -0,0 +1,111 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MemoryArena.h"
+#include "ShapeUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static constexpr int kAreaRepeatCount = 20;
+
+// The layout the coordinate streams replaced: a vector of pointers to coordinates allocated one by one in the arena
+struct PointerLine {
+	std::vector<FCoordinate*> coordinates;
+};
+
+static double CalculatePointerLineArea(const PointerLine& line) {
+	double result = 0;
+	int count = static_cast<int>(line.coordinates.size());
+	for (int i = 0; i < count; ++i) {
+		int next = i + 1 < count ? i + 1 : 0;
+		result += (line.coordinates[next]->localPosition.X - line.coordinates[i]->localPosition.X) *
+			(line.coordinates[next]->localPosition.Y + line.coordinates[i]->localPosition.Y);
+	}
+	return result;
+}
+
+// Builds the same random rings in the pointer layout and in the coordinate streams of FLine, comparing heap bytes per
+// vertex and the throughput of the shoelace area over every ring. Fails if the two layouts give a different area.
+int RunLineLayoutBenchmark(int argc, char** argv) {
+	size_t lineCount = argc >= 1 ? static_cast<size_t>(std::strtoull(argv[0], nullptr, 10)) : 100000;
+	int vertexCount = argc >= 2 ? std::max(atoi(argv[1]), 3) : 16;
+	size_t totalVertexCount = lineCount * vertexCount;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> radius(0.001, 0.01);
+	std::uniform_real_distribution<double> center(0.0, 1.0);
+	std::vector<VECTOR2D> positions(totalVertexCount);
+	for (size_t i = 0; i < lineCount; ++i) {
+		double x = center(random);
+		double y = center(random);
+		for (int j = 0; j < vertexCount; ++j) {
+			double angle = 2.0 * 3.14159265358979 * j / vertexCount;
+			double r = radius(random);
+			positions[i * vertexCount + j] = VECTOR2D(x + r * std::cos(angle), y + r * std::sin(angle));
+		}
+	}
+
+	MemoryArena pointerArena;
+	std::vector<PointerLine> pointerLines(lineCount);
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < lineCount; ++i) {
+			pointerLines[i].coordinates.reserve(vertexCount);
+			for (int j = 0; j < vertexCount; ++j) {
+				FCoordinate* coordinate = pointerArena.New<FCoordinate>();
+				coordinate->localPosition = positions[i * vertexCount + j];
+				pointerLines[i].coordinates.push_back(coordinate);
+			}
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+		printf("%-28s build %6.1f ns per vertex, %5.1f bytes per vertex\n", "FCoordinate pointers", seconds * 1e9 / totalVertexCount,
+			static_cast<double>(heap.GetStats().liveBytes) / totalVertexCount);
+	}
+	MemoryArena lineArena;
+	std::vector<FLine*> lines(lineCount);
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < lineCount; ++i) {
+			lines[i] = lineArena.New<FLine>();
+			lines[i]->ReserveVertices(vertexCount);
+			for (int j = 0; j < vertexCount; ++j) {
+				lines[i]->AddVertex(LatLong(0, 0), positions[i * vertexCount + j]);
+			}
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+		printf("%-28s build %6.1f ns per vertex, %5.1f bytes per vertex\n", "FLine streams", seconds * 1e9 / totalVertexCount,
+			static_cast<double>(heap.GetStats().liveBytes) / totalVertexCount);
+	}
+
+	double pointerArea = 0;
+	Benchmark::Stopwatch stopwatch;
+	for (int repeat = 0; repeat < kAreaRepeatCount; ++repeat) {
+		for (const PointerLine& line : pointerLines) {
+			pointerArea += CalculatePointerLineArea(line);
+		}
+	}
+	double pointerSeconds = stopwatch.GetElapsedSeconds();
+	double lineArea = 0;
+	stopwatch.Restart();
+	for (int repeat = 0; repeat < kAreaRepeatCount; ++repeat) {
+		for (FLine* line : lines) {
+			lineArea += ShapeUtils::CalculateShapeArea(line);
+		}
+	}
+	double lineSeconds = stopwatch.GetElapsedSeconds();
+	double vertexRate = static_cast<double>(totalVertexCount) * kAreaRepeatCount / 1e6;
+	printf("%-28s area  %6.1f M vertices per s\n", "FCoordinate pointers", vertexRate / pointerSeconds);
+	printf("%-28s area  %6.1f M vertices per s\n", "FLine streams", vertexRate / lineSeconds);
+	// The kernel sums in another order, so the last bits may differ
+	if (std::abs(pointerArea - lineArea) > 1e-9 * std::abs(pointerArea)) {
+		printf("MISMATCH areas differ: %.17g vs %.17g\n", pointerArea, lineArea);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,171 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "OsmParserUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// The pairwise scan is quadratic, it is not run on larger relations
+static constexpr size_t kMaxPairwiseWayCount = 20000;
+static constexpr uint32_t kNodesPerWay = 8;
+// Circles are this far apart in latitude, in 1e-7 degrees, and do not touch
+static constexpr int32_t kCircleSpacing = 10000000;
+static constexpr double kCircleRadius = 4000000.0;
+static constexpr size_t kMaxCircleCount = 200;
+
+// The assembly the endpoint index replaced: a ring starts at the first way left, every way left is scanned for one
+// continuing it. Returns the number of closed rings.
+static size_t ChainPairwise(const Osm::OsmCache& osmCache, const Osm::OsmRelation& relation) {
+	uint32_t outerRole = Osm::GetTagDictionary().Find("outer");
+	std::vector<uint32_t> wayIndices;
+	for (uint32_t i = 0; i < relation.memberCount; ++i) {
+		if (relation.members[i].role == outerRole) {
+			wayIndices.push_back(relation.members[i].handle.index);
+		}
+	}
+	size_t closedCount = 0;
+	while (!wayIndices.empty()) {
+		const Osm::OsmWay* way = &osmCache.ways[wayIndices[0]];
+		uint32_t startNodeIndex = way->nodeIndices[0];
+		uint32_t nodeIndex = way->nodeIndices[way->nodeCount - 1];
+		wayIndices.erase(wayIndices.begin());
+		while (nodeIndex != startNodeIndex && !wayIndices.empty()) {
+			auto next = wayIndices.begin();
+			for (; next != wayIndices.end(); ++next) {
+				const Osm::OsmWay& candidate = osmCache.ways[*next];
+				if (candidate.nodeIndices[0] == nodeIndex || candidate.nodeIndices[candidate.nodeCount - 1] == nodeIndex) {
+					break;
+				}
+			}
+			if (next == wayIndices.end()) {
+				break;
+			}
+			const Osm::OsmWay& candidate = osmCache.ways[*next];
+			nodeIndex = candidate.nodeIndices[0] == nodeIndex ? candidate.nodeIndices[candidate.nodeCount - 1] : candidate.nodeIndices[0];
+			wayIndices.erase(next);
+		}
+		if (nodeIndex == startNodeIndex) {
+			++closedCount;
+		}
+	}
+	return closedCount;
+}
+
+// A multipolygon of several circles split into short ways, listed in random order and half of them reversed, like the
+// boundaries of large lakes, forests or administrative areas. The holes are small squares in random circles, like the
+// clearings of a forest, the number of them in each circle is counted.
+static void CreateMultipolygon(Osm::OsmCache& osmCache, size_t wayCount, size_t ringCount, size_t holeCount, std::vector<uint32_t>& holeCounts,
+	std::mt19937& random) {
+	uint32_t outerRole = Osm::GetTagDictionary().Intern("outer");
+	uint32_t innerRole = Osm::GetTagDictionary().Intern("inner");
+	std::vector<Osm::OsmMemberReference> members;
+	uint64_t nodeId = 1;
+	uint64_t wayId = 1;
+	for (size_t ring = 0; ring < ringCount; ++ring) {
+		size_t ringWayCount = wayCount / ringCount + (ring < wayCount % ringCount ? 1 : 0);
+		size_t nodeCount = ringWayCount * (kNodesPerWay - 1);
+		uint64_t firstNodeId = nodeId;
+		for (size_t i = 0; i < nodeCount; ++i) {
+			double angle = 2.0 * 3.14159265358979 * i / nodeCount;
+			Osm::OsmNode node(Osm::FixedLatLong(static_cast<int32_t>(ring * kCircleSpacing + kCircleRadius * std::sin(angle)),
+				static_cast<int32_t>(kCircleRadius * std::cos(angle))));
+			node.id = nodeId++;
+			osmCache.AddNode(node);
+		}
+		std::vector<uint32_t> nodeIndices(kNodesPerWay);
+		for (size_t i = 0; i < ringWayCount; ++i) {
+			for (uint32_t j = 0; j < kNodesPerWay; ++j) {
+				uint64_t id = firstNodeId + (i * (kNodesPerWay - 1) + j) % nodeCount;
+				nodeIndices[j] = osmCache.nodeIndex.Find(id);
+			}
+			if (random() % 2 == 0) {
+				std::reverse(nodeIndices.begin(), nodeIndices.end());
+			}
+			Osm::OsmWay way;
+			way.id = wayId++;
+			way.SetNodes(nodeIndices.data(), nodeIndices.size(), osmCache.arena);
+			osmCache.AddWay(way);
+			members.push_back({ Osm::OsmMemberType::Way, way.id, outerRole });
+		}
+	}
+	holeCounts.assign(ringCount, 0);
+	std::uniform_real_distribution<double> offset(-kCircleRadius / 2.0, kCircleRadius / 2.0);
+	for (size_t i = 0; i < holeCount; ++i) {
+		size_t ring = random() % ringCount;
+		++holeCounts[ring];
+		int32_t latitude = static_cast<int32_t>(ring * kCircleSpacing + offset(random));
+		int32_t longitude = static_cast<int32_t>(offset(random));
+		uint32_t nodeIndices[5];
+		for (uint32_t j = 0; j < 4; ++j) {
+			Osm::OsmNode node(Osm::FixedLatLong(latitude + (j == 1 || j == 2 ? 1000 : 0), longitude + (j >= 2 ? 1000 : 0)));
+			node.id = nodeId++;
+			nodeIndices[j] = osmCache.AddNode(node);
+		}
+		nodeIndices[4] = nodeIndices[0];
+		Osm::OsmWay way;
+		way.id = wayId++;
+		way.SetNodes(nodeIndices, 5, osmCache.arena);
+		osmCache.AddWay(way);
+		members.push_back({ Osm::OsmMemberType::Way, way.id, innerRole });
+	}
+	std::shuffle(members.begin(), members.end(), random);
+	Osm::OsmRelation relation;
+	relation.id = 1;
+	osmCache.AddRelation(relation, members.data(), members.size());
+}
+
+// Chains the outer ways of multipolygons with thousands of members into rings, nests thousands of holes in them and
+// compares the chaining with the pairwise scan it replaced. Fails if a ring is not closed, a way is left out or a hole
+// is in the wrong ring.
+int RunMultipolygonBenchmark(int argc, char** argv) {
+	size_t ringCount = argc >= 1 ? std::min(std::max<size_t>(std::strtoull(argv[0], nullptr, 10), 1), kMaxCircleCount) : 4;
+	size_t holeCount = argc >= 2 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 5000;
+	std::vector<uint32_t> holeCounts;
+	const size_t wayCounts[] = { 1000, 10000, 20000, 100000 };
+	std::mt19937 random(42);
+	size_t failureCount = 0;
+	for (size_t wayCount : wayCounts) {
+		Osm::OsmCache osmCache;
+		CreateMultipolygon(osmCache, wayCount, ringCount, holeCount, holeCounts, random);
+		Benchmark::Stopwatch stopwatch;
+		osmCache.ResolveMembers();
+		double seconds = stopwatch.GetElapsedSeconds();
+		const Osm::OsmRelation& relation = osmCache.relations[0];
+		printf("%7zu ways, %zu holes  endpoint index %9.2f ms", wayCount, holeCount, seconds * 1000.0);
+
+		bool isClosed = relation.outerRingCount == ringCount && relation.ringSegmentCount == wayCount + holeCount;
+		for (uint32_t i = 0; isClosed && i < relation.outerRingCount; ++i) {
+			const Osm::OsmRing& ring = relation.rings[i];
+			const Osm::OsmRingSegment& first = relation.ringSegments[ring.firstSegment];
+			const Osm::OsmRingSegment& last = relation.ringSegments[ring.firstSegment + ring.segmentCount - 1];
+			const Osm::OsmWay& firstWay = osmCache.ways[first.wayIndex];
+			const Osm::OsmWay& lastWay = osmCache.ways[last.wayIndex];
+			uint32_t startNodeIndex = first.isReversed ? firstWay.nodeIndices[firstWay.nodeCount - 1] : firstWay.nodeIndices[0];
+			uint32_t endNodeIndex = last.isReversed ? lastWay.nodeIndices[0] : lastWay.nodeIndices[lastWay.nodeCount - 1];
+			// Rings are in member order, the latitude of a node tells which circle it is
+			size_t circle = static_cast<size_t>(std::lround(osmCache.nodes[startNodeIndex].coordinate.latitude / static_cast<double>(kCircleSpacing)));
+			isClosed = startNodeIndex == endNodeIndex && ring.innerRingCount == holeCounts[circle];
+		}
+		if (wayCount <= kMaxPairwiseWayCount) {
+			stopwatch.Restart();
+			size_t closedCount = ChainPairwise(osmCache, relation);
+			double pairwiseSeconds = stopwatch.GetElapsedSeconds();
+			printf("  pairwise scan %9.2f ms", pairwiseSeconds * 1000.0);
+			if (closedCount != ringCount) {
+				printf("\nFAIL the pairwise scan closed %zu of %zu rings", closedCount, ringCount);
+				++failureCount;
+			}
+		}
+		printf("\n");
+		if (!isClosed || relation.innerRingCount != holeCount) {
+			printf("FAIL %zu ways did not give %zu closed rings with their holes\n", wayCount, ringCount);
+			++failureCount;
+		}
+	}
+	return failureCount == 0 ? 0 : 1;
+}
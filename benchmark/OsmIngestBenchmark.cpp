@@ -0,0 +1,155 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+#include "tinyxml2.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static void AddDomTags(tinyxml2::XMLElement* source, Osm::OsmComponent& component, MemoryArena& arena) {
+	Osm::TagDictionary& dictionary = Osm::GetTagDictionary();
+	std::vector<Osm::OsmTag> tags;
+	for (tinyxml2::XMLElement* tag = source->FirstChildElement("tag"); tag != nullptr; tag = tag->NextSiblingElement("tag")) {
+		const char* key = tag->Attribute("k");
+		const char* value = tag->Attribute("v");
+		if (key != nullptr && value != nullptr) {
+			tags.push_back({ dictionary.Intern(key), dictionary.Intern(value) });
+		}
+	}
+	component.SetTags(tags.data(), tags.size(), arena);
+}
+
+static Osm::OsmMemberType GetDomMemberType(const char* type) {
+	if (strcmp(type, "node") == 0) {
+		return Osm::OsmMemberType::Node;
+	}
+	return strcmp(type, "way") == 0 ? Osm::OsmMemberType::Way : Osm::OsmMemberType::Relation;
+}
+
+// The caching loops of the former tinyxml2 based ProcessMapDataFromOsm, kept here as the reference to compare against
+static void ReadDomOsmCache(tinyxml2::XMLElement* root, Osm::OsmCache& osmCache) {
+	using namespace Osm;
+	for (tinyxml2::XMLElement* xmlNodeElement = root->FirstChildElement("node"); xmlNodeElement != nullptr; xmlNodeElement = xmlNodeElement->NextSiblingElement("node")) {
+		LatLong coordinate(std::stod(xmlNodeElement->Attribute("lat")), std::stod(xmlNodeElement->Attribute("lon")));
+		OsmNode currentNode(FixedLatLong::FromLatLong(coordinate));
+		AddDomTags(xmlNodeElement, currentNode, osmCache.arena);
+		currentNode.id = std::stoull(xmlNodeElement->Attribute("id"));
+		osmCache.AddNode(currentNode);
+	}
+
+	std::vector<uint32_t> nodeIndices;
+	for (tinyxml2::XMLElement* xmlWayElement = root->FirstChildElement("way"); xmlWayElement != nullptr; xmlWayElement = xmlWayElement->NextSiblingElement("way")) {
+		nodeIndices.clear();
+		for (tinyxml2::XMLElement* nd = xmlWayElement->FirstChildElement("nd"); nd != nullptr; nd = nd->NextSiblingElement("nd")) {
+			uint32_t nodeIndex = osmCache.nodeIndex.Find(std::stoull(nd->Attribute("ref")));
+			if (nodeIndex != OsmIdIndex::kInvalidIndex) {
+				nodeIndices.push_back(nodeIndex);
+			}
+		}
+		OsmWay currentWay;
+		currentWay.SetNodes(nodeIndices.data(), nodeIndices.size(), osmCache.arena);
+		AddDomTags(xmlWayElement, currentWay, osmCache.arena);
+		currentWay.id = std::stoull(xmlWayElement->Attribute("id"));
+		osmCache.AddWay(currentWay);
+	}
+
+	TagDictionary& dictionary = GetTagDictionary();
+	std::vector<OsmMemberReference> members;
+	for (tinyxml2::XMLElement* xmlRelationElement = root->FirstChildElement("relation"); xmlRelationElement != nullptr; xmlRelationElement = xmlRelationElement->NextSiblingElement("relation")) {
+		members.clear();
+		for (tinyxml2::XMLElement* member = xmlRelationElement->FirstChildElement("member"); member != nullptr; member = member->NextSiblingElement("member")) {
+			members.push_back({ GetDomMemberType(member->Attribute("type")), std::stoull(member->Attribute("ref")), dictionary.Intern(member->Attribute("role")) });
+		}
+		OsmRelation currentRelation;
+		AddDomTags(xmlRelationElement, currentRelation, osmCache.arena);
+		currentRelation.id = std::stoull(xmlRelationElement->Attribute("id"));
+		osmCache.AddRelation(currentRelation, members.data(), members.size());
+	}
+	osmCache.ResolveMembers();
+}
+
+// Compares the former tinyxml2 DOM ingestion with the streaming OsmXmlReader on the same document. Both full rows
+// start from the file on disk and end with a filled OsmCache, so their time and peak heap are comparable.
+int RunOsmIngestBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	size_t inputBytes = 0;
+	printf("Entities are stored by value, node %zu, way %zu, relation %zu bytes\n", sizeof(Osm::OsmNode), sizeof(Osm::OsmWay),
+		sizeof(Osm::OsmRelation));
+
+	{
+		// The DOM path needs the whole document in memory, and builds the DOM on top of it
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		std::string content;
+		if (!Benchmark::ReadFile(path, content)) {
+			printf("Could not read %s\n", path.c_str());
+			return 1;
+		}
+		inputBytes = content.size();
+		tinyxml2::XMLDocument doc;
+		if (doc.Parse(content.c_str(), content.size()) != tinyxml2::XML_SUCCESS) {
+			printf("tinyxml2 failed to parse %s\n", path.c_str());
+			return 1;
+		}
+		Benchmark::PrintRow("tinyxml2 DOM (parse only)", stopwatch.GetElapsedSeconds(), inputBytes, heap.GetStats());
+
+		Osm::OsmCache osmCache;
+		ReadDomOsmCache(doc.RootElement(), osmCache);
+		Benchmark::PrintRow("tinyxml2 DOM -> OsmCache", stopwatch.GetElapsedSeconds(), inputBytes, heap.GetStats());
+		printf("  %zu nodes, %zu ways, %zu relations\n", SIZE(osmCache.nodes), SIZE(osmCache.ways), SIZE(osmCache.relations));
+	}
+
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		std::ifstream input(path, std::ios::in | std::ios::binary);
+		Osm::OsmXmlReader reader(input);
+		size_t elementCount = 0;
+		while (reader.Read()) {
+			++elementCount;
+		}
+		Benchmark::PrintRow("OsmXmlReader (tokenize only)", stopwatch.GetElapsedSeconds(), inputBytes, heap.GetStats());
+		printf("  %zu element events\n", elementCount);
+	}
+
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		std::ifstream input(path, std::ios::in | std::ios::binary);
+		Osm::OsmXmlReader reader(input);
+		Osm::OsmCache osmCache;
+		if (!Osm::ReadOsmCache(reader, osmCache)) {
+			printf("OsmXmlReader failed to parse %s\n", path.c_str());
+			return 1;
+		}
+		Benchmark::PrintRow("OsmXmlReader -> OsmCache", stopwatch.GetElapsedSeconds(), inputBytes, heap.GetStats());
+		printf("  %zu nodes, %zu ways, %zu relations, reader buffer %zu bytes\n",
+			SIZE(osmCache.nodes), SIZE(osmCache.ways), SIZE(osmCache.relations), reader.GetBufferCapacity());
+	}
+
+	{
+		// What the OSM entry points keep by default
+		Osm::OsmTagFilter tagFilter = Benchmark::CreateFeatureTagFilter();
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		std::ifstream input(path, std::ios::in | std::ios::binary);
+		Osm::OsmXmlReader reader(input);
+		Osm::OsmCache osmCache;
+		if (!Osm::ReadOsmCache(reader, osmCache, tagFilter)) {
+			printf("OsmXmlReader failed to parse %s\n", path.c_str());
+			return 1;
+		}
+		Benchmark::PrintRow("OsmXmlReader -> OsmCache, feature tags", stopwatch.GetElapsedSeconds(), inputBytes, heap.GetStats());
+		printf("  %zu nodes, %zu ways, %zu relations, %.1f MB of arena\n", SIZE(osmCache.nodes), SIZE(osmCache.ways), SIZE(osmCache.relations),
+			osmCache.arena.GetUsedBytes() / (1024.0 * 1024.0));
+	}
+	return 0;
+}
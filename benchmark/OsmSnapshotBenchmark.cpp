@@ -0,0 +1,164 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmSnapshot.h"
+#include "OsmXmlReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static constexpr int kLoadRepeatCount = 5;
+
+static bool AreTagsEqual(const Osm::OsmComponent& left, const Osm::OsmComponent& right) {
+	return left.id == right.id && left.tagCount == right.tagCount &&
+		(left.tagCount == 0 || memcmp(left.tags, right.tags, left.tagCount * sizeof(Osm::OsmTag)) == 0);
+}
+
+static bool AreIndexesEqual(const Osm::OsmIdIndex& left, const Osm::OsmIdIndex& right) {
+	return left.GetSize() == right.GetSize() && left.GetSlotCount() == right.GetSlotCount() &&
+		std::equal(left.GetSlotIds(), left.GetSlotIds() + left.GetSlotCount(), right.GetSlotIds()) &&
+		std::equal(left.GetSlotIndices(), left.GetSlotIndices() + left.GetSlotCount(), right.GetSlotIndices());
+}
+
+// The loaded cache must be the parsed one entity by entity
+static bool AreCachesEqual(const Osm::OsmCache& parsed, const Osm::OsmCache& loaded) {
+	if (SIZE(parsed.nodes) != SIZE(loaded.nodes) || SIZE(parsed.ways) != SIZE(loaded.ways) || SIZE(parsed.relations) != SIZE(loaded.relations)) {
+		printf("MISMATCH entity counts differ\n");
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(parsed.nodes); ++i) {
+		if (!AreTagsEqual(parsed.nodes[i], loaded.nodes[i]) || parsed.nodes[i].coordinate != loaded.nodes[i].coordinate) {
+			printf("MISMATCH node %zu\n", i);
+			return false;
+		}
+	}
+	for (size_t i = 0; i < SIZE(parsed.ways); ++i) {
+		const Osm::OsmWay& left = parsed.ways[i];
+		const Osm::OsmWay& right = loaded.ways[i];
+		if (!AreTagsEqual(left, right) || left.nodeCount != right.nodeCount || !std::equal(left.nodeIndices, left.nodeIndices + left.nodeCount, right.nodeIndices)) {
+			printf("MISMATCH way %zu\n", i);
+			return false;
+		}
+	}
+	for (size_t i = 0; i < SIZE(parsed.relations); ++i) {
+		const Osm::OsmRelation& left = parsed.relations[i];
+		const Osm::OsmRelation& right = loaded.relations[i];
+		bool isEqual = AreTagsEqual(left, right) && left.memberCount == right.memberCount && left.isMultigon == right.isMultigon &&
+			left.ringSegmentCount == right.ringSegmentCount && left.outerRingCount == right.outerRingCount && left.innerRingCount == right.innerRingCount;
+		for (uint32_t j = 0; isEqual && j < left.memberCount; ++j) {
+			isEqual = left.members[j].handle.type == right.members[j].handle.type && left.members[j].handle.index == right.members[j].handle.index &&
+				left.members[j].role == right.members[j].role;
+		}
+		for (uint32_t j = 0; isEqual && j < left.outerRingCount + left.innerRingCount; ++j) {
+			isEqual = memcmp(&left.rings[j], &right.rings[j], sizeof(Osm::OsmRing)) == 0;
+		}
+		for (uint32_t j = 0; isEqual && j < left.ringSegmentCount; ++j) {
+			isEqual = left.ringSegments[j].wayIndex == right.ringSegments[j].wayIndex && left.ringSegments[j].isReversed == right.ringSegments[j].isReversed;
+		}
+		if (!isEqual) {
+			printf("MISMATCH relation %zu\n", i);
+			return false;
+		}
+	}
+	if (!AreIndexesEqual(parsed.nodeIndex, loaded.nodeIndex) || !AreIndexesEqual(parsed.wayIndex, loaded.wayIndex) ||
+		!AreIndexesEqual(parsed.relationIndex, loaded.relationIndex)) {
+		printf("MISMATCH id indexes differ\n");
+		return false;
+	}
+	return true;
+}
+
+template<typename T>
+static bool AreFeaturesEqual(const ARRAY<T*>& left, const ARRAY<T*>& right) {
+	if (SIZE(left) != SIZE(right)) {
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(left); ++i) {
+		if (left[i]->id != right[i]->id || left[i]->geometry->GetComponentCount() != right[i]->geometry->GetComponentCount()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Writes the cache read from an extract to a snapshot and maps it back, comparing the load time with parsing the XML.
+// Fails if the loaded cache or the features built from it differ from the parsed ones, or if a truncated snapshot
+// is accepted.
+int RunOsmSnapshotBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	const std::string snapshotPath = argc >= 2 ? argv[1] : path + ".snapshot";
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path.c_str())) {
+		printf("Could not open %s\n", path.c_str());
+		return 1;
+	}
+	Osm::OsmCache parsedCache;
+	Benchmark::Stopwatch stopwatch;
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	if (!Osm::ReadOsmCache(reader, parsedCache, Benchmark::CreateFeatureTagFilter())) {
+		printf("Could not parse %s\n", path.c_str());
+		return 1;
+	}
+	printf("%-40s %9.2f ms\n", "ReadOsmCache", stopwatch.GetElapsedSeconds() * 1000.0);
+
+	stopwatch.Restart();
+	if (!Osm::WriteOsmSnapshot(parsedCache, snapshotPath.c_str())) {
+		printf("Could not write %s\n", snapshotPath.c_str());
+		return 1;
+	}
+	printf("%-40s %9.2f ms\n", "WriteOsmSnapshot", stopwatch.GetElapsedSeconds() * 1000.0);
+
+	Osm::OsmCache loadedCache;
+	double bestSeconds = 0.0;
+	for (int i = 0; i < kLoadRepeatCount; ++i) {
+		stopwatch.Restart();
+		if (!Osm::ReadOsmSnapshot(snapshotPath.c_str(), loadedCache)) {
+			printf("Could not read %s\n", snapshotPath.c_str());
+			return 1;
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+		bestSeconds = i == 0 ? seconds : std::min(bestSeconds, seconds);
+	}
+	std::string label = "ReadOsmSnapshot, best of " + std::to_string(kLoadRepeatCount);
+	printf("%-40s %9.2f ms\n", label.c_str(), bestSeconds * 1000.0);
+
+	if (!AreCachesEqual(parsedCache, loadedCache)) {
+		return 1;
+	}
+	FTileMapData parsedData;
+	FTileMapData loadedData;
+	MapDataUtils::ProcessMapDataFromOsmCache(parsedCache, &parsedData);
+	MapDataUtils::ProcessMapDataFromOsmCache(loadedCache, &loadedData);
+	if (!AreFeaturesEqual(parsedData.paths, loadedData.paths) || !AreFeaturesEqual(parsedData.buildings, loadedData.buildings) ||
+		!AreFeaturesEqual(parsedData.landuse, loadedData.landuse)) {
+		printf("MISMATCH features built from the snapshot differ\n");
+		return 1;
+	}
+
+	// A snapshot cut short must be refused, not read past its end
+	std::string snapshot;
+	Benchmark::ReadFile(snapshotPath, snapshot);
+	std::string truncatedPath = snapshotPath + ".truncated";
+	FILE* truncatedFile = fopen(truncatedPath.c_str(), "wb");
+	if (truncatedFile == nullptr) {
+		return 1;
+	}
+	fwrite(snapshot.data(), 1, snapshot.size() / 2, truncatedFile);
+	fclose(truncatedFile);
+	bool isTruncatedRead = Osm::ReadOsmSnapshot(truncatedPath.c_str(), loadedCache);
+	remove(truncatedPath.c_str());
+	if (isTruncatedRead || SIZE(loadedCache.nodes) != 0) {
+		printf("MISMATCH a truncated snapshot was read\n");
+		return 1;
+	}
+	printf("  snapshot of %zu bytes identical to the parsed cache\n", snapshot.size());
+	return 0;
+}
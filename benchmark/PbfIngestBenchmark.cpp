@@ -0,0 +1,160 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmPbfReader.h"
+#include "OsmXmlReader.h"
+#include "ThreadUtils.h"
+
+#include <cstdio>
+#include <string>
+
+static bool ReportMismatch(const char* kind, uint64_t id, const char* what) {
+	printf("MISMATCH %s %llu: %s differ between the XML and the PBF cache\n", kind, static_cast<unsigned long long>(id), what);
+	return false;
+}
+
+static bool AreTagsEqual(const Osm::OsmComponent& xmlComponent, const Osm::OsmComponent& pbfComponent) {
+	if (xmlComponent.tagCount != pbfComponent.tagCount) {
+		return false;
+	}
+	// Both readers intern into the same dictionary, equal tags have equal ids
+	for (uint32_t i = 0; i < xmlComponent.tagCount; ++i) {
+		if (xmlComponent.tags[i].key != pbfComponent.tags[i].key || xmlComponent.tags[i].value != pbfComponent.tags[i].value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static const char* FindDifference(const Osm::OsmCache&, const Osm::OsmNode& xmlNode, const Osm::OsmCache&, const Osm::OsmNode& pbfNode) {
+	return xmlNode.coordinate != pbfNode.coordinate ? "coordinates" : nullptr;
+}
+
+// Node indices depend on the order the nodes were read in, so the node ids are compared
+static const char* FindDifference(const Osm::OsmCache& xmlCache, const Osm::OsmWay& xmlWay, const Osm::OsmCache& pbfCache, const Osm::OsmWay& pbfWay) {
+	if (xmlWay.nodeCount != pbfWay.nodeCount) {
+		return "node references";
+	}
+	for (uint32_t i = 0; i < xmlWay.nodeCount; ++i) {
+		if (xmlCache.nodes[xmlWay.nodeIndices[i]].id != pbfCache.nodes[pbfWay.nodeIndices[i]].id) {
+			return "node references";
+		}
+	}
+	return nullptr;
+}
+
+static const char* FindDifference(const Osm::OsmCache& xmlCache, const Osm::OsmRelation& xmlRelation, const Osm::OsmCache& pbfCache,
+	const Osm::OsmRelation& pbfRelation) {
+	if (xmlRelation.memberCount != pbfRelation.memberCount) {
+		return "members";
+	}
+	for (uint32_t i = 0; i < xmlRelation.memberCount; ++i) {
+		const Osm::OsmMember& xmlMember = xmlRelation.members[i];
+		const Osm::OsmMember& pbfMember = pbfRelation.members[i];
+		if (xmlMember.handle.type != pbfMember.handle.type || xmlMember.role != pbfMember.role ||
+			xmlCache.GetComponent(xmlMember.handle).id != pbfCache.GetComponent(pbfMember.handle).id) {
+			return "members";
+		}
+	}
+	return nullptr;
+}
+
+// Both caches keep the entities in file order, which is the same for the two encodings of the data
+template<typename T>
+static bool AreItemsEqual(const char* kind, const Osm::OsmCache& xmlCache, const ARRAY<T>& xmlItems, const Osm::OsmCache& pbfCache,
+	const ARRAY<T>& pbfItems) {
+	if (SIZE(xmlItems) != SIZE(pbfItems)) {
+		printf("MISMATCH %zu XML and %zu PBF %ss\n", static_cast<size_t>(SIZE(xmlItems)), static_cast<size_t>(SIZE(pbfItems)), kind);
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(xmlItems); ++i) {
+		const T& xmlItem = xmlItems[i];
+		const T& pbfItem = pbfItems[i];
+		if (xmlItem.id != pbfItem.id) {
+			return ReportMismatch(kind, xmlItem.id, "ids");
+		}
+		if (!AreTagsEqual(xmlItem, pbfItem)) {
+			return ReportMismatch(kind, xmlItem.id, "tags");
+		}
+		if (const char* difference = FindDifference(xmlCache, xmlItem, pbfCache, pbfItem)) {
+			return ReportMismatch(kind, xmlItem.id, difference);
+		}
+	}
+	return true;
+}
+
+// The PBF reader must fill the cache exactly like the XML reader does for the same data
+static bool AreCachesEqual(const Osm::OsmCache& xmlCache, const Osm::OsmCache& pbfCache) {
+	return AreItemsEqual("node", xmlCache, xmlCache.nodes, pbfCache, pbfCache.nodes) &&
+		AreItemsEqual("way", xmlCache, xmlCache.ways, pbfCache, pbfCache.ways) &&
+		AreItemsEqual("relation", xmlCache, xmlCache.relations, pbfCache, pbfCache.relations);
+}
+
+static bool RunXml(const char* path, const Osm::OsmTagFilter& tagFilter, Osm::OsmCache& osmCache) {
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path)) {
+		printf("Could not open %s\n", path);
+		return false;
+	}
+	Benchmark::HeapScope heap;
+	Benchmark::Stopwatch stopwatch;
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	if (!Osm::ReadOsmCache(reader, osmCache, tagFilter)) {
+		printf("OsmXmlReader failed to parse %s\n", path);
+		return false;
+	}
+	Benchmark::PrintRow("XML -> OsmCache", stopwatch.GetElapsedSeconds(), mappedFile.GetSize(), heap.GetStats());
+	printf("  %zu nodes, %zu ways, %zu relations\n", osmCache.nodes.size(), osmCache.ways.size(), osmCache.relations.size());
+	return true;
+}
+
+static bool RunPbf(const char* path, int32_t threadCount, const Osm::OsmTagFilter& tagFilter, const Osm::OsmCache& xmlCache) {
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path)) {
+		printf("Could not open %s\n", path);
+		return false;
+	}
+	Osm::OsmCache osmCache;
+	{
+		Benchmark::HeapScope heap;
+		Benchmark::Stopwatch stopwatch;
+		if (!Osm::ReadOsmPbfCache(mappedFile.GetData(), mappedFile.GetSize(), osmCache, tagFilter, threadCount)) {
+			printf("Could not decode %s\n", path);
+			return false;
+		}
+		std::string label = "PBF -> OsmCache, " + std::to_string(threadCount) + " thread(s)";
+		Benchmark::PrintRow(label.c_str(), stopwatch.GetElapsedSeconds(), mappedFile.GetSize(), heap.GetStats());
+	}
+	printf("  %zu nodes, %zu ways, %zu relations\n", osmCache.nodes.size(), osmCache.ways.size(), osmCache.relations.size());
+	if (!AreCachesEqual(xmlCache, osmCache)) {
+		return false;
+	}
+	printf("  identical to the XML cache\n");
+	return true;
+}
+
+// Compares filling the cache from an XML document with decoding the same data from PBF, on one and on all cores, with
+// all tags and with the default filter of the OSM entry points. Blobs
+// are decoded on the pool while the previous batch is added to the cache, adding to the cache itself stays serial.
+// Fails if the PBF cache differs from the XML one in any tag, coordinate, node reference or relation member.
+int RunPbfIngestBenchmark(int argc, char** argv) {
+	if (argc < 2) {
+		return 1;
+	}
+	printf("PBF blobs are decoded in parallel, adding them to the cache runs serially in file order\n");
+	int32_t threadCount = ThreadUtils::GetHardwareThreadCount();
+	const Osm::OsmTagFilter tagFilters[] = { Osm::OsmTagFilter(), Benchmark::CreateFeatureTagFilter() };
+	for (const Osm::OsmTagFilter& tagFilter : tagFilters) {
+		printf(tagFilter.IsKeepingAll() ? "All tags:\n" : "Feature tags only:\n");
+		Osm::OsmCache xmlCache;
+		if (!RunXml(argv[0], tagFilter, xmlCache)) {
+			return 1;
+		}
+		if (!RunPbf(argv[1], 1, tagFilter, xmlCache) || (threadCount > 1 && !RunPbf(argv[1], threadCount, tagFilter, xmlCache))) {
+			return 1;
+		}
+	}
+	return 0;
+}
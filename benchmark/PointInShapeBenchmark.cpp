@@ -0,0 +1,103 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MemoryArena.h"
+#include "ShapeUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static constexpr int kRingCount = 200;
+
+// A ring around the center of the area whose radius changes in a few waves and a little noise, like the outline of a
+// park or a forest, closed like the ways of landuse areas
+static FLine* CreateRing(MemoryArena& arena, int vertexCount, std::mt19937& random) {
+	std::uniform_real_distribution<double> noise(-0.002, 0.002);
+	std::uniform_real_distribution<double> phase(0.0, 6.0);
+	double firstPhase = phase(random);
+	double secondPhase = phase(random);
+	FLine* ring = arena.New<FLine>();
+	ring->ReserveVertices(vertexCount + 1);
+	for (int i = 0; i < vertexCount; ++i) {
+		double angle = 2.0 * 3.14159265358979 * i / vertexCount;
+		double r = 0.3 + 0.08 * std::sin(3 * angle + firstPhase) + 0.03 * std::sin(11 * angle + secondPhase) + noise(random);
+		ring->AddVertex(LatLong(0, 0), VECTOR2D(0.5 + r * std::cos(angle), 0.5 + r * std::sin(angle)));
+	}
+	ring->AddVertex(ring->GetGlobalPosition(0), ring->GetLocalPosition(0));
+	return ring;
+}
+
+// Tests random points against random rings of growing size with IsPointInShape, with the prepared rings one point at a
+// time and with all points of a ring in one call. Some points are on the vertices and the edges of the ring, where
+// rounding decides. Fails if any of them disagree.
+int RunPointInShapeBenchmark(int argc, char** argv) {
+	int pointCount = argc >= 1 ? std::max(atoi(argv[0]), 1) : 2000;
+	const int vertexCounts[] = { 8, 64, 512, 4096 };
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> position(0.0, 1.0);
+	std::uniform_real_distribution<double> fraction(0.0, 1.0);
+	size_t failureCount = 0;
+	for (int vertexCount : vertexCounts) {
+		MemoryArena arena;
+		std::vector<const FLine*> rings(kRingCount);
+		for (const FLine*& ring : rings) {
+			ring = CreateRing(arena, vertexCount, random);
+		}
+		std::vector<double> x(static_cast<size_t>(kRingCount) * pointCount);
+		std::vector<double> y(x.size());
+		for (int ring = 0; ring < kRingCount; ++ring) {
+			for (int i = 0; i < pointCount; ++i) {
+				size_t point = static_cast<size_t>(ring) * pointCount + i;
+				int vertex = static_cast<int>(random() % vertexCount);
+				VECTOR2D start = rings[ring]->GetLocalPosition(vertex);
+				VECTOR2D end = rings[ring]->GetLocalPosition(vertex + 1);
+				double t = fraction(random);
+				VECTOR2D onEdge(start.X + (end.X - start.X) * t, start.Y + (end.Y - start.Y) * t);
+				VECTOR2D anywhere(position(random), position(random));
+				VECTOR2D chosen = i % 10 == 0 ? start : i % 10 == 1 ? onEdge : anywhere;
+				x[point] = chosen.X;
+				y[point] = chosen.Y;
+			}
+		}
+
+		Benchmark::Stopwatch stopwatch;
+		ShapeUtils::PreparedShapes prepared;
+		for (const FLine* ring : rings) {
+			prepared.Add(ring);
+		}
+		double prepareSeconds = stopwatch.GetElapsedSeconds();
+		std::vector<char> expected(x.size());
+		std::vector<char> single(x.size());
+		std::vector<char> batch(x.size());
+		stopwatch.Restart();
+		for (size_t point = 0; point < x.size(); ++point) {
+			expected[point] = ShapeUtils::IsPointInShape(rings[point / pointCount], VECTOR2D(x[point], y[point]));
+		}
+		double directSeconds = stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (size_t point = 0; point < x.size(); ++point) {
+			single[point] = prepared.IsPointInShape(static_cast<int>(point / pointCount), VECTOR2D(x[point], y[point]));
+		}
+		double singleSeconds = stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (int ring = 0; ring < kRingCount; ++ring) {
+			size_t first = static_cast<size_t>(ring) * pointCount;
+			prepared.ArePointsInShape(ring, &x[first], &y[first], pointCount, reinterpret_cast<bool*>(&batch[first]));
+		}
+		double batchSeconds = stopwatch.GetElapsedSeconds();
+		double testRate = static_cast<double>(x.size()) / 1e6;
+		printf("%5d vertices  prepare %6.1f ns per vertex  IsPointInShape %7.2f  prepared %7.2f  batch %7.2f M points per s\n", vertexCount,
+			prepareSeconds * 1e9 / (static_cast<double>(kRingCount) * vertexCount), testRate / directSeconds, testRate / singleSeconds,
+			testRate / batchSeconds);
+		if (single != expected || batch != expected) {
+			size_t point = std::mismatch(expected.begin(), expected.end(), single != expected ? single.begin() : batch.begin()).first - expected.begin();
+			printf("MISMATCH point %.17g %.17g in ring %zu of %d vertices\n", x[point], y[point], point / pointCount, vertexCount);
+			++failureCount;
+		}
+	}
+	return failureCount == 0 ? 0 : 1;
+}
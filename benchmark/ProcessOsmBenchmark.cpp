@@ -0,0 +1,78 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Runs the whole OSM parse repeatedly into the same FTileMapData, dropping the previous tile with Reset() like a
+// long-running worker does. The first call grows the arenas, the following ones should reuse their memory, so their
+// heap allocations are only the ones the arenas do not cover. The live heap after each call shows that nothing leaks.
+int RunProcessOsmBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	int32_t repeatCount = argc >= 2 ? std::atoi(argv[1]) : 3;
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path.c_str())) {
+		printf("Could not open %s\n", path.c_str());
+		return 1;
+	}
+
+	size_t firstLiveBytes = 0;
+	size_t lastLiveBytes = 0;
+	{
+		FTileMapData mapData;
+		for (int32_t i = 0; i < repeatCount; ++i) {
+			Benchmark::HeapScope heap;
+			Benchmark::Stopwatch stopwatch;
+			mapData.Reset();
+			if (!MapDataUtils::ProcessMapDataFromOsm(mappedFile.GetData(), mappedFile.GetSize(), &mapData)) {
+				printf("Could not parse %s\n", path.c_str());
+				return 1;
+			}
+			std::string label = "ProcessMapDataFromOsm, call " + std::to_string(i + 1);
+			Benchmark::HeapStats stats = heap.GetStats();
+			Benchmark::PrintRow(label.c_str(), stopwatch.GetElapsedSeconds(), mappedFile.GetSize(), stats);
+			printf("  %zu output objects in %.1f MB of arena, %zu arena blocks allocated so far\n", mapData.arena.GetObjectCount(),
+				mapData.arena.GetUsedBytes() / (1024.0 * 1024.0), mapData.arena.GetBlockAllocationCount());
+			if (i == 0) {
+				firstLiveBytes = stats.liveBytes;
+			}
+			lastLiveBytes = stats.liveBytes;
+		}
+	}
+
+	{
+		// The cache on its own, the part that used to be leaked on every call
+		Osm::OsmCache osmCache;
+		for (int32_t i = 0; i < repeatCount; ++i) {
+			Benchmark::HeapScope heap;
+			Benchmark::Stopwatch stopwatch;
+			osmCache.Clear();
+			Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+			if (!Osm::ReadOsmCache(reader, osmCache)) {
+				printf("Could not parse %s\n", path.c_str());
+				return 1;
+			}
+			std::string label = "ReadOsmCache, call " + std::to_string(i + 1);
+			Benchmark::PrintRow(label.c_str(), stopwatch.GetElapsedSeconds(), mappedFile.GetSize(), heap.GetStats());
+			printf("  %zu entities in %.1f MB of arena, %zu arena blocks allocated so far\n", osmCache.arena.GetObjectCount(),
+				osmCache.arena.GetUsedBytes() / (1024.0 * 1024.0), osmCache.arena.GetBlockAllocationCount());
+		}
+	}
+	MapDataUtils::ReleaseThreadCache();
+
+	// Reused calls must not hold on to more memory than the first one
+	if (lastLiveBytes > firstLiveBytes) {
+		printf("Live heap grew from %zu to %zu bytes between the first and the last call\n", firstLiveBytes, lastLiveBytes);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "Benchmarks.h"
+
+#include "ShapeUtils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+const int kRingCount = 2000;
+const int kPointCount = 50;
+
+// A star shaped ring around a random point of the tile with the given number of vertices, some of them on the border
+// of the tile or outside of it like a clipped feature with a buffer
+void CreateRing(FLine& line, int vertexCount, std::mt19937& random) {
+	std::uniform_real_distribution<double> center(-0.05, 1.05);
+	std::uniform_real_distribution<double> radius(0.0001, 0.05);
+	double x = center(random);
+	double y = center(random);
+	line = FLine();
+	line.isClosed = true;
+	for (int i = 0; i < vertexCount; ++i) {
+		double angle = 2.0 * 3.14159265358979 * i / vertexCount;
+		double r = radius(random);
+		line.AddVertex(LatLong(0, 0), VECTOR2D(x + r * std::cos(angle), y + r * std::sin(angle)));
+	}
+	line.isClockwise = ShapeUtils::CalculateShapeOrientation(&line);
+}
+
+// The line the grid values stand for, for comparing with the double versions
+void CreateDequantizedLine(const FQuantizedLine<int32_t>& quantized, FLine& line) {
+	line = FLine();
+	for (int i = 0; i < quantized.GetVertexCount(); ++i) {
+		line.AddVertex(LatLong(0, 0), quantized.GetLocalPosition(i));
+	}
+}
+
+template<typename T>
+size_t CheckRings(int32_t extent, std::mt19937& random) {
+	size_t failureCount = 0;
+	FLine line;
+	FLine dequantized;
+	FQuantizedLine<T> quantized;
+	FQuantizedLine<int32_t> wide;
+	std::uniform_int_distribution<int32_t> gridValue(-extent / 16, extent + extent / 16);
+	for (int ring = 0; ring < kRingCount && failureCount == 0; ++ring) {
+		CreateRing(line, 3 + ring % 40, random);
+		if (!ShapeUtils::QuantizeLine(&line, extent, quantized) || !ShapeUtils::QuantizeLine(&line, extent, wide)) {
+			printf("FAIL ring %d did not fit the grid of extent %d\n", ring, extent);
+			return 1;
+		}
+		CreateDequantizedLine(wide, dequantized);
+		// Grid values are exact in double and their products stay below 2^53, so the double shoelace sum is exact too
+		int64_t area = ShapeUtils::CalculateShapeArea(DATA(quantized.x), DATA(quantized.y), quantized.GetVertexCount());
+		double expectedArea = ShapeUtils::CalculateShapeArea(&dequantized) * extent * extent;
+		if (static_cast<double>(area) != std::round(expectedArea) ||
+			ShapeUtils::CalculateShapeOrientation(quantized) != ShapeUtils::CalculateShapeOrientation(&dequantized)) {
+			printf("FAIL ring %d area %lld on the grid of extent %d, %.1f expected\n", ring, static_cast<long long>(area), extent, expectedArea);
+			++failureCount;
+		}
+		// Points are half a grid unit off the grid, a grid of twice the extent has them on its odd values
+		FQuantizedLine<int32_t> doubled;
+		for (int i = 0; i < wide.GetVertexCount(); ++i) {
+			ADD(doubled.x, wide.x[i] * 2);
+			ADD(doubled.y, wide.y[i] * 2);
+		}
+		for (int i = 0; i < kPointCount; ++i) {
+			int32_t x = gridValue(random);
+			int32_t y = gridValue(random);
+			bool isInside = ShapeUtils::IsPointInShape(&dequantized, VECTOR2D((x + 0.5) / extent, (y + 0.5) / extent));
+			if (ShapeUtils::IsPointInShape(doubled, x * 2 + 1, y * 2 + 1) != isInside) {
+				printf("FAIL point %d %d of ring %d on the grid of extent %d\n", x, y, ring, extent);
+				++failureCount;
+				break;
+			}
+		}
+	}
+	return failureCount;
+}
+
+}
+
+// Quantizes random rings to grids of int16_t and int32_t values and compares the integer area, orientation and
+// point-in-shape test with the double ones on the same vertices. Fails if a grid value does not survive the round
+// trip, if they disagree, or if a line that does not fit the grid is quantized.
+int RunQuantizeCheck(int /*argc*/, char** /*argv*/) {
+	size_t failureCount = 0;
+	const int32_t extents[] = { 4096, 65536 };
+	for (int32_t extent : extents) {
+		for (int32_t value = -extent; value <= 2 * extent; ++value) {
+			if (ShapeUtils::QuantizeCoordinate(value / static_cast<double>(extent), extent) != value) {
+				printf("FAIL grid value %d of extent %d changed in the round trip\n", value, extent);
+				++failureCount;
+				break;
+			}
+		}
+	}
+	std::mt19937 random(42);
+	failureCount += CheckRings<int16_t>(4096, random);
+	failureCount += CheckRings<int32_t>(65536, random);
+
+	// A tile of 65536 units does not fit int16_t, beyond kMaxQuantizedValue not even int32_t
+	FLine line;
+	line.AddVertex(LatLong(0, 0), VECTOR2D(0.0, 0.0));
+	line.AddVertex(LatLong(0, 0), VECTOR2D(1.0, 1.0));
+	FQuantizedLine<int16_t> narrow;
+	FQuantizedLine<int32_t> wide;
+	if (ShapeUtils::QuantizeLine(&line, 65536, narrow) || narrow.GetVertexCount() != 0 ||
+		ShapeUtils::QuantizeLine(&line, ShapeUtils::kMaxQuantizedValue * 2, wide) || !ShapeUtils::QuantizeLine(&line, 65536, wide)) {
+		printf("FAIL a line was quantized to a grid it does not fit\n");
+		++failureCount;
+	}
+	printf("%zu quantize checks failed\n", failureCount);
+	return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Relations refer ahead to relations and ways, nest, form a cycle, refer to themselves and to a missing node. The
+// multipolygon 104 is made of outer ways that are only read after it, 105 of two disjoint outer rings whose ways are
+// out of order and one of them reversed. The ring of 106 misses a way, its ways still give one open ring. 107 has an
+// island in its hole, the island has a hole of its own. 108 is an L with one hole inside of it and one in its notch,
+// inside of its box but outside of the ring. The hole of 109 touches the corner of its outer ring with its first node.
+// 110 only has an inner ring, so it has no area and gives no building.
+const char kRelationDocument[] =
+	"<osm>"
+	"<node id=\"1\" lat=\"0.001\" lon=\"0.001\"/>"
+	"<node id=\"2\" lat=\"0.002\" lon=\"0.001\"/>"
+	"<node id=\"3\" lat=\"0.002\" lon=\"0.002\"/>"
+	"<node id=\"4\" lat=\"0.001\" lon=\"0.002\"/>"
+	"<node id=\"5\" lat=\"0.003\" lon=\"0.003\"/>"
+	"<node id=\"6\" lat=\"0.004\" lon=\"0.003\"/>"
+	"<node id=\"7\" lat=\"0.004\" lon=\"0.004\"/>"
+	"<node id=\"8\" lat=\"0.003\" lon=\"0.004\"/>"
+	"<node id=\"9\" lat=\"0.005\" lon=\"0.005\"/>"
+	"<node id=\"20\" lat=\"0.006\" lon=\"0.005\"/>"
+	"<node id=\"21\" lat=\"0.006\" lon=\"0.006\"/>"
+	"<node id=\"30\" lat=\"0.010\" lon=\"0.010\"/>"
+	"<node id=\"31\" lat=\"0.020\" lon=\"0.010\"/>"
+	"<node id=\"32\" lat=\"0.020\" lon=\"0.020\"/>"
+	"<node id=\"33\" lat=\"0.010\" lon=\"0.020\"/>"
+	"<node id=\"34\" lat=\"0.012\" lon=\"0.012\"/>"
+	"<node id=\"35\" lat=\"0.018\" lon=\"0.012\"/>"
+	"<node id=\"36\" lat=\"0.018\" lon=\"0.018\"/>"
+	"<node id=\"37\" lat=\"0.012\" lon=\"0.018\"/>"
+	"<node id=\"38\" lat=\"0.013\" lon=\"0.013\"/>"
+	"<node id=\"39\" lat=\"0.017\" lon=\"0.013\"/>"
+	"<node id=\"40\" lat=\"0.017\" lon=\"0.017\"/>"
+	"<node id=\"41\" lat=\"0.013\" lon=\"0.017\"/>"
+	"<node id=\"42\" lat=\"0.014\" lon=\"0.014\"/>"
+	"<node id=\"43\" lat=\"0.016\" lon=\"0.014\"/>"
+	"<node id=\"44\" lat=\"0.016\" lon=\"0.016\"/>"
+	"<node id=\"45\" lat=\"0.014\" lon=\"0.016\"/>"
+	"<node id=\"50\" lat=\"0.030\" lon=\"0.030\"/>"
+	"<node id=\"51\" lat=\"0.040\" lon=\"0.030\"/>"
+	"<node id=\"52\" lat=\"0.040\" lon=\"0.034\"/>"
+	"<node id=\"53\" lat=\"0.034\" lon=\"0.034\"/>"
+	"<node id=\"54\" lat=\"0.034\" lon=\"0.040\"/>"
+	"<node id=\"55\" lat=\"0.030\" lon=\"0.040\"/>"
+	"<node id=\"56\" lat=\"0.036\" lon=\"0.036\"/>"
+	"<node id=\"57\" lat=\"0.038\" lon=\"0.036\"/>"
+	"<node id=\"58\" lat=\"0.038\" lon=\"0.038\"/>"
+	"<node id=\"59\" lat=\"0.036\" lon=\"0.038\"/>"
+	"<node id=\"60\" lat=\"0.031\" lon=\"0.031\"/>"
+	"<node id=\"61\" lat=\"0.032\" lon=\"0.031\"/>"
+	"<node id=\"62\" lat=\"0.032\" lon=\"0.032\"/>"
+	"<node id=\"63\" lat=\"0.031\" lon=\"0.032\"/>"
+	"<node id=\"70\" lat=\"0.050\" lon=\"0.050\"/>"
+	"<node id=\"71\" lat=\"0.060\" lon=\"0.050\"/>"
+	"<node id=\"72\" lat=\"0.060\" lon=\"0.060\"/>"
+	"<node id=\"73\" lat=\"0.050\" lon=\"0.060\"/>"
+	"<node id=\"74\" lat=\"0.055\" lon=\"0.058\"/>"
+	"<node id=\"75\" lat=\"0.058\" lon=\"0.055\"/>"
+	"<way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"1\"/></way>"
+	"<relation id=\"100\"><member type=\"relation\" ref=\"101\" role=\"\"/><member type=\"way\" ref=\"10\" role=\"\"/>"
+	"<member type=\"way\" ref=\"11\" role=\"\"/><member type=\"node\" ref=\"99\" role=\"\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"101\"><member type=\"relation\" ref=\"102\" role=\"\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"102\"><member type=\"relation\" ref=\"100\" role=\"\"/><member type=\"way\" ref=\"11\" role=\"\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"103\"><member type=\"relation\" ref=\"103\" role=\"\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"104\"><member type=\"way\" ref=\"12\" role=\"outer\"/><member type=\"way\" ref=\"13\" role=\"outer\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"105\"><member type=\"way\" ref=\"14\" role=\"outer\"/><member type=\"way\" ref=\"17\" role=\"outer\"/>"
+	"<member type=\"way\" ref=\"16\" role=\"outer\"/><member type=\"way\" ref=\"15\" role=\"outer\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"106\"><member type=\"way\" ref=\"14\" role=\"outer\"/><member type=\"way\" ref=\"16\" role=\"outer\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"107\"><member type=\"way\" ref=\"23\" role=\"inner\"/><member type=\"way\" ref=\"18\" role=\"outer\"/>"
+	"<member type=\"way\" ref=\"19\" role=\"inner\"/><member type=\"way\" ref=\"22\" role=\"outer\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"108\"><member type=\"way\" ref=\"25\" role=\"inner\"/><member type=\"way\" ref=\"24\" role=\"outer\"/>"
+	"<member type=\"way\" ref=\"26\" role=\"inner\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"109\"><member type=\"way\" ref=\"27\" role=\"outer\"/><member type=\"way\" ref=\"28\" role=\"inner\"/>"
+	"<tag k=\"building\" v=\"yes\"/></relation>"
+	"<relation id=\"110\"><member type=\"way\" ref=\"28\" role=\"inner\"/><tag k=\"building\" v=\"yes\"/></relation>"
+	"<way id=\"27\"><nd ref=\"70\"/><nd ref=\"71\"/><nd ref=\"72\"/><nd ref=\"73\"/><nd ref=\"70\"/></way>"
+	"<way id=\"28\"><nd ref=\"72\"/><nd ref=\"74\"/><nd ref=\"75\"/><nd ref=\"72\"/></way>"
+	"<way id=\"24\"><nd ref=\"50\"/><nd ref=\"51\"/><nd ref=\"52\"/><nd ref=\"53\"/><nd ref=\"54\"/><nd ref=\"55\"/><nd ref=\"50\"/></way>"
+	"<way id=\"25\"><nd ref=\"56\"/><nd ref=\"57\"/><nd ref=\"58\"/><nd ref=\"59\"/><nd ref=\"56\"/></way>"
+	"<way id=\"26\"><nd ref=\"60\"/><nd ref=\"61\"/><nd ref=\"62\"/><nd ref=\"63\"/><nd ref=\"60\"/></way>"
+	"<way id=\"18\"><nd ref=\"30\"/><nd ref=\"31\"/><nd ref=\"32\"/><nd ref=\"33\"/><nd ref=\"30\"/></way>"
+	"<way id=\"19\"><nd ref=\"34\"/><nd ref=\"35\"/><nd ref=\"36\"/><nd ref=\"37\"/><nd ref=\"34\"/></way>"
+	"<way id=\"22\"><nd ref=\"38\"/><nd ref=\"39\"/><nd ref=\"40\"/><nd ref=\"41\"/><nd ref=\"38\"/></way>"
+	"<way id=\"23\"><nd ref=\"42\"/><nd ref=\"43\"/><nd ref=\"44\"/><nd ref=\"45\"/><nd ref=\"42\"/></way>"
+	"<way id=\"14\"><nd ref=\"5\"/><nd ref=\"6\"/></way>"
+	"<way id=\"15\"><nd ref=\"7\"/><nd ref=\"6\"/></way>"
+	"<way id=\"16\"><nd ref=\"7\"/><nd ref=\"8\"/><nd ref=\"5\"/></way>"
+	"<way id=\"17\"><nd ref=\"9\"/><nd ref=\"20\"/><nd ref=\"21\"/><nd ref=\"9\"/></way>"
+	"<way id=\"11\"><nd ref=\"2\"/><nd ref=\"3\"/></way>"
+	"<way id=\"12\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/></way>"
+	"<way id=\"13\"><nd ref=\"3\"/><nd ref=\"4\"/><nd ref=\"1\"/></way>"
+	"</osm>";
+
+struct RelationCase {
+	uint64_t id;
+	std::vector<uint64_t> memberIds;
+};
+
+bool CheckRelation(const Osm::OsmCache& osmCache, const RelationCase& relationCase) {
+	const Osm::OsmRelation* relation = osmCache.FindRelation(relationCase.id);
+	if (relation == nullptr) {
+		printf("FAIL relation %llu is missing\n", static_cast<unsigned long long>(relationCase.id));
+		return false;
+	}
+	bool isEqual = relation->memberCount == relationCase.memberIds.size();
+	for (size_t i = 0; isEqual && i < relationCase.memberIds.size(); ++i) {
+		isEqual = relation->members[i].handle.IsValid() && osmCache.GetComponent(relation->members[i].handle).id == relationCase.memberIds[i];
+	}
+	if (!isEqual) {
+		printf("FAIL relation %llu has %zu members, expected %zu\n", static_cast<unsigned long long>(relationCase.id),
+			static_cast<size_t>(relation->memberCount), relationCase.memberIds.size());
+	}
+	return isEqual;
+}
+
+}
+
+// Regression cases for relation members that refer ahead in the input. They must be resolved after a single pass, the
+// member closing a cycle must be dropped so that building the geometry terminates. Returns non-zero on failure.
+int RunRelationCheck(int /*argc*/, char** /*argv*/) {
+	Osm::OsmCache osmCache;
+	Osm::OsmXmlReader reader(kRelationDocument, strlen(kRelationDocument));
+	if (!Osm::ReadOsmCache(reader, osmCache)) {
+		printf("FAIL the document could not be read\n");
+		return 1;
+	}
+
+	// The search starts at 100, so the member of 102 that leads back to it closes the cycle
+	const RelationCase cases[] = {
+		{ 100, { 101, 10, 11 } },
+		{ 101, { 102 } },
+		{ 102, { 11 } },
+		{ 103, {} },
+		{ 104, { 12, 13 } },
+	};
+	size_t failureCount = 0;
+	for (const RelationCase& relationCase : cases) {
+		if (!CheckRelation(osmCache, relationCase)) {
+			++failureCount;
+		}
+	}
+	const Osm::OsmRelation* multigon = osmCache.FindRelation(104);
+	if (multigon != nullptr && (!multigon->isMultigon || multigon->outerRingCount != 1 || multigon->rings[0].segmentCount != 2)) {
+		printf("FAIL the outer ways of relation 104 were not chained\n");
+		++failureCount;
+	}
+	// 14, 15 reversed and 16 close the first ring, 17 is the second one
+	const Osm::OsmRelation* islands = osmCache.FindRelation(105);
+	const uint64_t expectedWayIds[] = { 14, 15, 16, 17 };
+	const bool expectedReversed[] = { false, true, false, false };
+	bool isChained = islands != nullptr && islands->outerRingCount == 2 && islands->rings[0].segmentCount == 3 && islands->ringSegmentCount == 4;
+	for (uint32_t i = 0; isChained && i < 4; ++i) {
+		isChained = osmCache.ways[islands->ringSegments[i].wayIndex].id == expectedWayIds[i] && islands->ringSegments[i].isReversed == expectedReversed[i];
+	}
+	if (!isChained) {
+		printf("FAIL the outer rings of relation 105 were not chained\n");
+		++failureCount;
+	}
+	// Extended from the start of 14 to 16
+	const Osm::OsmRelation* openRing = osmCache.FindRelation(106);
+	if (openRing == nullptr || openRing->outerRingCount != 1 || openRing->ringSegmentCount != 2 ||
+		osmCache.ways[openRing->ringSegments[0].wayIndex].id != 16 || osmCache.ways[openRing->ringSegments[1].wayIndex].id != 14) {
+		printf("FAIL the open ring of relation 106 was not chained\n");
+		++failureCount;
+	}
+	// Both holes are in the box of the outer ring 18, the hole 23 is in the island 22
+	const Osm::OsmRelation* nested = osmCache.FindRelation(107);
+	if (nested == nullptr || nested->outerRingCount != 2 || nested->innerRingCount != 2 || nested->rings[0].innerRingCount != 1 ||
+		nested->rings[1].innerRingCount != 1 || osmCache.ways[nested->ringSegments[nested->rings[nested->rings[0].firstInnerRing].firstSegment].wayIndex].id != 19 ||
+		osmCache.ways[nested->ringSegments[nested->rings[nested->rings[1].firstInnerRing].firstSegment].wayIndex].id != 23) {
+		printf("FAIL the inner rings of relation 107 were not nested\n");
+		++failureCount;
+	}
+	// Only the hole 26 is in the L, the one in its notch is dropped
+	const Osm::OsmRelation* notched = osmCache.FindRelation(108);
+	if (notched == nullptr || notched->outerRingCount != 1 || notched->innerRingCount != 1 ||
+		osmCache.ways[notched->ringSegments[notched->rings[notched->rings[0].firstInnerRing].firstSegment].wayIndex].id != 26) {
+		printf("FAIL the hole in the notch of relation 108 was kept\n");
+		++failureCount;
+	}
+	// Placed by a node of the hole off the outer ring, not by the shared corner
+	const Osm::OsmRelation* touching = osmCache.FindRelation(109);
+	if (touching == nullptr || touching->outerRingCount != 1 || touching->innerRingCount != 1 || touching->rings[0].innerRingCount != 1) {
+		printf("FAIL the hole touching the outer ring of relation 109 was dropped\n");
+		++failureCount;
+	}
+	if (!osmCache.pendingMembers.empty()) {
+		printf("FAIL %zu members are still pending\n", osmCache.pendingMembers.size());
+		++failureCount;
+	}
+
+	FTileMapData mapData;
+	if (!MapDataUtils::ProcessMapDataFromOsm(kRelationDocument, strlen(kRelationDocument), &mapData) || SIZE(mapData.buildings) != 10) {
+		printf("FAIL the document did not give the 10 relation buildings\n");
+		++failureCount;
+	}
+	// Reading the components and holes of the features must not allocate
+	Benchmark::HeapScope heap;
+	size_t holeCount = 0;
+	for (size_t i = 0; i < SIZE(mapData.buildings); ++i) {
+		const FMapGeometry* geometry = mapData.buildings[i]->geometry;
+		if (mapData.buildings[i]->id == 105 && geometry->GetComponentCount() != 2) {
+			printf("FAIL relation 105 did not give a polygon per outer ring\n");
+			++failureCount;
+		}
+		bool hasHoleEach = true;
+		for (int j = 0; j < geometry->GetComponentCount(); ++j) {
+			FLineSpan holes = geometry->GetComponent(j)->GetHoleSegments();
+			hasHoleEach = hasHoleEach && holes.count == 1;
+			for (const FLine* hole : holes) {
+				holeCount += hole->GetVertexCount() > 0 ? 1 : 0;
+			}
+		}
+		if (mapData.buildings[i]->id == 107 && (geometry->GetComponentCount() != 2 || !hasHoleEach)) {
+			printf("FAIL relation 107 did not give two polygons with a hole each\n");
+			++failureCount;
+		}
+	}
+	if (heap.GetStats().allocationCount != 0) {
+		printf("FAIL reading the geometry of %zu holes allocated %zu times\n", holeCount, heap.GetStats().allocationCount);
+		++failureCount;
+	}
+	printf("%zu relation checks failed\n", failureCount);
+	return failureCount == 0 ? 0 : 1;
+}
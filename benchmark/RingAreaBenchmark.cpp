@@ -0,0 +1,123 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MemoryArena.h"
+#include "ShapeUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static constexpr int kAreaRepeatCount = 20;
+
+// The function the kernel replaced, one term after the other
+static double CalculateSequentialArea(const double* x, const double* y, int count) {
+	double result = 0;
+	for (int i = 0; i < count; ++i) {
+		int next = i + 1 < count ? i + 1 : 0;
+		result += (x[next] - x[i]) * (y[next] + y[i]);
+	}
+	return result;
+}
+
+// Sum of the magnitudes of the terms, the error of either order of summation is bounded relative to it
+static double CalculateTermMagnitude(const double* x, const double* y, int count) {
+	double result = 0;
+	for (int i = 0; i < count; ++i) {
+		int next = i + 1 < count ? i + 1 : 0;
+		result += std::abs((x[next] - x[i]) * (y[next] + y[i]));
+	}
+	return result;
+}
+
+// Vertex counts like the rings of an urban tile: most buildings are closed quadrilaterals, some have a few more
+// corners, landuse areas and multipolygon rings have tens to hundreds of vertices
+static int GetRealisticVertexCount(std::mt19937& random) {
+	int kind = random() % 100;
+	if (kind < 60) {
+		return 5;
+	}
+	if (kind < 85) {
+		return 6 + random() % 8;
+	}
+	if (kind < 98) {
+		return 14 + random() % 50;
+	}
+	return 64 + random() % 1000;
+}
+
+// Compares the vector shoelace kernel with the sequential function it replaced on rings of realistic sizes, one ring
+// per call and all rings in one batch. Fails if an area is off by more than the rounding of the other summation
+// order, if an orientation differs, or if the batch or the scalar kernel differ from the single calls by a bit.
+int RunRingAreaBenchmark(int argc, char** argv) {
+	size_t ringCount = argc >= 1 ? static_cast<size_t>(std::strtoull(argv[0], nullptr, 10)) : 200000;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> center(0.0, 1.0);
+	std::uniform_real_distribution<double> radius(0.0005, 0.005);
+	MemoryArena arena;
+	std::vector<const FLine*> rings(ringCount);
+	size_t vertexCount = 0;
+	for (size_t i = 0; i < ringCount; ++i) {
+		FLine* ring = arena.New<FLine>();
+		int count = GetRealisticVertexCount(random);
+		double x = center(random);
+		double y = center(random);
+		double r = radius(random);
+		ring->ReserveVertices(count);
+		// Closed like the ways of buildings, the last vertex repeats the first one
+		for (int j = 0; j < count - 1; ++j) {
+			double angle = 2.0 * 3.14159265358979 * j / (count - 1);
+			ring->AddVertex(LatLong(47.0 + y * 0.02, 19.0 + x * 0.02), VECTOR2D(x + r * std::cos(angle), y + r * std::sin(angle)));
+		}
+		ring->AddVertex(ring->GetGlobalPosition(0), ring->GetLocalPosition(0));
+		rings[i] = ring;
+		vertexCount += count;
+	}
+
+	std::vector<double> sequentialAreas(ringCount);
+	std::vector<double> singleAreas(ringCount);
+	std::vector<double> batchAreas(ringCount);
+	std::vector<char> batchOrientations(ringCount);
+	bool* orientations = reinterpret_cast<bool*>(batchOrientations.data());
+	double sequentialSeconds = 0;
+	double singleSeconds = 0;
+	double batchSeconds = 0;
+	for (int repeat = 0; repeat < kAreaRepeatCount; ++repeat) {
+		Benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < ringCount; ++i) {
+			FLineVertices vertices = rings[i]->GetVertices();
+			sequentialAreas[i] = CalculateSequentialArea(vertices.localX, vertices.localY, vertices.count);
+		}
+		sequentialSeconds += stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		for (size_t i = 0; i < ringCount; ++i) {
+			singleAreas[i] = ShapeUtils::CalculateShapeArea(rings[i]);
+		}
+		singleSeconds += stopwatch.GetElapsedSeconds();
+		stopwatch.Restart();
+		ShapeUtils::CalculateShapeAreas(rings.data(), static_cast<int>(ringCount), false, batchAreas.data(), orientations);
+		batchSeconds += stopwatch.GetElapsedSeconds();
+	}
+	double vertexRate = static_cast<double>(vertexCount) * kAreaRepeatCount / 1e6;
+	printf("%zu rings, %.1f vertices per ring on average\n", ringCount, static_cast<double>(vertexCount) / ringCount);
+	printf("%-32s %7.1f M vertices per s\n", "Sequential, one ring per call", vertexRate / sequentialSeconds);
+	printf("%-32s %7.1f M vertices per s\n", "Kernel, one ring per call", vertexRate / singleSeconds);
+	printf("%-32s %7.1f M vertices per s\n", "Kernel, all rings in one call", vertexRate / batchSeconds);
+
+	for (size_t i = 0; i < ringCount; ++i) {
+		const FLine* ring = rings[i];
+		FLineVertices vertices = ring->GetVertices();
+		double tolerance = 1e-13 * CalculateTermMagnitude(vertices.localX, vertices.localY, vertices.count);
+		double scalarArea = ShapeUtils::CalculateShapeAreaScalar(vertices.localX, vertices.localY, vertices.count);
+		if (std::abs(singleAreas[i] - sequentialAreas[i]) > tolerance || batchAreas[i] != singleAreas[i] || singleAreas[i] != scalarArea ||
+			orientations[i] != (sequentialAreas[i] > 0) || orientations[i] != ShapeUtils::CalculateShapeOrientation(ring)) {
+			printf("MISMATCH ring %zu of %d vertices: %.17g sequential, %.17g kernel, %.17g batch, %.17g scalar\n", i,
+				ring->GetVertexCount(), sequentialAreas[i], singleAreas[i], batchAreas[i], scalarArea);
+			return 1;
+		}
+	}
+	return 0;
+}
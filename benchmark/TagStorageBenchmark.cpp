@@ -0,0 +1,113 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::unordered_map<std::string, std::string> TagMap;
+
+// The classification of the former per-entity tag maps
+static bool IsFeature(const TagMap& tags) {
+	return tags.find("highway") != tags.end() || tags.find("building") != tags.end() ||
+		tags.find("building:part") != tags.end() || tags.find("landuse") != tags.end();
+}
+
+static bool IsFeature(const Osm::OsmComponent* component) {
+	return component->IsPath() || component->IsBuilding() || component->IsLandUse();
+}
+
+template<typename T>
+static void AddComponents(const ARRAY<T>& items, std::vector<const Osm::OsmComponent*>& components) {
+	for (const T& item : items) {
+		components.push_back(&item);
+	}
+}
+
+// Compares the interned, sorted tag arrays of the entities with the unordered_map<string, string> every entity used to
+// carry: memory per tagged entity and the speed of the IsPath/IsBuilding/IsLandUse classification over all entities.
+int RunTagStorageBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	MappedFile mappedFile;
+	if (!mappedFile.Open(argv[0])) {
+		printf("Could not open %s\n", argv[0]);
+		return 1;
+	}
+	Osm::OsmCache osmCache;
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	if (!Osm::ReadOsmCache(reader, osmCache)) {
+		printf("Could not parse %s\n", argv[0]);
+		return 1;
+	}
+	std::vector<const Osm::OsmComponent*> components;
+	AddComponents(osmCache.nodes, components);
+	AddComponents(osmCache.ways, components);
+	AddComponents(osmCache.relations, components);
+
+	size_t taggedCount = 0;
+	size_t tagCount = 0;
+	for (const Osm::OsmComponent* component : components) {
+		taggedCount += component->tagCount > 0 ? 1 : 0;
+		tagCount += component->tagCount;
+	}
+
+	// Rebuild the former representation from the same tags
+	const Osm::TagDictionary& dictionary = Osm::GetTagDictionary();
+	std::vector<TagMap> tagMaps;
+	tagMaps.reserve(components.size());
+	Benchmark::HeapScope heap;
+	for (const Osm::OsmComponent* component : components) {
+		tagMaps.emplace_back();
+		for (uint32_t i = 0; i < component->tagCount; ++i) {
+			tagMaps.back()[std::string(dictionary.GetString(component->tags[i].key))] = std::string(dictionary.GetString(component->tags[i].value));
+		}
+	}
+	size_t mapBytes = heap.GetStats().liveBytes + components.size() * sizeof(TagMap);
+	size_t arrayBytes = tagCount * sizeof(Osm::OsmTag) + components.size() * (sizeof(const Osm::OsmTag*) + sizeof(uint32_t));
+
+	printf("%zu entities, %zu tagged, %zu tags, %zu distinct strings\n", components.size(), taggedCount, tagCount, dictionary.GetCount());
+	printf("%-36s %8.1f bytes per tagged entity\n", "unordered_map<string, string>", static_cast<double>(mapBytes) / taggedCount);
+	printf("%-36s %8.1f bytes per tagged entity, dictionary %.1f MB\n", "interned tag arrays", static_cast<double>(arrayBytes) / taggedCount,
+		dictionary.GetMemoryBytes() / (1024.0 * 1024.0));
+
+	const int32_t kPassCount = 10;
+	size_t mapFeatureCount = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (int32_t pass = 0; pass < kPassCount; ++pass) {
+			for (const TagMap& tags : tagMaps) {
+				mapFeatureCount += IsFeature(tags) ? 1 : 0;
+			}
+		}
+		printf("%-36s %8.1f ns per entity\n", "classify, unordered_map", stopwatch.GetElapsedSeconds() * 1e9 / (components.size() * kPassCount));
+	}
+	size_t arrayFeatureCount = 0;
+	{
+		Benchmark::Stopwatch stopwatch;
+		for (int32_t pass = 0; pass < kPassCount; ++pass) {
+			for (const Osm::OsmComponent* component : components) {
+				arrayFeatureCount += IsFeature(component) ? 1 : 0;
+			}
+		}
+		printf("%-36s %8.1f ns per entity\n", "classify, interned tag arrays", stopwatch.GetElapsedSeconds() * 1e9 / (components.size() * kPassCount));
+	}
+	printf("%zu features\n", arrayFeatureCount / kPassCount);
+
+	// Nothing refers to the strings of the file any more, only the well-known keys are kept
+	osmCache.Release();
+	Osm::GetTagDictionary().Reset();
+	printf("%-36s %8.1f MB\n", "dictionary after reset", dictionary.GetMemoryBytes() / (1024.0 * 1024.0));
+	bool isReset = dictionary.GetCount() == Osm::kWellKnownTagCount && dictionary.Find("building") == Osm::kTagBuilding &&
+		dictionary.GetString(Osm::kTagRoofColour) == "roof:colour";
+	if (!isReset) {
+		printf("FAIL the reset dictionary has %zu strings\n", dictionary.GetCount());
+	}
+	return mapFeatureCount == arrayFeatureCount && isReset ? 0 : 1;
+}
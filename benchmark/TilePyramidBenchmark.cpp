@@ -0,0 +1,128 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+
+#include "MapDataUtils.h"
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+#include "OsmXmlReader.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Tiles that are also built one call at a time, to compare with the partitioned ones
+static constexpr size_t kSampleTileCount = 64;
+// Tiles that are also parsed from the XML one call at a time, the way the partitioner replaces
+static constexpr size_t kReparseTileCount = 4;
+
+template<typename T>
+static bool AreIdsEqual(const ARRAY<T*>& left, const ARRAY<T*>& right) {
+	if (SIZE(left) != SIZE(right)) {
+		return false;
+	}
+	for (size_t i = 0; i < SIZE(left); ++i) {
+		if (left[i]->id != right[i]->id || left[i]->geometry->GetComponentCount() != right[i]->geometry->GetComponentCount()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool AreTilesEqual(const FTileMapData& left, const FTileMapData& right) {
+	return AreIdsEqual(left.paths, right.paths) && AreIdsEqual(left.buildings, right.buildings) && AreIdsEqual(left.landuse, right.landuse);
+}
+
+// Partitions an extract into every tile of a zoom level in one pass, clipped to the tiles, and reports tiles per second.
+// The same tiles built one ProcessMapDataFromOsmCache call each, and a few parsed from the XML each time, give the rate
+// of the per tile pipeline it replaces. Fails if a partitioned tile differs from the one built on its own.
+int RunTilePyramidBenchmark(int argc, char** argv) {
+	if (argc < 1) {
+		return 1;
+	}
+	const std::string path = argv[0];
+	int32_t zoom = argc >= 2 ? std::atoi(argv[1]) : 16;
+	int32_t threadCount = argc >= 3 ? std::atoi(argv[2]) : ThreadUtils::GetHardwareThreadCount();
+	MappedFile mappedFile;
+	if (!mappedFile.Open(path.c_str())) {
+		printf("Could not open %s\n", path.c_str());
+		return 1;
+	}
+	Osm::OsmCache osmCache;
+	Benchmark::Stopwatch stopwatch;
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	if (!Osm::ReadOsmCache(reader, osmCache, Benchmark::CreateFeatureTagFilter())) {
+		printf("Could not parse %s\n", path.c_str());
+		return 1;
+	}
+	double readSeconds = stopwatch.GetElapsedSeconds();
+	printf("%-40s %9.2f ms\n", "ReadOsmCache, once", readSeconds * 1000.0);
+
+	MapDataParseOptions options;
+	options.threadCount = threadCount;
+	options.isClippingToTile = true;
+	stopwatch.Restart();
+	ARRAY<PartitionedTile> tiles;
+	if (!MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, zoom, tiles, options)) {
+		printf("Could not partition %s at zoom %d\n", path.c_str(), zoom);
+		return 1;
+	}
+	double partitionSeconds = stopwatch.GetElapsedSeconds();
+	std::string label = "Partitioned, " + std::to_string(threadCount) + " threads";
+	printf("%-40s %9.2f ms  %zu tiles at zoom %d, %.0f tiles/s\n", label.c_str(), partitionSeconds * 1000.0, static_cast<size_t>(SIZE(tiles)),
+		zoom, SIZE(tiles) / std::max(partitionSeconds, 1e-9));
+
+	// With shared vertices every tile looks up only the nodes of its own lines, so the rate stays close to the one above
+	options.isSharingVertices = true;
+	stopwatch.Restart();
+	ARRAY<PartitionedTile> sharedTiles;
+	MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, zoom, sharedTiles, options);
+	double sharedSeconds = stopwatch.GetElapsedSeconds();
+	options.isSharingVertices = false;
+	printf("%-40s %9.2f ms  %zu tiles, %.0f tiles/s\n", "Partitioned, shared vertices", sharedSeconds * 1000.0, static_cast<size_t>(SIZE(sharedTiles)),
+		SIZE(sharedTiles) / std::max(sharedSeconds, 1e-9));
+	size_t mismatchCount = 0;
+	for (size_t i = 0; i < SIZE(tiles) && SIZE(sharedTiles) == SIZE(tiles); ++i) {
+		mismatchCount += AreTilesEqual(*tiles[i].data, *sharedTiles[i].data) ? 0 : 1;
+	}
+	if (SIZE(sharedTiles) != SIZE(tiles) || mismatchCount > 0) {
+		printf("MISMATCH the tiles with shared vertices differ from the ones without\n");
+		return 1;
+	}
+
+	// Spread the sample over the whole extract
+	size_t sampleCount = std::min(static_cast<size_t>(SIZE(tiles)), kSampleTileCount);
+	FTileMapData tileData;
+	stopwatch.Restart();
+	for (size_t i = 0; i < sampleCount; ++i) {
+		const PartitionedTile& tile = tiles[i * SIZE(tiles) / sampleCount];
+		tileData.Reset();
+		MapDataUtils::ProcessMapDataFromOsmCache(osmCache, &tileData, tile.key.x, tile.key.y, zoom, options);
+		if (!AreTilesEqual(*tile.data, tileData)) {
+			printf("MISMATCH tile %d/%d differs from the one built on its own\n", tile.key.x, tile.key.y);
+			++mismatchCount;
+		}
+	}
+	double sampleSeconds = stopwatch.GetElapsedSeconds();
+	printf("%-40s %9.2f ms  %zu tiles, %.0f tiles/s\n", "One cache call per tile", sampleSeconds * 1000.0, sampleCount,
+		sampleCount / std::max(sampleSeconds, 1e-9));
+
+	size_t reparseCount = std::min(sampleCount, kReparseTileCount);
+	stopwatch.Restart();
+	for (size_t i = 0; i < reparseCount; ++i) {
+		const PartitionedTile& tile = tiles[i * SIZE(tiles) / sampleCount];
+		tileData.Reset();
+		MapDataUtils::ProcessMapDataFromOsm(mappedFile.GetData(), mappedFile.GetSize(), &tileData, tile.key.x, tile.key.y, zoom, options);
+	}
+	double reparseSeconds = stopwatch.GetElapsedSeconds();
+	printf("%-40s %9.2f ms  %zu tiles, %.1f tiles/s\n", "One XML parse per tile", reparseSeconds * 1000.0, reparseCount,
+		reparseCount / std::max(reparseSeconds, 1e-9));
+	MapDataUtils::ReleaseThreadCache();
+
+	if (mismatchCount > 0) {
+		return 1;
+	}
+	printf("  %zu sampled tiles identical to the ones built on their own\n", sampleCount);
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct BenchmarkEntry {
+	const char* name;
+	const char* usage;
+	int (*run)(int argc, char** argv);
+};
+
+static const BenchmarkEntry kBenchmarks[] = {
+	{ "osm-ingest", "<file.osm>", RunOsmIngestBenchmark },
+	{ "input-copy", "<file.osm>", RunInputCopyBenchmark },
+	{ "pbf-ingest", "<file.osm> <file.osm.pbf>", RunPbfIngestBenchmark },
+	{ "coordinate-parse", "[count]", RunCoordinateParseBenchmark },
+	{ "id-index", "[count]", RunIdIndexBenchmark },
+	{ "process-osm", "<file.osm> [repeat]", RunProcessOsmBenchmark },
+	{ "tag-storage", "<file.osm>", RunTagStorageBenchmark },
+	{ "feature-build", "<file.osm> [threads] [repeat]", RunFeatureBuildBenchmark },
+	{ "tile-pyramid", "<file.osm> [zoom] [threads]", RunTilePyramidBenchmark },
+	{ "osm-snapshot", "<file.osm> [file.snapshot]", RunOsmSnapshotBenchmark },
+	{ "multipolygon", "[rings] [holes]", RunMultipolygonBenchmark },
+	{ "line-layout", "[lines] [vertices]", RunLineLayoutBenchmark },
+	{ "ring-area", "[rings]", RunRingAreaBenchmark },
+	{ "landuse-assign", "[buildings per landuse area]", RunLanduseAssignBenchmark },
+	{ "building-neighborhood", "[radius in meters]", RunBuildingNeighborhoodBenchmark },
+	{ "point-in-shape", "[points per ring]", RunPointInShapeBenchmark },
+	{ "inflate-check", "", RunInflateCheck },
+	{ "relation-check", "", RunRelationCheck },
+	{ "clip-check", "", RunClipCheck },
+	{ "change-check", "", RunChangeCheck },
+	{ "quantize-check", "", RunQuantizeCheck },
+};
+
+int main(int argc, char** argv) {
+	if (argc >= 2) {
+		for (const BenchmarkEntry& benchmark : kBenchmarks) {
+			if (strcmp(argv[1], benchmark.name) == 0) {
+				return benchmark.run(argc - 2, argv + 2);
+			}
+		}
+	}
+	printf("Usage: %s <benchmark> [arguments]\n", argc > 0 ? argv[0] : "mapdata-benchmark");
+	for (const BenchmarkEntry& benchmark : kBenchmarks) {
+		printf("  %s %s\n", benchmark.name, benchmark.usage);
+	}
+	return 1;
+}
@@ -1,3 +1,26 @@
 #include "FTileMapData.h"
 
+#include <cstring>
+#include <utility>
 
+void FLine::SetVertexCapacity(int capacity) {
+	ARRAY<double> vertexData;
+	RESIZE(vertexData, 4 * capacity);
+	for (int stream = 0; _vertexCount > 0 && stream < 4; ++stream) {
+		memcpy(DATA(vertexData) + stream * capacity, DATA(_vertexData) + stream * _vertexCapacity, _vertexCount * sizeof(double));
+	}
+	_vertexData = std::move(vertexData);
+	_vertexCapacity = capacity;
+}
+
+void FLine::CopyPoolPositions() {
+	if (_vertexPool == nullptr) {
+		return;
+	}
+	const FVertexPool* vertexPool = _vertexPool;
+	_vertexPool = nullptr;
+	ReserveVertices(static_cast<int>(SIZE(vertexIndices)));
+	for (uint32_t vertexIndex : vertexIndices) {
+		AddVertex(vertexPool->GetGlobalPosition(vertexIndex), vertexPool->GetLocalPosition(vertexIndex));
+	}
+}
@@ -3,14 +3,18 @@
 #pragma once
 
 #include "LatLong.h"
+#include "MemoryArena.h"
 #include "type_defines.h"
 
+#include <memory>
+#include <vector>
+
 struct TileData {
 public:
-	TileData(LatLong lower, LatLong upper, const STRING& mapDataJson) : lowerCorner(lower), upperCorner(upper), mapDataJson(mapDataJson) {}
+	TileData(LatLong lower, LatLong upper, STRING_VIEW mapDataJson) : lowerCorner(lower), upperCorner(upper), mapDataJson(mapDataJson) {}
 	LatLong lowerCorner;
 	LatLong upperCorner;
-	const STRING& mapDataJson;
+	STRING_VIEW mapDataJson;
 };
 
 /*enum EGeometryType {
@@ -22,32 +26,170 @@ public:
 
 struct FLine;
 
+// Read-only view of an array of pointers owned by a geometry, valid until the array is changed
+template<typename T>
+struct FPointerSpan {
+public:
+	const T* const* data;
+	int count;
+	const T* operator[](int i) const { return data[i]; }
+	const T* const* begin() const { return data; }
+	const T* const* end() const { return data + count; }
+};
+
+typedef FPointerSpan<FLine> FLineSpan;
+
+// Geometries are only read through const accessors that neither allocate nor keep state, so the features of a parsed
+// tile can be traversed by several threads at once
 struct FMapGeometry {
 public:
 	//EGeometryType type;
-	virtual FLine* GetMainSegment() = 0;
-	virtual ARRAY<FLine*> GetHoleSegments() = 0;
-	virtual int GetComponentCount() { return 1; }
+	virtual const FLine* GetMainSegment() const = 0;
+	virtual FLineSpan GetHoleSegments() const = 0;
+	virtual int GetComponentCount() const { return 1; }
+	// Simple geometries are their only component
+	virtual const FMapGeometry* GetComponent(int /*index*/) const { return this; }
 	virtual ~FMapGeometry() = default;
 };
 
 struct FCoordinate : public FMapGeometry {
 public:
 	FCoordinate() : globalPosition(0, 0) {}
-	FLine* GetMainSegment() override { return nullptr; } // Invalid, a single node may not have segment
-	ARRAY<FLine*> GetHoleSegments() override { return ARRAY<FLine*>(); } // Invalid, a single node may not have holes
+	const FLine* GetMainSegment() const override { return nullptr; } // Invalid, a single node may not have segment
+	FLineSpan GetHoleSegments() const override { return { nullptr, 0 }; } // Invalid, a single node may not have holes
 	LatLong globalPosition;
 	VECTOR2D localPosition;
 };
 
+// The nodes the lines of a tile are made of, each one projected and stored once. Lines refer to them by their vertex
+// indices, so the lines of features sharing a node, e.g. roads meeting at a crossing or buildings wall to wall, refer
+// to the same vertex.
+struct FVertexPool {
+public:
+	// The vertices made by clipping are no node of the input
+	static constexpr uint32_t kNoVertex = 0xFFFFFFFF;
+	ARRAY<int64_t> nodeIds;
+	ARRAY<double> latitudes;
+	ARRAY<double> longitudes;
+	ARRAY<double> localX;
+	ARRAY<double> localY;
+	// Number of lines of the features of the tile that refer to each vertex
+	ARRAY<uint32_t> lineCounts;
+	int GetVertexCount() const { return SIZE(nodeIds); }
+	LatLong GetGlobalPosition(int i) const { return LatLong(latitudes[i], longitudes[i]); }
+	VECTOR2D GetLocalPosition(int i) const { return VECTOR2D(localX[i], localY[i]); }
+	bool IsShared(int i) const { return lineCounts[i] > 1; }
+	void Clear() {
+		CLEAR(nodeIds);
+		CLEAR(latitudes);
+		CLEAR(longitudes);
+		CLEAR(localX);
+		CLEAR(localY);
+		CLEAR(lineCounts);
+	}
+};
+
+struct FLineVertices {
+public:
+	// The streams of the line, or those of the vertex pool if the line keeps no positions of its own
+	const double* latitudes;
+	const double* longitudes;
+	const double* localX;
+	const double* localY;
+	// Null if the line does not refer to a vertex pool
+	const uint32_t* vertexIndices;
+	int count;
+	// Vertex i is element vertexIndices[i] of the streams of the pool instead of element i of those of the line
+	bool isPooled;
+	int GetStreamIndex(int i) const { return isPooled ? static_cast<int>(vertexIndices[i]) : i; }
+	LatLong GetGlobalPosition(int i) const { int j = GetStreamIndex(i); return LatLong(latitudes[j], longitudes[j]); }
+	VECTOR2D GetLocalPosition(int i) const { int j = GetStreamIndex(i); return VECTOR2D(localX[j], localY[j]); }
+};
+
 struct FLine : public FMapGeometry {
 public:
-	ARRAY<FCoordinate*> coordinates;
+	// The vertex of the FVertexPool of the tile each vertex is, empty if the tile has no pool. A line whose vertices are
+	// all vertices of the pool keeps no positions and reads them through these.
+	ARRAY<uint32_t> vertexIndices;
 	bool isClosed; //for closed ways, e.g. simple buildings or areas
 	bool isClockwise;
-	FCoordinate* GetCoordinate(int i) { return isClockwise ? coordinates[i] : coordinates[SIZE(coordinates) - 1 - i]; }
-	FLine* GetMainSegment() override { return this; } // This shape is the outer segment itself
-	ARRAY<FLine*> GetHoleSegments() override { return ARRAY<FLine*>(); } // A FLine will not have any holes
+	int GetVertexCount() const { return _vertexPool != nullptr ? static_cast<int>(SIZE(vertexIndices)) : _vertexCount; }
+	// Whether the positions are read through the vertex pool
+	bool IsPooled() const { return _vertexPool != nullptr; }
+	LatLong GetGlobalPosition(int i) const {
+		return _vertexPool != nullptr ? _vertexPool->GetGlobalPosition(vertexIndices[i]) : LatLong(_vertexData[i], _vertexData[_vertexCapacity + i]);
+	}
+	VECTOR2D GetLocalPosition(int i) const {
+		return _vertexPool != nullptr ? _vertexPool->GetLocalPosition(vertexIndices[i]) :
+			VECTOR2D(_vertexData[2 * _vertexCapacity + i], _vertexData[3 * _vertexCapacity + i]);
+	}
+	// Index of the i-th vertex in clockwise order
+	int GetClockwiseIndex(int i) const { return isClockwise ? i : GetVertexCount() - 1 - i; }
+	FLineVertices GetVertices() const {
+		if (_vertexPool != nullptr) {
+			return { DATA(_vertexPool->latitudes), DATA(_vertexPool->longitudes), DATA(_vertexPool->localX), DATA(_vertexPool->localY),
+				DATA(vertexIndices), GetVertexCount(), true };
+		}
+		const double* data = DATA(_vertexData);
+		return { data, data + _vertexCapacity, data + 2 * _vertexCapacity, data + 3 * _vertexCapacity, EMPTY(vertexIndices) ? nullptr : DATA(vertexIndices),
+			_vertexCount, false };
+	}
+	void ReserveVertices(int count) {
+		if (count > _vertexCapacity) {
+			SetVertexCapacity(count);
+		}
+	}
+	void AddVertex(const LatLong& globalPosition, const VECTOR2D& localPosition) {
+		if (_vertexCount == _vertexCapacity) {
+			SetVertexCapacity(MAX(2 * _vertexCapacity, 4));
+		}
+		double* data = DATA(_vertexData);
+		data[_vertexCount] = globalPosition.latitude;
+		data[_vertexCapacity + _vertexCount] = globalPosition.longitude;
+		data[2 * _vertexCapacity + _vertexCount] = localPosition.X;
+		data[3 * _vertexCapacity + _vertexCount] = localPosition.Y;
+		++_vertexCount;
+	}
+	void AddVertex(const LatLong& globalPosition, const VECTOR2D& localPosition, uint32_t vertexIndex) {
+		AddVertex(globalPosition, localPosition);
+		ADD(vertexIndices, vertexIndex);
+	}
+	// Refers to a vertex of the pool without keeping its positions, only for lines whose vertices are all added so
+	void AddVertex(const FVertexPool* vertexPool, uint32_t vertexIndex) {
+		_vertexPool = vertexPool;
+		ADD(vertexIndices, vertexIndex);
+	}
+	// Keeps the positions of the pool vertices added so far in the line itself, e.g. before adding a vertex that is
+	// none of the pool. The vertex indices stay.
+	void CopyPoolPositions();
+	const FLine* GetMainSegment() const override { return this; } // This shape is the outer segment itself
+	FLineSpan GetHoleSegments() const override { return { nullptr, 0 }; } // A FLine will not have any holes
+
+private:
+	void SetVertexCapacity(int capacity);
+
+	// The latitudes, longitudes, local X and local Y of the vertices one after the other in a single block, vertex i is
+	// element i of each stream. Each stream is _vertexCapacity long.
+	ARRAY<double> _vertexData;
+	int _vertexCount = 0;
+	int _vertexCapacity = 0;
+	// Set if the positions are read through vertexIndices, the line then keeps none
+	const FVertexPool* _vertexPool = nullptr;
+};
+
+// Local coordinates of a line on a grid of extent units per tile side, e.g. 4096 like vector tiles, with int16_t or
+// int32_t values. Local coordinate v is stored as round(v * extent), the clip buffer keeps values outside of
+// [0, extent]. ShapeUtils::QuantizeLine makes them from a line.
+template<typename T>
+struct FQuantizedLine {
+public:
+	ARRAY<T> x;
+	ARRAY<T> y;
+	int32_t extent = 0;
+	bool isClosed = false;
+	bool isClockwise = false;
+	int GetVertexCount() const { return SIZE(x); }
+	VECTOR2D GetLocalPosition(int i) const { return VECTOR2D(x[i] / static_cast<double>(extent), y[i] / static_cast<double>(extent)); }
 };
 
 struct FPolygon : public FMapGeometry {
@@ -55,23 +197,19 @@ public:
 	FLine* outerShape;
 	ARRAY<FLine*> innerShapes;
 
-	FLine* GetMainSegment() override { return outerShape; }
-	ARRAY<FLine*> GetHoleSegments() override { return innerShapes; }
+	const FLine* GetMainSegment() const override { return outerShape; }
+	FLineSpan GetHoleSegments() const override { return { DATA(innerShapes), static_cast<int>(SIZE(innerShapes)) }; }
 };
 
 struct FCompositeGeometry : public FMapGeometry {
 public:
 	ARRAY<FMapGeometry*> geometries;
 
-	FMapGeometry* GetActiveGeometry() {
-		return geometries[CurrentIndex];
-	}
-	FLine* GetMainSegment() override { return GetActiveGeometry()->GetMainSegment(); }
-	ARRAY<FLine*> GetHoleSegments() override { return GetActiveGeometry()->GetHoleSegments(); }
-	int GetComponentCount() { return SIZE(geometries); }
-	void SetGeometryIndex(int index) { CurrentIndex = index; }
-private:
-	int CurrentIndex = 0;
+	// The segments of the first component, a relation whose members are all outside of the input has no components
+	const FLine* GetMainSegment() const override { return SIZE(geometries) > 0 ? geometries[0]->GetMainSegment() : nullptr; }
+	FLineSpan GetHoleSegments() const override { return SIZE(geometries) > 0 ? geometries[0]->GetHoleSegments() : FLineSpan{ nullptr, 0 }; }
+	int GetComponentCount() const override { return SIZE(geometries); }
+	const FMapGeometry* GetComponent(int index) const override { return geometries[index]; }
 };
 
 struct FMapElement {
@@ -318,4 +456,23 @@ public:
 	ARRAY<FBuildingData*> buildings;
 	ARRAY<FLanduseData*> landuse;
 	ARRAY<FMapElement*> water;
+	// Only filled with MapDataParseOptions::isSharingVertices
+	FVertexPool vertexPool;
+	// Owns the elements above and their geometry, they live as long as the tile data or until Reset()
+	MemoryArena arena;
+	// Owns the elements built in parallel, one arena per work chunk so that no two threads share one
+	std::vector<std::unique_ptr<MemoryArena>> chunkArenas;
+
+	// Drops all elements at once, the arenas keep their memory for the next tile parsed into this object
+	void Reset() {
+		CLEAR(paths);
+		CLEAR(buildings);
+		CLEAR(landuse);
+		CLEAR(water);
+		vertexPool.Clear();
+		arena.Reset();
+		for (const std::unique_ptr<MemoryArena>& chunkArena : chunkArenas) {
+			chunkArena->Reset();
+		}
+	}
 };
@@ -3,7 +3,7 @@
 #include "ShapeUtils.h"
 #include "FTileMapData.h"
 
-static void SeekToValue(const STRING& input, int& i) {
+static void SeekToValue(STRING_VIEW input, int& i) {
 	while (i < LENGTH(input) && (isspace(input[i]) || input[i] == ':')) {
 		++i;
 	}
@@ -29,7 +29,7 @@ static void ParseNumber(const TileData& inputData, int32_t& i, T& result) {
 	while (i + count < LENGTH(inputData.mapDataJson) && IsNumber(inputData.mapDataJson[i + count])) {
 		++count;
 	}
-	STRING subString = SUBSTRING(inputData.mapDataJson, i, count);
+	STRING subString(SUBSTRING(inputData.mapDataJson, i, count));
 	i += count - 1;
 	if constexpr (std::is_same<std::decay_t<T>, double>::value) {
 		result = ATOD(subString);
@@ -48,10 +48,10 @@ static void ParseString(const TileData& inputData, int32_t& i, STRING& result) {
 	}
 	i = firstIndex + count;
 
-	result = SUBSTRING(inputData.mapDataJson, firstIndex, count);
+	result = STRING(SUBSTRING(inputData.mapDataJson, firstIndex, count));
 }
 
-static void SeekToNextCoordinate(const STRING& mapDataJson, int32_t& i) {
+static void SeekToNextCoordinate(STRING_VIEW mapDataJson, int32_t& i) {
 	while (i < LENGTH(mapDataJson) && !IsNumber(mapDataJson[i])) {
 		++i;
 	}
@@ -125,25 +125,26 @@ static void ParseShapes(const TileData& inputData, int32_t& i, ARRAY<FMapGeometr
 			currentShape = new FLine();
 		}
 		if (IsNumber(inputData.mapDataJson[i])) {
-			FCoordinate* coordinate;
-			ParseNumber<double>(inputData, i, coordinate->globalPosition.longitude);
+			LatLong globalPosition;
+			ParseNumber<double>(inputData, i, globalPosition.longitude);
 			++i;
 			SeekToNextCoordinate(inputData.mapDataJson, i);
-			ParseNumber<double>(inputData, i, coordinate->globalPosition.latitude);
-			coordinate->localPosition.X = GetRangeMappedValue(coordinate->globalPosition.longitude,
+			ParseNumber<double>(inputData, i, globalPosition.latitude);
+			VECTOR2D localPosition;
+			localPosition.X = GetRangeMappedValue(globalPosition.longitude,
 				inputData.lowerCorner.longitude,
 				inputData.upperCorner.longitude);
-			coordinate->localPosition.Y = GetRangeMappedValue(coordinate->globalPosition.latitude,
+			localPosition.Y = GetRangeMappedValue(globalPosition.latitude,
 				inputData.lowerCorner.latitude,
 				inputData.upperCorner.latitude);
-			ADD(currentShape->coordinates, coordinate);
+			currentShape->AddVertex(globalPosition, localPosition);
 		}
 		if (parser.IsInValidState()) {
 			break;
 		}
 		i += 1;
 	}
-	if (!EMPTY(currentShape->coordinates)) {
+	if (currentShape->GetVertexCount() > 0) {
 		//ShapeUtils::CalculateShapeOrientation(currentShape);
 		ADD(shapes, currentShape);
 	}
@@ -2,18 +2,39 @@
 
 #include "MapDataUtils.h"
 #include "JsonParserUtils.h"
+#include "MappedFile.h"
 #include "OsmParserUtils.h"
+#include "OsmPbfReader.h"
+#include "OsmXmlReader.h"
+#include "ThreadUtils.h"
 #include "TileUtils.h"
-#include "tinyxml2.h"
 
 #include <algorithm>
 #include <ctype.h>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <type_traits>
 #include <unordered_map>
 #include <string>
 
 bool MapDataUtils::ProcessMapDataFromGeoJson(const STRING& mapDataJson, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom)
 {
+	return ProcessMapDataFromGeoJson(CSTRINGOF(mapDataJson), LENGTH(mapDataJson), parsedMapData, tileX, tileY, zoom);
+}
+
+bool MapDataUtils::ProcessMapDataFromGeoJsonFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	return ProcessMapDataFromGeoJson(mappedFile.GetData(), mappedFile.GetSize(), parsedMapData, tileX, tileY, zoom);
+}
+
+bool MapDataUtils::ProcessMapDataFromGeoJson(const char* mapDataJsonBytes, size_t length, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom)
+{
+	STRING_VIEW mapDataJson(mapDataJsonBytes, length);
 	if (EMPTY(mapDataJson)) {
 		return false;
 	}
@@ -35,49 +56,78 @@ bool MapDataUtils::ProcessMapDataFromGeoJson(const STRING& mapDataJson, FTileMap
 	return true;
 }
 
-static void ParseOneItem(FTileMapData* parsedMapData, Osm::OsmComponent* component, LatLong tileCornerLow, LatLong tileCornerHigh)
+// A missing tag reads as an empty string
+static STRING GetTagString(const Osm::OsmTag* tag)
+{
+	return tag != nullptr ? Osm::GetTagDictionary().GetString(tag->value).data() : "";
+}
+
+// The elements of one work chunk, the chunks are appended to the tile data in order
+struct FeatureChunk {
+	ARRAY<FPathData*> paths;
+	ARRAY<FBuildingData*> buildings;
+	ARRAY<FLanduseData*> landuse;
+};
+
+static void ParseOneItem(FeatureChunk& output, MemoryArena& arena, const Osm::OsmCache& osmCache, Osm::OsmHandle item, LatLong tileCornerLow, LatLong tileCornerHigh, const Osm::GeometryClip* clip,
+	const Osm::GeometryVertexPool* vertexPool)
 {
+	const Osm::OsmComponent* component = &osmCache.GetComponent(item);
 	static const int kDefaultLevels = 1;
 	static const int kDefaultHeightPerLevel = 30;
+	// Paths are clipped as lines, buildings and landuse areas as areas. Geometry clipped away entirely drops the feature.
+	Osm::GeometryClip lineClip;
+	Osm::GeometryClip areaClip;
+	if (clip != nullptr) {
+		lineClip = *clip;
+		lineClip.isArea = false;
+		areaClip = *clip;
+		areaClip.isArea = true;
+	}
 
 	if (component->IsPath()) {
-		FPathData* fPath = new FPathData();
-		ADD(parsedMapData->paths, fPath);
-		STRING pathTypeStr = component->tags.find("highway") != component->tags.end() ?
-			component->tags.find("highway")->second.c_str() : "";
-		STRING surfaceStr = component->tags.find("surface") != component->tags.end() ?
-			component->tags.find("surface")->second.c_str() : "";
-		fPath->pathType = MapDataUtils::StringToPathType(pathTypeStr);
-		fPath->surfaceMaterial = MapDataUtils::StringToPathSurfaceMaterial(surfaceStr);
-		fPath->geometry = component->CreateGeometry(tileCornerLow, tileCornerHigh);
+		FMapGeometry* geometry = osmCache.CreateGeometry(item, tileCornerLow, tileCornerHigh, arena, clip != nullptr ? &lineClip : nullptr, vertexPool);
+		if (geometry != nullptr) {
+			FPathData* fPath = arena.New<FPathData>();
+			ADD(output.paths, fPath);
+			fPath->id = component->id;
+			STRING pathTypeStr = component->GetTagValue(Osm::kTagHighway).data();
+			STRING surfaceStr = component->GetTagValue(Osm::kTagSurface).data();
+			fPath->pathType = MapDataUtils::StringToPathType(pathTypeStr);
+			fPath->surfaceMaterial = MapDataUtils::StringToPathSurfaceMaterial(surfaceStr);
+			fPath->geometry = geometry;
+		}
 	}
 	if (component->IsLandUse()) {
-		FLanduseData* fLanduse = new FLanduseData();
-		ADD(parsedMapData->landuse, fLanduse);
-		LanduseKind landuseKind = LanduseKind::Unknown;
-		STRING landuseStr = component->tags.find("landuse") != component->tags.end() ?
-			component->tags.find("landuse")->second.c_str() : "";
-
-		fLanduse->kind = MapDataUtils::StringToLanduseKind(landuseStr);
-		fLanduse->geometry = component->CreateGeometry(tileCornerLow, tileCornerHigh);
+		FMapGeometry* geometry = osmCache.CreateGeometry(item, tileCornerLow, tileCornerHigh, arena, clip != nullptr ? &areaClip : nullptr, vertexPool);
+		if (geometry != nullptr) {
+			FLanduseData* fLanduse = arena.New<FLanduseData>();
+			ADD(output.landuse, fLanduse);
+			fLanduse->id = component->id;
+			STRING landuseStr = component->GetTagValue(Osm::kTagLanduse).data();
+
+			fLanduse->kind = MapDataUtils::StringToLanduseKind(landuseStr);
+			fLanduse->geometry = geometry;
+		}
 	}
-	if (component->IsBuilding())
+	FMapGeometry* buildingGeometry = component->IsBuilding() ? osmCache.CreateGeometry(item, tileCornerLow, tileCornerHigh, arena, clip != nullptr ? &areaClip : nullptr, vertexPool) : nullptr;
+	if (buildingGeometry != nullptr)
 	{
-		FBuildingData* fBuilding = new FBuildingData();
-		ADD(parsedMapData->buildings, fBuilding);
+		FBuildingData* fBuilding = arena.New<FBuildingData>();
+		ADD(output.buildings, fBuilding);
 		fBuilding->id = component->id;
 		fBuilding->isHeightKnown = true;
-		auto buildingTag = component->tags.find("building");
-		auto minHeightTag = component->tags.find("min-height");
-		auto heightTag = component->tags.find("height");
-		auto levelTag = component->tags.find("levels");
-		auto roofShapeTag = component->tags.find("roof:shape");
-		auto buildingColourTag = component->tags.find("building:colour");
-		auto roofColourTag = component->tags.find("roof:colour");
-
-		uint32_t levelValue = (minHeightTag != component->tags.end()) ? std::stoi(heightTag->second) : 0;
-		float heightValue = (heightTag != component->tags.end()) ? std::stoi(heightTag->second) : 0;
-		uint32_t minHeightValue = (minHeightTag != component->tags.end()) ? std::stoi(minHeightTag->second) : 0;
+		const Osm::OsmTag* buildingTag = component->FindTag(Osm::kTagBuilding);
+		const Osm::OsmTag* minHeightTag = component->FindTag(Osm::kTagMinHeight);
+		const Osm::OsmTag* heightTag = component->FindTag(Osm::kTagHeight);
+		const Osm::OsmTag* levelTag = component->FindTag(Osm::kTagLevels);
+		const Osm::OsmTag* roofShapeTag = component->FindTag(Osm::kTagRoofShape);
+		const Osm::OsmTag* buildingColourTag = component->FindTag(Osm::kTagBuildingColour);
+		const Osm::OsmTag* roofColourTag = component->FindTag(Osm::kTagRoofColour);
+
+		uint32_t levelValue = (minHeightTag != nullptr) ? std::stoi(GetTagString(heightTag)) : 0;
+		float heightValue = (heightTag != nullptr) ? std::stoi(GetTagString(heightTag)) : 0;
+		uint32_t minHeightValue = (minHeightTag != nullptr) ? std::stoi(GetTagString(minHeightTag)) : 0;
 		if (levelValue == 0 && heightValue == 0)
 		{
 			levelValue = kDefaultLevels;
@@ -92,134 +142,603 @@ static void ParseOneItem(FTileMapData* parsedMapData, Osm::OsmComponent* compone
 		{
 			heightValue = levelValue * kDefaultHeightPerLevel;
 		}
-		fBuilding->kind = buildingTag != component->tags.end() ? MapDataUtils::StringToBuildingKind(buildingTag->second.c_str())
+		fBuilding->kind = buildingTag != nullptr ? MapDataUtils::StringToBuildingKind(GetTagString(buildingTag))
 			: BuildingKind::Unknown;
 		fBuilding->height = heightValue;
 		fBuilding->levels = levelValue;
-		fBuilding->buildingColor = buildingColourTag != component->tags.end() ? MapDataUtils::StringToColor(buildingColourTag->second.c_str()) : ColorProperty::Unknown;
-		fBuilding->roofShape = roofShapeTag != component->tags.end() ? MapDataUtils::StringToRoofShape(roofShapeTag->second.c_str())
+		fBuilding->buildingColor = buildingColourTag != nullptr ? MapDataUtils::StringToColor(GetTagString(buildingColourTag)) : ColorProperty::Unknown;
+		fBuilding->roofShape = roofShapeTag != nullptr ? MapDataUtils::StringToRoofShape(GetTagString(roofShapeTag))
 			: RoofShape::Unknown;
-		fBuilding->roofColor = roofColourTag != component->tags.end() ? MapDataUtils::StringToColor(roofColourTag->second.c_str()) : ColorProperty::Unknown;
-		fBuilding->geometry = component->CreateGeometry(tileCornerLow, tileCornerHigh);
+		fBuilding->roofColor = roofColourTag != nullptr ? MapDataUtils::StringToColor(GetTagString(roofColourTag)) : ColorProperty::Unknown;
+		fBuilding->geometry = buildingGeometry;
 	}
 }
 
-bool MapDataUtils::ProcessMapDataFromOsm(const STRING& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom)
+// Small inputs are not worth waking threads for
+static constexpr size_t kMinItemsPerChunk = 256;
+// More chunks than threads, so that threads finishing early take over the remaining work
+static constexpr size_t kChunksPerThread = 4;
+
+static size_t GetChunkCount(size_t itemCount, int32_t threadCount)
 {
-	using namespace Osm;
-	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.Parse(CSTRINGOF(mapDataOsm));
+	size_t chunkCount = std::min(static_cast<size_t>(threadCount) * kChunksPerThread, (itemCount + kMinItemsPerChunk - 1) / kMinItemsPerChunk);
+	return threadCount > 1 ? std::max(chunkCount, static_cast<size_t>(1)) : 1;
+}
 
-	if (error != tinyxml2::XML_SUCCESS) {
-		return false;
+// Calls function(chunk, begin, end) for chunkCount consecutive ranges of [0, itemCount) on up to threadCount threads. An exception
+// thrown for a range is rethrown on the calling thread, the one of the first range if there are several.
+template<typename Function>
+static void ParallelForRanges(size_t itemCount, size_t chunkCount, int32_t threadCount, const Function& function)
+{
+	std::vector<std::exception_ptr> errors(chunkCount);
+	ThreadUtils::ParallelFor(chunkCount, threadCount, [&](size_t chunk) {
+		try {
+			function(chunk, chunk * itemCount / chunkCount, (chunk + 1) * itemCount / chunkCount);
+		}
+		catch (...) {
+			errors[chunk] = std::current_exception();
+		}
+	});
+	for (const std::exception_ptr& error : errors) {
+		if (error != nullptr) {
+			std::rethrow_exception(error);
+		}
 	}
+}
 
-	if (parsedMapData == nullptr) {
-		return false;
+// Adds the entities that become features, sorted by id. Extracts are usually sorted already, then the check is all
+// the sorting costs.
+template<typename T>
+static void AddFeatureItems(const ARRAY<T>& entities, Osm::OsmMemberType type, std::vector<Osm::OsmHandle>& items)
+{
+	size_t begin = items.size();
+	for (uint32_t i = 0; i < SIZE(entities); ++i) {
+		const T& entity = entities[i];
+		if (entity.IsPath() || entity.IsLandUse() || entity.IsBuilding()) {
+			items.push_back({ type, i });
+		}
+	}
+	auto isIdLess = [&entities](Osm::OsmHandle left, Osm::OsmHandle right) { return entities[left.index].id < entities[right.index].id; };
+	if (!std::is_sorted(items.begin() + begin, items.end(), isIdLess)) {
+		std::sort(items.begin() + begin, items.end(), isIdLess);
 	}
+}
 
-	LatLong tileCornerLow = TileUtils::TileToLatLong(tileX, tileY, zoom);
-	LatLong tileCornerHigh = TileUtils::TileToLatLong(tileX + 1, tileY + 1, zoom);
+// Every chunk of items is built into its own arena and arrays, then the chunks are appended in order, so the output
+// does not depend on the number of threads or on which thread built what
+static void BuildFeatures(const Osm::OsmCache& osmCache, const std::vector<Osm::OsmHandle>& items, FTileMapData* parsedMapData, LatLong tileCornerLow, LatLong tileCornerHigh, const Osm::GeometryClip* clip,
+	const Osm::GeometryVertexPool* vertexPool, int32_t threadCount)
+{
+	size_t chunkCount = GetChunkCount(items.size(), threadCount);
+	std::vector<FeatureChunk> chunks(chunkCount);
+	if (chunkCount == 1) {
+		for (Osm::OsmHandle item : items) {
+			ParseOneItem(chunks[0], parsedMapData->arena, osmCache, item, tileCornerLow, tileCornerHigh, clip, vertexPool);
+		}
+	}
+	else {
+		while (parsedMapData->chunkArenas.size() < chunkCount) {
+			parsedMapData->chunkArenas.push_back(std::make_unique<MemoryArena>());
+		}
+		ParallelForRanges(items.size(), chunkCount, threadCount, [&](size_t chunk, size_t begin, size_t end) {
+			MemoryArena& arena = *parsedMapData->chunkArenas[chunk];
+			for (size_t i = begin; i < end; ++i) {
+				ParseOneItem(chunks[chunk], arena, osmCache, items[i], tileCornerLow, tileCornerHigh, clip, vertexPool);
+			}
+		});
+	}
+	for (const FeatureChunk& chunk : chunks) {
+		for (FPathData* path : chunk.paths) {
+			ADD(parsedMapData->paths, path);
+		}
+		for (FBuildingData* building : chunk.buildings) {
+			ADD(parsedMapData->buildings, building);
+		}
+		for (FLanduseData* landuse : chunk.landuse) {
+			ADD(parsedMapData->landuse, landuse);
+		}
+	}
+}
+
+// Buildings only read the landuse areas, so they are matched in parallel as well. A building belongs to the first
+// landuse area its first vertex is in, the grid only leaves out the areas whose box misses the vertex.
+static void AssignBelongingLanduse(FTileMapData* parsedMapData, int32_t threadCount)
+{
+	size_t landuseCount = SIZE(parsedMapData->landuse);
+	std::vector<const FLine*> landuseSegments(landuseCount);
+	for (size_t i = 0; i < landuseCount; ++i) {
+		landuseSegments[i] = parsedMapData->landuse[i]->geometry->GetMainSegment();
+	}
+	ShapeUtils::ShapeGrid landuseGrid;
+	landuseGrid.Build(landuseSegments.data(), static_cast<int>(landuseCount));
+	size_t buildingCount = SIZE(parsedMapData->buildings);
+	ParallelForRanges(buildingCount, GetChunkCount(buildingCount, threadCount), threadCount, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			FBuildingData* building = parsedMapData->buildings[i];
+			// Buildings mapped as a single node have no segment, and extracts can cut ways whose nodes are all outside of them
+			const FLine* buildingSegment = building->geometry->GetMainSegment();
+			if (buildingSegment == nullptr || buildingSegment->GetVertexCount() == 0) {
+				continue;
+			}
+			int landuse = landuseGrid.FindFirstContainingShape(buildingSegment->GetLocalPosition(0));
+			if (landuse >= 0) {
+				building->belongingLanduse = parsedMapData->landuse[landuse];
+			}
+		}
+	});
+}
 
+// The tile grown by the buffer on every side, in fixed-point degrees. The lower tile corner is the north-west one.
+static Osm::FixedBounds GetBufferedTileBounds(LatLong tileCornerLow, LatLong tileCornerHigh, double buffer)
+{
+	double longitudeMargin = (tileCornerHigh.longitude - tileCornerLow.longitude) * buffer;
+	double latitudeMargin = (tileCornerLow.latitude - tileCornerHigh.latitude) * buffer;
+	auto clampDegrees = [](double degrees) { return std::min(std::max(degrees, -180.0), 180.0); };
+	Osm::FixedBounds bounds;
+	bounds.Extend(Osm::FixedLatLong::FromLatLong(LatLong(clampDegrees(tileCornerHigh.latitude - latitudeMargin), clampDegrees(tileCornerLow.longitude - longitudeMargin))));
+	bounds.Extend(Osm::FixedLatLong::FromLatLong(LatLong(clampDegrees(tileCornerLow.latitude + latitudeMargin), clampDegrees(tileCornerHigh.longitude + longitudeMargin))));
+	return bounds;
+}
 
-	OsmCache osmCache;
+// Calls function for the main segment and the holes of every component, components of composites included
+template<typename Function>
+static void ForEachLine(const FMapGeometry* geometry, const Function& function)
+{
+	for (int i = 0; geometry != nullptr && i < geometry->GetComponentCount(); ++i) {
+		const FMapGeometry* component = geometry->GetComponent(i);
+		if (component != geometry) {
+			ForEachLine(component, function);
+			continue;
+		}
+		if (component->GetMainSegment() != nullptr) {
+			function(component->GetMainSegment());
+		}
+		for (const FLine* hole : component->GetHoleSegments()) {
+			function(hole);
+		}
+	}
+}
 
-	tinyxml2::XMLElement* root = doc.RootElement();
+// Counts the lines of the features referring to each vertex of the pool, a closed ring refers to its first vertex
+// twice but is one line
+static void CountVertexLines(FTileMapData* parsedMapData)
+{
+	FVertexPool& pool = parsedMapData->vertexPool;
+	std::vector<uint32_t> lastLines(pool.GetVertexCount(), 0);
+	uint32_t lineNumber = 0;
+	auto countLine = [&](const FLine* line) {
+		++lineNumber;
+		FLineVertices vertices = line->GetVertices();
+		for (int i = 0; vertices.vertexIndices != nullptr && i < vertices.count; ++i) {
+			uint32_t vertexIndex = vertices.vertexIndices[i];
+			if (vertexIndex != FVertexPool::kNoVertex && lastLines[vertexIndex] != lineNumber) {
+				lastLines[vertexIndex] = lineNumber;
+				++pool.lineCounts[vertexIndex];
+			}
+		}
+	};
+	for (const FPathData* path : parsedMapData->paths) {
+		ForEachLine(path->geometry, countLine);
+	}
+	for (const FBuildingData* building : parsedMapData->buildings) {
+		ForEachLine(building->geometry, countLine);
+	}
+	for (const FLanduseData* landuse : parsedMapData->landuse) {
+		ForEachLine(landuse->geometry, countLine);
+	}
+}
 
-	// Cache all nodes
-	for (tinyxml2::XMLElement* xmlNodeElement = root->FirstChildElement("node"); xmlNodeElement != nullptr; xmlNodeElement = xmlNodeElement->NextSiblingElement("node")) {
-		const char* nodeIdStr = xmlNodeElement->Attribute("id");
-		const char* lat = xmlNodeElement->Attribute("lat");
-		const char* lon = xmlNodeElement->Attribute("lon");
-		uint64_t nodeId = std::stoull(nodeIdStr);
-		OsmNode* currentNode = new OsmNode(LatLong(std::stod(lat), std::stod(lon)));
-		currentNode->AddTags(xmlNodeElement);
-		currentNode->id = nodeId;
-		osmCache.nodes[nodeId] = currentNode;
+// Builds the features of the items, with the vertex pool of the tile if the options ask for it
+static void BuildTileFeatures(const Osm::OsmCache& osmCache, const std::vector<Osm::OsmHandle>& items, FTileMapData* parsedMapData, LatLong tileCornerLow, LatLong tileCornerHigh, const Osm::GeometryClip* clip,
+	const MapDataParseOptions& options, int32_t threadCount, Osm::GeometryVertexPool& vertexPool)
+{
+	if (!options.isSharingVertices) {
+		BuildFeatures(osmCache, items, parsedMapData, tileCornerLow, tileCornerHigh, clip, nullptr, threadCount);
+		return;
 	}
+	osmCache.CreateVertexPool(items, tileCornerLow, tileCornerHigh, clip, parsedMapData->vertexPool, vertexPool);
+	BuildFeatures(osmCache, items, parsedMapData, tileCornerLow, tileCornerHigh, clip, &vertexPool, threadCount);
+	CountVertexLines(parsedMapData);
+}
+
+// All feature entities of the cache in output order: relations, ways and then nodes, each sorted by id
+static void CollectFeatureItems(const Osm::OsmCache& osmCache, std::vector<Osm::OsmHandle>& items)
+{
+	items.reserve(osmCache.relations.size() + osmCache.ways.size() + osmCache.nodes.size());
+	AddFeatureItems(osmCache.relations, Osm::OsmMemberType::Relation, items);
+	AddFeatureItems(osmCache.ways, Osm::OsmMemberType::Way, items);
+	AddFeatureItems(osmCache.nodes, Osm::OsmMemberType::Node, items);
+}
 
-	// Cache all ways
-	for (tinyxml2::XMLElement* xmlWayElement = root->FirstChildElement("way"); xmlWayElement != nullptr; xmlWayElement = xmlWayElement->NextSiblingElement("way")) {
-		const char* wayIdString = xmlWayElement->Attribute("id");
-		uint64_t wayId = std::stoull(wayIdString);
-		ARRAY<OsmNode*> nodeReferences;
-		// For each 'nd' (node reference) element inside this way
-		for (tinyxml2::XMLElement* nd = xmlWayElement->FirstChildElement("nd"); nd != nullptr; nd = nd->NextSiblingElement("nd")) {
-			const char* ref = nd->Attribute("ref");  // 'ref' is the node ID
-			uint64_t nodeId = std::stoull(ref);
+// Builds the features of one tile from the candidate items. When clipping, candidates whose bounding box misses the
+// buffered tile are left out, candidateBounds holds their boxes if they are known already. The vertex pool lookup is
+// reused from the previous tile built with it.
+static void BuildTile(const Osm::OsmCache& osmCache, const std::vector<Osm::OsmHandle>& candidates, const Osm::FixedBounds* candidateBounds, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options, int32_t threadCount,
+	Osm::GeometryVertexPool& vertexPool)
+{
+	LatLong tileCornerLow = TileUtils::TileToLatLong(tileX, tileY, zoom);
+	LatLong tileCornerHigh = TileUtils::TileToLatLong(tileX + 1, tileY + 1, zoom);
+	if (!options.isClippingToTile) {
+		BuildTileFeatures(osmCache, candidates, parsedMapData, tileCornerLow, tileCornerHigh, nullptr, options, threadCount, vertexPool);
+		AssignBelongingLanduse(parsedMapData, threadCount);
+		return;
+	}
 
-			// Check if the node exists in the cached nodes
-			if (osmCache.nodes.find(nodeId) != osmCache.nodes.end()) {
-				ADD(nodeReferences, dynamic_cast<OsmNode*>(osmCache.nodes[nodeId]));  // Add the LatLong of the node to the vector
-			}
+	double buffer = std::max(options.clipBuffer, 0.0);
+	Osm::FixedBounds tileBounds = GetBufferedTileBounds(tileCornerLow, tileCornerHigh, buffer);
+	Osm::GeometryClip clip;
+	clip.low = VECTOR2D(-buffer, -buffer);
+	clip.high = VECTOR2D(1 + buffer, 1 + buffer);
+	std::vector<Osm::OsmHandle> items;
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		if (tileBounds.Intersects(candidateBounds != nullptr ? candidateBounds[i] : osmCache.GetBounds(candidates[i]))) {
+			items.push_back(candidates[i]);
 		}
+	}
+	BuildTileFeatures(osmCache, items, parsedMapData, tileCornerLow, tileCornerHigh, &clip, options, threadCount, vertexPool);
+	AssignBelongingLanduse(parsedMapData, threadCount);
+}
 
-		OsmWay* currentWay = new OsmWay(nodeReferences);
-		currentWay->AddTags(xmlWayElement);
-		currentWay->id = wayId;
-		osmCache.ways[wayId] = currentWay;
-	}
-
-	// Cache all relations
-	for (tinyxml2::XMLElement* xmlRelationElement = root->FirstChildElement("relation"); xmlRelationElement != nullptr; xmlRelationElement = xmlRelationElement->NextSiblingElement("relation")) {
-		const char* relationIdString = xmlRelationElement->Attribute("id");
-		uint64_t relationId = std::stoull(relationIdString);
-		OsmRelation* currentRelation = new OsmRelation;
-		currentRelation->id = relationId;
-		// For each 'member' (node reference) element inside this way
-		for (tinyxml2::XMLElement* member = xmlRelationElement->FirstChildElement("member"); member != nullptr; member = member->NextSiblingElement("member")) {
-			const char* type = member->Attribute("type");
-			const char* ref = member->Attribute("ref");
-			const char* role = member->Attribute("role");
-			uint64_t memberId = std::stoull(ref);
-
-			// Check if the node exists in the cached nodes
-			if (strcmp(type, "node") == 0 && osmCache.nodes.find(memberId) != osmCache.nodes.end()) {
-				currentRelation->AddRelation(osmCache.nodes[memberId], role);
-			}
-			else if (strcmp(type, "way") == 0 && osmCache.ways.find(memberId) != osmCache.ways.end()) {
-				currentRelation->AddRelation(osmCache.ways[memberId], role);
-			}
-			else if (strcmp(type, "relation") == 0 && osmCache.relations.find(memberId) != osmCache.relations.end()) {
-				currentRelation->AddRelation(osmCache.relations[memberId], role);
-			}
+bool MapDataUtils::ProcessMapDataFromOsmCache(const Osm::OsmCache& osmCache, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	if (parsedMapData == nullptr) {
+		return false;
+	}
+	int32_t threadCount = options.threadCount > 0 ? options.threadCount : ThreadUtils::GetHardwareThreadCount();
+	std::vector<Osm::OsmHandle> items;
+	CollectFeatureItems(osmCache, items);
+	Osm::GeometryVertexPool vertexPool;
+	BuildTile(osmCache, items, nullptr, parsedMapData, tileX, tileY, zoom, options, threadCount, vertexPool);
+	return true;
+}
+
+// Tile columns and rows have to fit in 31 bits
+static constexpr int32_t kMaxTileZoom = 30;
+
+// A feature assigned to a tile. Sorting by tile and then by item keeps the output order within every tile.
+struct TileItem {
+	uint64_t tile; // Row in the high half, column in the low one
+	uint32_t item;
+	bool operator<(const TileItem& other) const { return tile != other.tile ? tile < other.tile : item < other.item; }
+};
+
+static uint64_t PackTile(int32_t x, int32_t y)
+{
+	return (static_cast<uint64_t>(y) << 32) | static_cast<uint32_t>(x);
+}
+
+static TileKey UnpackTile(uint64_t packedTile, int32_t zoom)
+{
+	return { static_cast<int32_t>(packedTile & 0xffffffffu), static_cast<int32_t>(packedTile >> 32), zoom };
+}
+
+// A clip buffer reaches into the neighbouring tiles, one more of them as tiles get shorter towards the poles
+static int32_t GetTileMargin(const MapDataParseOptions& options)
+{
+	return options.isClippingToTile && options.clipBuffer > 0 ? static_cast<int32_t>(floor(options.clipBuffer)) + 1 : 0;
+}
+
+// Calls function(x, y) for the tiles a bounding box touches, grown by margin tiles on every side. Rows are counted from
+// the north, so the northern edge of the box gives its first row. The box is grown by the rounding of the fixed-point
+// tile bounds, so a box touching a tile border goes to both tiles.
+template<typename Function>
+static void ForEachTile(const Osm::FixedBounds& bounds, int32_t zoom, int32_t margin, const Function& function)
+{
+	static constexpr double kBorderTolerance = 1e-6;
+	int32_t maxTile = (1 << zoom) - 1;
+	auto clampTile = [maxTile](int32_t tile) { return std::min(std::max(tile, 0), maxTile); };
+	LatLong low = bounds.low.ToLatLong();
+	LatLong high = bounds.high.ToLatLong();
+	int32_t firstX = clampTile(TileUtils::LongitudeToTileX(low.longitude - kBorderTolerance, zoom) - margin);
+	int32_t lastX = clampTile(TileUtils::LongitudeToTileX(high.longitude + kBorderTolerance, zoom) + margin);
+	int32_t firstY = clampTile(TileUtils::LatitudeToTileY(high.latitude + kBorderTolerance, zoom) - margin);
+	int32_t lastY = clampTile(TileUtils::LatitudeToTileY(low.latitude - kBorderTolerance, zoom) + margin);
+	for (int32_t y = firstY; y <= lastY; ++y) {
+		for (int32_t x = firstX; x <= lastX; ++x) {
+			function(x, y);
 		}
-		currentRelation->AddTags(xmlRelationElement);
-		currentRelation->PrecomputeMultigonRelations();
-		osmCache.relations[relationId] = currentRelation;
 	}
+}
 
-	//parsedMapData->buildings = FMapLayer();
+// Calls buildTile(key, candidates, candidateBounds) for every tile touched by a feature, on up to threadCount threads
+template<typename Function>
+static void PartitionTiles(const Osm::OsmCache& osmCache, int32_t zoom, const MapDataParseOptions& options, int32_t threadCount, const Function& buildTile)
+{
+	std::vector<Osm::OsmHandle> items;
+	CollectFeatureItems(osmCache, items);
+	std::vector<Osm::FixedBounds> bounds(items.size());
+	ParallelForRanges(items.size(), GetChunkCount(items.size(), threadCount), threadCount, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			bounds[i] = osmCache.GetBounds(items[i]);
+		}
+	});
+
+	int32_t margin = GetTileMargin(options);
+	std::vector<TileItem> tileItems;
+	tileItems.reserve(items.size());
+	for (uint32_t i = 0; i < items.size(); ++i) {
+		if (!bounds[i].IsEmpty()) {
+			ForEachTile(bounds[i], zoom, margin, [&](int32_t x, int32_t y) {
+				tileItems.push_back({ PackTile(x, y), i });
+			});
+		}
+	}
+	std::sort(tileItems.begin(), tileItems.end());
 
-	// Parse everything
-	for (const auto& osmItem : osmCache.relations)
-	{
-		ParseOneItem(parsedMapData, osmItem.second, tileCornerLow, tileCornerHigh);
+	std::vector<size_t> tileStarts;
+	for (size_t i = 0; i < tileItems.size(); ++i) {
+		if (i == 0 || tileItems[i].tile != tileItems[i - 1].tile) {
+			tileStarts.push_back(i);
+		}
 	}
+	tileStarts.push_back(tileItems.size());
+	size_t tileCount = tileStarts.size() - 1;
+	ParallelForRanges(tileCount, tileCount, threadCount, [&](size_t tile, size_t, size_t) {
+		std::vector<Osm::OsmHandle> candidates;
+		std::vector<Osm::FixedBounds> candidateBounds;
+		for (size_t i = tileStarts[tile]; i < tileStarts[tile + 1]; ++i) {
+			candidates.push_back(items[tileItems[i].item]);
+			candidateBounds.push_back(bounds[tileItems[i].item]);
+		}
+		buildTile(UnpackTile(tileItems[tileStarts[tile]].tile, zoom), candidates, candidateBounds.data());
+	});
+}
 
-	for (const auto& osmItem : osmCache.ways)
+// The vertex pool lookups of the tiles built at the same time. A lookup is sized to the cache once, so they are kept
+// for the next tiles instead of made for each one.
+class VertexPoolLookups {
+public:
+	std::unique_ptr<Osm::GeometryVertexPool> Take()
 	{
-		ParseOneItem(parsedMapData, osmItem.second, tileCornerLow, tileCornerHigh);
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_freeLookups.empty()) {
+			return std::make_unique<Osm::GeometryVertexPool>();
+		}
+		std::unique_ptr<Osm::GeometryVertexPool> lookup = std::move(_freeLookups.back());
+		_freeLookups.pop_back();
+		return lookup;
 	}
 
-	for (const auto& osmItem : osmCache.nodes)
+	void Return(std::unique_ptr<Osm::GeometryVertexPool> lookup)
 	{
-		ParseOneItem(parsedMapData, osmItem.second, tileCornerLow, tileCornerHigh);
+		std::lock_guard<std::mutex> lock(_mutex);
+		_freeLookups.push_back(std::move(lookup));
 	}
 
-	for (FBuildingData* building : parsedMapData->buildings) {
-		for (FLanduseData* landuse : parsedMapData->landuse) {
-			if (ShapeUtils::IsPointInShape(landuse->geometry->GetMainSegment(), building->geometry->GetMainSegment()->coordinates[0]->localPosition))
-			{
-				building->belongingLanduse = landuse;
-				break;
+private:
+	std::mutex _mutex;
+	std::vector<std::unique_ptr<Osm::GeometryVertexPool>> _freeLookups;
+};
+
+static bool IsTileEmpty(const FTileMapData& tileData)
+{
+	return EMPTY(tileData.paths) && EMPTY(tileData.buildings) && EMPTY(tileData.landuse);
+}
+
+bool MapDataUtils::ProcessMapDataTilesFromOsmCache(const Osm::OsmCache& osmCache, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options)
+{
+	if (zoom < 0 || zoom > kMaxTileZoom) {
+		return false;
+	}
+	int32_t threadCount = options.threadCount > 0 ? options.threadCount : ThreadUtils::GetHardwareThreadCount();
+	// Every thread takes a tile data from the free ones and returns it once the sink is done with it, so tile data
+	// is only made for the first tiles and its arenas are reused after that
+	std::mutex mutex;
+	std::vector<std::unique_ptr<FTileMapData>> freeTileData;
+	VertexPoolLookups vertexPoolLookups;
+	PartitionTiles(osmCache, zoom, options, threadCount, [&](const TileKey& key, const std::vector<Osm::OsmHandle>& candidates, const Osm::FixedBounds* candidateBounds) {
+		std::unique_ptr<FTileMapData> tileData;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!freeTileData.empty()) {
+				tileData = std::move(freeTileData.back());
+				freeTileData.pop_back();
 			}
 		}
+		if (tileData == nullptr) {
+			tileData = std::make_unique<FTileMapData>();
+		}
+		tileData->Reset();
+		// The tiles are the parallel work, each one is built on a single thread
+		std::unique_ptr<Osm::GeometryVertexPool> vertexPool = vertexPoolLookups.Take();
+		BuildTile(osmCache, candidates, candidateBounds, tileData.get(), key.x, key.y, zoom, options, 1, *vertexPool);
+		vertexPoolLookups.Return(std::move(vertexPool));
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!IsTileEmpty(*tileData)) {
+			sink(key, *tileData);
+		}
+		freeTileData.push_back(std::move(tileData));
+	});
+	return true;
+}
+
+bool MapDataUtils::ProcessMapDataTilesFromOsmCache(const Osm::OsmCache& osmCache, int32_t zoom, ARRAY<PartitionedTile>& tiles, const MapDataParseOptions& options)
+{
+	if (zoom < 0 || zoom > kMaxTileZoom) {
+		return false;
+	}
+	int32_t threadCount = options.threadCount > 0 ? options.threadCount : ThreadUtils::GetHardwareThreadCount();
+	std::mutex mutex;
+	VertexPoolLookups vertexPoolLookups;
+	PartitionTiles(osmCache, zoom, options, threadCount, [&](const TileKey& key, const std::vector<Osm::OsmHandle>& candidates, const Osm::FixedBounds* candidateBounds) {
+		std::unique_ptr<FTileMapData> tileData = std::make_unique<FTileMapData>();
+		std::unique_ptr<Osm::GeometryVertexPool> vertexPool = vertexPoolLookups.Take();
+		BuildTile(osmCache, candidates, candidateBounds, tileData.get(), key.x, key.y, zoom, options, 1, *vertexPool);
+		vertexPoolLookups.Return(std::move(vertexPool));
+		if (!IsTileEmpty(*tileData)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			tiles.push_back({ key, std::move(tileData) });
+		}
+	});
+	std::sort(tiles.begin(), tiles.end(), [](const PartitionedTile& left, const PartitionedTile& right) {
+		return left.key.y != right.key.y ? left.key.y < right.key.y : left.key.x < right.key.x;
+	});
+	return true;
+}
+
+MapDataParseOptions::MapDataParseOptions()
+{
+	// The keys ParseOneItem reads are the first ones of the dictionary
+	const Osm::TagDictionary& dictionary = Osm::GetTagDictionary();
+	for (uint32_t key = 0; key < Osm::kWellKnownTagCount; ++key) {
+		ADD(tagKeys, STRING(dictionary.GetString(key).data()));
 	}
+}
+
+static Osm::OsmTagFilter CreateTagFilter(const MapDataParseOptions& options)
+{
+	if (options.isKeepingAllTags) {
+		return Osm::OsmTagFilter();
+	}
+	std::vector<std::string> keys;
+	for (const STRING& key : options.tagKeys) {
+		keys.emplace_back(CSTRINGOF(key));
+	}
+	return Osm::OsmTagFilter(std::vector<std::string_view>(keys.begin(), keys.end()), options.isFeatureOnly);
+}
+
+// The cache is only needed during a call, so every call on a thread reuses the memory of the previous one
+static Osm::OsmCache& GetThreadOsmCache()
+{
+	thread_local Osm::OsmCache osmCache;
+	return osmCache;
+}
+
+static bool ProcessOsmXml(Osm::OsmXmlReader& reader, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	if (parsedMapData == nullptr) {
+		return false;
+	}
+
+	// Nodes, ways and relations are cached while the document is read, no DOM is built
+	Osm::OsmCache& osmCache = GetThreadOsmCache();
+	bool isRead = Osm::ReadOsmCache(reader, osmCache, CreateTagFilter(options));
+	if (isRead) {
+		MapDataUtils::ProcessMapDataFromOsmCache(osmCache, parsedMapData, tileX, tileY, zoom, options);
+	}
+	osmCache.Clear();
+	return isRead;
+}
+
+bool MapDataUtils::ProcessMapDataFromOsm(const STRING& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	return ProcessMapDataFromOsm(CSTRINGOF(mapDataOsm), LENGTH(mapDataOsm), parsedMapData, tileX, tileY, zoom, options);
+}
 
+bool MapDataUtils::ProcessMapDataFromOsm(const char* mapDataOsm, size_t length, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	Osm::OsmXmlReader reader(mapDataOsm, length);
+	return ProcessOsmXml(reader, parsedMapData, tileX, tileY, zoom, options);
+}
+
+bool MapDataUtils::ProcessMapDataFromOsm(std::istream& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	Osm::OsmXmlReader reader(mapDataOsm);
+	return ProcessOsmXml(reader, parsedMapData, tileX, tileY, zoom, options);
+}
+
+bool MapDataUtils::ProcessMapDataFromOsmPbf(const char* mapDataPbf, size_t length, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	if (parsedMapData == nullptr) {
+		return false;
+	}
+
+	Osm::OsmCache& osmCache = GetThreadOsmCache();
+	bool isRead = Osm::ReadOsmPbfCache(mapDataPbf, length, osmCache, CreateTagFilter(options));
+	if (isRead) {
+		MapDataUtils::ProcessMapDataFromOsmCache(osmCache, parsedMapData, tileX, tileY, zoom, options);
+	}
+	osmCache.Clear();
+	return isRead;
+}
+
+bool MapDataUtils::ProcessMapDataFromOsmPbfFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	return ProcessMapDataFromOsmPbf(mappedFile.GetData(), mappedFile.GetSize(), parsedMapData, tileX, tileY, zoom, options);
+}
+
+bool MapDataUtils::ProcessMapDataTilesFromOsmFile(const STRING& path, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	Osm::OsmCache& osmCache = GetThreadOsmCache();
+	Osm::OsmXmlReader reader(mappedFile.GetData(), mappedFile.GetSize());
+	bool isProcessed = Osm::ReadOsmCache(reader, osmCache, CreateTagFilter(options)) &&
+		MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, zoom, sink, options);
+	osmCache.Clear();
+	return isProcessed;
+}
+
+bool MapDataUtils::ProcessMapDataTilesFromOsmPbfFile(const STRING& path, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	Osm::OsmCache& osmCache = GetThreadOsmCache();
+	bool isProcessed = Osm::ReadOsmPbfCache(mappedFile.GetData(), mappedFile.GetSize(), osmCache, CreateTagFilter(options)) &&
+		MapDataUtils::ProcessMapDataTilesFromOsmCache(osmCache, zoom, sink, options);
+	osmCache.Clear();
+	return isProcessed;
+}
+
+bool MapDataUtils::ApplyOsmChange(const char* osmChange, size_t length, Osm::OsmCache& osmCache, int32_t zoom, ARRAY<TileKey>& dirtyTiles, const MapDataParseOptions& options)
+{
+	if (zoom < 0 || zoom > kMaxTileZoom) {
+		return false;
+	}
+	Osm::OsmChange change;
+	Osm::OsmXmlReader reader(osmChange, length);
+	if (!Osm::ReadOsmChange(reader, change, CreateTagFilter(options))) {
+		return false;
+	}
+	std::vector<Osm::FixedBounds> dirtyBounds;
+	osmCache.ApplyChange(change, dirtyBounds);
+
+	std::vector<uint64_t> packedTiles;
+	int32_t margin = GetTileMargin(options);
+	for (const Osm::FixedBounds& bounds : dirtyBounds) {
+		ForEachTile(bounds, zoom, margin, [&](int32_t x, int32_t y) {
+			packedTiles.push_back(PackTile(x, y));
+		});
+	}
+	std::sort(packedTiles.begin(), packedTiles.end());
+	packedTiles.erase(std::unique(packedTiles.begin(), packedTiles.end()), packedTiles.end());
+	for (uint64_t packedTile : packedTiles) {
+		ADD(dirtyTiles, UnpackTile(packedTile, zoom));
+	}
 	return true;
 }
 
+bool MapDataUtils::ApplyOsmChangeFile(const STRING& path, Osm::OsmCache& osmCache, int32_t zoom, ARRAY<TileKey>& dirtyTiles, const MapDataParseOptions& options)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	return ApplyOsmChange(mappedFile.GetData(), mappedFile.GetSize(), osmCache, zoom, dirtyTiles, options);
+}
+
+void MapDataUtils::ReleaseThreadCache()
+{
+	GetThreadOsmCache().Release();
+}
+
+bool MapDataUtils::ProcessMapDataFromOsmFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom, const MapDataParseOptions& options)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(CSTRINGOF(path))) {
+		return false;
+	}
+	return ProcessMapDataFromOsm(mappedFile.GetData(), mappedFile.GetSize(), parsedMapData, tileX, tileY, zoom, options);
+}
+
 STRING MapDataUtils::LanduseKindToString(LanduseKind kind) {
 	switch (kind) {
 	case LanduseKind::Commercial: return "Commercial";
@@ -5,12 +5,93 @@
 #include "type_defines.h"
 #include "FTileMapData.h"
 
+#include <functional>
+#include <istream>
+#include <memory>
+
+namespace Osm {
+	struct OsmCache;
+}
+
+// Options of the OSM entry points
+struct MapDataParseOptions {
+	MapDataParseOptions();
+	// Keys of the OSM tags kept while reading, tags with other keys are dropped before they are stored. By default the
+	// keys the output features are built from.
+	ARRAY<STRING> tagKeys;
+	// Keeps every tag, tagKeys is ignored
+	bool isKeepingAllTags = false;
+	// Entities that can not become a path, building or landuse area keep no tags. They are still read, as ways and
+	// relations may refer to them.
+	bool isFeatureOnly = true;
+	// Threads building the output features, the calling thread included. A non-positive count means one per core.
+	int32_t threadCount = 0;
+	// Drops the features whose bounding box misses the tile and cuts the geometry of the others at its border, so
+	// that the output scales with the tile and not with the extract
+	bool isClippingToTile = false;
+	// Margin kept around the tile when clipping, as a fraction of the tile size, e.g. for roads drawn wider than their
+	// line or to hide the seams between neighbouring tiles
+	double clipBuffer = 0.0;
+	// Projects every node the lines of the tile are made of once into FTileMapData::vertexPool, the lines refer to its
+	// vertices, so the features sharing a node can be found
+	bool isSharingVertices = false;
+};
+
+struct TileKey {
+	int32_t x;
+	int32_t y;
+	int32_t zoom;
+};
+
+// A tile of a partitioned extract with its features
+struct PartitionedTile {
+	TileKey key;
+	std::unique_ptr<FTileMapData> data;
+};
+
+// Receives the tiles of a partitioned extract. Calls come from the worker threads one at a time, in no particular
+// order. The tile data is reused for a later tile once the call returns.
+typedef std::function<void(const TileKey& tile, FTileMapData& tileData)> TileSink;
+
 class MapDataUtils
 {
 public:
 	static constexpr int32_t k_tileSizeWorld = 30000;
 	static bool ProcessMapDataFromGeoJson(const STRING& mapDataJson, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom);
-	static bool ProcessMapDataFromOsm(const STRING& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14);
+	// Parses the bytes in place, the input is not copied
+	static bool ProcessMapDataFromGeoJson(const char* mapDataJson, size_t length, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom);
+	// Memory maps the file read-only and parses it in place
+	static bool ProcessMapDataFromGeoJsonFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX, int32_t tileY, int32_t zoom);
+	static bool ProcessMapDataFromOsm(const STRING& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Parses the bytes in place, the input is not copied
+	static bool ProcessMapDataFromOsm(const char* mapDataOsm, size_t length, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Streams the OSM XML document, only a fixed size window of the input is kept in memory
+	static bool ProcessMapDataFromOsm(std::istream& mapDataOsm, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Memory maps the file read-only and parses it in place
+	static bool ProcessMapDataFromOsmFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Decodes the OSM PBF binary format, blobs are decompressed and decoded on all cores
+	static bool ProcessMapDataFromOsmPbf(const char* mapDataPbf, size_t length, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	static bool ProcessMapDataFromOsmPbfFile(const STRING& path, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Builds the output features of entities that were already read. The features are in the same order for every
+	// thread count: relations, ways and then nodes, each sorted by id.
+	static bool ProcessMapDataFromOsmCache(const Osm::OsmCache& osmCache, FTileMapData* parsedMapData, int32_t tileX = 0, int32_t tileY = 0, int32_t zoom = 14, const MapDataParseOptions& options = MapDataParseOptions());
+	// Partitions the extract into the tiles of the zoom level: every feature goes to each tile its bounding box
+	// touches, so the input is read once for all of them. Tiles are built in parallel, threadCount threads in all, and
+	// only the ones with features are emitted. Their features are in the same order as for ProcessMapDataFromOsmCache,
+	// with isClippingToTile each tile is the same as ProcessMapDataFromOsmCache would give for it.
+	static bool ProcessMapDataTilesFromOsmCache(const Osm::OsmCache& osmCache, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options = MapDataParseOptions());
+	// Keeps every tile, sorted by row and then column
+	static bool ProcessMapDataTilesFromOsmCache(const Osm::OsmCache& osmCache, int32_t zoom, ARRAY<PartitionedTile>& tiles, const MapDataParseOptions& options = MapDataParseOptions());
+	static bool ProcessMapDataTilesFromOsmFile(const STRING& path, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options = MapDataParseOptions());
+	static bool ProcessMapDataTilesFromOsmPbfFile(const STRING& path, int32_t zoom, const TileSink& sink, const MapDataParseOptions& options = MapDataParseOptions());
+	// Applies an OsmChange (.osc) document, e.g. a minutely diff, to a cache read earlier with the same options. Lists
+	// the tiles of the zoom level whose output the change affects, sorted by row and then column, only these have to be
+	// built again. The cache is left as it was if the document is malformed.
+	static bool ApplyOsmChange(const char* osmChange, size_t length, Osm::OsmCache& osmCache, int32_t zoom, ARRAY<TileKey>& dirtyTiles, const MapDataParseOptions& options = MapDataParseOptions());
+	static bool ApplyOsmChangeFile(const STRING& path, Osm::OsmCache& osmCache, int32_t zoom, ARRAY<TileKey>& dirtyTiles, const MapDataParseOptions& options = MapDataParseOptions());
+	// The OSM entry points keep the memory of their intermediate entity cache for the next call on the same thread,
+	// this returns it to the heap, e.g. after an unusually large input
+	static void ReleaseThreadCache();
 	static STRING LanduseKindToString(LanduseKind kind);
 	static PathType StringToPathType(const STRING& typeStr);
 	static PathSurfaceMaterial StringToPathSurfaceMaterial(const STRING& materialStr);
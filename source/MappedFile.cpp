@@ -0,0 +1,111 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	_fileHandle = file;
+	_size = static_cast<size_t>(fileSize.QuadPart);
+	_isOpen = true;
+	if (_size == 0) {
+		return true; // Empty files can not be mapped
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		Close();
+		return false;
+	}
+	_mappingHandle = mapping;
+	_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (_data == nullptr) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data != nullptr) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mappingHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_mappingHandle));
+	}
+	if (_fileHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_fileHandle));
+	}
+	_data = nullptr;
+	_mappingHandle = nullptr;
+	_fileHandle = nullptr;
+	_size = 0;
+	_isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0) {
+		close(file);
+		return false;
+	}
+	_size = static_cast<size_t>(fileStat.st_size);
+	_isOpen = true;
+	if (_size == 0) {
+		close(file);
+		return true; // Empty files can not be mapped
+	}
+
+	void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping keeps its own reference to the file
+	close(file);
+	if (data == MAP_FAILED) {
+		_size = 0;
+		_isOpen = false;
+		return false;
+	}
+	madvise(data, _size, MADV_SEQUENTIAL);
+	_data = static_cast<const char*>(data);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data != nullptr) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+	_data = nullptr;
+	_size = 0;
+	_isOpen = false;
+}
+
+#endif
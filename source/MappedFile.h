@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The contents are paged in by the OS on demand and are never copied.
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* path) { Open(path); }
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return _isOpen; }
+	const char* GetData() const { return _data; }
+	size_t GetSize() const { return _size; }
+
+private:
+	const char* _data = nullptr;
+	size_t _size = 0;
+	bool _isOpen = false;
+#if defined(_WIN32) || defined(_WIN64)
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,81 @@
+#include "MemoryArena.h"
+
+#include <algorithm>
+
+MemoryArena::MemoryArena(size_t initialBlockSize) : _nextBlockSize(initialBlockSize > 0 ? initialBlockSize : kDefaultInitialBlockSize) {}
+
+MemoryArena::~MemoryArena() {
+	Release();
+}
+
+void* MemoryArena::Allocate(size_t size, size_t alignment) {
+	// Blocks are aligned for any fundamental type, so aligning the offset aligns the address
+	for (; _blockIndex < _blocks.size(); ++_blockIndex, _offset = 0) {
+		size_t begin = (_offset + alignment - 1) & ~(alignment - 1);
+		if (begin + size <= _blocks[_blockIndex].size) {
+			_offset = begin + size;
+			return _blocks[_blockIndex].data + begin;
+		}
+	}
+
+	// Out of blocks, block sizes grow geometrically so small inputs stay small and large ones need few blocks
+	size_t blockSize = _nextBlockSize;
+	while (blockSize < size) {
+		blockSize *= 2;
+	}
+	_nextBlockSize = std::min(_nextBlockSize * 2, kMaxBlockSize);
+	Block block = { static_cast<char*>(::operator new(blockSize)), blockSize };
+	_blocks.push_back(block);
+	++_blockAllocationCount;
+	_blockIndex = _blocks.size() - 1;
+	_offset = size;
+	return block.data;
+}
+
+void MemoryArena::AddDestructor(void* object, void (*destroy)(void*)) {
+	Destructor* destructor = static_cast<Destructor*>(Allocate(sizeof(Destructor), alignof(Destructor)));
+	destructor->destroy = destroy;
+	destructor->object = object;
+	destructor->previous = _lastDestructor;
+	_lastDestructor = destructor;
+}
+
+void MemoryArena::RunDestructors() {
+	for (Destructor* destructor = _lastDestructor; destructor != nullptr; destructor = destructor->previous) {
+		destructor->destroy(destructor->object);
+	}
+	_lastDestructor = nullptr;
+	_objectCount = 0;
+}
+
+void MemoryArena::Reset() {
+	RunDestructors();
+	_blockIndex = 0;
+	_offset = 0;
+}
+
+void MemoryArena::Release() {
+	RunDestructors();
+	for (const Block& block : _blocks) {
+		::operator delete(block.data);
+	}
+	_blocks.clear();
+	_blockIndex = 0;
+	_offset = 0;
+}
+
+size_t MemoryArena::GetUsedBytes() const {
+	size_t usedBytes = 0;
+	for (size_t i = 0; i < _blockIndex && i < _blocks.size(); ++i) {
+		usedBytes += _blocks[i].size;
+	}
+	return usedBytes + _offset;
+}
+
+size_t MemoryArena::GetReservedBytes() const {
+	size_t reservedBytes = 0;
+	for (const Block& block : _blocks) {
+		reservedBytes += block.size;
+	}
+	return reservedBytes;
+}
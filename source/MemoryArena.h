@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator that owns everything made with it. Objects are not freed one by one: Reset() or the destructor
+// releases all of them at once, running the destructors of the ones that have one in reverse order of creation.
+// Reset() keeps the memory blocks, so an arena reused for inputs of a similar size stops allocating after the first.
+class MemoryArena {
+public:
+	explicit MemoryArena(size_t initialBlockSize = kDefaultInitialBlockSize);
+	~MemoryArena();
+
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	template<typename T, typename... Arguments>
+	T* New(Arguments&&... arguments) {
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Blocks are only aligned for fundamental types");
+		T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Arguments>(arguments)...);
+		if constexpr (!std::is_trivially_destructible<T>::value) {
+			AddDestructor(object, [](void* pointer) { static_cast<T*>(pointer)->~T(); });
+		}
+		++_objectCount;
+		return object;
+	}
+
+	// Uninitialized memory, valid until the next Reset()
+	void* Allocate(size_t size, size_t alignment);
+	// Destroys every object and makes the memory available again, without returning it to the heap
+	void Reset();
+	// Destroys every object and returns the memory to the heap
+	void Release();
+
+	// Objects made since the last Reset()
+	size_t GetObjectCount() const { return _objectCount; }
+	size_t GetUsedBytes() const;
+	size_t GetReservedBytes() const;
+	// Heap allocations the arena made over its lifetime, it is zero for a reused arena that had enough memory
+	size_t GetBlockAllocationCount() const { return _blockAllocationCount; }
+
+	static constexpr size_t kDefaultInitialBlockSize = 16 * 1024;
+	static constexpr size_t kMaxBlockSize = 1024 * 1024;
+
+private:
+	struct Block {
+		char* data;
+		size_t size;
+	};
+	// Kept in the arena memory itself, as a list from the newest object to the oldest
+	struct Destructor {
+		void (*destroy)(void*);
+		void* object;
+		Destructor* previous;
+	};
+
+	void AddDestructor(void* object, void (*destroy)(void*));
+	void RunDestructors();
+
+	std::vector<Block> _blocks;
+	size_t _blockIndex = 0;
+	size_t _offset = 0;
+	size_t _nextBlockSize;
+	size_t _objectCount = 0;
+	size_t _blockAllocationCount = 0;
+	Destructor* _lastDestructor = nullptr;
+};
@@ -0,0 +1,101 @@
+#include "OsmIdIndex.h"
+
+namespace Osm {
+
+	static constexpr size_t kMinSlotCount = 16;
+
+	void OsmIdIndex::Reserve(size_t count) {
+		if (count * 2 <= _ids.size()) {
+			return;
+		}
+		size_t slotCount = kMinSlotCount;
+		while (slotCount < count * 2) {
+			slotCount *= 2;
+		}
+		Rehash(slotCount);
+	}
+
+	size_t OsmIdIndex::FindSlot(uint64_t id) const {
+		size_t slot = GetSlot(id);
+		while (_indices[slot] != kInvalidIndex && _ids[slot] != id) {
+			slot = (slot + 1) & _mask;
+		}
+		return slot;
+	}
+
+	uint32_t OsmIdIndex::Insert(uint64_t id, uint32_t index) {
+		Reserve(_size + 1);
+		size_t slot = FindSlot(id);
+		if (_indices[slot] != kInvalidIndex) {
+			return _indices[slot];
+		}
+		_ids[slot] = id;
+		_indices[slot] = index;
+		++_size;
+		return index;
+	}
+
+	void OsmIdIndex::Assign(uint64_t id, uint32_t index) {
+		Reserve(_size + 1);
+		size_t slot = FindSlot(id);
+		if (_indices[slot] == kInvalidIndex) {
+			_ids[slot] = id;
+			++_size;
+		}
+		_indices[slot] = index;
+	}
+
+	void OsmIdIndex::Build(const uint64_t* ids, size_t count) {
+		Clear();
+		Reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			Assign(ids[i], static_cast<uint32_t>(i));
+		}
+	}
+
+	void OsmIdIndex::Clear() {
+		if (_size > 0) {
+			_indices.assign(_indices.size(), kInvalidIndex);
+			_size = 0;
+		}
+	}
+
+	void OsmIdIndex::Rehash(size_t slotCount) {
+		std::vector<uint64_t> ids(slotCount);
+		std::vector<uint32_t> indices(slotCount, kInvalidIndex);
+		ids.swap(_ids);
+		indices.swap(_indices);
+		SetSlotCount(slotCount);
+
+		for (size_t slot = 0; slot < indices.size(); ++slot) {
+			if (indices[slot] != kInvalidIndex) {
+				size_t target = FindSlot(ids[slot]);
+				_ids[target] = ids[slot];
+				_indices[target] = indices[slot];
+			}
+		}
+	}
+
+	void OsmIdIndex::SetSlotCount(size_t slotCount) {
+		_mask = slotCount - 1;
+		_shift = 64;
+		for (size_t count = slotCount; count > 1; count >>= 1) {
+			--_shift;
+		}
+	}
+
+	bool OsmIdIndex::LoadSlots(const uint64_t* ids, const uint32_t* indices, size_t slotCount, size_t size) {
+		if (slotCount == 0) {
+			*this = OsmIdIndex();
+			return size == 0;
+		}
+		if (slotCount < kMinSlotCount || (slotCount & (slotCount - 1)) != 0 || size * 2 > slotCount) {
+			return false;
+		}
+		_ids.assign(ids, ids + slotCount);
+		_indices.assign(indices, indices + slotCount);
+		_size = size;
+		SetSlotCount(slotCount);
+		return true;
+	}
+}
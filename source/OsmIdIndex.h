@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Osm {
+
+// Maps OSM ids to positions in the entity arrays of the cache. Open addressing with linear probing over two flat
+// arrays, so a lookup usually touches a single cache line of ids and there is no allocation per entry. The table is
+// kept at most half full and grows by doubling.
+class OsmIdIndex {
+public:
+	static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+	// Sizes the table for count entries, so inserting up to that many never rehashes
+	void Reserve(size_t count);
+	// Adds id -> index unless the id is already present, returns the index stored for the id
+	uint32_t Insert(uint64_t id, uint32_t index);
+	// Adds or replaces the index of an id
+	void Assign(uint64_t id, uint32_t index);
+	// Bulk build, replaces the content with ids[i] -> i. Later duplicates win, like repeated Assign calls.
+	void Build(const uint64_t* ids, size_t count);
+	// Removes every entry, the capacity is kept
+	void Clear();
+
+	uint32_t Find(uint64_t id) const {
+		if (_size == 0) {
+			return kInvalidIndex;
+		}
+		for (size_t slot = GetSlot(id);; slot = (slot + 1) & _mask) {
+			uint32_t index = _indices[slot];
+			if (index == kInvalidIndex || _ids[slot] == id) {
+				return index;
+			}
+		}
+	}
+	bool Contains(uint64_t id) const { return Find(id) != kInvalidIndex; }
+	// The raw table, so that it can be saved and loaded back without hashing every id again
+	size_t GetSlotCount() const { return _ids.size(); }
+	const uint64_t* GetSlotIds() const { return _ids.data(); }
+	const uint32_t* GetSlotIndices() const { return _indices.data(); }
+	// Replaces the content with a table saved earlier. Fails if the slot count is not a power of two.
+	bool LoadSlots(const uint64_t* ids, const uint32_t* indices, size_t slotCount, size_t size);
+	size_t GetSize() const { return _size; }
+	size_t GetMemoryBytes() const { return _ids.capacity() * sizeof(uint64_t) + _indices.capacity() * sizeof(uint32_t); }
+
+private:
+	// Fibonacci hashing, the top bits of the product are well mixed even for the dense sequential ids of OSM
+	size_t GetSlot(uint64_t id) const { return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> _shift); }
+	size_t FindSlot(uint64_t id) const;
+	void Rehash(size_t slotCount);
+	void SetSlotCount(size_t slotCount);
+
+	std::vector<uint64_t> _ids;
+	std::vector<uint32_t> _indices; // kInvalidIndex marks an empty slot
+	size_t _size = 0;
+	size_t _mask = 0;
+	int32_t _shift = 63;
+};
+
+}
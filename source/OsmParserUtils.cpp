@@ -4,197 +4,1379 @@
 #include "FTileMapData.h"
 #include "ShapeUtils.h"
 #include "type_defines.h"
-#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #define IS_VERBOSE 0
 
 namespace Osm {
 
-	void OsmComponent::AddTags(tinyxml2::XMLElement* source) {
-		for (tinyxml2::XMLElement* tag = source->FirstChildElement("tag"); tag != nullptr; tag = tag->NextSiblingElement("tag")) {
-			const char* key = tag->Attribute("k");
-			const char* value = tag->Attribute("v");
+	static constexpr int32_t kMaxFixedDegrees = 1800000000;
+	static constexpr int32_t kFixedDecimals = 7;
 
-			if (key != nullptr && value != nullptr) {
-				tags[key] = value;
+	FixedLatLong FixedLatLong::FromLatLong(const LatLong& coordinate) {
+		return FixedLatLong(static_cast<int32_t>(llround(coordinate.latitude * kScale)), static_cast<int32_t>(llround(coordinate.longitude * kScale)));
+	}
+
+	void FixedBounds::Extend(const FixedLatLong& coordinate) {
+		low.latitude = std::min(low.latitude, coordinate.latitude);
+		low.longitude = std::min(low.longitude, coordinate.longitude);
+		high.latitude = std::max(high.latitude, coordinate.latitude);
+		high.longitude = std::max(high.longitude, coordinate.longitude);
+	}
+
+	void FixedBounds::Extend(const FixedBounds& other) {
+		if (!other.IsEmpty()) {
+			Extend(other.low);
+			Extend(other.high);
+		}
+	}
+
+	bool FixedBounds::Intersects(const FixedBounds& other) const {
+		return !IsEmpty() && !other.IsEmpty() &&
+			low.latitude <= other.high.latitude && other.low.latitude <= high.latitude &&
+			low.longitude <= other.high.longitude && other.low.longitude <= high.longitude;
+	}
+
+	bool ParseFixedDegrees(std::string_view text, int32_t& value) {
+		const char* cursor = text.data();
+		const char* end = cursor + text.size();
+		bool isNegative = cursor < end && *cursor == '-';
+		if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+			++cursor;
+		}
+
+		int64_t result = 0;
+		int32_t digitCount = 0;
+		for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor, ++digitCount) {
+			// Leading zeros aside, more than three integer digits are out of range anyway
+			if (result > kMaxFixedDegrees) {
+				return false;
+			}
+			result = result * 10 + (*cursor - '0');
+		}
+		int32_t decimalCount = 0;
+		bool isRoundingUp = false;
+		if (cursor < end && *cursor == '.') {
+			for (++cursor; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor, ++digitCount) {
+				if (decimalCount < kFixedDecimals) {
+					result = result * 10 + (*cursor - '0');
+					++decimalCount;
+				}
+				else if (decimalCount++ == kFixedDecimals) {
+					isRoundingUp = *cursor >= '5';
+				}
+			}
+		}
+		if (digitCount == 0 || cursor != end) {
+			return false;
+		}
+		for (; decimalCount < kFixedDecimals; ++decimalCount) {
+			result *= 10;
+		}
+		result += isRoundingUp ? 1 : 0;
+		if (result > kMaxFixedDegrees) {
+			return false;
+		}
+		value = static_cast<int32_t>(isNegative ? -result : result);
+		return true;
+	}
+
+	void OsmComponent::SetTags(const OsmTag* newTags, size_t count, MemoryArena& arena) {
+		OsmTag* sortedTags = count > 0 ? static_cast<OsmTag*>(arena.Allocate(count * sizeof(OsmTag), alignof(OsmTag))) : nullptr;
+		uint32_t sortedCount = 0;
+		// Insertion sort, entities rarely have more than a handful of tags
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t position = sortedCount;
+			while (position > 0 && sortedTags[position - 1].key > newTags[i].key) {
+				--position;
+			}
+			if (position > 0 && sortedTags[position - 1].key == newTags[i].key) {
+				sortedTags[position - 1].value = newTags[i].value;
+				continue;
 			}
+			memmove(sortedTags + position + 1, sortedTags + position, (sortedCount - position) * sizeof(OsmTag));
+			sortedTags[position] = newTags[i];
+			++sortedCount;
 		}
+		tags = sortedTags;
+		tagCount = sortedCount;
+	}
+
+	const OsmTag* OsmComponent::FindTag(uint32_t key) const {
+		for (uint32_t i = 0; i < tagCount && tags[i].key <= key; ++i) {
+			if (tags[i].key == key) {
+				return &tags[i];
+			}
+		}
+		return nullptr;
+	}
+
+	std::string_view OsmComponent::GetTagValue(uint32_t key) const {
+		const OsmTag* tag = FindTag(key);
+		return tag != nullptr ? GetTagDictionary().GetString(tag->value) : std::string_view("");
 	}
 
 	bool OsmComponent::IsPath() const {
-		return tags.find("highway") != tags.end();
+		return HasTag(kTagHighway);
 	}
 
 	bool OsmComponent::IsBuilding() const {
-		return tags.find("building") != tags.end() || tags.find("building:part") != tags.end();
+		return HasTag(kTagBuilding) || HasTag(kTagBuildingPart);
 	}
 
 	bool OsmComponent::IsLandUse() const {
-		return tags.find("landuse") != tags.end();
+		return HasTag(kTagLanduse);
 	}
 
-	static void PopulateCoordinate(FCoordinate* coordinate, LatLong input, LatLong lowerCorner, LatLong upperCorner) {
-		coordinate->globalPosition = input;
-		coordinate->localPosition.X = GetRangeMappedValue(coordinate->globalPosition.longitude,
-			lowerCorner.longitude,
-			upperCorner.longitude);
-		coordinate->localPosition.Y = GetRangeMappedValue(coordinate->globalPosition.latitude,
-			upperCorner.latitude,
-			lowerCorner.latitude);
+	OsmTagFilter::OsmTagFilter(const std::vector<std::string_view>& keys, bool isFeatureOnly) : _isKeepingAll(false), _isFeatureOnly(isFeatureOnly) {
+		TagDictionary& dictionary = GetTagDictionary();
+		for (std::string_view key : keys) {
+			uint32_t id = dictionary.Intern(key);
+			if (id >= _isKeyKept.size()) {
+				_isKeyKept.resize(id + 1, false);
+			}
+			_isKeyKept[id] = true;
+		}
 	}
 
-	FMapGeometry* OsmNode::CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const {
-		FCoordinate* fCoordinate = new FCoordinate();
-		PopulateCoordinate(fCoordinate, coordinate, lowerCorner, upperCorner);
-		return fCoordinate;
+	bool OsmTagFilter::AreTagsKept(const OsmTag* tags, size_t count) const {
+		if (!_isFeatureOnly) {
+			return true;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t key = tags[i].key;
+			if (key == kTagHighway || key == kTagBuilding || key == kTagBuildingPart || key == kTagLanduse) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<typename T>
+	static uint32_t AddItem(ARRAY<T>& items, OsmIdIndex& index, const T& item) {
+		uint32_t itemIndex = index.Insert(item.id, static_cast<uint32_t>(SIZE(items)));
+		if (itemIndex < SIZE(items)) {
+			items[itemIndex] = item;
+		}
+		else {
+			ADD(items, item);
+		}
+		return itemIndex;
+	}
+
+	template<typename T>
+	static const T* FindItem(const ARRAY<T>& items, const OsmIdIndex& index, uint64_t id) {
+		uint32_t itemIndex = index.Find(id);
+		return itemIndex != OsmIdIndex::kInvalidIndex ? &items[itemIndex] : nullptr;
+	}
+
+	template<typename T>
+	static T* CopyToArena(const T* source, size_t count, MemoryArena& arena) {
+		if (count == 0) {
+			return nullptr;
+		}
+		T* copy = static_cast<T*>(arena.Allocate(count * sizeof(T), alignof(T)));
+		memcpy(copy, source, count * sizeof(T));
+		return copy;
+	}
+
+	void OsmWay::SetNodes(const uint32_t* newNodeIndices, size_t count, MemoryArena& arena) {
+		nodeIndices = CopyToArena(newNodeIndices, count, arena);
+		nodeCount = static_cast<uint32_t>(count);
+	}
+
+	void OsmReverseIndex::Clear() {
+		_firstEntries.clear();
+		_entries.clear();
+	}
+
+	void OsmReverseIndex::Add(uint32_t target, uint32_t source) {
+		if (target >= _firstEntries.size()) {
+			_firstEntries.resize(target + 1, kNoEntry);
+		}
+		// Lists are short, and replaced entities are added again with mostly the same references
+		for (uint32_t entry = _firstEntries[target]; entry != kNoEntry; entry = _entries[entry].next) {
+			if (_entries[entry].source == source) {
+				return;
+			}
+		}
+		_entries.push_back({ source, _firstEntries[target] });
+		_firstEntries[target] = static_cast<uint32_t>(_entries.size() - 1);
+	}
+
+	void OsmCache::Reserve(size_t nodeCount, size_t wayCount, size_t relationCount) {
+		nodes.reserve(nodeCount);
+		ways.reserve(wayCount);
+		relations.reserve(relationCount);
+		nodeIndex.Reserve(nodeCount);
+		wayIndex.Reserve(wayCount);
+		relationIndex.Reserve(relationCount);
+	}
+
+	void OsmCache::Clear() {
+		CLEAR(nodes);
+		CLEAR(ways);
+		CLEAR(relations);
+		nodeIndex.Clear();
+		wayIndex.Clear();
+		relationIndex.Clear();
+		pendingMembers.clear();
+		unresolvedMembers.clear();
+		nodeWays.Clear();
+		nodeRelations.Clear();
+		wayRelations.Clear();
+		relationRelations.Clear();
+		isReverseIndexBuilt = false;
+		relationMarks.clear();
+		relationMarkGeneration = 0;
+		arena.Reset();
+		snapshot.reset();
+	}
+
+	void OsmCache::Release() {
+		Clear();
+		ARRAY<OsmNode>().swap(nodes);
+		ARRAY<OsmWay>().swap(ways);
+		ARRAY<OsmRelation>().swap(relations);
+		nodeIndex = OsmIdIndex();
+		wayIndex = OsmIdIndex();
+		relationIndex = OsmIdIndex();
+		std::vector<OsmPendingMember>().swap(pendingMembers);
+		std::vector<OsmPendingMember>().swap(unresolvedMembers);
+		nodeWays = OsmReverseIndex();
+		nodeRelations = OsmReverseIndex();
+		wayRelations = OsmReverseIndex();
+		relationRelations = OsmReverseIndex();
+		std::vector<uint32_t>().swap(relationMarks);
+		arena.Release();
+	}
+
+	uint32_t OsmCache::AddNode(const OsmNode& node) {
+		return AddItem(nodes, nodeIndex, node);
+	}
+
+	uint32_t OsmCache::AddWay(const OsmWay& way) {
+		return AddItem(ways, wayIndex, way);
+	}
+
+	uint32_t OsmCache::AddRelation(const OsmRelation& relation, const OsmMemberReference* members, size_t memberCount) {
+		OsmRelation added = relation;
+		added.members = memberCount > 0 ? static_cast<OsmMember*>(arena.Allocate(memberCount * sizeof(OsmMember), alignof(OsmMember))) : nullptr;
+		added.memberCount = static_cast<uint32_t>(memberCount);
+		for (size_t i = 0; i < memberCount; ++i) {
+			added.members[i] = { FindMember(members[i].type, members[i].id), members[i].role };
+		}
+		uint32_t index = AddItem(relations, relationIndex, added);
+		// Members keep their position until they are resolved, ResolveMembers() drops the ones that stay missing
+		for (size_t i = 0; i < memberCount; ++i) {
+			if (!added.members[i].handle.IsValid()) {
+				pendingMembers.push_back({ &added.members[i], index, members[i].id });
+			}
+		}
+		return index;
+	}
+
+	const OsmNode* OsmCache::FindNode(uint64_t id) const {
+		return FindItem(nodes, nodeIndex, id);
+	}
+
+	const OsmWay* OsmCache::FindWay(uint64_t id) const {
+		return FindItem(ways, wayIndex, id);
 	}
 
-	uint64_t OsmWay::GetStartNodeId() const {
-		return nodes[0]->id;
+	const OsmRelation* OsmCache::FindRelation(uint64_t id) const {
+		return FindItem(relations, relationIndex, id);
 	}
 
-	uint64_t OsmWay::GetEndNodeId() const {
-		return nodes[SIZE(nodes) - 1]->id;
+	OsmHandle OsmCache::FindMember(OsmMemberType type, uint64_t id) const {
+		OsmHandle handle;
+		handle.type = type;
+		switch (type) {
+		case OsmMemberType::Node: handle.index = nodeIndex.Find(id); break;
+		case OsmMemberType::Way: handle.index = wayIndex.Find(id); break;
+		case OsmMemberType::Relation: handle.index = relationIndex.Find(id); break;
+		}
+		return handle;
+	}
+
+	const OsmComponent& OsmCache::GetComponent(OsmHandle handle) const {
+		switch (handle.type) {
+		case OsmMemberType::Node: return nodes[handle.index];
+		case OsmMemberType::Way: return ways[handle.index];
+		default: return relations[handle.index];
+		}
 	}
 
-	FMapGeometry* OsmWay::CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const {
-		FLine* fLine = new FLine();
-		for (const auto& node : this->nodes) {
-			if (SIZE(fLine->coordinates) > 0 &&
-				fLine->coordinates[SIZE(fLine->coordinates) - 1]->globalPosition.Equals(node->coordinate)) {
+	// Members that only refer back form no cycle, so every cycle has a member that was resolved late and searching from
+	// the relations that had one finds all cycles. The member that closes a cycle is cleared, its relation is added to
+	// the changed ones.
+	static void BreakRelationCycles(OsmCache& osmCache, std::vector<uint32_t>& changedRelations) {
+		enum VisitState : uint8_t { kNotVisited, kVisiting, kDone };
+		std::vector<uint8_t> states(SIZE(osmCache.relations), kNotVisited);
+		std::vector<std::pair<uint32_t, uint32_t>> stack;
+		size_t rootCount = changedRelations.size();
+		for (size_t i = 0; i < rootCount; ++i) {
+			if (states[changedRelations[i]] != kNotVisited) {
+				continue;
+			}
+			states[changedRelations[i]] = kVisiting;
+			stack.push_back(std::make_pair(changedRelations[i], 0u));
+			while (!stack.empty()) {
+				uint32_t relationIndex = stack.back().first;
+				uint32_t memberIndex = stack.back().second++;
+				OsmRelation& relation = osmCache.relations[relationIndex];
+				if (memberIndex >= relation.memberCount) {
+					states[relationIndex] = kDone;
+					stack.pop_back();
 					continue;
+				}
+				OsmHandle& member = relation.members[memberIndex].handle;
+				if (member.type != OsmMemberType::Relation || !member.IsValid()) {
+					continue;
+				}
+				if (states[member.index] == kNotVisited) {
+					states[member.index] = kVisiting;
+					stack.push_back(std::make_pair(member.index, 0u));
+				}
+				else if (states[member.index] == kVisiting) {
+					member.index = OsmIdIndex::kInvalidIndex;
+					changedRelations.push_back(relationIndex);
+				}
 			}
-			FCoordinate* fCoordinate = new FCoordinate();
-			PopulateCoordinate(fCoordinate, node->coordinate, lowerCorner, upperCorner);
-			ADD(fLine->coordinates, fCoordinate);
 		}
-		fLine->isClockwise = ShapeUtils::CalculateShapeOrientation(fLine);
-		return fLine;
 	}
 
-	FMapGeometry* OsmRelation::CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const {
-		if (isMultigon) {
-			FPolygon* polygon = new FPolygon();
-			FLine* fLine = new FLine();
-			uint64_t lastAddedNodeId = 0;
-
-			for (int i = 0; i < SIZE(this->multigonCache.outerSegments); ++i) {
-				auto& segment = this->multigonCache.outerSegments[i];
-				if (segment.second) { // Is reversed?
-					for (auto nodeIterator = segment.first->nodes.rbegin(); nodeIterator != segment.first->nodes.rend(); ++nodeIterator) {
-						if ((*nodeIterator)->id != lastAddedNodeId) {
-							FCoordinate* fCoordinate = new FCoordinate();
-							PopulateCoordinate(fCoordinate, (*nodeIterator)->coordinate, lowerCorner, upperCorner);
-							ADD(fLine->coordinates, fCoordinate);
-							lastAddedNodeId = (*nodeIterator)->id;
-						}
+	static uint32_t GetStartNodeIndex(const OsmWay& way) {
+		return way.nodeIndices[0];
+	}
+
+	static uint32_t GetEndNodeIndex(const OsmWay& way) {
+		return way.nodeIndices[way.nodeCount - 1];
+	}
+
+	// Chains the ways of multipolygons into rings by their end nodes. Node indices are unique per node id, so the ways
+	// are matched by them. The tables are kept for the next relation.
+	class RingAssembler {
+	public:
+		// Every way is used once, in the given order: a ring starts at the first unused way and is extended at its end,
+		// then at its start if it does not close, so ways missing from the input leave one open ring instead of pieces.
+		// Linear in the number of ways.
+		void Assemble(const OsmCache& osmCache, const std::vector<uint32_t>& wayIndices, std::vector<OsmRingSegment>& segments, std::vector<OsmRing>& rings) {
+			ClearFirstEndpoints(wayIndices.size() * 2);
+			_endpoints.clear();
+			_isUsed.assign(wayIndices.size(), false);
+			for (uint32_t position = 0; position < wayIndices.size(); ++position) {
+				const OsmWay& way = osmCache.ways[wayIndices[position]];
+				AddEndpoint(GetStartNodeIndex(way), position, true);
+				AddEndpoint(GetEndNodeIndex(way), position, false);
+			}
+
+			for (uint32_t position = 0; position < wayIndices.size(); ++position) {
+				if (_isUsed[position]) {
+					continue;
+				}
+				_isUsed[position] = true;
+				OsmRing ring = {};
+				ring.firstSegment = static_cast<uint32_t>(segments.size());
+				segments.push_back({ wayIndices[position], false });
+				const OsmWay& firstWay = osmCache.ways[wayIndices[position]];
+				uint32_t startNodeIndex = GetStartNodeIndex(firstWay);
+				uint32_t endNodeIndex = GetEndNodeIndex(firstWay);
+				bool isAtStartNode = false;
+				while (endNodeIndex != startNodeIndex) {
+					uint32_t next = TakeWay(endNodeIndex, isAtStartNode);
+					if (next == kNoEndpoint) {
+						break;
 					}
+					// Walked from the end node on
+					const OsmWay& way = osmCache.ways[wayIndices[next]];
+					segments.push_back({ wayIndices[next], !isAtStartNode });
+					endNodeIndex = isAtStartNode ? GetEndNodeIndex(way) : GetStartNodeIndex(way);
 				}
-				else {
-					for (OsmNode* node : segment.first->nodes) {
-						if (node->id != lastAddedNodeId) {
-							FCoordinate* fCoordinate = new FCoordinate();
-							PopulateCoordinate(fCoordinate, node->coordinate, lowerCorner, upperCorner);
-							ADD(fLine->coordinates, fCoordinate);
-							lastAddedNodeId = node->id;
+				if (endNodeIndex != startNodeIndex) {
+					_prefix.clear();
+					while (startNodeIndex != endNodeIndex) {
+						uint32_t previous = TakeWay(startNodeIndex, isAtStartNode);
+						if (previous == kNoEndpoint) {
+							break;
 						}
+						// Walked up to the start node
+						const OsmWay& way = osmCache.ways[wayIndices[previous]];
+						_prefix.push_back({ wayIndices[previous], isAtStartNode });
+						startNodeIndex = isAtStartNode ? GetEndNodeIndex(way) : GetStartNodeIndex(way);
 					}
+					segments.insert(segments.begin() + ring.firstSegment, _prefix.rbegin(), _prefix.rend());
 				}
-				fLine->isClockwise = ShapeUtils::CalculateShapeOrientation(fLine);
+				ring.segmentCount = static_cast<uint32_t>(segments.size()) - ring.firstSegment;
+				rings.push_back(ring);
+#if IS_VERBOSE
+				LOG_F("[RING] %u ways%s", ring.segmentCount, endNodeIndex == startNodeIndex ? "" : " OPEN");
+#endif
 			}
-			polygon->outerShape = fLine;
-			return polygon;
 		}
-		else {
-			FCompositeGeometry* compositeGeometry = new FCompositeGeometry();
-			for (const auto& component : this->relations) {
-				FMapGeometry* child = component.first->CreateGeometry(lowerCorner, upperCorner);
-				ADD(compositeGeometry->geometries, child);
+
+	private:
+		static constexpr uint32_t kNoEndpoint = UINT32_MAX;
+
+		// Ways ending at the same node are a list, from the last one added
+		struct Endpoint {
+			uint32_t position;
+			uint32_t next;
+			bool isStart;
+		};
+
+		// The first endpoint of a node, in a flat table kept from relation to relation. Slots of an earlier generation
+		// are empty, so clearing it does not touch the slots.
+		struct FirstEndpoint {
+			uint32_t nodeIndex;
+			uint32_t endpoint;
+			uint32_t generation;
+		};
+
+		void ClearFirstEndpoints(size_t endpointCount) {
+			if (++_generation == 0) {
+				_firstEndpoints.assign(_firstEndpoints.size(), {});
+				_generation = 1;
+			}
+			if (endpointCount * 2 > _firstEndpoints.size()) {
+				size_t slotCount = 16;
+				while (slotCount < endpointCount * 2) {
+					slotCount *= 2;
+				}
+				_firstEndpoints.assign(slotCount, {});
+				_slotShift = 64;
+				for (size_t count = slotCount; count > 1; count >>= 1) {
+					--_slotShift;
+				}
+			}
+		}
+
+		FirstEndpoint& FindFirstEndpoint(uint32_t nodeIndex) {
+			size_t mask = _firstEndpoints.size() - 1;
+			size_t slot = static_cast<size_t>((nodeIndex * 0x9E3779B97F4A7C15ull) >> _slotShift);
+			while (_firstEndpoints[slot].generation == _generation && _firstEndpoints[slot].nodeIndex != nodeIndex) {
+				slot = (slot + 1) & mask;
+			}
+			return _firstEndpoints[slot];
+		}
+
+		void AddEndpoint(uint32_t nodeIndex, uint32_t position, bool isStart) {
+			FirstEndpoint& first = FindFirstEndpoint(nodeIndex);
+			_endpoints.push_back({ position, first.generation == _generation ? first.endpoint : kNoEndpoint, isStart });
+			first = { nodeIndex, static_cast<uint32_t>(_endpoints.size() - 1), _generation };
+		}
+
+		// Marks an unused way with an end at the node as used and returns its position, kNoEndpoint if there is none.
+		// Used ways are dropped from the front of the list, so each endpoint is skipped at most once.
+		uint32_t TakeWay(uint32_t nodeIndex, bool& isAtStartNode) {
+			FirstEndpoint& first = FindFirstEndpoint(nodeIndex);
+			if (first.generation != _generation) {
+				return kNoEndpoint;
+			}
+			uint32_t endpoint = first.endpoint;
+			while (endpoint != kNoEndpoint && _isUsed[_endpoints[endpoint].position]) {
+				endpoint = _endpoints[endpoint].next;
+			}
+			first.endpoint = endpoint;
+			if (endpoint == kNoEndpoint) {
+				return kNoEndpoint;
+			}
+			_isUsed[_endpoints[endpoint].position] = true;
+			isAtStartNode = _endpoints[endpoint].isStart;
+			return _endpoints[endpoint].position;
+		}
+
+		std::vector<FirstEndpoint> _firstEndpoints;
+		uint32_t _generation = 0;
+		int32_t _slotShift = 63;
+		std::vector<Endpoint> _endpoints;
+		std::vector<bool> _isUsed;
+		std::vector<OsmRingSegment> _prefix;
+	};
+
+	// Nodes of a ring in order, a node shared by consecutive ways once
+	static void GetRingCoordinates(const OsmCache& osmCache, const OsmRingSegment* segments, const OsmRing& ring, std::vector<FixedLatLong>& coordinates) {
+		coordinates.clear();
+		uint32_t lastNodeIndex = OsmIdIndex::kInvalidIndex;
+		for (uint32_t i = 0; i < ring.segmentCount; ++i) {
+			const OsmRingSegment& segment = segments[ring.firstSegment + i];
+			const OsmWay& way = osmCache.ways[segment.wayIndex];
+			for (uint32_t j = 0; j < way.nodeCount; ++j) {
+				uint32_t nodeIndex = way.nodeIndices[segment.isReversed ? way.nodeCount - 1 - j : j];
+				if (nodeIndex != lastNodeIndex) {
+					coordinates.push_back(osmCache.nodes[nodeIndex].coordinate);
+					lastNodeIndex = nodeIndex;
+				}
 			}
-			return compositeGeometry;
 		}
 	}
 
-	void OsmRelation::AddRelation(OsmComponent* component, const std::string role) {
-		// Add to the front
-		if (role == "outer" || role == "inner") {
-			isMultigon = true;
+	// Whether the edge from a to b toggles the even-odd rule for the point: it crosses the latitude of the point east of
+	// it. Exact on the fixed-point coordinates, the products fit 64 bits.
+	static bool IsCrossedEastOf(const FixedLatLong& a, const FixedLatLong& b, FixedLatLong point) {
+		if ((a.latitude > point.latitude) == (b.latitude > point.latitude)) {
+			return false;
 		}
-		ADD(relations, std::make_pair(component, role));
+		// Whether the point is west of the edge where it crosses the latitude of the point, without dividing
+		int64_t height = static_cast<int64_t>(b.latitude) - a.latitude;
+		int64_t west = (static_cast<int64_t>(point.longitude) - a.longitude) * height;
+		int64_t edge = (static_cast<int64_t>(b.longitude) - a.longitude) * (static_cast<int64_t>(point.latitude) - a.latitude);
+		return height > 0 ? west < edge : west > edge;
 	}
 
-	void OsmRelation::PrecomputeMultigonRelations() {
-		if (isMultigon) {
-			// Index to map node IDs to ways for faster searching
-			std::unordered_set<OsmWay*> segmentCache;
+	// Whether the point is on the edge from a to b. Inside the box of the edge the two products have the same sign, so
+	// their difference cannot overflow.
+	static bool IsOnEdge(const FixedLatLong& a, const FixedLatLong& b, FixedLatLong point) {
+		if (point.latitude < std::min(a.latitude, b.latitude) || point.latitude > std::max(a.latitude, b.latitude) ||
+			point.longitude < std::min(a.longitude, b.longitude) || point.longitude > std::max(a.longitude, b.longitude)) {
+			return false;
+		}
+		int64_t along = (static_cast<int64_t>(b.longitude) - a.longitude) * (static_cast<int64_t>(point.latitude) - a.latitude);
+		int64_t across = (static_cast<int64_t>(b.latitude) - a.latitude) * (static_cast<int64_t>(point.longitude) - a.longitude);
+		return along == across;
+	}
 
-			// First, fill in the cache set of all possible outer ways
-			for (auto& currentMember : relations) {
-				if (currentMember.second == "outer") {
-					OsmWay* outerWay = dynamic_cast<OsmWay*>(currentMember.first);
-					if (outerWay != nullptr) {
-						segmentCache.insert(outerWay);
-					}
+	// The edges of a ring by latitude band, so that the even-odd rule only looks at the edges of the band of the point.
+	// An open ring is closed from its last node to its first, edge i goes from node i to the node before it.
+	class RingBands {
+	public:
+		void Build(const std::vector<FixedLatLong>& ring, const FixedBounds& bounds) {
+			_lowLatitude = bounds.low.latitude;
+			_highLatitude = bounds.high.latitude;
+			// About two edges in every band, fewer bands when the edges span much of the height of the ring
+			double edgeHeight = 0;
+			for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+				edgeHeight += std::abs(static_cast<double>(ring[i].latitude) - ring[j].latitude);
+			}
+			double height = static_cast<double>(_highLatitude) - _lowLatitude;
+			double bandCount = edgeHeight > 0 ? ring.size() * height / edgeHeight : 1;
+			_bandCount = static_cast<uint32_t>(std::min(std::max(bandCount, 1.0), static_cast<double>(kMaxBandCount)));
+			_bandsPerUnit = height > 0 ? _bandCount / (height + 1) : 0;
+			// Counts the edges of every band, fills them in moving the start of each band to its end, then moves them back
+			_bandStarts.assign(_bandCount + 1, 0);
+			for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+				for (uint32_t band = GetBand(std::min(ring[i].latitude, ring[j].latitude)), highBand = GetBand(std::max(ring[i].latitude, ring[j].latitude));
+					band <= highBand; ++band) {
+					++_bandStarts[band + 1];
 				}
 			}
-			// Begin the algorithm with an outer way
-			const auto& startIterator = segmentCache.begin();
-			if (startIterator == segmentCache.end()) return; // No outer segments found
-			OsmWay* startWay = *startIterator;
-			OsmWay* currentWay = startWay;
-			bool isReversed = false;
-			ADD(multigonCache.outerSegments, std::make_pair(currentWay, isReversed));
-			segmentCache.erase(startIterator);
-#if IS_VERBOSE
-			LOG_F("[BEGIN MATCHING] START NODE: %lu END NODE: %lu", currentWay->GetStartNodeId(), currentWay->GetEndNodeId());
-#endif	
-			// In my solution, we keep iterating in the cache looking for a next segment until we create a closed loop or we
-			// are out of way segments.
-			// We also take into account if the segment is reversed or not.
-			int32_t maxLoop = 5000;
-			while (maxLoop-- > 0) {
-				uint64_t currentIdToMatch = isReversed ? currentWay->GetStartNodeId() : currentWay->GetEndNodeId();
-
-				// We got back matching on the start way
-				if (currentIdToMatch == startWay->GetStartNodeId()) {
-#if IS_VERBOSE
-					LOG("[END MATCHING] Returned to start.");
-#endif
-					break;
-				}
-				for (auto cacheIterator = segmentCache.begin(); cacheIterator != segmentCache.end(); ++cacheIterator) {
-					if ((*cacheIterator)->GetStartNodeId() == currentIdToMatch) {
-						isReversed = false;
-						currentWay = (*cacheIterator);
-						ADD(multigonCache.outerSegments, std::make_pair(currentWay, isReversed));
-						segmentCache.erase(cacheIterator++);
-#if IS_VERBOSE
-						LOG_F("START NODE: %lu END NODE: %lu", currentWay->GetStartNodeId(), currentWay->GetEndNodeId());
-#endif
-						break;
+			for (uint32_t band = 0; band < _bandCount; ++band) {
+				_bandStarts[band + 1] += _bandStarts[band];
+			}
+			_bandEdges.resize(_bandStarts[_bandCount]);
+			for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+				for (uint32_t band = GetBand(std::min(ring[i].latitude, ring[j].latitude)), highBand = GetBand(std::max(ring[i].latitude, ring[j].latitude));
+					band <= highBand; ++band) {
+					_bandEdges[_bandStarts[band]++] = static_cast<uint32_t>(i);
+				}
+			}
+			for (uint32_t band = _bandCount; band > 0; --band) {
+				_bandStarts[band] = _bandStarts[band - 1];
+			}
+			_bandStarts[0] = 0;
+		}
+
+		// Even-odd rule, the same as testing every edge of the ring
+		bool IsInside(const std::vector<FixedLatLong>& ring, FixedLatLong point) const {
+			if (point.latitude < _lowLatitude || point.latitude > _highLatitude) {
+				return false;
+			}
+			bool isInside = false;
+			uint32_t band = GetBand(point.latitude);
+			for (uint32_t i = _bandStarts[band]; i < _bandStarts[band + 1]; ++i) {
+				uint32_t edge = _bandEdges[i];
+				if (IsCrossedEastOf(ring[edge], ring[edge == 0 ? ring.size() - 1 : edge - 1], point)) {
+					isInside = !isInside;
+				}
+			}
+			return isInside;
+		}
+
+		// On one of its nodes or edges, where the even-odd rule may go either way
+		bool IsOnBoundary(const std::vector<FixedLatLong>& ring, FixedLatLong point) const {
+			if (point.latitude < _lowLatitude || point.latitude > _highLatitude) {
+				return false;
+			}
+			uint32_t band = GetBand(point.latitude);
+			for (uint32_t i = _bandStarts[band]; i < _bandStarts[band + 1]; ++i) {
+				uint32_t edge = _bandEdges[i];
+				if (IsOnEdge(ring[edge], ring[edge == 0 ? ring.size() - 1 : edge - 1], point)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		// Rings of hundreds of thousands of nodes still have a few edges in every band
+		static constexpr uint32_t kMaxBandCount = 1 << 16;
+
+		// Monotonic in the latitude, so an edge is in the band of every latitude it spans
+		uint32_t GetBand(int32_t latitude) const {
+			double band = (static_cast<double>(latitude) - _lowLatitude) * _bandsPerUnit;
+			return static_cast<uint32_t>(std::min(std::max(band, 0.0), _bandCount - 1.0));
+		}
+
+		int32_t _lowLatitude = 0;
+		int32_t _highLatitude = 0;
+		double _bandsPerUnit = 0;
+		uint32_t _bandCount = 0;
+		std::vector<uint32_t> _bandStarts;
+		std::vector<uint32_t> _bandEdges;
+	};
+
+	// Assigns every inner ring to the smallest outer ring it is in. Bounding boxes rule out most outer rings, the others
+	// are tested by a node of the inner ring off the outer ring through the latitude bands of the outer ring, which are
+	// built the first time the ring is tested. A relation with thousands of holes in one large outer ring costs a few edge tests per
+	// hole.
+	class RingNester {
+	public:
+		// Orders the rings as OsmRelation::rings expects them, inner rings outside of every outer ring are dropped
+		void Nest(const OsmCache& osmCache, const std::vector<OsmRingSegment>& segments, const std::vector<OsmRing>& outerRings,
+			const std::vector<OsmRing>& innerRings, std::vector<OsmRing>& rings) {
+			_outerBounds.resize(outerRings.size());
+			_outerCoordinates.resize(outerRings.size());
+			_outerBands.resize(std::max(_outerBands.size(), outerRings.size()));
+			_isOuterBandBuilt.assign(outerRings.size(), false);
+			for (size_t i = 0; i < outerRings.size(); ++i) {
+				GetRingCoordinates(osmCache, segments.data(), outerRings[i], _outerCoordinates[i]);
+				_outerBounds[i] = GetBounds(_outerCoordinates[i]);
+			}
+
+			_outerOfInner.assign(innerRings.size(), kNoRing);
+			for (size_t i = 0; i < innerRings.size(); ++i) {
+				GetRingCoordinates(osmCache, segments.data(), innerRings[i], _innerCoordinates);
+				FixedBounds bounds = GetBounds(_innerCoordinates);
+				_candidates.clear();
+				for (uint32_t outer = 0; outer < outerRings.size(); ++outer) {
+					if (Contains(_outerBounds[outer], bounds)) {
+						_candidates.push_back(outer);
 					}
-					else if ((*cacheIterator)->GetEndNodeId() == currentIdToMatch) {
-						isReversed = true;
-						currentWay = (*cacheIterator);
-						ADD(multigonCache.outerSegments, std::make_pair(currentWay, isReversed));
-						segmentCache.erase(cacheIterator++);
-#if IS_VERBOSE
-						LOG_F("START NODE: %lu END NODE: %lu REVERSED", currentWay->GetStartNodeId(), currentWay->GetEndNodeId());
-#endif
+				}
+				// Nested boxes: the smaller outer ring is the one in the hole of the larger one
+				std::sort(_candidates.begin(), _candidates.end(), [this](uint32_t left, uint32_t right) {
+					return GetArea(_outerBounds[left]) < GetArea(_outerBounds[right]);
+				});
+				// A hole in the box of a single outer ring may still be outside of the ring, e.g. in the notch of an L
+				for (uint32_t outer : _candidates) {
+					if (!_isOuterBandBuilt[outer]) {
+						_outerBands[outer].Build(_outerCoordinates[outer], _outerBounds[outer]);
+						_isOuterBandBuilt[outer] = true;
+					}
+					if (_outerBands[outer].IsInside(_outerCoordinates[outer], GetPointOffRing(_outerBands[outer], _outerCoordinates[outer]))) {
+						_outerOfInner[i] = outer;
 						break;
 					}
 				}
+			}
 
-				if (segmentCache.empty()) {
-#if IS_VERBOSE
-					LOG("[END MATCHING] Cache is now empty.");
-#endif
-					break;
+			// Group the inner rings by their outer ring, keeping their order
+			rings.assign(outerRings.begin(), outerRings.end());
+			for (uint32_t outer : _outerOfInner) {
+				if (outer != kNoRing) {
+					++rings[outer].innerRingCount;
+				}
+			}
+			uint32_t firstInnerRing = static_cast<uint32_t>(outerRings.size());
+			for (OsmRing& ring : rings) {
+				ring.firstInnerRing = firstInnerRing;
+				firstInnerRing += ring.innerRingCount;
+				ring.innerRingCount = 0;
+			}
+			rings.resize(firstInnerRing);
+			for (size_t i = 0; i < innerRings.size(); ++i) {
+				uint32_t outer = _outerOfInner[i];
+				if (outer != kNoRing) {
+					rings[rings[outer].firstInnerRing + rings[outer].innerRingCount++] = innerRings[i];
+				}
+			}
+		}
+
+	private:
+		static constexpr uint32_t kNoRing = UINT32_MAX;
+
+		// A node of the inner ring that is not on the outer ring, else the middle of one of its edges, so that a hole
+		// touching its outer ring is still tested by a point strictly inside of it
+		FixedLatLong GetPointOffRing(const RingBands& bands, const std::vector<FixedLatLong>& ring) const {
+			for (const FixedLatLong& coordinate : _innerCoordinates) {
+				if (!bands.IsOnBoundary(ring, coordinate)) {
+					return coordinate;
+				}
+			}
+			for (size_t i = 0, j = _innerCoordinates.size() - 1; i < _innerCoordinates.size(); j = i++) {
+				FixedLatLong middle(static_cast<int32_t>((static_cast<int64_t>(_innerCoordinates[i].latitude) + _innerCoordinates[j].latitude) / 2),
+					static_cast<int32_t>((static_cast<int64_t>(_innerCoordinates[i].longitude) + _innerCoordinates[j].longitude) / 2));
+				if (!bands.IsOnBoundary(ring, middle)) {
+					return middle;
+				}
+			}
+			return _innerCoordinates[0];
+		}
+
+		static FixedBounds GetBounds(const std::vector<FixedLatLong>& coordinates) {
+			FixedBounds bounds;
+			for (const FixedLatLong& coordinate : coordinates) {
+				bounds.Extend(coordinate);
+			}
+			return bounds;
+		}
+
+		static bool Contains(const FixedBounds& outer, const FixedBounds& inner) {
+			return !inner.IsEmpty() && outer.low.latitude <= inner.low.latitude && outer.low.longitude <= inner.low.longitude &&
+				outer.high.latitude >= inner.high.latitude && outer.high.longitude >= inner.high.longitude;
+		}
+
+		static double GetArea(const FixedBounds& bounds) {
+			return (static_cast<double>(bounds.high.latitude) - bounds.low.latitude) * (static_cast<double>(bounds.high.longitude) - bounds.low.longitude);
+		}
+
+		std::vector<FixedBounds> _outerBounds;
+		std::vector<std::vector<FixedLatLong>> _outerCoordinates;
+		std::vector<RingBands> _outerBands;
+		std::vector<bool> _isOuterBandBuilt;
+		std::vector<FixedLatLong> _innerCoordinates;
+		std::vector<uint32_t> _candidates;
+		std::vector<uint32_t> _outerOfInner;
+	};
+
+	static bool AreRingsEqual(const OsmRelation& relation, const std::vector<OsmRingSegment>& segments, const std::vector<OsmRing>& rings, size_t outerRingCount) {
+		if (relation.ringSegmentCount != segments.size() || relation.outerRingCount + relation.innerRingCount != rings.size() ||
+			relation.outerRingCount != outerRingCount) {
+			return false;
+		}
+		for (size_t i = 0; i < segments.size(); ++i) {
+			if (relation.ringSegments[i].wayIndex != segments[i].wayIndex || relation.ringSegments[i].isReversed != segments[i].isReversed) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < rings.size(); ++i) {
+			const OsmRing& ring = relation.rings[i];
+			if (ring.firstSegment != rings[i].firstSegment || ring.segmentCount != rings[i].segmentCount || ring.firstInnerRing != rings[i].firstInnerRing ||
+				ring.innerRingCount != rings[i].innerRingCount) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Rings that come out as the relation has them already are kept, so that chaining a relation again only takes
+	// memory of the arena if its rings changed
+	static void PrecomputeMultigonRelations(const OsmCache& osmCache, OsmRelation& relation, uint32_t outerRole, uint32_t innerRole, MemoryArena& arena,
+		RingAssembler& assembler, RingNester& nester) {
+		if (!relation.isMultigon) {
+			relation.ringSegments = nullptr;
+			relation.rings = nullptr;
+			relation.ringSegmentCount = 0;
+			relation.outerRingCount = 0;
+			relation.innerRingCount = 0;
+			return;
+		}
+		// Ways without nodes in the input can not be chained
+		std::vector<uint32_t> outerWayIndices;
+		std::vector<uint32_t> innerWayIndices;
+		for (uint32_t i = 0; i < relation.memberCount; ++i) {
+			const OsmMember& member = relation.members[i];
+			if (member.handle.type == OsmMemberType::Way && member.handle.IsValid() && osmCache.ways[member.handle.index].nodeCount > 0) {
+				if (member.role == outerRole) {
+					outerWayIndices.push_back(member.handle.index);
+				}
+				else if (member.role == innerRole) {
+					innerWayIndices.push_back(member.handle.index);
+				}
+			}
+		}
+		std::vector<OsmRingSegment> segments;
+		std::vector<OsmRing> outerRings;
+		std::vector<OsmRing> innerRings;
+		assembler.Assemble(osmCache, outerWayIndices, segments, outerRings);
+		assembler.Assemble(osmCache, innerWayIndices, segments, innerRings);
+		std::vector<OsmRing> rings;
+		nester.Nest(osmCache, segments, outerRings, innerRings, rings);
+		if (AreRingsEqual(relation, segments, rings, outerRings.size())) {
+			return;
+		}
+		relation.ringSegments = CopyToArena(segments.data(), segments.size(), arena);
+		relation.rings = CopyToArena(rings.data(), rings.size(), arena);
+		relation.ringSegmentCount = static_cast<uint32_t>(segments.size());
+		relation.outerRingCount = static_cast<uint32_t>(outerRings.size());
+		relation.innerRingCount = static_cast<uint32_t>(rings.size() - outerRings.size());
+	}
+
+	static OsmReverseIndex& GetMemberRelations(OsmCache& osmCache, OsmMemberType type) {
+		switch (type) {
+		case OsmMemberType::Node: return osmCache.nodeRelations;
+		case OsmMemberType::Way: return osmCache.wayRelations;
+		default: return osmCache.relationRelations;
+		}
+	}
+
+	// Looks the pending members up again and adds the relations of the ones found to changedRelations, with
+	// missingMembers the ones still missing go there instead. Members of relations that were replaced since are dropped.
+	static void LookUpPendingMembers(OsmCache& osmCache, const std::vector<OsmPendingMember>& pendingMembers, std::vector<uint32_t>& changedRelations,
+		std::vector<OsmPendingMember>* missingMembers) {
+		for (const OsmPendingMember& pendingMember : pendingMembers) {
+			const OsmRelation& relation = osmCache.relations[pendingMember.relationIndex];
+			if (pendingMember.member < relation.members || pendingMember.member >= relation.members + relation.memberCount) {
+				continue;
+			}
+			OsmHandle& handle = pendingMember.member->handle;
+			handle = osmCache.FindMember(handle.type, pendingMember.id);
+			if (!handle.IsValid() && missingMembers != nullptr) {
+				missingMembers->push_back(pendingMember);
+				continue;
+			}
+			if (handle.IsValid() && osmCache.isReverseIndexBuilt) {
+				GetMemberRelations(osmCache, handle.type).Add(handle.index, pendingMember.relationIndex);
+			}
+			if (changedRelations.empty() || changedRelations.back() != pendingMember.relationIndex) {
+				changedRelations.push_back(pendingMember.relationIndex);
+			}
+		}
+	}
+
+	// Decides by the roles of its members whether the relation is a multigon and chains its rings
+	static void PrepareMultigon(OsmCache& osmCache, OsmRelation& relation, uint32_t outerRole, uint32_t innerRole, RingAssembler& assembler, RingNester& nester) {
+		relation.isMultigon = false;
+		for (uint32_t i = 0; i < relation.memberCount && !relation.isMultigon; ++i) {
+			const OsmMember& member = relation.members[i];
+			relation.isMultigon = member.handle.IsValid() && (member.role == outerRole || member.role == innerRole);
+		}
+		PrecomputeMultigonRelations(osmCache, relation, outerRole, innerRole, osmCache.arena, assembler, nester);
+	}
+
+	// Fills in the pending members and prepares the multipolygons. Cycles are searched from the relations with pending
+	// members.
+	void OsmCache::ResolveMembers() {
+		std::vector<uint32_t> changedRelations;
+		LookUpPendingMembers(*this, pendingMembers, changedRelations, nullptr);
+		pendingMembers.clear();
+		BreakRelationCycles(*this, changedRelations);
+
+		// Like members that are not found while reading, the ones outside of the input are left out
+		for (uint32_t relationIndex : changedRelations) {
+			OsmRelation& relation = relations[relationIndex];
+			OsmMember* end = std::remove_if(relation.members, relation.members + relation.memberCount, [](const OsmMember& member) {
+				return !member.handle.IsValid();
+			});
+			relation.memberCount = static_cast<uint32_t>(end - relation.members);
+		}
+
+		TagDictionary& dictionary = GetTagDictionary();
+		uint32_t outerRole = dictionary.Find("outer");
+		uint32_t innerRole = dictionary.Find("inner");
+		RingAssembler assembler;
+		RingNester nester;
+		for (OsmRelation& relation : relations) {
+			PrepareMultigon(*this, relation, outerRole, innerRole, assembler, nester);
+		}
+	}
+
+	void OsmChange::Clear() {
+		entities.clear();
+		tags.clear();
+		nodeIds.clear();
+		members.clear();
+	}
+
+	static bool IsFeature(const OsmComponent& component) {
+		return component.IsPath() || component.IsLandUse() || component.IsBuilding();
+	}
+
+	static void AddFeatureBounds(const OsmCache& osmCache, OsmHandle handle, std::vector<FixedBounds>& dirtyBounds) {
+		if (IsFeature(osmCache.GetComponent(handle))) {
+			FixedBounds bounds = osmCache.GetBounds(handle);
+			if (!bounds.IsEmpty()) {
+				dirtyBounds.push_back(bounds);
+			}
+		}
+	}
+
+	// Adds the entity to the reverse indexes of the entities it refers to
+	static void IndexReferences(OsmCache& osmCache, OsmHandle handle) {
+		if (handle.type == OsmMemberType::Way) {
+			const OsmWay& way = osmCache.ways[handle.index];
+			for (uint32_t i = 0; i < way.nodeCount; ++i) {
+				osmCache.nodeWays.Add(way.nodeIndices[i], handle.index);
+			}
+		}
+		else if (handle.type == OsmMemberType::Relation) {
+			const OsmRelation& relation = osmCache.relations[handle.index];
+			for (uint32_t i = 0; i < relation.memberCount; ++i) {
+				OsmHandle member = relation.members[i].handle;
+				if (member.IsValid()) {
+					GetMemberRelations(osmCache, member.type).Add(member.index, handle.index);
+				}
+			}
+		}
+	}
+
+	static void BuildReverseIndexes(OsmCache& osmCache) {
+		for (uint32_t i = 0; i < SIZE(osmCache.ways); ++i) {
+			IndexReferences(osmCache, { OsmMemberType::Way, i });
+		}
+		for (uint32_t i = 0; i < SIZE(osmCache.relations); ++i) {
+			IndexReferences(osmCache, { OsmMemberType::Relation, i });
+		}
+		osmCache.isReverseIndexBuilt = true;
+	}
+
+	static bool RefersTo(const OsmWay& way, uint32_t nodeIndex) {
+		return std::find(way.nodeIndices, way.nodeIndices + way.nodeCount, nodeIndex) != way.nodeIndices + way.nodeCount;
+	}
+
+	static bool RefersTo(const OsmRelation& relation, OsmHandle handle) {
+		for (uint32_t i = 0; i < relation.memberCount; ++i) {
+			if (relation.members[i].handle.type == handle.type && relation.members[i].handle.index == handle.index) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Starts a new set of relation marks. Entries of an earlier generation are unmarked, so only a wrapped generation
+	// clears the array.
+	static void ClearRelationMarks(OsmCache& osmCache) {
+		if (++osmCache.relationMarkGeneration == 0) {
+			osmCache.relationMarks.assign(osmCache.relationMarks.size(), 0);
+			osmCache.relationMarkGeneration = 1;
+		}
+	}
+
+	// Adds the relation to markedRelations unless it is marked already
+	static bool MarkRelation(OsmCache& osmCache, uint32_t relationIndex, std::vector<uint32_t>& markedRelations) {
+		if (relationIndex >= osmCache.relationMarks.size()) {
+			osmCache.relationMarks.resize(SIZE(osmCache.relations), 0);
+		}
+		if (osmCache.relationMarks[relationIndex] == osmCache.relationMarkGeneration) {
+			return false;
+		}
+		osmCache.relationMarks[relationIndex] = osmCache.relationMarkGeneration;
+		markedRelations.push_back(relationIndex);
+		return true;
+	}
+
+	// Appends the relations that have one of the entities from touched[first] on as a member, directly or through
+	// other relations. The relations that are in touched already are the marked ones.
+	static void MarkParentRelations(OsmCache& osmCache, size_t first, std::vector<OsmHandle>& touched, std::vector<uint32_t>& markedRelations) {
+		for (size_t i = first; i < touched.size(); ++i) {
+			OsmHandle handle = touched[i];
+			GetMemberRelations(osmCache, handle.type).ForEach(handle.index, [&](uint32_t relationIndex) {
+				if (RefersTo(osmCache.relations[relationIndex], handle) && MarkRelation(osmCache, relationIndex, markedRelations)) {
+					touched.push_back({ OsmMemberType::Relation, relationIndex });
+				}
+			});
+		}
+	}
+
+	// Appends the ways that have a node of touched and the relations that have a member of it, found through the
+	// reverse indexes
+	static void MarkDependents(OsmCache& osmCache, std::vector<OsmHandle>& touched, std::vector<uint32_t>& markedRelations) {
+		size_t changedCount = touched.size();
+		for (size_t i = 0; i < changedCount; ++i) {
+			OsmHandle handle = touched[i];
+			if (handle.type == OsmMemberType::Node) {
+				osmCache.nodeWays.ForEach(handle.index, [&](uint32_t wayIndex) {
+					if (RefersTo(osmCache.ways[wayIndex], handle.index)) {
+						touched.push_back({ OsmMemberType::Way, wayIndex });
+					}
+				});
+			}
+			else if (handle.type == OsmMemberType::Relation) {
+				MarkRelation(osmCache, handle.index, markedRelations);
+			}
+		}
+		MarkParentRelations(osmCache, 0, touched, markedRelations);
+	}
+
+	static void SortHandles(std::vector<OsmHandle>& handles) {
+		std::sort(handles.begin(), handles.end(), [](OsmHandle left, OsmHandle right) {
+			return left.type != right.type ? left.type < right.type : left.index < right.index;
+		});
+		handles.erase(std::unique(handles.begin(), handles.end(), [](OsmHandle left, OsmHandle right) {
+			return left.type == right.type && left.index == right.index;
+		}), handles.end());
+	}
+
+	void OsmCache::ApplyChange(const OsmChange& change, std::vector<FixedBounds>& dirtyBounds) {
+		if (!isReverseIndexBuilt) {
+			BuildReverseIndexes(*this);
+		}
+		// The entities the change replaces and the ones that depend on them, their boxes before the change
+		std::vector<OsmHandle> touched;
+		std::vector<uint32_t> markedRelations;
+		ClearRelationMarks(*this);
+		for (const OsmChangeEntity& entity : change.entities) {
+			OsmHandle handle = FindMember(entity.type, entity.id);
+			if (handle.IsValid()) {
+				touched.push_back(handle);
+			}
+		}
+		MarkDependents(*this, touched, markedRelations);
+		SortHandles(touched);
+		for (OsmHandle handle : touched) {
+			AddFeatureBounds(*this, handle, dirtyBounds);
+		}
+
+		// Relations that change may close a cycle without referring ahead, so cycles are searched from them as well
+		std::vector<uint32_t> changedRelations;
+		std::vector<uint32_t> nodeBuffer;
+		for (const OsmChangeEntity& entity : change.entities) {
+			bool isDeleted = entity.action == OsmChangeAction::Delete;
+			if (isDeleted && !FindMember(entity.type, entity.id).IsValid()) {
+				continue;
+			}
+			OsmComponent component;
+			component.id = entity.id;
+			if (!isDeleted) {
+				component.SetTags(change.tags.data() + entity.firstTag, entity.tagCount, arena);
+			}
+			OsmHandle handle;
+			handle.type = entity.type;
+			switch (entity.type) {
+			case OsmMemberType::Node: {
+				OsmNode node(entity.coordinate);
+				static_cast<OsmComponent&>(node) = component;
+				// A deleted node keeps its position, ways still referring to it do not move
+				if (isDeleted) {
+					node.coordinate = nodes[nodeIndex.Find(entity.id)].coordinate;
+				}
+				handle.index = AddNode(node);
+				break;
+			}
+			case OsmMemberType::Way: {
+				OsmWay way;
+				static_cast<OsmComponent&>(way) = component;
+				nodeBuffer.clear();
+				for (uint32_t i = 0; i < (isDeleted ? 0 : entity.referenceCount); ++i) {
+					uint32_t index = nodeIndex.Find(change.nodeIds[entity.firstReference + i]);
+					if (index != OsmIdIndex::kInvalidIndex) {
+						nodeBuffer.push_back(index);
+					}
+				}
+				way.SetNodes(nodeBuffer.data(), nodeBuffer.size(), arena);
+				handle.index = AddWay(way);
+				break;
+			}
+			case OsmMemberType::Relation: {
+				OsmRelation relation;
+				static_cast<OsmComponent&>(relation) = component;
+				handle.index = AddRelation(relation, change.members.data() + entity.firstReference, isDeleted ? 0 : entity.referenceCount);
+				changedRelations.push_back(handle.index);
+				break;
+			}
+			}
+			IndexReferences(*this, handle);
+			touched.push_back(handle);
+		}
+
+		// Members of earlier changes whose entity this one adds, then the ones of this change. The ones that are still
+		// missing stay in their relations for a later change.
+		std::vector<uint32_t> resolvedRelations;
+		std::vector<OsmPendingMember> missingMembers;
+		LookUpPendingMembers(*this, unresolvedMembers, resolvedRelations, &missingMembers);
+		LookUpPendingMembers(*this, pendingMembers, changedRelations, &missingMembers);
+		pendingMembers.clear();
+		unresolvedMembers.swap(missingMembers);
+		changedRelations.insert(changedRelations.end(), resolvedRelations.begin(), resolvedRelations.end());
+		BreakRelationCycles(*this, changedRelations);
+		// Relations that gained a member changed, and so did the ones they are members of
+		size_t firstResolved = touched.size();
+		for (uint32_t relationIndex : resolvedRelations) {
+			touched.push_back({ OsmMemberType::Relation, relationIndex });
+		}
+		MarkParentRelations(*this, firstResolved, touched, markedRelations);
+
+		// Only the multigons whose members or nodes of them changed are chained again
+		changedRelations.insert(changedRelations.end(), markedRelations.begin(), markedRelations.end());
+		std::sort(changedRelations.begin(), changedRelations.end());
+		changedRelations.erase(std::unique(changedRelations.begin(), changedRelations.end()), changedRelations.end());
+		TagDictionary& dictionary = GetTagDictionary();
+		uint32_t outerRole = dictionary.Find("outer");
+		uint32_t innerRole = dictionary.Find("inner");
+		RingAssembler assembler;
+		RingNester nester;
+		for (uint32_t relationIndex : changedRelations) {
+			PrepareMultigon(*this, relations[relationIndex], outerRole, innerRole, assembler, nester);
+		}
+
+		// The same features and the new ones after the change
+		SortHandles(touched);
+		for (OsmHandle handle : touched) {
+			AddFeatureBounds(*this, handle, dirtyBounds);
+		}
+	}
+
+	FixedBounds OsmCache::GetBounds(OsmHandle handle) const {
+		FixedBounds bounds;
+		switch (handle.type) {
+		case OsmMemberType::Node:
+			bounds.Extend(nodes[handle.index].coordinate);
+			break;
+		case OsmMemberType::Way: {
+			const OsmWay& way = ways[handle.index];
+			for (uint32_t i = 0; i < way.nodeCount; ++i) {
+				bounds.Extend(nodes[way.nodeIndices[i]].coordinate);
+			}
+			break;
+		}
+		default: {
+			// ResolveMembers() broke the cycles, so the recursion ends
+			const OsmRelation& relation = relations[handle.index];
+			for (uint32_t i = 0; i < relation.memberCount; ++i) {
+				if (relation.members[i].handle.IsValid()) {
+					bounds.Extend(GetBounds(relation.members[i].handle));
+				}
+			}
+			break;
+		}
+		}
+		return bounds;
+	}
+
+	static VECTOR2D GetLocalPosition(const LatLong& globalPosition, LatLong lowerCorner, LatLong upperCorner) {
+		return VECTOR2D(GetRangeMappedValue(globalPosition.longitude,
+			lowerCorner.longitude,
+			upperCorner.longitude),
+			GetRangeMappedValue(globalPosition.latitude,
+			upperCorner.latitude,
+			lowerCorner.latitude));
+	}
+
+	static void PopulateCoordinate(FCoordinate* coordinate, FixedLatLong input, LatLong lowerCorner, LatLong upperCorner) {
+		coordinate->globalPosition = input.ToLatLong();
+		coordinate->localPosition = GetLocalPosition(coordinate->globalPosition, lowerCorner, upperCorner);
+	}
+
+	static void AddVertex(FLine* fLine, FixedLatLong input, LatLong lowerCorner, LatLong upperCorner) {
+		LatLong globalPosition = input.ToLatLong();
+		fLine->AddVertex(globalPosition, GetLocalPosition(globalPosition, lowerCorner, upperCorner));
+	}
+
+	// Refers to the vertex of the node in the pool if there is one. A line with a node outside of the clip keeps the
+	// positions of all of its vertices, it is cut at the clip and the cut makes vertices that are no node.
+	static void AddNodeVertex(FLine* fLine, const OsmCache& osmCache, uint32_t nodeIndex, LatLong lowerCorner, LatLong upperCorner, const GeometryVertexPool* vertexPool) {
+		if (vertexPool == nullptr) {
+			AddVertex(fLine, osmCache.nodes[nodeIndex].coordinate, lowerCorner, upperCorner);
+			return;
+		}
+		uint32_t vertexIndex = vertexPool->vertexIndices[nodeIndex];
+		if (vertexIndex == GeometryVertexPool::kOutsideClip) {
+			// Outside of the clip, it does not remain in the line
+			fLine->CopyPoolPositions();
+			AddVertex(fLine, osmCache.nodes[nodeIndex].coordinate, lowerCorner, upperCorner);
+			ADD(fLine->vertexIndices, FVertexPool::kNoVertex);
+			return;
+		}
+		if (fLine->IsPooled() || fLine->GetVertexCount() == 0) {
+			fLine->AddVertex(vertexPool->pool, vertexIndex);
+		}
+		else {
+			fLine->AddVertex(vertexPool->pool->GetGlobalPosition(vertexIndex), vertexPool->pool->GetLocalPosition(vertexIndex), vertexIndex);
+		}
+	}
+
+	static void ReserveVertices(FLine* fLine, int count, const GeometryVertexPool* vertexPool) {
+		if (vertexPool != nullptr) {
+			RESERVE(fLine->vertexIndices, count);
+		}
+		else {
+			fLine->ReserveVertices(count);
+		}
+	}
+
+	static FMapGeometry* ClipLineGeometry(FLine* fLine, const GeometryClip* clip, MemoryArena& arena) {
+		if (clip == nullptr) {
+			return fLine;
+		}
+		if (clip->isArea) {
+			return ShapeUtils::ClipRing(fLine, clip->low, clip->high, arena);
+		}
+		ARRAY<FLine*> pieces;
+		ShapeUtils::ClipLine(fLine, clip->low, clip->high, arena, pieces);
+		if (SIZE(pieces) <= 1) {
+			return SIZE(pieces) == 1 ? pieces[0] : nullptr;
+		}
+		FCompositeGeometry* compositeGeometry = arena.New<FCompositeGeometry>();
+		for (FLine* piece : pieces) {
+			ADD(compositeGeometry->geometries, piece);
+		}
+		return compositeGeometry;
+	}
+
+	static FMapGeometry* CreateNodeGeometry(const OsmNode& node, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena, const GeometryClip* clip) {
+		FCoordinate* fCoordinate = arena.New<FCoordinate>();
+		PopulateCoordinate(fCoordinate, node.coordinate, lowerCorner, upperCorner);
+		if (clip != nullptr && (fCoordinate->localPosition.X < clip->low.X || fCoordinate->localPosition.X > clip->high.X ||
+			fCoordinate->localPosition.Y < clip->low.Y || fCoordinate->localPosition.Y > clip->high.Y)) {
+			return nullptr;
+		}
+		return fCoordinate;
+	}
+
+	static FMapGeometry* CreateWayGeometry(const OsmCache& osmCache, const OsmWay& way, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena, const GeometryClip* clip,
+		const GeometryVertexPool* vertexPool) {
+		FLine* fLine = arena.New<FLine>();
+		ReserveVertices(fLine, way.nodeCount, vertexPool);
+		const OsmNode* lastAddedNode = nullptr;
+		for (uint32_t i = 0; i < way.nodeCount; ++i) {
+			const OsmNode& node = osmCache.nodes[way.nodeIndices[i]];
+			if (lastAddedNode != nullptr && lastAddedNode->coordinate == node.coordinate) {
+				continue;
+			}
+			AddNodeVertex(fLine, osmCache, way.nodeIndices[i], lowerCorner, upperCorner, vertexPool);
+			lastAddedNode = &node;
+		}
+		fLine->isClockwise = ShapeUtils::CalculateShapeOrientation(fLine);
+		return ClipLineGeometry(fLine, clip, arena);
+	}
+
+	static FLine* CreateRingLine(const OsmCache& osmCache, const OsmRelation& relation, const OsmRing& ring, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena,
+		const GeometryVertexPool* vertexPool) {
+		FLine* fLine = arena.New<FLine>();
+		uint32_t vertexCount = 0;
+		for (uint32_t i = 0; i < ring.segmentCount; ++i) {
+			vertexCount += osmCache.ways[relation.ringSegments[ring.firstSegment + i].wayIndex].nodeCount;
+		}
+		ReserveVertices(fLine, vertexCount, vertexPool);
+		uint32_t lastAddedNodeIndex = OsmIdIndex::kInvalidIndex;
+		for (uint32_t i = 0; i < ring.segmentCount; ++i) {
+			const OsmRingSegment& segment = relation.ringSegments[ring.firstSegment + i];
+			const OsmWay& way = osmCache.ways[segment.wayIndex];
+			for (uint32_t j = 0; j < way.nodeCount; ++j) {
+				uint32_t nodeIndex = way.nodeIndices[segment.isReversed ? way.nodeCount - 1 - j : j];
+				if (nodeIndex != lastAddedNodeIndex) {
+					AddNodeVertex(fLine, osmCache, nodeIndex, lowerCorner, upperCorner, vertexPool);
+					lastAddedNodeIndex = nodeIndex;
+				}
+			}
+		}
+		fLine->isClockwise = ShapeUtils::CalculateShapeOrientation(fLine);
+		return fLine;
+	}
+
+	static FMapGeometry* CreateRelationGeometry(const OsmCache& osmCache, const OsmRelation& relation, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena, const GeometryClip* clip,
+		const GeometryVertexPool* vertexPool) {
+		if (relation.isMultigon) {
+			// Each outer ring is a polygon with its inner rings as holes, the first one is the main segment of the relation.
+			// A relation without outer rings has no area and is skipped.
+			if (relation.outerRingCount == 0) {
+				return nullptr;
+			}
+			FCompositeGeometry* compositeGeometry = arena.New<FCompositeGeometry>();
+			for (uint32_t i = 0; i < relation.outerRingCount; ++i) {
+				FLine* fLine = CreateRingLine(osmCache, relation, relation.rings[i], lowerCorner, upperCorner, arena, vertexPool);
+				// The rings are areas even if the relation is only drawn as a line
+				if (clip != nullptr) {
+					fLine = ShapeUtils::ClipRing(fLine, clip->low, clip->high, arena);
+					if (fLine == nullptr) {
+						continue;
+					}
+				}
+				FPolygon* polygon = arena.New<FPolygon>();
+				polygon->outerShape = fLine;
+				for (uint32_t j = 0; j < relation.rings[i].innerRingCount; ++j) {
+					FLine* hole = CreateRingLine(osmCache, relation, relation.rings[relation.rings[i].firstInnerRing + j], lowerCorner, upperCorner, arena, vertexPool);
+					if (clip != nullptr) {
+						hole = ShapeUtils::ClipRing(hole, clip->low, clip->high, arena);
+					}
+					if (hole != nullptr) {
+						ADD(polygon->innerShapes, hole);
+					}
+				}
+				ADD(compositeGeometry->geometries, polygon);
+			}
+			if (SIZE(compositeGeometry->geometries) <= 1) {
+				return SIZE(compositeGeometry->geometries) == 1 ? compositeGeometry->geometries[0] : nullptr;
+			}
+			return compositeGeometry;
+		}
+		else {
+			FCompositeGeometry* compositeGeometry = arena.New<FCompositeGeometry>();
+			for (uint32_t i = 0; i < relation.memberCount; ++i) {
+				if (!relation.members[i].handle.IsValid()) {
+					continue;
 				}
+				FMapGeometry* child = osmCache.CreateGeometry(relation.members[i].handle, lowerCorner, upperCorner, arena, clip, vertexPool);
+				if (child != nullptr) {
+					ADD(compositeGeometry->geometries, child);
+				}
+			}
+			if (clip != nullptr && EMPTY(compositeGeometry->geometries)) {
+				return nullptr;
 			}
+			return compositeGeometry;
+		}
+	}
+
+	FMapGeometry* OsmCache::CreateGeometry(OsmHandle handle, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena, const GeometryClip* clip,
+		const GeometryVertexPool* vertexPool) const {
+		switch (handle.type) {
+		case OsmMemberType::Node: return CreateNodeGeometry(nodes[handle.index], lowerCorner, upperCorner, arena, clip);
+		case OsmMemberType::Way: return CreateWayGeometry(*this, ways[handle.index], lowerCorner, upperCorner, arena, clip, vertexPool);
+		default: return CreateRelationGeometry(*this, relations[handle.index], lowerCorner, upperCorner, arena, clip, vertexPool);
+		}
+	}
 
-			// TODO take care of outers still remaining in the cache set. They are likely separate islands, handle them as well.
-			// TODO take care of the inners (later), should be easy, because they don't seem to be separated to segments.
+	// Calls function(nodeIndex) for the nodes in the lines of the entity. Nodes of relations are points, not lines.
+	template<typename Function>
+	static void ForEachLineNode(const OsmCache& osmCache, OsmHandle handle, const Function& function) {
+		if (handle.type == OsmMemberType::Way) {
+			const OsmWay& way = osmCache.ways[handle.index];
+			for (uint32_t i = 0; i < way.nodeCount; ++i) {
+				function(way.nodeIndices[i]);
+			}
+			return;
+		}
+		if (handle.type != OsmMemberType::Relation) {
+			return;
+		}
+		const OsmRelation& relation = osmCache.relations[handle.index];
+		if (relation.isMultigon) {
+			for (uint32_t i = 0; i < relation.ringSegmentCount; ++i) {
+				ForEachLineNode(osmCache, { OsmMemberType::Way, relation.ringSegments[i].wayIndex }, function);
+			}
+			return;
+		}
+		// ResolveMembers() broke the cycles, so the recursion ends
+		for (uint32_t i = 0; i < relation.memberCount; ++i) {
+			if (relation.members[i].handle.IsValid()) {
+				ForEachLineNode(osmCache, relation.members[i].handle, function);
+			}
+		}
+	}
+
+	void OsmCache::CreateVertexPool(const std::vector<OsmHandle>& handles, LatLong lowerCorner, LatLong upperCorner, const GeometryClip* clip, FVertexPool& pool,
+		GeometryVertexPool& vertexPool) const {
+		std::vector<uint32_t>& vertexIndices = vertexPool.vertexIndices;
+		for (uint32_t nodeIndex : vertexPool.lineNodes) {
+			vertexIndices[nodeIndex] = GeometryVertexPool::kNoLineNode;
+		}
+		vertexPool.lineNodes.clear();
+		vertexIndices.resize(nodes.size(), GeometryVertexPool::kNoLineNode);
+		pool.Clear();
+		vertexPool.pool = &pool;
+		for (OsmHandle handle : handles) {
+			ForEachLineNode(*this, handle, [&](uint32_t nodeIndex) {
+				if (vertexIndices[nodeIndex] != GeometryVertexPool::kNoLineNode) {
+					return;
+				}
+				vertexPool.lineNodes.push_back(nodeIndex);
+				LatLong globalPosition = nodes[nodeIndex].coordinate.ToLatLong();
+				VECTOR2D localPosition = GetLocalPosition(globalPosition, lowerCorner, upperCorner);
+				if (clip != nullptr && (localPosition.X < clip->low.X || localPosition.X > clip->high.X || localPosition.Y < clip->low.Y || localPosition.Y > clip->high.Y)) {
+					vertexIndices[nodeIndex] = GeometryVertexPool::kOutsideClip;
+					return;
+				}
+				vertexIndices[nodeIndex] = static_cast<uint32_t>(SIZE(pool.nodeIds));
+				ADD(pool.nodeIds, static_cast<int64_t>(nodes[nodeIndex].id));
+				ADD(pool.latitudes, globalPosition.latitude);
+				ADD(pool.longitudes, globalPosition.longitude);
+				ADD(pool.localX, localPosition.X);
+				ADD(pool.localY, localPosition.Y);
+				ADD(pool.lineCounts, 0u);
+			});
 		}
 	}
 }
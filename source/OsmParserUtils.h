@@ -1,67 +1,312 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 #include "LatLong.h"
-#include "tinyxml2.h"
+#include "MemoryArena.h"
+#include "OsmIdIndex.h"
+#include "TagDictionary.h"
 #include "type_defines.h"
 
-#include <string>
-
 struct FMapGeometry;
+struct FVertexPool;
+class MappedFile;
 
 namespace Osm {
 
-struct OsmWay;
-struct MultigonCache {
-	MultigonCache() {}
-	ARRAY<std::pair<OsmWay*, bool>> outerSegments; // Holds the IDs of outer ways
-	ARRAY<OsmWay*> innerSegments; // Holds the IDs of inner ways
+// OSM coordinates are integer multiples of 1e-7 degrees, nodes keep them in that form and only convert them to a
+// LatLong when geometry is created. Dividing the exact integer gives the same double as parsing the decimal text.
+struct FixedLatLong {
+	static constexpr double kScale = 1e7;
+	FixedLatLong() {}
+	FixedLatLong(int32_t latitude, int32_t longitude) : latitude(latitude), longitude(longitude) {}
+	static FixedLatLong FromLatLong(const LatLong& coordinate);
+	LatLong ToLatLong() const { return LatLong(latitude / kScale, longitude / kScale); }
+	bool operator==(const FixedLatLong& other) const { return latitude == other.latitude && longitude == other.longitude; }
+	bool operator!=(const FixedLatLong& other) const { return !(*this == other); }
+	int32_t latitude = 0;
+	int32_t longitude = 0;
+};
+
+// Bounding box of entities in fixed-point degrees. A default constructed box is empty and contains nothing.
+struct FixedBounds {
+	FixedLatLong low = FixedLatLong(INT32_MAX, INT32_MAX);
+	FixedLatLong high = FixedLatLong(INT32_MIN, INT32_MIN);
+	bool IsEmpty() const { return low.latitude > high.latitude; }
+	void Extend(const FixedLatLong& coordinate);
+	void Extend(const FixedBounds& other);
+	bool Intersects(const FixedBounds& other) const;
+};
+
+// Parses decimal degrees such as "-47.4953746" into 1e-7 degree units, further decimals are rounded. Fails on
+// anything but plain decimal notation and on values outside [-180, 180].
+bool ParseFixedDegrees(std::string_view text, int32_t& value);
+
+// The values match the member types of the PBF format
+enum class OsmMemberType : uint8_t {
+	Node = 0,
+	Way = 1,
+	Relation = 2
 };
 
+// Refers to an entity of an OsmCache by its type and its index in the array of that type. Indices stay valid while
+// entities are added, an entity replaced by one with the same id keeps its index.
+struct OsmHandle {
+	OsmMemberType type = OsmMemberType::Node;
+	uint32_t index = OsmIdIndex::kInvalidIndex;
+	bool IsValid() const { return index != OsmIdIndex::kInvalidIndex; }
+};
+
+struct OsmMember {
+	OsmHandle handle;
+	uint32_t role; // Id of the global TagDictionary
+};
+
+// A relation member as read, before the entity it refers to is looked up
+struct OsmMemberReference {
+	OsmMemberType type;
+	uint64_t id;
+	uint32_t role;
+};
+
+// A way of a multipolygon ring. The ways of a ring follow each other, reversed ones are walked from their last node.
+struct OsmRingSegment {
+	uint32_t wayIndex;
+	bool isReversed;
+};
+
+// Consecutive segments of OsmRelation::ringSegments. A ring is open if ways of it are missing from the input. The
+// holes of an outer ring are consecutive inner rings of OsmRelation::rings.
+struct OsmRing {
+	uint32_t firstSegment;
+	uint32_t segmentCount;
+	uint32_t firstInnerRing;
+	uint32_t innerRingCount;
+};
+
+// Entities are plain values in the typed arrays of an OsmCache, without virtual functions. Everything they point to
+// is in the arena of the cache.
 struct OsmComponent {
-	std::unordered_map<std::string, std::string> tags;
-	void AddTags(tinyxml2::XMLElement* source);
+	uint64_t id = 0;
+	const OsmTag* tags = nullptr; // Sorted by key, ids of the global TagDictionary
+	uint32_t tagCount = 0;
+	// Copies the tags into the arena sorted by key, of repeated keys the last one wins
+	void SetTags(const OsmTag* newTags, size_t count, MemoryArena& arena);
+	const OsmTag* FindTag(uint32_t key) const;
+	bool HasTag(uint32_t key) const { return FindTag(key) != nullptr; }
+	// Empty if the tag is missing, the view is null-terminated
+	std::string_view GetTagValue(uint32_t key) const;
 	bool IsPath() const;
 	bool IsBuilding() const;
 	bool IsLandUse() const;
-	uint64_t id = 0;
-	virtual FMapGeometry* CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const = 0;
-	virtual ~OsmComponent() = default;
 };
 
 struct OsmNode : public OsmComponent {
 	OsmNode() {}
-	OsmNode(const LatLong& c) { coordinate = c; }
-	LatLong coordinate;
-	FMapGeometry* CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const override;
+	OsmNode(const FixedLatLong& c) : coordinate(c) {}
+	FixedLatLong coordinate;
 };
 
 struct OsmWay : public OsmComponent {
-	OsmWay() {}
-	OsmWay(const ARRAY<OsmNode*>& n) { nodes = n; }
-	uint64_t GetStartNodeId() const;
-	uint64_t GetEndNodeId() const;
-	ARRAY<OsmNode*> nodes;
-	FMapGeometry* CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const override;
+	const uint32_t* nodeIndices = nullptr; // Into OsmCache::nodes
+	uint32_t nodeCount = 0;
+	void SetNodes(const uint32_t* newNodeIndices, size_t count, MemoryArena& arena);
 };
 
 struct OsmRelation : public OsmComponent {
-	ARRAY<std::pair<OsmComponent*, std::string>> relations;
-	FMapGeometry* CreateGeometry(LatLong lowerCorner, LatLong upperCorner) const override;
-	void AddRelation(OsmComponent* component, const std::string role);
-	void PrecomputeMultigonRelations();
+	OsmMember* members = nullptr;
+	uint32_t memberCount = 0;
+	// Has members in the outer or inner role
 	bool isMultigon = false;
-	MultigonCache multigonCache;
+	// The rings of a multigon, chained from its outer and inner ways once all members are known. The outer rings come
+	// first, then the inner rings grouped by the outer ring they are in. Inner rings outside of every outer ring are
+	// left out.
+	const OsmRingSegment* ringSegments = nullptr;
+	const OsmRing* rings = nullptr;
+	uint32_t ringSegmentCount = 0;
+	uint32_t outerRingCount = 0;
+	uint32_t innerRingCount = 0;
 };
 
-typedef std::unordered_map<uint64_t, OsmComponent*> OsmItemsCache;
+// Rectangle created geometry is cut to, in the tile coordinates of FCoordinate::localPosition where the tile is
+// [0, 1] on both axes. Areas keep the part of their rings inside, closed along the border, lines are cut into pieces.
+struct GeometryClip {
+	VECTOR2D low;
+	VECTOR2D high;
+	bool isArea = false;
+};
+
+// The vertex pool of a tile with the lookup from the nodes of the cache to its vertices. Geometry created with it takes
+// the positions of its nodes from the pool instead of projecting them again and refers to their vertices.
+struct GeometryVertexPool {
+	// Lookup entries of the nodes in no line of the tile and of the ones outside of the clip
+	static constexpr uint32_t kNoLineNode = 0xFFFFFFFF;
+	static constexpr uint32_t kOutsideClip = 0xFFFFFFFE;
+	const FVertexPool* pool = nullptr;
+	// By node index in the cache. It is sized to the cache once, after that CreateVertexPool() only resets the entries
+	// it set before, so that one lookup serves many tiles one after the other.
+	std::vector<uint32_t> vertexIndices;
+	std::vector<uint32_t> lineNodes; // The nodes whose entries are set
+};
+
+// Decides which tags the readers keep. A tag is dropped by its key before its value reaches the dictionary, so dropped
+// tags cost one lookup and no memory.
+class OsmTagFilter {
+public:
+	// Keeps every tag
+	OsmTagFilter() {}
+	// Keeps the tags with the given keys. With isFeatureOnly, entities that have none of the tags paths, buildings or
+	// landuse areas are made from keep no tags at all.
+	OsmTagFilter(const std::vector<std::string_view>& keys, bool isFeatureOnly);
+
+	bool IsKeepingAll() const { return _isKeepingAll; }
+	// Key ids of keys that were never interned are kInvalidId, they are never kept
+	bool IsKeyKept(uint32_t key) const { return _isKeepingAll || (key < _isKeyKept.size() && _isKeyKept[key]); }
+	// Whether the kept tags of an entity are stored
+	bool AreTagsKept(const OsmTag* tags, size_t count) const;
+
+private:
+	std::vector<bool> _isKeyKept;
+	bool _isKeepingAll = true;
+	bool _isFeatureOnly = false;
+};
+
+// A relation member that referred to an entity the reader had not seen yet
+struct OsmPendingMember {
+	OsmMember* member;
+	uint32_t relationIndex;
+	uint64_t id;
+};
+
+// The entities of one type that refer to each entity of another, e.g. the ways of each node, as lists in one array.
+// Lists keep the entities that were replaced since and may no longer refer, so users check the entities they find.
+class OsmReverseIndex {
+public:
+	static constexpr uint32_t kNoEntry = 0xFFFFFFFF;
+	void Clear();
+	// Adds the source to the list of the target unless it is in it already
+	void Add(uint32_t target, uint32_t source);
+	template<typename Function>
+	void ForEach(uint32_t target, const Function& function) const {
+		for (uint32_t entry = target < _firstEntries.size() ? _firstEntries[target] : kNoEntry; entry != kNoEntry; entry = _entries[entry].next) {
+			function(_entries[entry].source);
+		}
+	}
 
+private:
+	struct Entry {
+		uint32_t source;
+		uint32_t next;
+	};
+	std::vector<uint32_t> _firstEntries; // By target
+	std::vector<Entry> _entries;
+};
+
+enum class OsmChangeAction : uint8_t {
+	Create,
+	Modify,
+	Delete
+};
+
+// An entity of an OsmChange document as read. It refers to nodes and members by id, they are looked up when the change
+// is applied.
+struct OsmChangeEntity {
+	OsmChangeAction action;
+	OsmMemberType type;
+	uint64_t id;
+	FixedLatLong coordinate; // Nodes only
+	uint32_t firstTag; // Into OsmChange::tags
+	uint32_t tagCount;
+	uint32_t firstReference; // Into OsmChange::nodeIds for ways and OsmChange::members for relations
+	uint32_t referenceCount;
+};
+
+// The entities of an OsmChange document in document order. The whole document is read before any of it is applied,
+// so a malformed one leaves the cache as it was.
+struct OsmChange {
+	std::vector<OsmChangeEntity> entities;
+	std::vector<OsmTag> tags;
+	std::vector<uint64_t> nodeIds;
+	std::vector<OsmMemberReference> members;
+	void Clear();
+};
+
+// Entities in the order they were read, in one array per type with an id index each. Adding an entity whose id is
+// already present replaces the earlier one in place. The arena owns the tags, node indices and members of the
+// entities, including the ones of entities that were replaced or never added because the input turned out to be
+// invalid.
 struct OsmCache {
-	OsmItemsCache nodes;
-	OsmItemsCache ways;
-	OsmItemsCache relations;
+	ARRAY<OsmNode> nodes;
+	ARRAY<OsmWay> ways;
+	ARRAY<OsmRelation> relations;
+	OsmIdIndex nodeIndex;
+	OsmIdIndex wayIndex;
+	OsmIdIndex relationIndex;
+	// Members added before the entity they refer to, ResolveMembers() fills them in
+	std::vector<OsmPendingMember> pendingMembers;
+	// Members of relations added by ApplyChange whose entity is not in the cache. They stay in their relation without an
+	// entity, which every user of the members skips, until a change adds it.
+	std::vector<OsmPendingMember> unresolvedMembers;
+	// The ways of each node and the relations of each member, so that ApplyChange finds what depends on the entities it
+	// changes by lookups. Built by the first ApplyChange and kept up to date by it.
+	OsmReverseIndex nodeWays;
+	OsmReverseIndex nodeRelations;
+	OsmReverseIndex wayRelations;
+	OsmReverseIndex relationRelations;
+	bool isReverseIndexBuilt = false;
+	// The relations ApplyChange has marked as depending on the change, by relation index. An entry is marked if it holds
+	// the generation of the change, so a change does not clear the array.
+	std::vector<uint32_t> relationMarks;
+	uint32_t relationMarkGeneration = 0;
+	MemoryArena arena;
+	// The snapshot file the cache was loaded from, if any. It holds tags, node indices and multipolygon rings of the
+	// entities, so it stays mapped until the cache is cleared.
+	std::shared_ptr<const MappedFile> snapshot;
+
+	// Sizes the arrays and indexes up front, e.g. when the entity counts of the input are known
+	void Reserve(size_t nodeCount, size_t wayCount, size_t relationCount);
+	// Drops all entities, the arrays, indexes and arena keep their memory for the next input
+	void Clear();
+	// Drops all entities and returns all memory to the heap
+	void Release();
+	// Return the index of the entity in its array
+	uint32_t AddNode(const OsmNode& node);
+	uint32_t AddWay(const OsmWay& way);
+	// Looks up the members, the ones whose entity was not read yet are left for ResolveMembers()
+	uint32_t AddRelation(const OsmRelation& relation, const OsmMemberReference* members, size_t memberCount);
+	// The pointers are valid until the next entity is added
+	const OsmNode* FindNode(uint64_t id) const;
+	const OsmWay* FindWay(uint64_t id) const;
+	const OsmRelation* FindRelation(uint64_t id) const;
+	// Invalid if the entity is not in the cache
+	OsmHandle FindMember(OsmMemberType type, uint64_t id) const;
+	const OsmComponent& GetComponent(OsmHandle handle) const;
+	// Called once the whole input is read. Fills in the members that referred ahead, drops the ones whose entity is
+	// not in the input and the ones that would close a cycle of relations, then prepares the multipolygons.
+	void ResolveMembers();
+	// Applies a change read from an OsmChange document, in document order. Deleted entities stay in their arrays without
+	// tags, nodes or members, so handles to them stay valid. Appends the bounding boxes of the features the change
+	// touched, both before and after it, including the ways and relations whose nodes or members changed. Output
+	// built from the cache only differs from the one built before the change where these boxes are. Only the
+	// multipolygons among these relations are chained again. Members whose entity is missing are kept for a later
+	// change that adds it.
+	void ApplyChange(const OsmChange& change, std::vector<FixedBounds>& dirtyBounds);
+	// Bounding box of the nodes of the entity, of relations the one of all their members. Empty if it has no nodes.
+	FixedBounds GetBounds(OsmHandle handle) const;
+	// Geometry of the entity in the coordinates of the tile between the corners, made in the arena. Only reads the
+	// cache, so threads may create geometry at the same time. With a clip, geometry entirely outside of it is null and
+	// a line cut into several pieces is a composite of them.
+	FMapGeometry* CreateGeometry(OsmHandle handle, LatLong lowerCorner, LatLong upperCorner, MemoryArena& arena, const GeometryClip* clip = nullptr,
+		const GeometryVertexPool* vertexPool = nullptr) const;
+	// Fills the pool with the nodes the lines of the entities are made of, each one once, in the order the lines reach
+	// them and in the coordinates of the tile between the corners. With a clip only the nodes inside of it, the others do not
+	// remain in clipped lines. The line counts of the vertices are left at zero. Costs as much as the lines, the
+	// lookup of vertexPool is only sized to the cache the first time.
+	void CreateVertexPool(const std::vector<OsmHandle>& handles, LatLong lowerCorner, LatLong upperCorner, const GeometryClip* clip, FVertexPool& pool,
+		GeometryVertexPool& vertexPool) const;
 };
-}
\ No newline at end of file
+}
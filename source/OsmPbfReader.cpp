@@ -0,0 +1,599 @@
+#include "OsmPbfReader.h"
+
+#include "OsmParserUtils.h"
+#include "ProtobufReader.h"
+#include "ThreadUtils.h"
+#include "ZlibUtils.h"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace Osm {
+
+	// Limits from the PBF specification
+	static constexpr size_t kMaxBlobHeaderSize = 64 * 1024;
+	static constexpr size_t kMaxBlobSize = 32 * 1024 * 1024;
+	static constexpr size_t kBlobsPerThreadInBatch = 4;
+	// Marks strings not looked up yet, kInvalidId is the result of looking up a key that was never interned
+	static constexpr uint32_t kUnresolvedId = TagDictionary::kInvalidId - 1;
+
+	enum class PbfGroupType : uint8_t {
+		Nodes,
+		Ways,
+		Relations
+	};
+
+	struct PbfBlobReference {
+		std::string_view blob;
+		bool isHeader;
+	};
+
+	// One decoded blob. Entities are kept in the order of their primitive groups, strings point either into the input
+	// or into the uncompressed buffer of the block.
+	struct PbfBlock {
+		struct Group {
+			PbfGroupType type;
+			uint32_t begin;
+			uint32_t count;
+		};
+		struct Node {
+			uint64_t id;
+			FixedLatLong coordinate;
+			uint32_t firstTag;
+			uint32_t tagCount;
+		};
+		struct Way {
+			uint64_t id;
+			uint32_t firstTag;
+			uint32_t tagCount;
+			uint32_t firstRef;
+			uint32_t refCount;
+		};
+		struct Member {
+			uint64_t id;
+			uint32_t role; // Index into the string table while decoding, then an id of the tag dictionary
+			OsmMemberType type;
+		};
+		struct Relation {
+			uint64_t id;
+			uint32_t firstTag;
+			uint32_t tagCount;
+			uint32_t firstMember;
+			uint32_t memberCount;
+		};
+
+		void Clear() {
+			uncompressed.clear();
+			strings.clear();
+			groups.clear();
+			nodes.clear();
+			ways.clear();
+			relations.clear();
+			tags.clear();
+			keyIds.clear();
+			stringIds.clear();
+			refs.clear();
+			members.clear();
+		}
+
+		std::vector<uint8_t> uncompressed;
+		std::vector<std::string_view> strings;
+		std::vector<Group> groups;
+		std::vector<Node> nodes;
+		std::vector<Way> ways;
+		std::vector<Relation> relations;
+		std::vector<OsmTag> tags; // Indices into the string table while decoding, then ids of the tag dictionary
+		std::vector<uint32_t> keyIds; // Dictionary ids of the strings used as keys, once looked up
+		std::vector<uint32_t> stringIds; // Dictionary ids of the strings used as values, once interned
+		std::vector<uint64_t> refs;
+		std::vector<Member> members;
+		bool isValid = false;
+	};
+
+	struct PbfCoordinateTransform {
+		static constexpr int64_t kNanodegreesPerFixed = 100;
+		static constexpr int64_t kMaxNanodegrees = 180LL * 1000000000LL;
+		int64_t granularity = 100;
+		int64_t latitudeOffset = 0;
+		int64_t longitudeOffset = 0;
+
+		bool IsValid() const {
+			return granularity > 0 && granularity <= 1000000000 &&
+				latitudeOffset >= -kMaxNanodegrees && latitudeOffset <= kMaxNanodegrees &&
+				longitudeOffset >= -kMaxNanodegrees && longitudeOffset <= kMaxNanodegrees;
+		}
+
+		// Coordinates are stored in nanodegrees, rounded to the 1e-7 degrees of the node store
+		static bool ToFixed(int64_t offset, int64_t granularity, int64_t value, int32_t& fixed) {
+			if (value > 2 * kMaxNanodegrees / granularity || value < -2 * kMaxNanodegrees / granularity) {
+				return false;
+			}
+			int64_t nanodegrees = offset + granularity * value;
+			if (nanodegrees > kMaxNanodegrees || nanodegrees < -kMaxNanodegrees) {
+				return false;
+			}
+			int64_t half = nanodegrees < 0 ? -kNanodegreesPerFixed / 2 : kNanodegreesPerFixed / 2;
+			fixed = static_cast<int32_t>((nanodegrees + half) / kNanodegreesPerFixed);
+			return true;
+		}
+
+		bool ToFixedLatLong(int64_t latitude, int64_t longitude, FixedLatLong& coordinate) const {
+			return ToFixed(latitudeOffset, granularity, latitude, coordinate.latitude) &&
+				ToFixed(longitudeOffset, granularity, longitude, coordinate.longitude);
+		}
+	};
+
+	static bool ReadTags(ProtobufReader keys, ProtobufReader values, PbfBlock& block, uint32_t& tagCount) {
+		tagCount = 0;
+		while (!keys.IsAtEnd() && !values.IsAtEnd()) {
+			uint32_t key = static_cast<uint32_t>(keys.ReadRawVarint());
+			uint32_t value = static_cast<uint32_t>(values.ReadRawVarint());
+			if (key >= block.strings.size() || value >= block.strings.size()) {
+				return false;
+			}
+			block.tags.push_back({ key, value });
+			++tagCount;
+		}
+		return !keys.HasError() && !values.HasError() && keys.IsAtEnd() == values.IsAtEnd();
+	}
+
+	static bool DecodeNode(ProtobufReader reader, const PbfCoordinateTransform& transform, PbfBlock& block) {
+		PbfBlock::Node node = {};
+		int64_t latitude = 0;
+		int64_t longitude = 0;
+		ProtobufReader keys;
+		ProtobufReader values;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: node.id = static_cast<uint64_t>(reader.ReadSignedInt64()); break;
+			case 2: keys = reader.ReadPacked(); break;
+			case 3: values = reader.ReadPacked(); break;
+			case 8: latitude = reader.ReadSignedInt64(); break;
+			case 9: longitude = reader.ReadSignedInt64(); break;
+			default: reader.Skip(); break;
+			}
+		}
+		node.firstTag = static_cast<uint32_t>(block.tags.size());
+		if (reader.HasError() || !transform.ToFixedLatLong(latitude, longitude, node.coordinate) || !ReadTags(keys, values, block, node.tagCount)) {
+			return false;
+		}
+		block.nodes.push_back(node);
+		return true;
+	}
+
+	static bool DecodeDenseNodes(ProtobufReader reader, const PbfCoordinateTransform& transform, PbfBlock& block) {
+		ProtobufReader ids;
+		ProtobufReader latitudes;
+		ProtobufReader longitudes;
+		ProtobufReader keysAndValues;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: ids = reader.ReadPacked(); break;
+			case 8: latitudes = reader.ReadPacked(); break;
+			case 9: longitudes = reader.ReadPacked(); break;
+			case 10: keysAndValues = reader.ReadPacked(); break;
+			default: reader.Skip(); break;
+			}
+		}
+		if (reader.HasError()) {
+			return false;
+		}
+
+		// Ids and coordinates are delta coded, tags are a flat list of key, value pairs closed by a 0 for each node
+		int64_t id = 0;
+		int64_t latitude = 0;
+		int64_t longitude = 0;
+		while (!ids.IsAtEnd()) {
+			id += ids.ReadRawSignedVarint();
+			latitude += latitudes.ReadRawSignedVarint();
+			longitude += longitudes.ReadRawSignedVarint();
+
+			PbfBlock::Node node = {};
+			node.id = static_cast<uint64_t>(id);
+			if (!transform.ToFixedLatLong(latitude, longitude, node.coordinate)) {
+				return false;
+			}
+			node.firstTag = static_cast<uint32_t>(block.tags.size());
+			while (!keysAndValues.IsAtEnd()) {
+				uint32_t key = static_cast<uint32_t>(keysAndValues.ReadRawVarint());
+				if (key == 0) {
+					break;
+				}
+				uint32_t value = static_cast<uint32_t>(keysAndValues.ReadRawVarint());
+				if (key >= block.strings.size() || value >= block.strings.size()) {
+					return false;
+				}
+				block.tags.push_back({ key, value });
+				++node.tagCount;
+			}
+			block.nodes.push_back(node);
+		}
+		return !ids.HasError() && !latitudes.HasError() && !longitudes.HasError() && !keysAndValues.HasError();
+	}
+
+	static bool DecodeWay(ProtobufReader reader, PbfBlock& block) {
+		PbfBlock::Way way = {};
+		ProtobufReader keys;
+		ProtobufReader values;
+		ProtobufReader refs;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: way.id = static_cast<uint64_t>(reader.ReadInt64()); break;
+			case 2: keys = reader.ReadPacked(); break;
+			case 3: values = reader.ReadPacked(); break;
+			case 8: refs = reader.ReadPacked(); break;
+			default: reader.Skip(); break;
+			}
+		}
+		way.firstTag = static_cast<uint32_t>(block.tags.size());
+		if (reader.HasError() || !ReadTags(keys, values, block, way.tagCount)) {
+			return false;
+		}
+
+		way.firstRef = static_cast<uint32_t>(block.refs.size());
+		int64_t nodeId = 0;
+		while (!refs.IsAtEnd()) {
+			nodeId += refs.ReadRawSignedVarint();
+			block.refs.push_back(static_cast<uint64_t>(nodeId));
+		}
+		way.refCount = static_cast<uint32_t>(block.refs.size() - way.firstRef);
+		block.ways.push_back(way);
+		return !refs.HasError();
+	}
+
+	static bool DecodeRelation(ProtobufReader reader, PbfBlock& block) {
+		PbfBlock::Relation relation = {};
+		ProtobufReader keys;
+		ProtobufReader values;
+		ProtobufReader roles;
+		ProtobufReader memberIds;
+		ProtobufReader types;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: relation.id = static_cast<uint64_t>(reader.ReadInt64()); break;
+			case 2: keys = reader.ReadPacked(); break;
+			case 3: values = reader.ReadPacked(); break;
+			case 8: roles = reader.ReadPacked(); break;
+			case 9: memberIds = reader.ReadPacked(); break;
+			case 10: types = reader.ReadPacked(); break;
+			default: reader.Skip(); break;
+			}
+		}
+		relation.firstTag = static_cast<uint32_t>(block.tags.size());
+		if (reader.HasError() || !ReadTags(keys, values, block, relation.tagCount)) {
+			return false;
+		}
+
+		relation.firstMember = static_cast<uint32_t>(block.members.size());
+		int64_t memberId = 0;
+		while (!memberIds.IsAtEnd()) {
+			memberId += memberIds.ReadRawSignedVarint();
+			PbfBlock::Member member;
+			member.id = static_cast<uint64_t>(memberId);
+			member.role = static_cast<uint32_t>(roles.ReadRawVarint());
+			uint64_t type = types.ReadRawVarint();
+			if (member.role >= block.strings.size() || type > static_cast<uint64_t>(OsmMemberType::Relation)) {
+				return false;
+			}
+			member.type = static_cast<OsmMemberType>(type);
+			block.members.push_back(member);
+		}
+		relation.memberCount = static_cast<uint32_t>(block.members.size() - relation.firstMember);
+		block.relations.push_back(relation);
+		return !memberIds.HasError() && !roles.HasError() && !types.HasError();
+	}
+
+	static bool DecodePrimitiveGroup(ProtobufReader reader, const PbfCoordinateTransform& transform, PbfBlock& block) {
+		while (reader.Next()) {
+			bool isValid = true;
+			switch (reader.GetFieldNumber()) {
+			case 1: isValid = DecodeNode(reader.ReadMessage(), transform, block); break;
+			case 2: isValid = DecodeDenseNodes(reader.ReadMessage(), transform, block); break;
+			case 3: isValid = DecodeWay(reader.ReadMessage(), block); break;
+			case 4: isValid = DecodeRelation(reader.ReadMessage(), block); break;
+			default: reader.Skip(); break;
+			}
+			if (!isValid) {
+				return false;
+			}
+		}
+		return !reader.HasError();
+	}
+
+	static uint32_t GetStringId(std::vector<uint32_t>& ids, const PbfBlock& block, uint32_t stringIndex, bool isInterning, TagDictionary& dictionary) {
+		uint32_t& id = ids[stringIndex];
+		if (id == kUnresolvedId) {
+			id = isInterning ? dictionary.Intern(block.strings[stringIndex]) : dictionary.Find(block.strings[stringIndex]);
+		}
+		return id;
+	}
+
+	// Replaces the string table indices of the tags and member roles with dictionary ids, looking up every string of
+	// the block once, and drops the tags the filter does not keep. Entities are visited in decoding order, their tag
+	// ranges are in the same order, so the kept tags can be moved to the front in place.
+	static void InternStrings(PbfBlock& block, const OsmTagFilter& tagFilter) {
+		TagDictionary& dictionary = GetTagDictionary();
+		block.keyIds.assign(block.strings.size(), kUnresolvedId);
+		block.stringIds.assign(block.strings.size(), kUnresolvedId);
+		uint32_t keptCount = 0;
+		auto filterTags = [&](uint32_t& firstTag, uint32_t& tagCount) {
+			uint32_t keptBegin = keptCount;
+			for (uint32_t i = firstTag; i < firstTag + tagCount; ++i) {
+				OsmTag tag = block.tags[i];
+				uint32_t key = GetStringId(block.keyIds, block, tag.key, tagFilter.IsKeepingAll(), dictionary);
+				if (tagFilter.IsKeyKept(key)) {
+					block.tags[keptCount++] = { key, GetStringId(block.stringIds, block, tag.value, true, dictionary) };
+				}
+			}
+			if (!tagFilter.AreTagsKept(block.tags.data() + keptBegin, keptCount - keptBegin)) {
+				keptCount = keptBegin;
+			}
+			firstTag = keptBegin;
+			tagCount = keptCount - keptBegin;
+		};
+		for (const PbfBlock::Group& group : block.groups) {
+			for (uint32_t i = group.begin; i < group.begin + group.count; ++i) {
+				if (group.type == PbfGroupType::Nodes) {
+					filterTags(block.nodes[i].firstTag, block.nodes[i].tagCount);
+				}
+				else if (group.type == PbfGroupType::Ways) {
+					filterTags(block.ways[i].firstTag, block.ways[i].tagCount);
+				}
+				else {
+					filterTags(block.relations[i].firstTag, block.relations[i].tagCount);
+				}
+			}
+		}
+		block.tags.resize(keptCount);
+		for (PbfBlock::Member& member : block.members) {
+			member.role = GetStringId(block.stringIds, block, member.role, true, dictionary);
+		}
+	}
+
+	static bool DecodePrimitiveBlock(ProtobufReader reader, const OsmTagFilter& tagFilter, PbfBlock& block) {
+		// The coordinate fields follow the groups in the encoding, so the groups are only decoded once all are known
+		std::vector<std::string_view> groups;
+		PbfCoordinateTransform transform;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: {
+				ProtobufReader stringTable = reader.ReadMessage();
+				while (stringTable.Next()) {
+					if (stringTable.GetFieldNumber() == 1) {
+						block.strings.push_back(stringTable.ReadBytes());
+					}
+					else {
+						stringTable.Skip();
+					}
+				}
+				if (stringTable.HasError()) {
+					return false;
+				}
+				break;
+			}
+			case 2: groups.push_back(reader.ReadBytes()); break;
+			case 17: transform.granularity = reader.ReadInt64(); break;
+			case 19: transform.latitudeOffset = reader.ReadInt64(); break;
+			case 20: transform.longitudeOffset = reader.ReadInt64(); break;
+			default: reader.Skip(); break;
+			}
+		}
+		if (reader.HasError() || !transform.IsValid()) {
+			return false;
+		}
+
+		for (std::string_view group : groups) {
+			size_t nodeCount = block.nodes.size();
+			size_t wayCount = block.ways.size();
+			size_t relationCount = block.relations.size();
+			if (!DecodePrimitiveGroup(ProtobufReader(group), transform, block)) {
+				return false;
+			}
+			// A group only holds one kind of entity
+			if (block.nodes.size() > nodeCount) {
+				block.groups.push_back({ PbfGroupType::Nodes, static_cast<uint32_t>(nodeCount), static_cast<uint32_t>(block.nodes.size() - nodeCount) });
+			}
+			if (block.ways.size() > wayCount) {
+				block.groups.push_back({ PbfGroupType::Ways, static_cast<uint32_t>(wayCount), static_cast<uint32_t>(block.ways.size() - wayCount) });
+			}
+			if (block.relations.size() > relationCount) {
+				block.groups.push_back({ PbfGroupType::Relations, static_cast<uint32_t>(relationCount), static_cast<uint32_t>(block.relations.size() - relationCount) });
+			}
+		}
+		// Blocks are decoded in parallel, so this is where the dictionary lookups are cheapest
+		InternStrings(block, tagFilter);
+		return true;
+	}
+
+	static bool DecodeHeaderBlock(ProtobufReader reader) {
+		while (reader.Next()) {
+			if (reader.GetFieldNumber() == 4) {
+				std::string_view feature = reader.ReadBytes();
+				if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+					return false; // e.g. HistoricalInformation, which the cache can not represent
+				}
+			}
+			else {
+				reader.Skip();
+			}
+		}
+		return !reader.HasError();
+	}
+
+	static bool DecodeBlob(const PbfBlobReference& reference, const OsmTagFilter& tagFilter, PbfBlock& block) {
+		ProtobufReader reader(reference.blob);
+		std::string_view raw;
+		std::string_view zlibData;
+		uint64_t rawSize = 0;
+		bool hasData = false;
+		while (reader.Next()) {
+			switch (reader.GetFieldNumber()) {
+			case 1: raw = reader.ReadBytes(); hasData = true; break;
+			case 2: rawSize = reader.ReadVarint(); break;
+			case 3: zlibData = reader.ReadBytes(); hasData = true; break;
+			case 4: // LZMA
+			case 5: // Bzip2, obsolete
+			case 6: // LZ4
+			case 7: // Zstandard
+				return false;
+			default: reader.Skip(); break;
+			}
+		}
+		if (reader.HasError() || !hasData) {
+			return false;
+		}
+
+		std::string_view payload = raw;
+		if (payload.empty() && !zlibData.empty()) {
+			if (rawSize == 0 || rawSize > kMaxBlobSize) {
+				return false;
+			}
+			block.uncompressed.resize(static_cast<size_t>(rawSize));
+			if (!ZlibUtils::Uncompress(reinterpret_cast<const uint8_t*>(zlibData.data()), zlibData.size(), block.uncompressed.data(), block.uncompressed.size())) {
+				return false;
+			}
+			payload = std::string_view(reinterpret_cast<const char*>(block.uncompressed.data()), block.uncompressed.size());
+		}
+
+		return reference.isHeader ? DecodeHeaderBlock(ProtobufReader(payload)) : DecodePrimitiveBlock(ProtobufReader(payload), tagFilter, block);
+	}
+
+	static void AddBlockToCache(const PbfBlock& block, OsmCache& osmCache) {
+		osmCache.Reserve(SIZE(osmCache.nodes) + block.nodes.size(), SIZE(osmCache.ways) + block.ways.size(),
+			SIZE(osmCache.relations) + block.relations.size());
+		std::vector<uint32_t> nodeIndices;
+		std::vector<OsmMemberReference> members;
+		for (const PbfBlock::Group& group : block.groups) {
+			for (uint32_t i = group.begin; i < group.begin + group.count; ++i) {
+				if (group.type == PbfGroupType::Nodes) {
+					const PbfBlock::Node& node = block.nodes[i];
+					OsmNode currentNode(node.coordinate);
+					currentNode.id = node.id;
+					currentNode.SetTags(block.tags.data() + node.firstTag, node.tagCount, osmCache.arena);
+					osmCache.AddNode(currentNode);
+				}
+				else if (group.type == PbfGroupType::Ways) {
+					const PbfBlock::Way& way = block.ways[i];
+					OsmWay currentWay;
+					currentWay.id = way.id;
+					nodeIndices.clear();
+					for (uint32_t ref = way.firstRef; ref < way.firstRef + way.refCount; ++ref) {
+						uint32_t nodeIndex = osmCache.nodeIndex.Find(block.refs[ref]);
+						if (nodeIndex != OsmIdIndex::kInvalidIndex) {
+							nodeIndices.push_back(nodeIndex);
+						}
+					}
+					currentWay.SetNodes(nodeIndices.data(), nodeIndices.size(), osmCache.arena);
+					currentWay.SetTags(block.tags.data() + way.firstTag, way.tagCount, osmCache.arena);
+					osmCache.AddWay(currentWay);
+				}
+				else {
+					const PbfBlock::Relation& relation = block.relations[i];
+					OsmRelation currentRelation;
+					currentRelation.id = relation.id;
+					members.clear();
+					for (uint32_t memberIndex = relation.firstMember; memberIndex < relation.firstMember + relation.memberCount; ++memberIndex) {
+						const PbfBlock::Member& member = block.members[memberIndex];
+						members.push_back({ member.type, member.id, member.role });
+					}
+					currentRelation.SetTags(block.tags.data() + relation.firstTag, relation.tagCount, osmCache.arena);
+					osmCache.AddRelation(currentRelation, members.data(), members.size());
+				}
+			}
+		}
+	}
+
+	bool ReadOsmPbfCache(const char* data, size_t size, OsmCache& osmCache, int32_t threadCount) {
+		return ReadOsmPbfCache(data, size, osmCache, OsmTagFilter(), threadCount);
+	}
+
+	bool ReadOsmPbfCache(const char* data, size_t size, OsmCache& osmCache, const OsmTagFilter& tagFilter, int32_t threadCount) {
+		// Split the file into blobs first, this only touches the small blob headers
+		std::vector<PbfBlobReference> blobs;
+		bool hasHeader = false;
+		size_t position = 0;
+		while (position < size) {
+			if (size - position < 4) {
+				return false;
+			}
+			const uint8_t* lengthBytes = reinterpret_cast<const uint8_t*>(data + position);
+			size_t headerSize = (static_cast<size_t>(lengthBytes[0]) << 24) | (lengthBytes[1] << 16) | (lengthBytes[2] << 8) | lengthBytes[3];
+			position += 4;
+			if (headerSize > kMaxBlobHeaderSize || headerSize > size - position) {
+				return false;
+			}
+
+			ProtobufReader header(reinterpret_cast<const uint8_t*>(data + position), headerSize);
+			std::string_view type;
+			uint64_t dataSize = 0;
+			while (header.Next()) {
+				switch (header.GetFieldNumber()) {
+				case 1: type = header.ReadBytes(); break;
+				case 3: dataSize = header.ReadVarint(); break;
+				default: header.Skip(); break;
+				}
+			}
+			position += headerSize;
+			if (header.HasError() || dataSize > kMaxBlobSize || dataSize > size - position) {
+				return false;
+			}
+
+			std::string_view blob(data + position, static_cast<size_t>(dataSize));
+			position += static_cast<size_t>(dataSize);
+			if (type == "OSMHeader") {
+				hasHeader = true;
+				blobs.push_back({ blob, true });
+			}
+			else if (type == "OSMData") {
+				blobs.push_back({ blob, false });
+			}
+		}
+		if (!hasHeader) {
+			return false;
+		}
+
+		// Decoding runs on the pool, while adding to the cache stays in file order on this thread as ways and relations
+		// look up the entities before them. The next batch is decoded while the current one is added.
+		ThreadUtils::ThreadPool pool(threadCount);
+		size_t batchCapacity = static_cast<size_t>(pool.GetThreadCount()) * kBlobsPerThreadInBatch;
+		std::vector<PbfBlock> batches[2] = { std::vector<PbfBlock>(batchCapacity), std::vector<PbfBlock>(batchCapacity) };
+		auto startDecoding = [&](size_t batchBegin, std::vector<PbfBlock>& batch) {
+			size_t batchSize = std::min(batchCapacity, blobs.size() - batchBegin);
+			if (batchSize > 0) {
+				pool.Start(batchSize, [&blobs, &batch, &tagFilter, batchBegin](size_t i) {
+					batch[i].Clear();
+					batch[i].isValid = DecodeBlob(blobs[batchBegin + i], tagFilter, batch[i]);
+				});
+			}
+			return batchSize;
+		};
+
+		size_t batchBegin = 0;
+		size_t batchSize = startDecoding(batchBegin, batches[0]);
+		pool.Wait();
+		for (size_t current = 0; batchSize > 0; current ^= 1) {
+			size_t nextBatchBegin = batchBegin + batchSize;
+			size_t nextBatchSize = startDecoding(nextBatchBegin, batches[current ^ 1]);
+
+			bool isValid = true;
+			for (size_t i = 0; i < batchSize && isValid; ++i) {
+				isValid = batches[current][i].isValid;
+				if (isValid) {
+					AddBlockToCache(batches[current][i], osmCache);
+				}
+			}
+			if (nextBatchSize > 0) {
+				pool.Wait();
+			}
+			if (!isValid) {
+				return false;
+			}
+			batchBegin = nextBatchBegin;
+			batchSize = nextBatchSize;
+		}
+		// Relations may refer to entities in later blocks
+		osmCache.ResolveMembers();
+		return true;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Osm {
+
+struct OsmCache;
+class OsmTagFilter;
+
+// Decodes an OSM PBF file (https://wiki.openstreetmap.org/wiki/PBF_Format) into the cache. Blobs are decompressed
+// and decoded in parallel, a bounded batch at a time, then added to the cache in file order, so the cache is the same
+// as the one read from the equivalent XML document. Relation members referring ahead are resolved at the end. A
+// non-positive threadCount uses one thread per core.
+bool ReadOsmPbfCache(const char* data, size_t size, OsmCache& osmCache, int32_t threadCount = 0);
+// Keeps the tags the filter decides to, tags are filtered on the decoding threads
+bool ReadOsmPbfCache(const char* data, size_t size, OsmCache& osmCache, const OsmTagFilter& tagFilter, int32_t threadCount = 0);
+
+}
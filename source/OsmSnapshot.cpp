@@ -0,0 +1,513 @@
+#include "OsmSnapshot.h"
+
+#include "MappedFile.h"
+#include "OsmParserUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Osm {
+
+	static constexpr char kSnapshotMagic[8] = { 'O', 'S', 'M', 'S', 'N', 'A', 'P', '\0' };
+	// Increase whenever a record or the meaning of a field changes
+	static constexpr uint32_t kSnapshotVersion = 3;
+	static constexpr uint32_t kByteOrderMark = 0x01020304;
+	static constexpr uint64_t kSectionAlignment = 8;
+
+	// Every section is an array of one record type, 8 byte aligned in the file
+	enum SnapshotSection : uint32_t {
+		kSectionStrings,
+		kSectionStringOffsets,
+		kSectionTags,
+		kSectionNodeIndices,
+		kSectionMembers,
+		kSectionRingSegments,
+		kSectionRings,
+		kSectionNodes,
+		kSectionWays,
+		kSectionRelations,
+		kSectionNodeSlotIds,
+		kSectionNodeSlotIndices,
+		kSectionWaySlotIds,
+		kSectionWaySlotIndices,
+		kSectionRelationSlotIds,
+		kSectionRelationSlotIndices,
+		kSectionCount
+	};
+
+	struct SnapshotNode {
+		uint64_t id;
+		uint64_t firstTag;
+		int32_t latitude;
+		int32_t longitude;
+		uint32_t tagCount;
+		uint32_t padding;
+	};
+
+	struct SnapshotWay {
+		uint64_t id;
+		uint64_t firstTag;
+		uint64_t firstNode;
+		uint32_t tagCount;
+		uint32_t nodeCount;
+	};
+
+	struct SnapshotRelation {
+		uint64_t id;
+		uint64_t firstTag;
+		uint64_t firstMember;
+		uint64_t firstSegment;
+		uint64_t firstRing;
+		uint32_t tagCount;
+		uint32_t memberCount;
+		uint32_t ringSegmentCount;
+		uint32_t outerRingCount;
+		uint32_t innerRingCount;
+		uint32_t isMultigon;
+	};
+
+	struct SnapshotMember {
+		uint32_t index;
+		uint32_t role;
+		uint32_t type;
+	};
+
+	struct SnapshotSectionRange {
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrderMark;
+		uint64_t nodeIndexSize;
+		uint64_t wayIndexSize;
+		uint64_t relationIndexSize;
+		SnapshotSectionRange sections[kSectionCount];
+	};
+
+	// Tags and rings are used in place, so their records are the structs of the cache
+	static_assert(sizeof(OsmTag) == 8, "OsmTag is used in place from snapshots");
+	static_assert(sizeof(OsmRingSegment) == 8, "OsmRingSegment is used in place from snapshots");
+	static_assert(sizeof(OsmRing) == 16, "OsmRing is used in place from snapshots");
+
+	static constexpr size_t kSectionRecordSizes[kSectionCount] = {
+		sizeof(char),
+		sizeof(uint64_t),
+		sizeof(OsmTag),
+		sizeof(uint32_t),
+		sizeof(SnapshotMember),
+		sizeof(OsmRingSegment),
+		sizeof(OsmRing),
+		sizeof(SnapshotNode),
+		sizeof(SnapshotWay),
+		sizeof(SnapshotRelation),
+		sizeof(uint64_t),
+		sizeof(uint32_t),
+		sizeof(uint64_t),
+		sizeof(uint32_t),
+		sizeof(uint64_t),
+		sizeof(uint32_t),
+	};
+
+	static uint64_t AlignSectionOffset(uint64_t offset) {
+		return (offset + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+	}
+
+	// Buffered by the FILE, records are written one at a time
+	class SnapshotWriter {
+	public:
+		explicit SnapshotWriter(FILE* file) : _file(file) {}
+		template<typename T>
+		void Write(const T& record) { Write(&record, sizeof(T)); }
+		void Write(const void* data, size_t size) {
+			if (size > 0 && _isGood) {
+				_isGood = fwrite(data, 1, size, _file) == size;
+				_position += size;
+			}
+		}
+		void SeekSection(uint64_t offset) {
+			static const char kPadding[kSectionAlignment] = {};
+			Write(kPadding, static_cast<size_t>(offset - _position));
+		}
+		bool IsGood() const { return _isGood; }
+
+	private:
+		FILE* _file;
+		uint64_t _position = 0;
+		bool _isGood = true;
+	};
+
+	static void WriteIndexSlots(SnapshotWriter& writer, const SnapshotHeader& header, const OsmIdIndex& index, uint32_t idSection) {
+		writer.SeekSection(header.sections[idSection].offset);
+		writer.Write(index.GetSlotIds(), index.GetSlotCount() * sizeof(uint64_t));
+		writer.SeekSection(header.sections[idSection + 1].offset);
+		writer.Write(index.GetSlotIndices(), index.GetSlotCount() * sizeof(uint32_t));
+	}
+
+	// Members without an entity, which changes leave in their relations, are not written
+	static uint32_t GetWrittenMemberCount(const OsmRelation& relation) {
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < relation.memberCount; ++i) {
+			count += relation.members[i].handle.IsValid() ? 1 : 0;
+		}
+		return count;
+	}
+
+	bool WriteOsmSnapshot(const OsmCache& osmCache, const char* path) {
+		if (!osmCache.pendingMembers.empty()) {
+			return false;
+		}
+		const TagDictionary& dictionary = GetTagDictionary();
+		// Strings interned later by other threads are not referred to by the cache
+		size_t stringCount = dictionary.GetCount();
+
+		SnapshotHeader header = {};
+		memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+		header.version = kSnapshotVersion;
+		header.byteOrderMark = kByteOrderMark;
+		header.nodeIndexSize = osmCache.nodeIndex.GetSize();
+		header.wayIndexSize = osmCache.wayIndex.GetSize();
+		header.relationIndexSize = osmCache.relationIndex.GetSize();
+		SnapshotSectionRange* sections = header.sections;
+		for (size_t i = 0; i < stringCount; ++i) {
+			sections[kSectionStrings].count += dictionary.GetString(static_cast<uint32_t>(i)).size();
+		}
+		sections[kSectionStringOffsets].count = stringCount + 1;
+		for (const OsmNode& node : osmCache.nodes) {
+			sections[kSectionTags].count += node.tagCount;
+		}
+		for (const OsmWay& way : osmCache.ways) {
+			sections[kSectionTags].count += way.tagCount;
+			sections[kSectionNodeIndices].count += way.nodeCount;
+		}
+		for (const OsmRelation& relation : osmCache.relations) {
+			sections[kSectionTags].count += relation.tagCount;
+			sections[kSectionMembers].count += GetWrittenMemberCount(relation);
+			sections[kSectionRingSegments].count += relation.ringSegmentCount;
+			sections[kSectionRings].count += relation.outerRingCount + relation.innerRingCount;
+		}
+		sections[kSectionNodes].count = SIZE(osmCache.nodes);
+		sections[kSectionWays].count = SIZE(osmCache.ways);
+		sections[kSectionRelations].count = SIZE(osmCache.relations);
+		sections[kSectionNodeSlotIds].count = sections[kSectionNodeSlotIndices].count = osmCache.nodeIndex.GetSlotCount();
+		sections[kSectionWaySlotIds].count = sections[kSectionWaySlotIndices].count = osmCache.wayIndex.GetSlotCount();
+		sections[kSectionRelationSlotIds].count = sections[kSectionRelationSlotIndices].count = osmCache.relationIndex.GetSlotCount();
+		uint64_t offset = sizeof(SnapshotHeader);
+		for (uint32_t section = 0; section < kSectionCount; ++section) {
+			offset = AlignSectionOffset(offset);
+			sections[section].offset = offset;
+			offset += sections[section].count * kSectionRecordSizes[section];
+		}
+
+		FILE* file = fopen(path, "wb");
+		if (file == nullptr) {
+			return false;
+		}
+		SnapshotWriter writer(file);
+		writer.Write(header);
+
+		writer.SeekSection(sections[kSectionStrings].offset);
+		for (size_t i = 0; i < stringCount; ++i) {
+			std::string_view text = dictionary.GetString(static_cast<uint32_t>(i));
+			writer.Write(text.data(), text.size());
+		}
+		writer.SeekSection(sections[kSectionStringOffsets].offset);
+		uint64_t stringOffset = 0;
+		writer.Write(stringOffset);
+		for (size_t i = 0; i < stringCount; ++i) {
+			stringOffset += dictionary.GetString(static_cast<uint32_t>(i)).size();
+			writer.Write(stringOffset);
+		}
+
+		// Variable length data in entity order: the tags of all nodes, ways and relations, then the node indices, the
+		// members and the rings
+		writer.SeekSection(sections[kSectionTags].offset);
+		for (const OsmNode& node : osmCache.nodes) {
+			writer.Write(node.tags, node.tagCount * sizeof(OsmTag));
+		}
+		for (const OsmWay& way : osmCache.ways) {
+			writer.Write(way.tags, way.tagCount * sizeof(OsmTag));
+		}
+		for (const OsmRelation& relation : osmCache.relations) {
+			writer.Write(relation.tags, relation.tagCount * sizeof(OsmTag));
+		}
+		writer.SeekSection(sections[kSectionNodeIndices].offset);
+		for (const OsmWay& way : osmCache.ways) {
+			writer.Write(way.nodeIndices, way.nodeCount * sizeof(uint32_t));
+		}
+		writer.SeekSection(sections[kSectionMembers].offset);
+		for (const OsmRelation& relation : osmCache.relations) {
+			for (uint32_t i = 0; i < relation.memberCount; ++i) {
+				const OsmMember& member = relation.members[i];
+				if (!member.handle.IsValid()) {
+					continue;
+				}
+				writer.Write(SnapshotMember{ member.handle.index, member.role, static_cast<uint32_t>(member.handle.type) });
+			}
+		}
+		writer.SeekSection(sections[kSectionRingSegments].offset);
+		for (const OsmRelation& relation : osmCache.relations) {
+			for (uint32_t i = 0; i < relation.ringSegmentCount; ++i) {
+				// Through memset, so that the padding is not left uninitialized in the file
+				OsmRingSegment segment;
+				memset(&segment, 0, sizeof(segment));
+				segment.wayIndex = relation.ringSegments[i].wayIndex;
+				segment.isReversed = relation.ringSegments[i].isReversed;
+				writer.Write(segment);
+			}
+		}
+		writer.SeekSection(sections[kSectionRings].offset);
+		for (const OsmRelation& relation : osmCache.relations) {
+			writer.Write(relation.rings, (relation.outerRingCount + relation.innerRingCount) * sizeof(OsmRing));
+		}
+
+		uint64_t firstTag = 0;
+		writer.SeekSection(sections[kSectionNodes].offset);
+		for (const OsmNode& node : osmCache.nodes) {
+			writer.Write(SnapshotNode{ node.id, firstTag, node.coordinate.latitude, node.coordinate.longitude, node.tagCount, 0 });
+			firstTag += node.tagCount;
+		}
+		uint64_t firstNode = 0;
+		writer.SeekSection(sections[kSectionWays].offset);
+		for (const OsmWay& way : osmCache.ways) {
+			writer.Write(SnapshotWay{ way.id, firstTag, firstNode, way.tagCount, way.nodeCount });
+			firstTag += way.tagCount;
+			firstNode += way.nodeCount;
+		}
+		uint64_t firstMember = 0;
+		uint64_t firstSegment = 0;
+		uint64_t firstRing = 0;
+		writer.SeekSection(sections[kSectionRelations].offset);
+		for (const OsmRelation& relation : osmCache.relations) {
+			uint32_t memberCount = GetWrittenMemberCount(relation);
+			writer.Write(SnapshotRelation{ relation.id, firstTag, firstMember, firstSegment, firstRing, relation.tagCount, memberCount,
+				relation.ringSegmentCount, relation.outerRingCount, relation.innerRingCount, relation.isMultigon ? 1u : 0u });
+			firstTag += relation.tagCount;
+			firstMember += memberCount;
+			firstSegment += relation.ringSegmentCount;
+			firstRing += relation.outerRingCount + relation.innerRingCount;
+		}
+
+		WriteIndexSlots(writer, header, osmCache.nodeIndex, kSectionNodeSlotIds);
+		WriteIndexSlots(writer, header, osmCache.wayIndex, kSectionWaySlotIds);
+		WriteIndexSlots(writer, header, osmCache.relationIndex, kSectionRelationSlotIds);
+		bool isWritten = writer.IsGood();
+		return fclose(file) == 0 && isWritten;
+	}
+
+	// The sections of a mapped snapshot, checked to be inside the file
+	class SnapshotView {
+	public:
+		bool Open(const MappedFile& file) {
+			if (file.GetSize() < sizeof(SnapshotHeader)) {
+				return false;
+			}
+			_data = file.GetData();
+			memcpy(&_header, _data, sizeof(SnapshotHeader));
+			if (memcmp(_header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 || _header.version != kSnapshotVersion ||
+				_header.byteOrderMark != kByteOrderMark) {
+				return false;
+			}
+			for (uint32_t section = 0; section < kSectionCount; ++section) {
+				const SnapshotSectionRange& range = _header.sections[section];
+				if (range.offset % kSectionAlignment != 0 || range.offset > file.GetSize() ||
+					range.count > (file.GetSize() - range.offset) / kSectionRecordSizes[section]) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		const SnapshotHeader& GetHeader() const { return _header; }
+		uint64_t GetCount(uint32_t section) const { return _header.sections[section].count; }
+		template<typename T>
+		const T* Get(uint32_t section) const { return reinterpret_cast<const T*>(_data + _header.sections[section].offset); }
+		// Whether [first, first + count) is inside the section
+		bool Contains(uint32_t section, uint64_t first, uint64_t count) const {
+			return first <= GetCount(section) && count <= GetCount(section) - first;
+		}
+
+	private:
+		const char* _data = nullptr;
+		SnapshotHeader _header;
+	};
+
+	// Interns the strings of the snapshot. Tags are used in place if every string got the id it had when the
+	// snapshot was written, e.g. in a process that read nothing else before.
+	static bool InternSnapshotStrings(const SnapshotView& view, std::vector<uint32_t>& stringIds, bool& isIdentity) {
+		const char* strings = view.Get<char>(kSectionStrings);
+		const uint64_t* offsets = view.Get<uint64_t>(kSectionStringOffsets);
+		uint64_t offsetCount = view.GetCount(kSectionStringOffsets);
+		if (offsetCount == 0 || offsets[0] != 0 || offsets[offsetCount - 1] != view.GetCount(kSectionStrings)) {
+			return false;
+		}
+		TagDictionary& dictionary = GetTagDictionary();
+		stringIds.resize(static_cast<size_t>(offsetCount - 1));
+		isIdentity = true;
+		for (size_t i = 0; i < stringIds.size(); ++i) {
+			if (offsets[i + 1] < offsets[i]) {
+				return false;
+			}
+			stringIds[i] = dictionary.Intern(std::string_view(strings + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i])));
+			isIdentity = isIdentity && stringIds[i] == i;
+		}
+		return true;
+	}
+
+	class SnapshotLoader {
+	public:
+		SnapshotLoader(const SnapshotView& view, OsmCache& osmCache) : _view(view), _osmCache(osmCache) {}
+
+		bool Load() {
+			if (!InternSnapshotStrings(_view, _stringIds, _isIdentity)) {
+				return false;
+			}
+			_tags = _view.Get<OsmTag>(kSectionTags);
+			OsmCache& osmCache = _osmCache;
+
+			const SnapshotNode* nodes = _view.Get<SnapshotNode>(kSectionNodes);
+			osmCache.nodes.resize(static_cast<size_t>(_view.GetCount(kSectionNodes)));
+			for (size_t i = 0; i < SIZE(osmCache.nodes); ++i) {
+				const SnapshotNode& record = nodes[i];
+				OsmNode& node = osmCache.nodes[i];
+				node.id = record.id;
+				node.coordinate = FixedLatLong(record.latitude, record.longitude);
+				if (!LoadTags(node, record.firstTag, record.tagCount)) {
+					return false;
+				}
+			}
+
+			const SnapshotWay* ways = _view.Get<SnapshotWay>(kSectionWays);
+			const uint32_t* nodeIndices = _view.Get<uint32_t>(kSectionNodeIndices);
+			osmCache.ways.resize(static_cast<size_t>(_view.GetCount(kSectionWays)));
+			for (size_t i = 0; i < SIZE(osmCache.ways); ++i) {
+				const SnapshotWay& record = ways[i];
+				OsmWay& way = osmCache.ways[i];
+				way.id = record.id;
+				if (!LoadTags(way, record.firstTag, record.tagCount) || !_view.Contains(kSectionNodeIndices, record.firstNode, record.nodeCount)) {
+					return false;
+				}
+				way.nodeIndices = record.nodeCount > 0 ? nodeIndices + record.firstNode : nullptr;
+				way.nodeCount = record.nodeCount;
+			}
+
+			// Members are copied, resolving and applying changes rewrite them in place
+			const SnapshotRelation* relations = _view.Get<SnapshotRelation>(kSectionRelations);
+			const SnapshotMember* members = _view.Get<SnapshotMember>(kSectionMembers);
+			const OsmRingSegment* segments = _view.Get<OsmRingSegment>(kSectionRingSegments);
+			const OsmRing* rings = _view.Get<OsmRing>(kSectionRings);
+			osmCache.relations.resize(static_cast<size_t>(_view.GetCount(kSectionRelations)));
+			for (size_t i = 0; i < SIZE(osmCache.relations); ++i) {
+				const SnapshotRelation& record = relations[i];
+				OsmRelation& relation = osmCache.relations[i];
+				relation.id = record.id;
+				if (!LoadTags(relation, record.firstTag, record.tagCount) || !_view.Contains(kSectionMembers, record.firstMember, record.memberCount) ||
+					!_view.Contains(kSectionRingSegments, record.firstSegment, record.ringSegmentCount) ||
+					!_view.Contains(kSectionRings, record.firstRing, static_cast<uint64_t>(record.outerRingCount) + record.innerRingCount)) {
+					return false;
+				}
+				if (record.memberCount > 0) {
+					relation.members = static_cast<OsmMember*>(osmCache.arena.Allocate(record.memberCount * sizeof(OsmMember), alignof(OsmMember)));
+				}
+				for (uint32_t j = 0; j < record.memberCount; ++j) {
+					const SnapshotMember& memberRecord = members[record.firstMember + j];
+					if (!IsMemberValid(memberRecord)) {
+						return false;
+					}
+					relation.members[j].handle.type = static_cast<OsmMemberType>(memberRecord.type);
+					relation.members[j].handle.index = memberRecord.index;
+					relation.members[j].role = _stringIds[memberRecord.role];
+				}
+				relation.memberCount = record.memberCount;
+				relation.isMultigon = record.isMultigon != 0;
+				relation.ringSegments = record.ringSegmentCount > 0 ? segments + record.firstSegment : nullptr;
+				relation.rings = record.outerRingCount > 0 ? rings + record.firstRing : nullptr;
+				relation.ringSegmentCount = record.ringSegmentCount;
+				relation.outerRingCount = record.outerRingCount;
+				relation.innerRingCount = record.innerRingCount;
+			}
+
+			const SnapshotHeader& header = _view.GetHeader();
+			return LoadIndex(osmCache.nodeIndex, kSectionNodeSlotIds, header.nodeIndexSize) &&
+				LoadIndex(osmCache.wayIndex, kSectionWaySlotIds, header.wayIndexSize) &&
+				LoadIndex(osmCache.relationIndex, kSectionRelationSlotIds, header.relationIndexSize);
+		}
+
+	private:
+		bool LoadTags(OsmComponent& component, uint64_t firstTag, uint32_t tagCount) {
+			if (!_view.Contains(kSectionTags, firstTag, tagCount)) {
+				return false;
+			}
+			if (tagCount == 0) {
+				return true;
+			}
+			const OsmTag* tags = _tags + firstTag;
+			if (_isIdentity) {
+				component.tags = tags;
+				component.tagCount = tagCount;
+				return true;
+			}
+			// Ids changed, so does the order of the keys
+			_tagBuffer.clear();
+			for (uint32_t i = 0; i < tagCount; ++i) {
+				if (tags[i].key >= _stringIds.size() || tags[i].value >= _stringIds.size()) {
+					return false;
+				}
+				_tagBuffer.push_back({ _stringIds[tags[i].key], _stringIds[tags[i].value] });
+			}
+			component.SetTags(_tagBuffer.data(), _tagBuffer.size(), _osmCache.arena);
+			return true;
+		}
+
+		bool IsMemberValid(const SnapshotMember& member) const {
+			if (member.role >= _stringIds.size()) {
+				return false;
+			}
+			switch (static_cast<OsmMemberType>(member.type)) {
+			case OsmMemberType::Node:
+				return member.index < SIZE(_osmCache.nodes);
+			case OsmMemberType::Way:
+				return member.index < SIZE(_osmCache.ways);
+			case OsmMemberType::Relation:
+				// Relations may refer ahead
+				return member.index < _view.GetCount(kSectionRelations);
+			}
+			return false;
+		}
+
+		bool LoadIndex(OsmIdIndex& index, uint32_t idSection, uint64_t size) {
+			uint64_t slotCount = _view.GetCount(idSection);
+			return slotCount == _view.GetCount(idSection + 1) &&
+				index.LoadSlots(_view.Get<uint64_t>(idSection), _view.Get<uint32_t>(idSection + 1), static_cast<size_t>(slotCount), static_cast<size_t>(size));
+		}
+
+		const SnapshotView& _view;
+		OsmCache& _osmCache;
+		std::vector<uint32_t> _stringIds;
+		bool _isIdentity = false;
+		const OsmTag* _tags = nullptr;
+		std::vector<OsmTag> _tagBuffer;
+	};
+
+	bool ReadOsmSnapshot(const char* path, OsmCache& osmCache) {
+		osmCache.Clear();
+		std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+		SnapshotView view;
+		if (!file->Open(path) || !view.Open(*file)) {
+			return false;
+		}
+		SnapshotLoader loader(view, osmCache);
+		if (!loader.Load()) {
+			osmCache.Clear();
+			return false;
+		}
+		osmCache.snapshot = std::move(file);
+		return true;
+	}
+
+}
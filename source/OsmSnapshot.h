@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Osm {
+
+struct OsmCache;
+
+// Binary image of a resolved OsmCache, written once and memory mapped read-only at start up instead of parsing the
+// input again. The tags, node indices and multipolygon rings of the entities are used in place from the mapping, only
+// the fixed size entity records, the relation members and the id indexes are copied, without hashing or parsing. The
+// file is only readable on machines of the same byte order by a build of the same snapshot version.
+// Fails if members of the cache are still waiting for ResolveMembers(). Members that changes left without an entity
+// are not written.
+bool WriteOsmSnapshot(const OsmCache& osmCache, const char* path);
+// Replaces the content of the cache, the cache keeps the file mapped until it is cleared. The cache is empty if the
+// file is not a snapshot of this version or is cut short. The entity data itself is trusted to be what
+// WriteOsmSnapshot wrote.
+bool ReadOsmSnapshot(const char* path, OsmCache& osmCache);
+
+}
@@ -0,0 +1,573 @@
+#include "OsmXmlReader.h"
+
+#include "OsmParserUtils.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace Osm {
+
+	static bool IsXmlWhitespace(char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	static bool ParseId(std::string_view text, uint64_t& id) {
+		int64_t value = 0;
+		std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+			return false;
+		}
+		id = static_cast<uint64_t>(value);
+		return true;
+	}
+
+	OsmXmlReader::OsmXmlReader(const char* data, size_t size) {
+		_windowBegin = data;
+		_cursor = data;
+		_limit = data + size;
+	}
+
+	OsmXmlReader::OsmXmlReader(std::istream& input, size_t chunkSize) : _input(&input), _chunkSize(chunkSize > 0 ? chunkSize : kDefaultChunkSize) {
+		_buffer.resize(_chunkSize);
+		_windowBegin = _buffer.data();
+		_cursor = _windowBegin;
+		_limit = _windowBegin;
+	}
+
+	bool OsmXmlReader::TryGetAttribute(std::string_view name, std::string_view& value) const {
+		for (const Attribute& attribute : _attributes) {
+			if (attribute.name == name) {
+				value = attribute.value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string_view OsmXmlReader::GetAttribute(std::string_view name) const {
+		std::string_view value;
+		TryGetAttribute(name, value);
+		return value;
+	}
+
+	bool OsmXmlReader::Fail() {
+		_hasError = true;
+		_eventType = EventType::None;
+		return false;
+	}
+
+	bool OsmXmlReader::Read() {
+		if (_hasError) {
+			return false;
+		}
+		if (_pendingEndElement) {
+			_pendingEndElement = false;
+			_eventType = EventType::EndElement;
+			return true;
+		}
+
+		for (;;) {
+			const char* markupBegin = _cursor < _limit ? static_cast<const char*>(memchr(_cursor, '<', _limit - _cursor)) : nullptr;
+			if (markupBegin == nullptr) {
+				// Character data between elements carries no information in OSM documents.
+				_cursor = _limit;
+				if (!Refill(markupBegin)) {
+					_eventType = EventType::None;
+					return _openElements.empty() && _hasRootElement ? false : Fail();
+				}
+				continue;
+			}
+
+			const char* markupEnd = nullptr;
+			if (!FindMarkupEnd(markupBegin, markupEnd)) {
+				if (!Refill(markupBegin)) {
+					return Fail(); // Truncated markup
+				}
+				continue;
+			}
+			_cursor = markupEnd;
+
+			if (markupBegin[1] == '?' || markupBegin[1] == '!') {
+				continue; // Declarations, comments, doctype and CDATA
+			}
+			if (markupBegin[1] == '/') {
+				return ParseEndTag(markupBegin, markupEnd);
+			}
+			return ParseStartTag(markupBegin, markupEnd);
+		}
+	}
+
+	bool OsmXmlReader::FindMarkupEnd(const char* markupBegin, const char*& markupEnd) {
+		std::string_view markup(markupBegin, _limit - markupBegin);
+		if (markup.size() < 2) {
+			return false;
+		}
+
+		size_t terminator = std::string_view::npos;
+		size_t terminatorLength = 1;
+		if (markup[1] == '?') {
+			terminator = markup.find("?>", 2);
+			terminatorLength = 2;
+		}
+		else if (markup[1] == '!') {
+			if (markup.size() < 4) {
+				return false;
+			}
+			if (markup.compare(0, 4, "<!--") == 0) {
+				terminator = markup.find("-->", 4);
+				terminatorLength = 3;
+			}
+			else if (markup[2] == '[') {
+				terminator = markup.find("]]>", 3);
+				terminatorLength = 3;
+			}
+			else {
+				// Doctype, possibly with an internal subset in brackets
+				int32_t bracketDepth = 0;
+				for (size_t i = 2; i < markup.size(); ++i) {
+					if (markup[i] == '[') ++bracketDepth;
+					else if (markup[i] == ']') --bracketDepth;
+					else if (markup[i] == '>' && bracketDepth <= 0) {
+						terminator = i;
+						break;
+					}
+				}
+			}
+		}
+		else {
+			// A '>' may legally appear inside quoted attribute values
+			char quote = 0;
+			for (size_t i = 1; i < markup.size(); ++i) {
+				char c = markup[i];
+				if (quote != 0) {
+					if (c == quote) quote = 0;
+				}
+				else if (c == '"' || c == '\'') {
+					quote = c;
+				}
+				else if (c == '>') {
+					terminator = i;
+					break;
+				}
+			}
+		}
+
+		if (terminator == std::string_view::npos) {
+			return false;
+		}
+		markupEnd = markupBegin + terminator + terminatorLength;
+		return true;
+	}
+
+	bool OsmXmlReader::Refill(const char*& markupBegin) {
+		if (_input == nullptr) {
+			return false;
+		}
+
+		// Keep the incomplete markup (if any) and move it to the front of the buffer
+		const char* keepBegin = markupBegin != nullptr ? markupBegin : _limit;
+		size_t discarded = keepBegin - _windowBegin;
+		size_t kept = _limit - keepBegin;
+		memmove(_buffer.data(), keepBegin, kept);
+		_consumedBeforeWindow += discarded;
+
+		// Only a single markup larger than the chunk size can grow the buffer
+		if (kept + _chunkSize > _buffer.size()) {
+			_buffer.resize(kept + _chunkSize);
+		}
+		_input->read(_buffer.data() + kept, static_cast<std::streamsize>(_buffer.size() - kept));
+		size_t received = static_cast<size_t>(_input->gcount());
+
+		_windowBegin = _buffer.data();
+		_cursor = _windowBegin;
+		_limit = _windowBegin + kept + received;
+		if (markupBegin != nullptr) {
+			markupBegin = _windowBegin;
+		}
+		return received > 0;
+	}
+
+	bool OsmXmlReader::ParseStartTag(const char* begin, const char* end) {
+		const char* p = begin + 1;
+		const char* tagEnd = end - 1; // Points to '>'
+		bool isSelfClosing = tagEnd > p && tagEnd[-1] == '/';
+		if (isSelfClosing) {
+			--tagEnd;
+		}
+
+		const char* nameBegin = p;
+		while (p < tagEnd && !IsXmlWhitespace(*p)) {
+			++p;
+		}
+		if (p == nameBegin) {
+			return Fail();
+		}
+		_name = std::string_view(nameBegin, p - nameBegin);
+
+		_attributes.clear();
+		size_t escapedLength = 0;
+		for (;;) {
+			while (p < tagEnd && IsXmlWhitespace(*p)) ++p;
+			if (p >= tagEnd) break;
+
+			const char* attributeNameBegin = p;
+			while (p < tagEnd && *p != '=' && !IsXmlWhitespace(*p)) ++p;
+			std::string_view attributeName(attributeNameBegin, p - attributeNameBegin);
+			while (p < tagEnd && IsXmlWhitespace(*p)) ++p;
+			if (attributeName.empty() || p >= tagEnd || *p != '=') {
+				return Fail();
+			}
+			++p;
+			while (p < tagEnd && IsXmlWhitespace(*p)) ++p;
+			if (p >= tagEnd || (*p != '"' && *p != '\'')) {
+				return Fail();
+			}
+			char quote = *p++;
+			const char* valueBegin = p;
+			while (p < tagEnd && *p != quote) ++p;
+			if (p >= tagEnd) {
+				return Fail();
+			}
+			std::string_view value(valueBegin, p - valueBegin);
+			++p;
+
+			if (value.find('&') != std::string_view::npos) {
+				escapedLength += value.size();
+			}
+			_attributes.push_back({ attributeName, value });
+		}
+
+		if (escapedLength > 0) {
+			// Decoding never makes a value longer, so reserving up front keeps the decoded views stable
+			_decodedValues.clear();
+			_decodedValues.reserve(escapedLength);
+			for (Attribute& attribute : _attributes) {
+				if (attribute.value.find('&') != std::string_view::npos && !DecodeEntities(attribute.value, attribute.value)) {
+					return Fail();
+				}
+			}
+		}
+
+		_hasRootElement = true;
+		_eventType = EventType::StartElement;
+		_depth = static_cast<int32_t>(_openElements.size());
+		if (isSelfClosing) {
+			_pendingEndElement = true;
+		}
+		else {
+			_openElements.emplace_back(_name);
+		}
+		return true;
+	}
+
+	bool OsmXmlReader::ParseEndTag(const char* begin, const char* end) {
+		const char* nameBegin = begin + 2;
+		const char* nameEnd = end - 1;
+		while (nameEnd > nameBegin && IsXmlWhitespace(nameEnd[-1])) {
+			--nameEnd;
+		}
+		std::string_view name(nameBegin, nameEnd - nameBegin);
+		if (_openElements.empty() || _openElements.back() != name) {
+			return Fail();
+		}
+		_openElements.pop_back();
+		_depth = static_cast<int32_t>(_openElements.size());
+		_name = name;
+		_attributes.clear();
+		_eventType = EventType::EndElement;
+		return true;
+	}
+
+	static void AppendUtf8(std::string& target, uint32_t codePoint) {
+		if (codePoint < 0x80) {
+			target += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800) {
+			target += static_cast<char>(0xC0 | (codePoint >> 6));
+			target += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000) {
+			target += static_cast<char>(0xE0 | (codePoint >> 12));
+			target += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			target += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else {
+			target += static_cast<char>(0xF0 | (codePoint >> 18));
+			target += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			target += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			target += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	bool OsmXmlReader::DecodeEntities(std::string_view raw, std::string_view& decoded) {
+		size_t decodedBegin = _decodedValues.size();
+		for (size_t i = 0; i < raw.size(); ++i) {
+			if (raw[i] != '&') {
+				_decodedValues += raw[i];
+				continue;
+			}
+			size_t semicolon = raw.find(';', i);
+			if (semicolon == std::string_view::npos) {
+				return false;
+			}
+			std::string_view entity = raw.substr(i + 1, semicolon - i - 1);
+			if (entity == "amp") _decodedValues += '&';
+			else if (entity == "lt") _decodedValues += '<';
+			else if (entity == "gt") _decodedValues += '>';
+			else if (entity == "quot") _decodedValues += '"';
+			else if (entity == "apos") _decodedValues += '\'';
+			else if (entity.size() > 1 && entity[0] == '#') {
+				bool isHex = entity[1] == 'x' || entity[1] == 'X';
+				std::string_view digits = entity.substr(isHex ? 2 : 1);
+				uint32_t codePoint = 0;
+				std::from_chars_result result = std::from_chars(digits.data(), digits.data() + digits.size(), codePoint, isHex ? 16 : 10);
+				if (digits.empty() || result.ec != std::errc() || result.ptr != digits.data() + digits.size() || codePoint > 0x10FFFF) {
+					return false;
+				}
+				AppendUtf8(_decodedValues, codePoint);
+			}
+			else {
+				return false;
+			}
+			i = semicolon;
+		}
+		decoded = std::string_view(_decodedValues.data() + decodedBegin, _decodedValues.size() - decodedBegin);
+		return true;
+	}
+
+	static bool ParseMemberType(std::string_view text, OsmMemberType& type) {
+		if (text == "node") {
+			type = OsmMemberType::Node;
+		}
+		else if (text == "way") {
+			type = OsmMemberType::Way;
+		}
+		else if (text == "relation") {
+			type = OsmMemberType::Relation;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadOsmCache(OsmXmlReader& reader, OsmCache& osmCache) {
+		return ReadOsmCache(reader, osmCache, OsmTagFilter());
+	}
+
+	bool ReadOsmCache(OsmXmlReader& reader, OsmCache& osmCache, const OsmTagFilter& tagFilter) {
+		// The entity being read points to one of these, it is added to the cache once it is complete
+		OsmNode currentNode;
+		OsmWay currentWay;
+		OsmRelation currentRelation;
+		OsmComponent* currentComponent = nullptr;
+		// Tags, node references and members of the current entity, they are copied into the arena at its end
+		std::vector<OsmTag> tagBuffer;
+		std::vector<uint32_t> nodeBuffer;
+		std::vector<OsmMemberReference> memberBuffer;
+		TagDictionary& dictionary = GetTagDictionary();
+
+		while (reader.Read()) {
+			std::string_view name = reader.GetName();
+			if (reader.IsStartElement()) {
+				// Entities are the direct children of the <osm> root
+				if (reader.GetDepth() == 1) {
+					uint64_t id = 0;
+					if (name == "node") {
+						FixedLatLong coordinate;
+						if (!ParseId(reader.GetAttribute("id"), id) ||
+							!ParseFixedDegrees(reader.GetAttribute("lat"), coordinate.latitude) ||
+							!ParseFixedDegrees(reader.GetAttribute("lon"), coordinate.longitude)) {
+							return false;
+						}
+						currentNode = OsmNode(coordinate);
+						currentComponent = &currentNode;
+					}
+					else if (name == "way") {
+						if (!ParseId(reader.GetAttribute("id"), id)) {
+							return false;
+						}
+						currentWay = OsmWay();
+						currentComponent = &currentWay;
+					}
+					else if (name == "relation") {
+						if (!ParseId(reader.GetAttribute("id"), id)) {
+							return false;
+						}
+						currentRelation = OsmRelation();
+						currentComponent = &currentRelation;
+					}
+					if (currentComponent != nullptr) {
+						currentComponent->id = id;
+					}
+				}
+				else if (currentComponent != nullptr && reader.GetDepth() == 2) {
+					if (name == "tag") {
+						std::string_view key;
+						std::string_view value;
+						if (reader.TryGetAttribute("k", key) && reader.TryGetAttribute("v", value)) {
+							uint32_t keyId = tagFilter.IsKeepingAll() ? dictionary.Intern(key) : dictionary.Find(key);
+							if (tagFilter.IsKeyKept(keyId)) {
+								tagBuffer.push_back({ keyId, dictionary.Intern(value) });
+							}
+						}
+					}
+					else if (name == "nd" && currentComponent == &currentWay) {
+						uint64_t nodeId = 0;
+						if (!ParseId(reader.GetAttribute("ref"), nodeId)) {
+							return false;
+						}
+						// Check if the node exists in the cached nodes
+						uint32_t nodeIndex = osmCache.nodeIndex.Find(nodeId);
+						if (nodeIndex != OsmIdIndex::kInvalidIndex) {
+							nodeBuffer.push_back(nodeIndex);
+						}
+					}
+					else if (name == "member" && currentComponent == &currentRelation) {
+						uint64_t memberId = 0;
+						if (!ParseId(reader.GetAttribute("ref"), memberId)) {
+							return false;
+						}
+						OsmMemberType type;
+						if (ParseMemberType(reader.GetAttribute("type"), type)) {
+							memberBuffer.push_back({ type, memberId, dictionary.Intern(reader.GetAttribute("role")) });
+						}
+					}
+				}
+			}
+			else if (reader.GetDepth() == 1 && currentComponent != nullptr) {
+				// End of the current entity, it is complete now
+				if (tagFilter.AreTagsKept(tagBuffer.data(), tagBuffer.size())) {
+					currentComponent->SetTags(tagBuffer.data(), tagBuffer.size(), osmCache.arena);
+				}
+				tagBuffer.clear();
+				if (currentComponent == &currentNode) {
+					osmCache.AddNode(currentNode);
+				}
+				else if (currentComponent == &currentWay) {
+					currentWay.SetNodes(nodeBuffer.data(), nodeBuffer.size(), osmCache.arena);
+					osmCache.AddWay(currentWay);
+					nodeBuffer.clear();
+				}
+				else {
+					osmCache.AddRelation(currentRelation, memberBuffer.data(), memberBuffer.size());
+					memberBuffer.clear();
+				}
+				currentComponent = nullptr;
+			}
+		}
+
+		if (reader.HasError() || !reader.HasRootElement()) {
+			return false;
+		}
+		// Relations may refer to entities later in the document
+		osmCache.ResolveMembers();
+		return true;
+	}
+
+	static bool ParseChangeAction(std::string_view text, OsmChangeAction& action) {
+		if (text == "create") {
+			action = OsmChangeAction::Create;
+		}
+		else if (text == "modify") {
+			action = OsmChangeAction::Modify;
+		}
+		else if (text == "delete") {
+			action = OsmChangeAction::Delete;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadOsmChange(OsmXmlReader& reader, OsmChange& change, const OsmTagFilter& tagFilter) {
+		// Entities are the children of the action blocks, which are the children of the <osmChange> root
+		OsmChangeAction action = OsmChangeAction::Create;
+		bool isInAction = false;
+		OsmChangeEntity* currentEntity = nullptr;
+		TagDictionary& dictionary = GetTagDictionary();
+
+		while (reader.Read()) {
+			std::string_view name = reader.GetName();
+			if (reader.IsStartElement()) {
+				if (reader.GetDepth() == 1) {
+					isInAction = ParseChangeAction(name, action);
+				}
+				else if (isInAction && reader.GetDepth() == 2) {
+					OsmChangeEntity entity = {};
+					entity.action = action;
+					entity.firstTag = static_cast<uint32_t>(change.tags.size());
+					if (name == "node") {
+						entity.type = OsmMemberType::Node;
+						// Deleted nodes do not need a position
+						if (action != OsmChangeAction::Delete && (!ParseFixedDegrees(reader.GetAttribute("lat"), entity.coordinate.latitude) ||
+							!ParseFixedDegrees(reader.GetAttribute("lon"), entity.coordinate.longitude))) {
+							return false;
+						}
+					}
+					else if (name == "way") {
+						entity.type = OsmMemberType::Way;
+						entity.firstReference = static_cast<uint32_t>(change.nodeIds.size());
+					}
+					else if (name == "relation") {
+						entity.type = OsmMemberType::Relation;
+						entity.firstReference = static_cast<uint32_t>(change.members.size());
+					}
+					else {
+						continue;
+					}
+					if (!ParseId(reader.GetAttribute("id"), entity.id)) {
+						return false;
+					}
+					change.entities.push_back(entity);
+					currentEntity = &change.entities.back();
+				}
+				else if (currentEntity != nullptr && reader.GetDepth() == 3) {
+					if (name == "tag") {
+						std::string_view key;
+						std::string_view value;
+						if (reader.TryGetAttribute("k", key) && reader.TryGetAttribute("v", value)) {
+							uint32_t keyId = tagFilter.IsKeepingAll() ? dictionary.Intern(key) : dictionary.Find(key);
+							if (tagFilter.IsKeyKept(keyId)) {
+								change.tags.push_back({ keyId, dictionary.Intern(value) });
+								++currentEntity->tagCount;
+							}
+						}
+					}
+					else if (name == "nd" && currentEntity->type == OsmMemberType::Way) {
+						uint64_t nodeId = 0;
+						if (!ParseId(reader.GetAttribute("ref"), nodeId)) {
+							return false;
+						}
+						change.nodeIds.push_back(nodeId);
+						++currentEntity->referenceCount;
+					}
+					else if (name == "member" && currentEntity->type == OsmMemberType::Relation) {
+						uint64_t memberId = 0;
+						if (!ParseId(reader.GetAttribute("ref"), memberId)) {
+							return false;
+						}
+						OsmMemberType type;
+						if (ParseMemberType(reader.GetAttribute("type"), type)) {
+							change.members.push_back({ type, memberId, dictionary.Intern(reader.GetAttribute("role")) });
+							++currentEntity->referenceCount;
+						}
+					}
+				}
+			}
+			else if (reader.GetDepth() == 2 && currentEntity != nullptr) {
+				// End of the current entity, the filter decides on its tags as a whole
+				if (!tagFilter.AreTagsKept(change.tags.data() + currentEntity->firstTag, currentEntity->tagCount)) {
+					change.tags.resize(currentEntity->firstTag);
+					currentEntity->tagCount = 0;
+				}
+				currentEntity = nullptr;
+			}
+			else if (reader.GetDepth() == 1) {
+				isInAction = false;
+			}
+		}
+		return !reader.HasError() && reader.HasRootElement();
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Osm {
+
+struct OsmCache;
+struct OsmChange;
+class OsmTagFilter;
+
+// Forward-only pull parser for OSM XML. Unlike tinyxml2 it never builds a DOM: each Read() advances to the next
+// element, and the name and attributes of that element stay valid until the following Read(). When reading from a
+// stream, only a small window of the input is held in memory, so memory use does not depend on the input size.
+class OsmXmlReader {
+public:
+	enum class EventType {
+		None,
+		StartElement,
+		EndElement
+	};
+
+	static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+	// Reads from a buffer that must outlive the reader. The buffer is not copied.
+	OsmXmlReader(const char* data, size_t size);
+	// Reads the stream in chunks of chunkSize bytes.
+	explicit OsmXmlReader(std::istream& input, size_t chunkSize = kDefaultChunkSize);
+
+	// Advances to the next element. Self-closing elements are reported as a StartElement followed by an EndElement.
+	// Returns false at the end of the document or on malformed input (see HasError).
+	bool Read();
+
+	EventType GetEventType() const { return _eventType; }
+	bool IsStartElement() const { return _eventType == EventType::StartElement; }
+	bool IsEndElement() const { return _eventType == EventType::EndElement; }
+	std::string_view GetName() const { return _name; }
+	// Number of enclosing elements, e.g. 0 for the root element and 1 for its children
+	int32_t GetDepth() const { return _depth; }
+	// Returns false if the current element has no such attribute. Entities in the value are already decoded.
+	bool TryGetAttribute(std::string_view name, std::string_view& value) const;
+	std::string_view GetAttribute(std::string_view name) const;
+
+	bool HasError() const { return _hasError; }
+	bool HasRootElement() const { return _hasRootElement; }
+	size_t GetBytesConsumed() const { return _consumedBeforeWindow + (_cursor - _windowBegin); }
+	size_t GetBufferCapacity() const { return _buffer.capacity(); }
+
+private:
+	struct Attribute {
+		std::string_view name;
+		std::string_view value;
+	};
+
+	bool FindMarkupEnd(const char* markupBegin, const char*& markupEnd);
+	bool Refill(const char*& markupBegin);
+	bool ParseStartTag(const char* begin, const char* end);
+	bool ParseEndTag(const char* begin, const char* end);
+	bool DecodeEntities(std::string_view raw, std::string_view& decoded);
+	bool Fail();
+
+	std::istream* _input = nullptr;
+	std::vector<char> _buffer;
+	size_t _chunkSize = kDefaultChunkSize;
+	size_t _consumedBeforeWindow = 0;
+	const char* _windowBegin = nullptr;
+	const char* _cursor = nullptr;
+	const char* _limit = nullptr;
+
+	EventType _eventType = EventType::None;
+	std::string_view _name;
+	std::vector<Attribute> _attributes;
+	std::string _decodedValues;
+	std::vector<std::string> _openElements;
+	int32_t _depth = 0;
+	bool _pendingEndElement = false;
+	bool _hasError = false;
+	bool _hasRootElement = false;
+};
+
+// Fills the cache with every node, way and relation of the document, one element at a time. Tags are kept as the
+// filter decides. Relation members may refer ahead in the document, they are resolved once it is read.
+bool ReadOsmCache(OsmXmlReader& reader, OsmCache& osmCache, const OsmTagFilter& tagFilter);
+bool ReadOsmCache(OsmXmlReader& reader, OsmCache& osmCache);
+
+// Reads an OsmChange document (https://wiki.openstreetmap.org/wiki/OsmChange), the entities of its create, modify and
+// delete blocks are appended to the change in document order. Tags are kept as the filter decides, it should be the one
+// the cache the change is applied to was read with.
+bool ReadOsmChange(OsmXmlReader& reader, OsmChange& change, const OsmTagFilter& tagFilter);
+
+}
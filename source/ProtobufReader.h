@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Minimal reader for the protobuf wire format, just enough to decode OSM PBF messages without generated code.
+// Fields are visited in order with Next(), then read with the accessor matching their declared type. Any malformed
+// input puts the reader in an error state in which Next() returns false.
+class ProtobufReader {
+public:
+	enum WireType {
+		Varint = 0,
+		Fixed64 = 1,
+		LengthDelimited = 2,
+		Fixed32 = 5
+	};
+
+	ProtobufReader() = default;
+	ProtobufReader(const uint8_t* data, size_t size) : _cursor(data), _end(data + size) {}
+	explicit ProtobufReader(std::string_view bytes)
+		: _cursor(reinterpret_cast<const uint8_t*>(bytes.data())), _end(_cursor + bytes.size()) {}
+
+	// Moves to the next field, returns false at the end of the message or on error
+	bool Next() {
+		if (_cursor >= _end || _hasError) {
+			return false;
+		}
+		uint64_t key = ReadRawVarint();
+		_fieldNumber = static_cast<uint32_t>(key >> 3);
+		_wireType = static_cast<uint32_t>(key & 7);
+		return !_hasError;
+	}
+
+	uint32_t GetFieldNumber() const { return _fieldNumber; }
+	bool IsAtEnd() const { return _cursor >= _end; }
+	bool HasError() const { return _hasError; }
+
+	uint64_t ReadVarint() {
+		return Expect(Varint) ? ReadRawVarint() : 0;
+	}
+
+	// int64/int32 fields, negative values are sign extended varints
+	int64_t ReadInt64() {
+		return static_cast<int64_t>(ReadVarint());
+	}
+
+	// sint64/sint32 fields use zigzag encoding
+	int64_t ReadSignedInt64() {
+		return DecodeZigzag(ReadVarint());
+	}
+
+	bool ReadBool() {
+		return ReadVarint() != 0;
+	}
+
+	std::string_view ReadBytes() {
+		if (!Expect(LengthDelimited)) {
+			return std::string_view();
+		}
+		uint64_t length = ReadRawVarint();
+		if (_hasError || length > static_cast<uint64_t>(_end - _cursor)) {
+			_hasError = true;
+			return std::string_view();
+		}
+		std::string_view bytes(reinterpret_cast<const char*>(_cursor), static_cast<size_t>(length));
+		_cursor += length;
+		return bytes;
+	}
+
+	ProtobufReader ReadMessage() {
+		return ProtobufReader(ReadBytes());
+	}
+
+	// Packed repeated fields are a length delimited run of values, read them from the returned reader with the Raw
+	// accessors until IsAtEnd()
+	ProtobufReader ReadPacked() {
+		return ProtobufReader(ReadBytes());
+	}
+
+	uint64_t ReadRawVarint() {
+		uint64_t value = 0;
+		for (int32_t shift = 0; shift < 64; shift += 7) {
+			if (_cursor >= _end) {
+				break;
+			}
+			uint8_t byte = *_cursor++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		_hasError = true;
+		return 0;
+	}
+
+	int64_t ReadRawSignedVarint() {
+		return DecodeZigzag(ReadRawVarint());
+	}
+
+	void Skip() {
+		switch (_wireType) {
+		case Varint: ReadRawVarint(); break;
+		case Fixed64: Advance(8); break;
+		case LengthDelimited: ReadBytes(); break;
+		case Fixed32: Advance(4); break;
+		default: _hasError = true; break; // Groups are deprecated and not used by OSM PBF
+		}
+	}
+
+private:
+	static int64_t DecodeZigzag(uint64_t value) {
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	bool Expect(uint32_t wireType) {
+		if (_wireType != wireType) {
+			_hasError = true;
+		}
+		return !_hasError;
+	}
+
+	void Advance(size_t count) {
+		if (count > static_cast<size_t>(_end - _cursor)) {
+			_hasError = true;
+			_cursor = _end;
+			return;
+		}
+		_cursor += count;
+	}
+
+	const uint8_t* _cursor = nullptr;
+	const uint8_t* _end = nullptr;
+	uint32_t _fieldNumber = 0;
+	uint32_t _wireType = 0;
+	bool _hasError = false;
+};
@@ -1,45 +1,842 @@
 #include "ShapeUtils.h"
 
+#include "type_defines.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// A multiply and an add contracted into one fused instruction round once instead of twice, the area would then depend
+// on the compiler and the machine
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHAPE_UTILS_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 namespace ShapeUtils {
 
-    double CalculateShapeArea(FLine* shape, bool global) {
-        double result = 0;
-        for (size_t i = 0; i < SIZE(shape->coordinates); ++i) {
-            int32_t next = (i + 1) % SIZE(shape->coordinates);
-            VECTOR2D pCurrent = global ? VECTOR2D(shape->coordinates[i]->globalPosition.latitude, shape->coordinates[i]->globalPosition.longitude) : shape->coordinates[i]->localPosition;
-            VECTOR2D pNext = global ? VECTOR2D(shape->coordinates[next]->globalPosition.latitude, shape->coordinates[next]->globalPosition.longitude) : shape->coordinates[next]->localPosition;
+    // The shoelace terms are summed in four interleaved partial sums, term i goes to sum i % 4, and the sums are added
+    // pairwise at the end. The vector kernels and the scalar one keep this order, so the area does not depend on the
+    // instruction set of the machine.
+    static constexpr int kAreaLaneCount = 4;
 
-            result += (pNext.X - pCurrent.X) * (pNext.Y + pCurrent.Y);
+    // Adds the terms from first on, the last one closing the ring, and combines the partial sums
+    static double FinishShapeArea(const double* x, const double* y, int count, int first, double* sums) {
+        for (int i = first; i < count; ++i) {
+            int next = i + 1 < count ? i + 1 : 0;
+            sums[i % kAreaLaneCount] += (x[next] - x[i]) * (y[next] + y[i]);
         }
-        return result;
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    double CalculateShapeAreaScalar(const double* x, const double* y, int count) {
+        double sums[kAreaLaneCount] = { 0, 0, 0, 0 };
+        int i = 0;
+        // Groups of four terms whose next vertex does not wrap around
+        for (; i + kAreaLaneCount < count; i += kAreaLaneCount) {
+            for (int lane = 0; lane < kAreaLaneCount; ++lane) {
+                sums[lane] += (x[i + lane + 1] - x[i + lane]) * (y[i + lane + 1] + y[i + lane]);
+            }
+        }
+        return FinishShapeArea(x, y, count, i, sums);
+    }
+
+#ifdef SHAPE_UTILS_SSE2
+    static double CalculateShapeAreaSse2(const double* x, const double* y, int count) {
+        __m128d low = _mm_setzero_pd();
+        __m128d high = _mm_setzero_pd();
+        int i = 0;
+        for (; i + kAreaLaneCount < count; i += kAreaLaneCount) {
+            __m128d deltaLow = _mm_sub_pd(_mm_loadu_pd(x + i + 1), _mm_loadu_pd(x + i));
+            __m128d deltaHigh = _mm_sub_pd(_mm_loadu_pd(x + i + 3), _mm_loadu_pd(x + i + 2));
+            __m128d sumLow = _mm_add_pd(_mm_loadu_pd(y + i + 1), _mm_loadu_pd(y + i));
+            __m128d sumHigh = _mm_add_pd(_mm_loadu_pd(y + i + 3), _mm_loadu_pd(y + i + 2));
+            low = _mm_add_pd(low, _mm_mul_pd(deltaLow, sumLow));
+            high = _mm_add_pd(high, _mm_mul_pd(deltaHigh, sumHigh));
+        }
+        double sums[kAreaLaneCount];
+        _mm_storeu_pd(sums, low);
+        _mm_storeu_pd(sums + 2, high);
+        return FinishShapeArea(x, y, count, i, sums);
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((target("avx2")))
+#endif
+    static double CalculateShapeAreaAvx2(const double* x, const double* y, int count) {
+        __m256d lanes = _mm256_setzero_pd();
+        int i = 0;
+        for (; i + kAreaLaneCount < count; i += kAreaLaneCount) {
+            __m256d delta = _mm256_sub_pd(_mm256_loadu_pd(x + i + 1), _mm256_loadu_pd(x + i));
+            __m256d sum = _mm256_add_pd(_mm256_loadu_pd(y + i + 1), _mm256_loadu_pd(y + i));
+            lanes = _mm256_add_pd(lanes, _mm256_mul_pd(delta, sum));
+        }
+        double sums[kAreaLaneCount];
+        _mm256_storeu_pd(sums, lanes);
+        // The rest is SSE code, mixing it with dirty upper halves of the registers is slow
+        _mm256_zeroupper();
+        return FinishShapeArea(x, y, count, i, sums);
+    }
+
+    static bool IsAvx2Supported() {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        // The OS has to save the AVX registers as well
+        bool isAvxEnabled = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return isAvxEnabled && (info[1] & (1 << 5)) != 0;
+#else
+        return false;
+#endif
+    }
+#endif
+
+    // The scalar kernel on the vertices of a pooled line, read through their indices. The terms go to the same sums.
+    static double CalculatePooledShapeArea(const double* x, const double* y, const uint32_t* indices, int count) {
+        double sums[kAreaLaneCount] = { 0, 0, 0, 0 };
+        for (int i = 0; i < count; ++i) {
+            uint32_t current = indices[i];
+            uint32_t next = indices[i + 1 < count ? i + 1 : 0];
+            sums[i % kAreaLaneCount] += (x[next] - x[current]) * (y[next] + y[current]);
+        }
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    typedef double (*ShapeAreaKernel)(const double* x, const double* y, int count);
+
+    // Chosen once for the machine
+    static ShapeAreaKernel GetShapeAreaKernel() {
+#ifdef SHAPE_UTILS_SSE2
+        static const ShapeAreaKernel kernel = IsAvx2Supported() ? CalculateShapeAreaAvx2 : CalculateShapeAreaSse2;
+        return kernel;
+#else
+        return CalculateShapeAreaScalar;
+#endif
+    }
+
+    double CalculateShapeArea(const double* x, const double* y, int count) {
+        return GetShapeAreaKernel()(x, y, count);
+    }
+
+    static double CalculateShapeArea(const FLineVertices& vertices, bool global, ShapeAreaKernel kernel) {
+        const double* x = global ? vertices.latitudes : vertices.localX;
+        const double* y = global ? vertices.longitudes : vertices.localY;
+        return vertices.isPooled ? CalculatePooledShapeArea(x, y, vertices.vertexIndices, vertices.count) : kernel(x, y, vertices.count);
     }
 
-    bool CalculateShapeOrientation(FLine* shape) 
+    void CalculateShapeAreas(const FLine* const* shapes, int count, bool global, double* areas, bool* orientations) {
+        ShapeAreaKernel kernel = GetShapeAreaKernel();
+        for (int i = 0; i < count; ++i) {
+            FLineVertices vertices = shapes[i]->GetVertices();
+            // The orientation is the one in local coordinates
+            double localArea = !global || orientations != nullptr ? CalculateShapeArea(vertices, false, kernel) : 0;
+            if (areas != nullptr) {
+                areas[i] = global ? CalculateShapeArea(vertices, true, kernel) : localArea;
+            }
+            if (orientations != nullptr) {
+                orientations[i] = localArea > 0;
+            }
+        }
+    }
+
+    double CalculateShapeArea(const FLine* shape, bool global) {
+        return CalculateShapeArea(shape->GetVertices(), global, GetShapeAreaKernel());
+    }
+
+    bool CalculateShapeOrientation(const FLine* shape) 
     {
         double result = CalculateShapeArea(shape, false);
         return result > 0;
 	}
 
-    bool IsPointInShape(FLine* shape, VECTOR2D point) 
-    {
-        bool result = false;
-        int numVertices = SIZE(shape->coordinates);
+    // Vertex i is element i of the streams of a line, element indices[i] of those of the pool for a pooled line
+    struct LineStreamIndex {
+        int operator()(int i) const { return i; }
+    };
 
-        // Loop through each edge of the polygon
-        for (int i = 0, j = numVertices - 1; i < numVertices; j = i++) {
-            VECTOR2D currentPoint = shape->coordinates[i]->localPosition;
-            VECTOR2D previousPoint = shape->coordinates[j]->localPosition;
+    struct PoolStreamIndex {
+        const uint32_t* indices;
+        int operator()(int i) const { return static_cast<int>(indices[i]); }
+    };
 
+    template<typename StreamIndex>
+    static bool IsPointInRing(const double* x, const double* y, int count, StreamIndex index, VECTOR2D point) {
+        bool result = false;
+        // Loop through each edge of the polygon
+        for (int i = 0, j = count - 1; i < count; j = i++) {
+            int current = index(i);
+            int previous = index(j);
             // Check if point is within the Y-range of the current edge
-            if ((currentPoint.Y > point.Y) != (previousPoint.Y > point.Y) &&
+            if ((y[current] > point.Y) != (y[previous] > point.Y) &&
                 // Check if point is to the left of the edge
-                (point.X < (previousPoint.X - currentPoint.X) *
-                    (point.Y - currentPoint.Y) / (previousPoint.Y - currentPoint.Y) + currentPoint.X)) {
+                (point.X < (x[previous] - x[current]) * (point.Y - y[current]) / (y[previous] - y[current]) + x[current])) {
                 result = !result; // Toggle result
             }
         }
+        return result;
+    }
+
+    bool IsPointInShape(const FLine* shape, VECTOR2D point) 
+    {
+        FLineVertices vertices = shape->GetVertices();
+        return vertices.isPooled ? IsPointInRing(vertices.localX, vertices.localY, vertices.count, PoolStreamIndex{ vertices.vertexIndices }, point) :
+            IsPointInRing(vertices.localX, vertices.localY, vertices.count, LineStreamIndex(), point);
+    }
+
+    template<typename StreamIndex>
+    static VECTOR2D CalculateRingCentroid(const double* x, const double* y, int count, StreamIndex index) {
+        // Relative to the first vertex, so that far from the origin the products keep their precision
+        double firstX = x[index(0)];
+        double firstY = y[index(0)];
+        double area = 0;
+        double centroidX = 0;
+        double centroidY = 0;
+        double averageX = 0;
+        double averageY = 0;
+        for (int i = 0; i < count; ++i) {
+            int next = index(i + 1 < count ? i + 1 : 0);
+            double currentX = x[index(i)] - firstX;
+            double currentY = y[index(i)] - firstY;
+            double nextX = x[next] - firstX;
+            double nextY = y[next] - firstY;
+            double cross = currentX * nextY - nextX * currentY;
+            area += cross;
+            centroidX += (currentX + nextX) * cross;
+            centroidY += (currentY + nextY) * cross;
+            averageX += currentX;
+            averageY += currentY;
+        }
+        if (area == 0) {
+            return VECTOR2D(firstX + averageX / count, firstY + averageY / count);
+        }
+        return VECTOR2D(firstX + centroidX / (3 * area), firstY + centroidY / (3 * area));
+    }
+
+    VECTOR2D CalculateShapeCentroid(const FLine* shape, bool global) {
+        FLineVertices vertices = shape->GetVertices();
+        if (vertices.count == 0) {
+            return VECTOR2D(0, 0);
+        }
+        const double* x = global ? vertices.latitudes : vertices.localX;
+        const double* y = global ? vertices.longitudes : vertices.localY;
+        return vertices.isPooled ? CalculateRingCentroid(x, y, vertices.count, PoolStreamIndex{ vertices.vertexIndices }) :
+            CalculateRingCentroid(x, y, vertices.count, LineStreamIndex());
+    }
+
+    // Rings of thousands of vertices still have a few edges in each band
+    static constexpr int kMaxBandCount = 256;
+
+    void PreparedShapes::Clear() {
+        _shapes.clear();
+        _edges.clear();
+        _bandStarts.clear();
+        _bandEdges.clear();
+    }
+
+    void PreparedShapes::Reserve(int shapeCount, int vertexCount) {
+        _shapes.reserve(shapeCount);
+        _edges.reserve(vertexCount);
+    }
+
+    int PreparedShapes::Add(const FLine* shape) {
+        _shapes.push_back(Shape{ VECTOR2D(0, 0), VECTOR2D(0, 0), 0, 0, static_cast<uint32_t>(_bandStarts.size()) });
+        Shape& prepared = _shapes.back();
+        if (shape == nullptr || shape->GetVertexCount() == 0) {
+            return GetShapeCount() - 1;
+        }
+        FLineVertices vertices = shape->GetVertices();
+        size_t firstEdge = _edges.size();
+        VECTOR2D low = vertices.GetLocalPosition(0);
+        VECTOR2D high = low;
+        VECTOR2D previous = vertices.GetLocalPosition(vertices.count - 1);
+        for (int i = 0; i < vertices.count; ++i) {
+            VECTOR2D current = vertices.GetLocalPosition(i);
+            low = VECTOR2D(std::min(low.X, current.X), std::min(low.Y, current.Y));
+            high = VECTOR2D(std::max(high.X, current.X), std::max(high.Y, current.Y));
+            // Horizontal edges never toggle IsPointInShape
+            if (current.Y != previous.Y) {
+                _edges.push_back(Edge{ current.X, current.Y, previous.X, previous.Y });
+            }
+            previous = current;
+        }
+        // The crossing test may round a point just outside of the box to inside of the shape
+        double margin = 1e-9 * (1 + std::max(std::max(std::abs(low.X), std::abs(high.X)), std::max(std::abs(low.Y), std::abs(high.Y))));
+        prepared.low = VECTOR2D(low.X - margin, low.Y - margin);
+        prepared.high = VECTOR2D(high.X + margin, high.Y + margin);
+        // About two edges in every band: a convex ring gets half as many bands as edges, one whose edges span much of its
+        // height fewer
+        double edgeHeight = 0;
+        for (size_t i = firstEdge; i < _edges.size(); ++i) {
+            edgeHeight += std::abs(_edges[i].previousY - _edges[i].y);
+        }
+        double bandCount = edgeHeight > 0 ? (_edges.size() - firstEdge) * (high.Y - low.Y) / edgeHeight : 1;
+        prepared.bandCount = static_cast<int>(std::min(std::max(bandCount, 1.0), static_cast<double>(kMaxBandCount)));
+        prepared.bandsPerUnit = prepared.bandCount / (prepared.high.Y - prepared.low.Y);
+        // Counts the edges of every band, fills them in moving the start of each band to its end, then moves them back
+        _bandStarts.resize(prepared.firstBand + prepared.bandCount + 1, 0);
+        uint32_t* bandStarts = &_bandStarts[prepared.firstBand];
+        for (size_t i = firstEdge; i < _edges.size(); ++i) {
+            const Edge& edge = _edges[i];
+            for (int band = GetBand(prepared, std::min(edge.y, edge.previousY)), highBand = GetBand(prepared, std::max(edge.y, edge.previousY));
+                band <= highBand; ++band) {
+                ++bandStarts[band + 1];
+            }
+        }
+        uint32_t firstBandEdge = static_cast<uint32_t>(_bandEdges.size());
+        bandStarts[0] = firstBandEdge;
+        for (int band = 0; band < prepared.bandCount; ++band) {
+            bandStarts[band + 1] += bandStarts[band];
+        }
+        _bandEdges.resize(bandStarts[prepared.bandCount]);
+        for (size_t i = firstEdge; i < _edges.size(); ++i) {
+            const Edge& edge = _edges[i];
+            for (int band = GetBand(prepared, std::min(edge.y, edge.previousY)), highBand = GetBand(prepared, std::max(edge.y, edge.previousY));
+                band <= highBand; ++band) {
+                _bandEdges[bandStarts[band]++] = static_cast<uint32_t>(i);
+            }
+        }
+        for (int band = prepared.bandCount - 1; band > 0; --band) {
+            bandStarts[band] = bandStarts[band - 1];
+        }
+        bandStarts[0] = firstBandEdge;
+        return GetShapeCount() - 1;
+    }
+
+    // Monotonic in y, so an edge is in the band of every y it spans. Only called inside of the box.
+    int PreparedShapes::GetBand(const Shape& shape, double y) {
+        int band = static_cast<int>((y - shape.low.Y) * shape.bandsPerUnit);
+        return std::min(std::max(band, 0), shape.bandCount - 1);
+    }
+
+    bool PreparedShapes::IsPointInShape(int shape, VECTOR2D point) const {
+        const Shape& prepared = _shapes[shape];
+        if (prepared.bandCount == 0 || !(point.X >= prepared.low.X && point.X <= prepared.high.X && point.Y >= prepared.low.Y && point.Y <= prepared.high.Y)) {
+            return false;
+        }
+        bool result = false;
+        uint32_t band = prepared.firstBand + GetBand(prepared, point.Y);
+        for (uint32_t i = _bandStarts[band]; i < _bandStarts[band + 1]; ++i) {
+            const Edge& edge = _edges[_bandEdges[i]];
+            // The same comparisons and division as IsPointInShape, on the few edges of the band
+            if ((edge.y > point.Y) == (edge.previousY > point.Y)) {
+                continue;
+            }
+            if (point.X < (edge.previousX - edge.x) * (point.Y - edge.y) / (edge.previousY - edge.y) + edge.x) {
+                result = !result;
+            }
+        }
+        return result;
+    }
+
+    void PreparedShapes::ArePointsInShape(int shape, const double* x, const double* y, int count, bool* results) const {
+        for (int i = 0; i < count; ++i) {
+            results[i] = IsPointInShape(shape, VECTOR2D(x[i], y[i]));
+        }
+    }
+
+    // About one cell per shape, shapes spanning many cells are in each of them
+    static constexpr int kMaxGridSide = 1024;
+
+    void ShapeGrid::Build(const FLine* const* shapes, int count) {
+        _shapes.Clear();
+        int vertexCount = 0;
+        for (int i = 0; i < count; ++i) {
+            vertexCount += shapes[i] != nullptr ? shapes[i]->GetVertexCount() : 0;
+        }
+        _shapes.Reserve(count, vertexCount);
+        _columnCount = 0;
+        _rowCount = 0;
+        _cellStarts.clear();
+        _cellShapes.clear();
+        bool isEmpty = true;
+        for (int i = 0; i < count; ++i) {
+            _shapes.Add(shapes[i]);
+            if (_shapes.IsEmpty(i)) {
+                continue;
+            }
+            VECTOR2D low = _shapes.GetLow(i);
+            VECTOR2D high = _shapes.GetHigh(i);
+            _gridBounds = isEmpty ? Bounds{ low.X, low.Y, high.X, high.Y } : Bounds{ std::min(_gridBounds.lowX, low.X), std::min(_gridBounds.lowY, low.Y),
+                std::max(_gridBounds.highX, high.X), std::max(_gridBounds.highY, high.Y) };
+            isEmpty = false;
+        }
+        if (isEmpty) {
+            return;
+        }
+        int side = std::min(std::max(static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count)))), 1), kMaxGridSide);
+        _columnCount = side;
+        _rowCount = side;
+        _cellWidth = (_gridBounds.highX - _gridBounds.lowX) / side;
+        _cellHeight = (_gridBounds.highY - _gridBounds.lowY) / side;
+        // Counts the shapes of every cell, then fills them in, in the order of the shapes
+        _cellStarts.assign(GetCellCount() + 1, 0);
+        for (int pass = 0; pass < 2; ++pass) {
+            std::vector<uint32_t> cellEnds(_cellStarts.begin(), _cellStarts.end() - 1);
+            for (int i = 0; i < count; ++i) {
+                if (_shapes.IsEmpty(i)) {
+                    continue;
+                }
+                VECTOR2D low = _shapes.GetLow(i);
+                VECTOR2D high = _shapes.GetHigh(i);
+                for (int row = GetRow(low.Y); row <= GetRow(high.Y); ++row) {
+                    for (int column = GetColumn(low.X); column <= GetColumn(high.X); ++column) {
+                        int cell = row * _columnCount + column;
+                        if (pass == 0) {
+                            ++_cellStarts[cell + 1];
+                        }
+                        else {
+                            _cellShapes[cellEnds[cell]++] = static_cast<uint32_t>(i);
+                        }
+                    }
+                }
+            }
+            if (pass == 0) {
+                for (int cell = 0; cell < GetCellCount(); ++cell) {
+                    _cellStarts[cell + 1] += _cellStarts[cell];
+                }
+                _cellShapes.resize(_cellStarts.back());
+            }
+        }
+    }
+
+    // Monotonic in the coordinate, so a point inside of a box is in one of the cells of the box
+    int ShapeGrid::GetColumn(double x) const {
+        int column = _cellWidth > 0 ? static_cast<int>(std::floor((x - _gridBounds.lowX) / _cellWidth)) : 0;
+        return std::min(std::max(column, 0), _columnCount - 1);
+    }
+
+    int ShapeGrid::GetRow(double y) const {
+        int row = _cellHeight > 0 ? static_cast<int>(std::floor((y - _gridBounds.lowY) / _cellHeight)) : 0;
+        return std::min(std::max(row, 0), _rowCount - 1);
+    }
+
+    int ShapeGrid::FindFirstContainingShape(VECTOR2D point) const {
+        if (GetCellCount() == 0 || point.X < _gridBounds.lowX || point.X > _gridBounds.highX || point.Y < _gridBounds.lowY || point.Y > _gridBounds.highY) {
+            return -1;
+        }
+        int cell = GetRow(point.Y) * _columnCount + GetColumn(point.X);
+        for (uint32_t i = _cellStarts[cell]; i < _cellStarts[cell + 1]; ++i) {
+            uint32_t shape = _cellShapes[i];
+            if (_shapes.IsPointInShape(shape, point)) {
+                return static_cast<int>(shape);
+            }
+        }
+        return -1;
+    }
+
+    // Points per cell on average, and the cells at most per point when the points are not spread evenly
+    static constexpr double kPointsPerCell = 4;
+    static constexpr double kMaxCellsPerPoint = 4;
+
+    void PointGrid::Build(const VECTOR2D* points, int count) {
+        _columnCount = 0;
+        _rowCount = 0;
+        _cellStarts.clear();
+        _cellPoints.clear();
+        _cellPositions.clear();
+        if (count == 0) {
+            return;
+        }
+        VECTOR2D high = points[0];
+        _low = points[0];
+        for (int i = 1; i < count; ++i) {
+            _low = VECTOR2D(std::min(_low.X, points[i].X), std::min(_low.Y, points[i].Y));
+            high = VECTOR2D(std::max(high.X, points[i].X), std::max(high.Y, points[i].Y));
+        }
+        double width = high.X - _low.X;
+        double height = high.Y - _low.Y;
+        double extent = std::max(width, height);
+        _cellSize = std::sqrt(std::max(width * height, extent * extent / count) * kPointsPerCell / count);
+        if (!(_cellSize > 0)) {
+            _cellSize = 1;
+        }
+        _columnCount = static_cast<int>(width / _cellSize) + 1;
+        _rowCount = static_cast<int>(height / _cellSize) + 1;
+        double cellCount = static_cast<double>(_columnCount) * _rowCount;
+        if (cellCount > kMaxCellsPerPoint * count + 1) {
+            double scale = std::sqrt(cellCount / (kMaxCellsPerPoint * count + 1));
+            _cellSize *= scale;
+            _columnCount = static_cast<int>(width / _cellSize) + 1;
+            _rowCount = static_cast<int>(height / _cellSize) + 1;
+        }
+        std::vector<uint32_t> pointCells(count);
+        _cellStarts.assign(static_cast<size_t>(_columnCount) * _rowCount + 1, 0);
+        for (int i = 0; i < count; ++i) {
+            pointCells[i] = static_cast<uint32_t>(GetRow(points[i].Y) * _columnCount + GetColumn(points[i].X));
+            ++_cellStarts[pointCells[i] + 1];
+        }
+        for (size_t cell = 1; cell < _cellStarts.size(); ++cell) {
+            _cellStarts[cell] += _cellStarts[cell - 1];
+        }
+        std::vector<uint32_t> cellEnds(_cellStarts.begin(), _cellStarts.end() - 1);
+        _cellPoints.resize(count);
+        _cellPositions.resize(count);
+        for (int i = 0; i < count; ++i) {
+            uint32_t position = cellEnds[pointCells[i]]++;
+            _cellPoints[position] = static_cast<uint32_t>(i);
+            _cellPositions[position] = points[i];
+        }
+    }
+
+    int PointGrid::GetColumn(double x) const {
+        double column = std::floor((x - _low.X) / _cellSize);
+        return static_cast<int>(std::min(std::max(column, 0.0), _columnCount - 1.0));
+    }
+
+    int PointGrid::GetRow(double y) const {
+        double row = std::floor((y - _low.Y) / _cellSize);
+        return static_cast<int>(std::min(std::max(row, 0.0), _rowCount - 1.0));
+    }
+
+    void PointGrid::FindPointsInRadius(VECTOR2D center, double radius, std::vector<int>& points) const {
+        if (_columnCount == 0 || !(radius >= 0)) {
+            return;
+        }
+        double squaredRadius = radius * radius;
+        int lowRow = GetRow(center.Y - radius);
+        int highRow = GetRow(center.Y + radius);
+        int lowColumn = GetColumn(center.X - radius);
+        int highColumn = GetColumn(center.X + radius);
+        for (int row = lowRow; row <= highRow; ++row) {
+            for (int column = lowColumn; column <= highColumn; ++column) {
+                size_t cell = static_cast<size_t>(row) * _columnCount + column;
+                for (uint32_t i = _cellStarts[cell]; i < _cellStarts[cell + 1]; ++i) {
+                    double dx = _cellPositions[i].X - center.X;
+                    double dy = _cellPositions[i].Y - center.Y;
+                    if (dx * dx + dy * dy <= squaredRadius) {
+                        points.push_back(static_cast<int>(_cellPoints[i]));
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Excluded>
+    int PointGrid::FindNearestPointIf(VECTOR2D center, const Excluded& isExcluded, double* distance) const {
+        int result = -1;
+        double squaredDistance = std::numeric_limits<double>::infinity();
+        int centerRow = GetRow(center.Y);
+        int centerColumn = GetColumn(center.X);
+        int ringCount = std::max(_columnCount, _rowCount);
+        // Cells ring by ring around the cell of the center, the points beyond ring k are at least k cells away from it
+        for (int ring = 0; ring < ringCount; ++ring) {
+            for (int row = std::max(centerRow - ring, 0); row <= std::min(centerRow + ring, _rowCount - 1); ++row) {
+                bool isEdgeRow = row == centerRow - ring || row == centerRow + ring;
+                int step = isEdgeRow ? 1 : 2 * ring;
+                for (int column = centerColumn - ring; column <= centerColumn + ring; column += step) {
+                    if (column < 0 || column >= _columnCount) {
+                        continue;
+                    }
+                    size_t cell = static_cast<size_t>(row) * _columnCount + column;
+                    for (uint32_t i = _cellStarts[cell]; i < _cellStarts[cell + 1]; ++i) {
+                        double dx = _cellPositions[i].X - center.X;
+                        double dy = _cellPositions[i].Y - center.Y;
+                        double pointDistance = dx * dx + dy * dy;
+                        if (pointDistance < squaredDistance && !isExcluded(static_cast<int>(_cellPoints[i]))) {
+                            squaredDistance = pointDistance;
+                            result = static_cast<int>(_cellPoints[i]);
+                        }
+                    }
+                }
+            }
+            double reach = ring * _cellSize;
+            if (result >= 0 && squaredDistance <= reach * reach) {
+                break;
+            }
+        }
+        if (distance != nullptr) {
+            *distance = result >= 0 ? std::sqrt(squaredDistance) : -1;
+        }
+        return result;
+    }
+
+    int PointGrid::FindNearestPoint(VECTOR2D center, int excludedPoint, double* distance) const {
+        return FindNearestPointIf(center, [excludedPoint](int point) { return point == excludedPoint; }, distance);
+    }
+
+    int PointGrid::FindNearestPoint(VECTOR2D center, const std::function<bool(int point)>& isExcluded, double* distance) const {
+        return FindNearestPointIf(center, isExcluded, distance);
+    }
+
+    int32_t QuantizeCoordinate(double value, int32_t extent) {
+        return static_cast<int32_t>(std::llround(value * extent));
+    }
+
+    template<typename T>
+    static bool QuantizeLineTo(const FLine* line, int32_t extent, FQuantizedLine<T>& quantized) {
+        const int32_t low = std::max<int32_t>(std::numeric_limits<T>::min(), -kMaxQuantizedValue);
+        const int32_t high = std::min<int32_t>(std::numeric_limits<T>::max(), kMaxQuantizedValue);
+        FLineVertices vertices = line->GetVertices();
+        CLEAR(quantized.x);
+        CLEAR(quantized.y);
+        RESERVE(quantized.x, vertices.count);
+        RESERVE(quantized.y, vertices.count);
+        quantized.extent = extent;
+        quantized.isClosed = line->isClosed;
+        quantized.isClockwise = line->isClockwise;
+        for (int i = 0; i < vertices.count; ++i) {
+            // Range checked in double, values far outside of the tile would not fit the integer
+            VECTOR2D position = vertices.GetLocalPosition(i);
+            double x = std::round(position.X * extent);
+            double y = std::round(position.Y * extent);
+            if (!(x >= low && x <= high && y >= low && y <= high)) {
+                CLEAR(quantized.x);
+                CLEAR(quantized.y);
+                return false;
+            }
+            ADD(quantized.x, static_cast<T>(x));
+            ADD(quantized.y, static_cast<T>(y));
+        }
+        return true;
+    }
+
+    bool QuantizeLine(const FLine* line, int32_t extent, FQuantizedLine<int16_t>& quantized) {
+        return QuantizeLineTo(line, extent, quantized);
+    }
+
+    bool QuantizeLine(const FLine* line, int32_t extent, FQuantizedLine<int32_t>& quantized) {
+        return QuantizeLineTo(line, extent, quantized);
+    }
+
+    // Each term is below 2^42 within kMaxQuantizedValue
+    template<typename T>
+    static int64_t CalculateQuantizedArea(const T* x, const T* y, int count) {
+        int64_t result = 0;
+        for (int i = 0; i < count; ++i) {
+            int next = i + 1 < count ? i + 1 : 0;
+            result += (static_cast<int64_t>(x[next]) - x[i]) * (static_cast<int64_t>(y[next]) + y[i]);
+        }
+        return result;
+    }
+
+    int64_t CalculateShapeArea(const int16_t* x, const int16_t* y, int count) {
+        return CalculateQuantizedArea(x, y, count);
+    }
 
+    int64_t CalculateShapeArea(const int32_t* x, const int32_t* y, int count) {
+        return CalculateQuantizedArea(x, y, count);
+    }
+
+    bool CalculateShapeOrientation(const FQuantizedLine<int16_t>& shape) {
+        return CalculateShapeArea(DATA(shape.x), DATA(shape.y), shape.GetVertexCount()) > 0;
+    }
+
+    bool CalculateShapeOrientation(const FQuantizedLine<int32_t>& shape) {
+        return CalculateShapeArea(DATA(shape.x), DATA(shape.y), shape.GetVertexCount()) > 0;
+    }
+
+    // The crossing test of the double version with the division multiplied out, so it stays exact
+    template<typename T>
+    static bool IsPointInQuantizedShape(const FQuantizedLine<T>& shape, int64_t pointX, int64_t pointY) {
+        bool result = false;
+        const T* x = DATA(shape.x);
+        const T* y = DATA(shape.y);
+        for (int i = 0, j = shape.GetVertexCount() - 1; i < shape.GetVertexCount(); j = i++) {
+            if ((y[i] > pointY) != (y[j] > pointY)) {
+                int64_t deltaY = static_cast<int64_t>(y[j]) - y[i];
+                int64_t left = (pointX - x[i]) * deltaY;
+                int64_t right = (static_cast<int64_t>(x[j]) - x[i]) * (pointY - y[i]);
+                if (deltaY > 0 ? left < right : left > right) {
+                    result = !result;
+                }
+            }
+        }
         return result;
     }
 
+    bool IsPointInShape(const FQuantizedLine<int16_t>& shape, int32_t x, int32_t y) {
+        return IsPointInQuantizedShape(shape, x, y);
+    }
+
+    bool IsPointInShape(const FQuantizedLine<int32_t>& shape, int32_t x, int32_t y) {
+        return IsPointInQuantizedShape(shape, x, y);
+    }
+
+    static bool IsInside(VECTOR2D point, VECTOR2D low, VECTOR2D high) {
+        return point.X >= low.X && point.X <= high.X && point.Y >= low.Y && point.Y <= high.Y;
+    }
+
+    // A vertex while clipping, with both of its positions and its vertex in the pool of the tile
+    struct ClipVertex {
+        LatLong globalPosition;
+        VECTOR2D localPosition;
+        uint32_t vertexIndex;
+    };
+
+    static ClipVertex GetClipVertex(const FLineVertices& vertices, int i) {
+        return { vertices.GetGlobalPosition(i), vertices.GetLocalPosition(i), vertices.vertexIndices != nullptr ? vertices.vertexIndices[i] : FVertexPool::kNoVertex };
+    }
+
+    // Lines refer to the pool only if the line they were cut from did
+    static void AddClipVertex(FLine* line, const ClipVertex& vertex, bool hasVertexIndices) {
+        if (hasVertexIndices) {
+            line->AddVertex(vertex.globalPosition, vertex.localPosition, vertex.vertexIndex);
+        }
+        else {
+            line->AddVertex(vertex.globalPosition, vertex.localPosition);
+        }
+    }
+
+    static ClipVertex CreateInterpolatedVertex(const ClipVertex& from, const ClipVertex& to, double t) {
+        ClipVertex vertex;
+        vertex.vertexIndex = FVertexPool::kNoVertex;
+        vertex.localPosition = VECTOR2D(from.localPosition.X + (to.localPosition.X - from.localPosition.X) * t,
+            from.localPosition.Y + (to.localPosition.Y - from.localPosition.Y) * t);
+        // Local positions are linear in the global ones, so the same fraction applies
+        vertex.globalPosition = LatLong(from.globalPosition.latitude + (to.globalPosition.latitude - from.globalPosition.latitude) * t,
+            from.globalPosition.longitude + (to.globalPosition.longitude - from.globalPosition.longitude) * t);
+        return vertex;
+    }
+
+    // One step of Sutherland-Hodgman: keeps the part of the ring on the inner side of a single border line. The border is
+    // x = limit for axis 0 and y = limit for axis 1, isLowSide keeps the values above the limit.
+    static void ClipRingAgainstBorder(const ARRAY<ClipVertex>& input, int axis, double limit, bool isLowSide, ARRAY<ClipVertex>& output) {
+        CLEAR(output);
+        size_t count = SIZE(input);
+        auto getValue = [axis](const ClipVertex& vertex) { return axis == 0 ? vertex.localPosition.X : vertex.localPosition.Y; };
+        auto isInside = [&](const ClipVertex& vertex) { return isLowSide ? getValue(vertex) >= limit : getValue(vertex) <= limit; };
+        for (size_t i = 0; i < count; ++i) {
+            const ClipVertex& current = input[i];
+            const ClipVertex& previous = input[(i + count - 1) % count];
+            bool isCurrentInside = isInside(current);
+            if (isCurrentInside != isInside(previous)) {
+                double t = (limit - getValue(previous)) / (getValue(current) - getValue(previous));
+                ADD(output, CreateInterpolatedVertex(previous, current, t));
+            }
+            if (isCurrentInside) {
+                ADD(output, current);
+            }
+        }
+    }
+
+    static bool IsAllInside(const FLineVertices& vertices, VECTOR2D low, VECTOR2D high) {
+        for (int i = 0; i < vertices.count; ++i) {
+            if (!IsInside(vertices.GetLocalPosition(i), low, high)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FLine* ClipRing(FLine* ring, VECTOR2D low, VECTOR2D high, MemoryArena& arena) {
+        FLineVertices vertices = ring->GetVertices();
+        int count = vertices.count;
+        if (count == 0) {
+            return nullptr;
+        }
+        if (IsAllInside(vertices, low, high)) {
+            return ring;
+        }
+
+        // Rings of closed ways repeat their first vertex at the end, the clipped ring does the same
+        bool isRepeatingFirst = count > 1 && vertices.GetGlobalPosition(0).Equals(vertices.GetGlobalPosition(count - 1));
+        ARRAY<ClipVertex> current;
+        for (int i = 0; i < count - (isRepeatingFirst ? 1 : 0); ++i) {
+            ADD(current, GetClipVertex(vertices, i));
+        }
+        ARRAY<ClipVertex> next;
+        ClipRingAgainstBorder(current, 0, low.X, true, next);
+        ClipRingAgainstBorder(next, 0, high.X, false, current);
+        ClipRingAgainstBorder(current, 1, low.Y, true, next);
+        ClipRingAgainstBorder(next, 1, high.Y, false, current);
+        if (SIZE(current) < 3) {
+            return nullptr;
+        }
+        if (isRepeatingFirst) {
+            ADD(current, current[0]);
+        }
+
+        FLine* clipped = arena.New<FLine>();
+        clipped->ReserveVertices(SIZE(current));
+        for (const ClipVertex& vertex : current) {
+            AddClipVertex(clipped, vertex, vertices.vertexIndices != nullptr);
+        }
+        clipped->isClosed = ring->isClosed;
+        clipped->isClockwise = CalculateShapeOrientation(clipped);
+        return clipped;
+    }
+
+    // Liang-Barsky: narrows [t0, t1] of the segment from -> from + delta to the part inside the rectangle. False if
+    // nothing of it is inside.
+    static bool ClipSegment(VECTOR2D from, VECTOR2D delta, VECTOR2D low, VECTOR2D high, double& t0, double& t1) {
+        const double p[4] = { -delta.X, delta.X, -delta.Y, delta.Y };
+        const double q[4] = { from.X - low.X, high.X - from.X, from.Y - low.Y, high.Y - from.Y };
+        t0 = 0;
+        t1 = 1;
+        for (int i = 0; i < 4; ++i) {
+            if (p[i] == 0) {
+                if (q[i] < 0) {
+                    return false;
+                }
+                continue;
+            }
+            double t = q[i] / p[i];
+            if (p[i] < 0) {
+                t0 = MAX(t0, t);
+            }
+            else {
+                t1 = std::min(t1, t);
+            }
+        }
+        return t0 <= t1;
+    }
+
+    void ClipLine(FLine* line, VECTOR2D low, VECTOR2D high, MemoryArena& arena, ARRAY<FLine*>& pieces) {
+        FLineVertices vertices = line->GetVertices();
+        int count = vertices.count;
+        if (count == 1) {
+            if (IsInside(vertices.GetLocalPosition(0), low, high)) {
+                ADD(pieces, line);
+            }
+            return;
+        }
+        if (IsAllInside(vertices, low, high)) {
+            ADD(pieces, line);
+            return;
+        }
+
+        size_t firstPiece = SIZE(pieces);
+        FLine* piece = nullptr;
+        for (int i = 0; i + 1 < count; ++i) {
+            ClipVertex from = GetClipVertex(vertices, i);
+            ClipVertex to = GetClipVertex(vertices, i + 1);
+            VECTOR2D delta(to.localPosition.X - from.localPosition.X, to.localPosition.Y - from.localPosition.Y);
+            double t0;
+            double t1;
+            if (!ClipSegment(from.localPosition, delta, low, high, t0, t1)) {
+                piece = nullptr;
+                continue;
+            }
+            if (piece == nullptr) {
+                piece = arena.New<FLine>();
+                piece->isClosed = false;
+                ClipVertex first = t0 > 0 ? CreateInterpolatedVertex(from, to, t0) : from;
+                AddClipVertex(piece, first, vertices.vertexIndices != nullptr);
+                ADD(pieces, piece);
+            }
+            ClipVertex last = t1 < 1 ? CreateInterpolatedVertex(from, to, t1) : to;
+            AddClipVertex(piece, last, vertices.vertexIndices != nullptr);
+            if (t1 < 1) {
+                piece = nullptr;
+            }
+        }
+        for (size_t i = firstPiece; i < SIZE(pieces); ++i) {
+            pieces[i]->isClockwise = CalculateShapeOrientation(pieces[i]);
+        }
+    }
+
 }
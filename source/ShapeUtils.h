@@ -1,11 +1,159 @@
 #pragma once
 
 #include "FTileMapData.h"
+#include "MemoryArena.h"
+
+#include <functional>
+#include <vector>
 
 namespace ShapeUtils {
 
-double CalculateShapeArea(FLine* shape, bool global = false);
-bool CalculateShapeOrientation(FLine* shape);
-bool IsPointInShape(FLine* shape, VECTOR2D point);
+// Twice the area of the ring of count vertices by the shoelace formula, its sign tells the orientation. The ring is
+// closed from its last vertex to its first. Uses AVX2 or SSE2 where the machine has them, the result is the same bit
+// for bit on every machine: the terms are summed in the same order and ShapeUtils.cpp is compiled without contracting
+// them into fused multiply-adds.
+double CalculateShapeArea(const double* x, const double* y, int count);
+// The same without vector instructions, the reference the kernels are checked against
+double CalculateShapeAreaScalar(const double* x, const double* y, int count);
+double CalculateShapeArea(const FLine* shape, bool global = false);
+bool CalculateShapeOrientation(const FLine* shape);
+// The area and the orientation of many rings in one call, e.g. of all the buildings of a tile, the same as the
+// functions above give one by one. Either output may be null.
+void CalculateShapeAreas(const FLine* const* shapes, int count, bool global, double* areas, bool* orientations);
+bool IsPointInShape(const FLine* shape, VECTOR2D point);
+// The center of mass of a ring, the average of its vertices if it has no area
+VECTOR2D CalculateShapeCentroid(const FLine* shape, bool global = false);
+
+// Rings prepared for testing many points in local coordinates: the box of each and the edges crossing each horizontal
+// band of the box, so a point is only tested against the few edges of its band. The edges of all rings share a few
+// arrays, so preparing thousands of rings allocates a few times. Gives the same result as IsPointInShape on the ring a
+// shape was prepared from.
+class PreparedShapes {
+public:
+	void Clear();
+	void Reserve(int shapeCount, int vertexCount);
+	// Index of the prepared shape. A null shape or one without vertices contains no point.
+	int Add(const FLine* shape);
+	int GetShapeCount() const { return static_cast<int>(_shapes.size()); }
+	bool IsEmpty(int shape) const { return _shapes[shape].bandCount == 0; }
+	// No point outside of the box of a shape is in it
+	VECTOR2D GetLow(int shape) const { return _shapes[shape].low; }
+	VECTOR2D GetHigh(int shape) const { return _shapes[shape].high; }
+	bool IsPointInShape(int shape, VECTOR2D point) const;
+	// The same for the count points of the coordinate streams
+	void ArePointsInShape(int shape, const double* x, const double* y, int count, bool* results) const;
+
+private:
+	// From the vertex x, y to the vertex before it. Horizontal edges are never crossed and are left out.
+	struct Edge {
+		double x;
+		double y;
+		double previousX;
+		double previousY;
+	};
+	// The edges of band i are _bandEdges[_bandStarts[firstBand + i]] up to _bandEdges[_bandStarts[firstBand + i + 1]]
+	struct Shape {
+		VECTOR2D low;
+		VECTOR2D high;
+		double bandsPerUnit;
+		int bandCount;
+		uint32_t firstBand;
+	};
+	static int GetBand(const Shape& shape, double y);
+
+	std::vector<Shape> _shapes;
+	std::vector<Edge> _edges;
+	std::vector<uint32_t> _bandStarts;
+	std::vector<uint32_t> _bandEdges;
+};
+
+// Uniform grid over the bounding boxes of shapes in local coordinates, so that a point is only tested against the
+// shapes whose box is in its cell. Cells keep the shapes in the order they were given, they are prepared when the grid
+// is built.
+class ShapeGrid {
+public:
+	// Null shapes and shapes without vertices are never found
+	void Build(const FLine* const* shapes, int count);
+	// Index of the first shape containing the point by IsPointInShape, the same one testing every shape in order gives.
+	// -1 if none does.
+	int FindFirstContainingShape(VECTOR2D point) const;
+	int GetCellCount() const { return _columnCount * _rowCount; }
+
+private:
+	struct Bounds {
+		double lowX;
+		double lowY;
+		double highX;
+		double highY;
+	};
+	int GetColumn(double x) const;
+	int GetRow(double y) const;
+
+	PreparedShapes _shapes;
+	Bounds _gridBounds = { 0, 0, 0, 0 };
+	double _cellWidth = 1;
+	double _cellHeight = 1;
+	int _columnCount = 0;
+	int _rowCount = 0;
+	// The shapes of cell i are _cellShapes[_cellStarts[i]] up to _cellShapes[_cellStarts[i + 1]]
+	std::vector<uint32_t> _cellStarts;
+	std::vector<uint32_t> _cellShapes;
+};
+
+// Uniform grid over points with a few points in each cell, for the points within a radius of a position and the
+// nearest point to it. Distances are in the units of the points.
+class PointGrid {
+public:
+	void Build(const VECTOR2D* points, int count);
+	// Appends the indices of the points within the radius, in no particular order
+	void FindPointsInRadius(VECTOR2D center, double radius, std::vector<int>& points) const;
+	// Index of the nearest point other than the excluded one, -1 if there is none
+	int FindNearestPoint(VECTOR2D center, int excludedPoint = -1, double* distance = nullptr) const;
+	// The same skipping every point the function excludes, e.g. the other parts of a building
+	int FindNearestPoint(VECTOR2D center, const std::function<bool(int point)>& isExcluded, double* distance = nullptr) const;
+
+private:
+	template<typename Excluded>
+	int FindNearestPointIf(VECTOR2D center, const Excluded& isExcluded, double* distance) const;
+	int GetColumn(double x) const;
+	int GetRow(double y) const;
+
+	VECTOR2D _low;
+	double _cellSize = 1;
+	int _columnCount = 0;
+	int _rowCount = 0;
+	// The points of cell i are _cellPoints[_cellStarts[i]] up to _cellPoints[_cellStarts[i + 1]], copied in that order
+	// to _cellPositions
+	std::vector<uint32_t> _cellStarts;
+	std::vector<uint32_t> _cellPoints;
+	std::vector<VECTOR2D> _cellPositions;
+};
+
+// Quantized lines keep local coordinates on an integer grid, see FQuantizedLine. Values are limited to
+// [-kMaxQuantizedValue, kMaxQuantizedValue] so that the integer shoelace sum is exact in 64 bits.
+constexpr int32_t kMaxQuantizedValue = 1 << 20;
+// The nearest grid value of a local coordinate. Quantizing the local coordinate of a grid value gives it back exactly.
+int32_t QuantizeCoordinate(double value, int32_t extent);
+// Fails if a vertex is outside of the range of T or of kMaxQuantizedValue, e.g. when the extent is too large for
+// int16_t, the quantized line is then empty
+bool QuantizeLine(const FLine* line, int32_t extent, FQuantizedLine<int16_t>& quantized);
+bool QuantizeLine(const FLine* line, int32_t extent, FQuantizedLine<int32_t>& quantized);
+// The same as for local coordinates in grid units, exact
+int64_t CalculateShapeArea(const int16_t* x, const int16_t* y, int count);
+int64_t CalculateShapeArea(const int32_t* x, const int32_t* y, int count);
+bool CalculateShapeOrientation(const FQuantizedLine<int16_t>& shape);
+bool CalculateShapeOrientation(const FQuantizedLine<int32_t>& shape);
+// The point is in grid units
+bool IsPointInShape(const FQuantizedLine<int16_t>& shape, int32_t x, int32_t y);
+bool IsPointInShape(const FQuantizedLine<int32_t>& shape, int32_t x, int32_t y);
+
+// Clipping works in local coordinates between the low and high corners of an axis aligned rectangle. Lines entirely
+// inside are returned as they are, the others are copied into new lines made in the arena, with the vertices made on the
+// border getting an interpolated global position.
+
+// The part of a ring inside the rectangle, closed along its border. Null if nothing of the ring is inside.
+FLine* ClipRing(FLine* ring, VECTOR2D low, VECTOR2D high, MemoryArena& arena);
+// Cuts a line into the pieces that are inside the rectangle, they are appended in the order of the line
+void ClipLine(FLine* line, VECTOR2D low, VECTOR2D high, MemoryArena& arena, ARRAY<FLine*>& pieces);
 
-}
\ No newline at end of file
+}
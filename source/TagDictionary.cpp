@@ -0,0 +1,95 @@
+#include "TagDictionary.h"
+
+#include <cstring>
+#include <mutex>
+
+namespace Osm {
+
+	static const char* const kWellKnownTags[kWellKnownTagCount] = {
+		"highway",
+		"surface",
+		"landuse",
+		"building",
+		"building:part",
+		"height",
+		"min-height",
+		"levels",
+		"roof:shape",
+		"building:colour",
+		"roof:colour"
+	};
+
+	TagDictionary::TagDictionary() {
+		InternWellKnownTags();
+	}
+
+	void TagDictionary::InternWellKnownTags() {
+		for (const char* tag : kWellKnownTags) {
+			InternLocked(tag);
+		}
+	}
+
+	uint32_t TagDictionary::Intern(std::string_view text) {
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			auto iterator = _ids.find(text);
+			if (iterator != _ids.end()) {
+				return iterator->second;
+			}
+		}
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		return InternLocked(text);
+	}
+
+	uint32_t TagDictionary::InternLocked(std::string_view text) {
+		// Another thread may have added it since the shared lock
+		auto iterator = _ids.find(text);
+		if (iterator != _ids.end()) {
+			return iterator->second;
+		}
+		char* storedText = static_cast<char*>(_storage.Allocate(text.size() + 1, 1));
+		memcpy(storedText, text.data(), text.size());
+		storedText[text.size()] = '\0';
+		std::string_view stored(storedText, text.size());
+		uint32_t id = static_cast<uint32_t>(_strings.size());
+		_strings.push_back(stored);
+		_ids.emplace(stored, id);
+		return id;
+	}
+
+	uint32_t TagDictionary::Find(std::string_view text) const {
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		auto iterator = _ids.find(text);
+		return iterator != _ids.end() ? iterator->second : kInvalidId;
+	}
+
+	std::string_view TagDictionary::GetString(uint32_t id) const {
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		return id < _strings.size() ? _strings[id] : std::string_view("");
+	}
+
+	size_t TagDictionary::GetCount() const {
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		return _strings.size();
+	}
+
+	size_t TagDictionary::GetMemoryBytes() const {
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		// The hash map nodes are estimated as a key, a value and a next pointer each
+		return _storage.GetReservedBytes() + _strings.capacity() * sizeof(std::string_view) +
+			_ids.bucket_count() * sizeof(void*) + _ids.size() * (sizeof(std::string_view) + sizeof(uint32_t) + sizeof(void*));
+	}
+
+	void TagDictionary::Reset() {
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		std::unordered_map<std::string_view, uint32_t>().swap(_ids);
+		std::vector<std::string_view>().swap(_strings);
+		_storage.Release();
+		InternWellKnownTags();
+	}
+
+	TagDictionary& GetTagDictionary() {
+		static TagDictionary dictionary;
+		return dictionary;
+	}
+}
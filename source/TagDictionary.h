@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryArena.h"
+
+namespace Osm {
+
+struct OsmTag {
+	uint32_t key;
+	uint32_t value;
+};
+
+// The keys the output features are built from. They are interned first, in this order, so their ids are constants.
+constexpr uint32_t kTagHighway = 0;
+constexpr uint32_t kTagSurface = 1;
+constexpr uint32_t kTagLanduse = 2;
+constexpr uint32_t kTagBuilding = 3;
+constexpr uint32_t kTagBuildingPart = 4;
+constexpr uint32_t kTagHeight = 5;
+constexpr uint32_t kTagMinHeight = 6;
+constexpr uint32_t kTagLevels = 7;
+constexpr uint32_t kTagRoofShape = 8;
+constexpr uint32_t kTagBuildingColour = 9;
+constexpr uint32_t kTagRoofColour = 10;
+constexpr uint32_t kWellKnownTagCount = 11;
+
+// Interned tag keys and values. Every distinct string is stored once and entities refer to it by id, so comparing tags
+// is comparing integers. Strings are never removed and their views stay valid for the lifetime of the dictionary. All
+// methods are safe to call from several threads.
+class TagDictionary {
+public:
+	static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+	TagDictionary();
+	TagDictionary(const TagDictionary&) = delete;
+	TagDictionary& operator=(const TagDictionary&) = delete;
+
+	// Returns the id of the string, adding it if it is new
+	uint32_t Intern(std::string_view text);
+	// Returns kInvalidId for strings that were never interned
+	uint32_t Find(std::string_view text) const;
+	// The view is null-terminated
+	std::string_view GetString(uint32_t id) const;
+	size_t GetCount() const;
+	size_t GetMemoryBytes() const;
+	// Drops every string but the well-known keys and returns their memory, so that a long running process does not
+	// keep the strings of every input it has read. The ids and views handed out before are invalid afterwards: call it
+	// only when no cache holds entities and no tag filter is in use, e.g. between the calls of MapDataUtils, whose
+	// caches are empty once a call returns.
+	void Reset();
+
+private:
+	// Call with the unique lock held
+	uint32_t InternLocked(std::string_view text);
+	void InternWellKnownTags();
+
+	mutable std::shared_mutex _mutex;
+	std::unordered_map<std::string_view, uint32_t> _ids;
+	std::vector<std::string_view> _strings;
+	MemoryArena _storage;
+};
+
+// The dictionary all entities share. It lives as long as the process, see TagDictionary::Reset.
+TagDictionary& GetTagDictionary();
+
+}
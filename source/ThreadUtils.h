@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ThreadUtils {
+
+inline int32_t GetHardwareThreadCount() {
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? static_cast<int32_t>(count) : 1;
+}
+
+// Calls function(i) for every i in [0, count). Indices are handed out one at a time to up to threadCount threads
+// (the calling thread included, a non-positive count means one per core), so uneven work items balance out.
+template<typename Function>
+void ParallelFor(size_t count, int32_t threadCount, const Function& function) {
+	if (threadCount <= 0) {
+		threadCount = GetHardwareThreadCount();
+	}
+	size_t workerCount = std::min(count, static_cast<size_t>(threadCount));
+	if (workerCount <= 1) {
+		for (size_t i = 0; i < count; ++i) {
+			function(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> nextIndex(0);
+	auto worker = [&]() {
+		for (size_t i = nextIndex.fetch_add(1); i < count; i = nextIndex.fetch_add(1)) {
+			function(i);
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(workerCount - 1);
+	for (size_t i = 1; i < workerCount; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+// Worker threads that live as long as the pool, for callers that run many short parallel loops. Start() hands a loop
+// to the workers and returns right away, so the calling thread can do other work until it calls Wait(), which also
+// helps with the indices not taken yet. With a thread count of one there are no workers and Wait() runs the whole loop.
+class ThreadPool {
+public:
+	// The calling thread counts as one of the threads, a non-positive count means one per core
+	explicit ThreadPool(int32_t threadCount = 0) {
+		if (threadCount <= 0) {
+			threadCount = GetHardwareThreadCount();
+		}
+		_threadCount = threadCount;
+		_workers.reserve(static_cast<size_t>(threadCount - 1));
+		for (int32_t i = 1; i < threadCount; ++i) {
+			_workers.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_isStopping = true;
+		}
+		_wake.notify_all();
+		for (std::thread& worker : _workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int32_t GetThreadCount() const { return _threadCount; }
+
+	// Starts calling function(i) for every i in [0, count). Only one loop runs at a time, Wait() must be called
+	// before the next Start().
+	void Start(size_t count, std::function<void(size_t)> function) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_function = std::move(function);
+			_count = count;
+			_nextIndex.store(0);
+			_busyWorkerCount = _workers.size();
+			++_generation;
+		}
+		_wake.notify_all();
+	}
+
+	void Wait() {
+		RunItems();
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this]() { return _busyWorkerCount == 0; });
+		_function = nullptr;
+	}
+
+	template<typename Function>
+	void ParallelFor(size_t count, const Function& function) {
+		Start(count, function);
+		Wait();
+	}
+
+private:
+	void RunItems() {
+		for (size_t i = _nextIndex.fetch_add(1); i < _count; i = _nextIndex.fetch_add(1)) {
+			_function(i);
+		}
+	}
+
+	void WorkerLoop() {
+		uint64_t seenGeneration = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [&]() { return _isStopping || _generation != seenGeneration; });
+				if (_isStopping) {
+					return;
+				}
+				seenGeneration = _generation;
+			}
+			RunItems();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (--_busyWorkerCount == 0) {
+					_done.notify_all();
+				}
+			}
+		}
+	}
+
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	std::function<void(size_t)> _function;
+	std::atomic<size_t> _nextIndex{ 0 };
+	size_t _count = 0;
+	size_t _busyWorkerCount = 0;
+	uint64_t _generation = 0;
+	int32_t _threadCount = 1;
+	bool _isStopping = false;
+};
+
+}
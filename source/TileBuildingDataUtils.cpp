@@ -1,88 +1,219 @@
 #include "TileBuildingDataUtils.hpp"
 
 #include "MapDataUtils.h"
+#include "OsmIdIndex.h"
 #include "ShapeUtils.h"
 #include "TileUtils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 static constexpr int kZoomLevel = 14;
+static constexpr double kPi = 3.14159265358979323846;
+// Meters per degree of latitude, and of longitude at the equator
+static constexpr double kMetersPerDegree = 6378137.0 * kPi / 180.0;
+
+static LatLong GetCentroid(const FLine* shape) {
+	VECTOR2D centroid = ShapeUtils::CalculateShapeCentroid(shape, true);
+	return LatLong(centroid.X, centroid.Y);
+}
 
 double* get_building_location(const char* osmData) {
 	FTileMapData mapData;
-	std::string osmDataStr(osmData);
-	MapDataUtils::ProcessMapDataFromOsm(osmData, &mapData);
+	MapDataUtils::ProcessMapDataFromOsm(osmData, strlen(osmData), &mapData);
 	static double result[3] = { -1, -1, -1 };
 	if (SIZE(mapData.buildings) > 0) {
-		FLine* mainComponent = mapData.buildings[0]->geometry->GetMainSegment();
-		if (mainComponent != nullptr && SIZE(mainComponent->coordinates) > 0) {
-			result[0] = mainComponent->coordinates[0]->globalPosition.latitude;
-			result[1] = mainComponent->coordinates[0]->globalPosition.longitude;
+		const FLine* mainComponent = mapData.buildings[0]->geometry->GetMainSegment();
+		if (mainComponent != nullptr && mainComponent->GetVertexCount() > 0) {
+			result[0] = mainComponent->GetGlobalPosition(0).latitude;
+			result[1] = mainComponent->GetGlobalPosition(0).longitude;
 			result[2] = ShapeUtils::CalculateShapeArea(mainComponent, true);
 		}
 	}
 	return result;
 }
 
-BuildingEnvironmentData get_building_environment_data(const char* osmData, int64_t buildingId) {
-	BuildingEnvironmentData data;
+// Meters along the earth between two points
+static double GetDistance(LatLong from, LatLong to) {
+	double latitudeSine = std::sin((to.latitude - from.latitude) * kPi / 360.0);
+	double longitudeSine = std::sin((to.longitude - from.longitude) * kPi / 360.0);
+	double a = latitudeSine * latitudeSine +
+		std::cos(from.latitude * kPi / 180.0) * std::cos(to.latitude * kPi / 180.0) * longitudeSine * longitudeSine;
+	return 2 * 6378137.0 * std::asin(std::sqrt(std::min(a, 1.0)));
+}
+
+// The main segments of the buildings with their areas and centroids. The grid is over the centroids in meters on a
+// plane touching the earth at the center of the data, which stretches distances east of it away from that latitude, so
+// it only finds the candidates and their distances are measured on the earth.
+struct BuildingEnvironment {
 	FTileMapData mapData;
-	std::string osmDataStr(osmData);
-	MapDataUtils::ProcessMapDataFromOsm(osmData, &mapData);
-	bool foundBuilding = false;
-	double averageBuildingAreaNearby = 0.0;
-	int buildingCountNearby = 0;
+	std::vector<const FLine*> segments;
+	std::vector<FBuildingData*> segmentBuildings;
+	std::vector<double> areas;
+	std::vector<LatLong> centroids;
+	std::vector<VECTOR2D> gridCentroids;
+	ShapeUtils::PointGrid centroidGrid;
+	// At most this many meters on the grid for a meter on the earth, the factor of the search radius on it
+	double gridScale = 1;
+	// Building id -> its last segment
+	Osm::OsmIdIndex segmentIndex;
+};
+
+BuildingEnvironmentData get_building_environment_data(const char* osmData, int64_t buildingId) {
+	return get_building_environment_data_in_radius(osmData, buildingId, 0);
+}
+
+BuildingEnvironmentData get_building_environment_data_in_radius(const char* osmData, int64_t buildingId, double radius) {
+	BuildingEnvironment* environment = create_building_environment(osmData);
+	BuildingEnvironmentData data = query_building_environment(environment, buildingId, radius);
+	destroy_building_environment(environment);
+	return data;
+}
+
+BuildingEnvironment* create_building_environment(const char* osmData) {
+	BuildingEnvironment* environment = new BuildingEnvironment();
+	FTileMapData& mapData = environment->mapData;
+	MapDataUtils::ProcessMapDataFromOsm(osmData, strlen(osmData), &mapData);
 	for (size_t i = 0; i < SIZE(mapData.buildings); ++i) {
-		FBuildingData* buildingData = mapData.buildings[i];
-		if (buildingId == buildingData->id) {
-			FLine* mainComponent = buildingData->geometry->GetMainSegment();
-			if (mainComponent != nullptr && SIZE(mainComponent->coordinates) > 0) {
-				data.latitude = mainComponent->coordinates[0]->globalPosition.latitude;
-				data.longitude = mainComponent->coordinates[0]->globalPosition.longitude;
-				data.buildingArea = std::abs(ShapeUtils::CalculateShapeArea(mainComponent, true)) * 1000000;
-				data.buildingKind = static_cast<int>(buildingData->kind);
-				data.roofShape = static_cast<int>(buildingData->roofShape);
-				data.isRoofShapeKnown = buildingData->roofShape != RoofShape::Unknown;
-				data.isHeightKnown = buildingData->isHeightKnown;
-				data.height = data.isHeightKnown ? buildingData->height : 0;
-				data.buildingLanduseKind = static_cast<int>(buildingData->belongingLanduse->kind);
-				data.buildingColor = static_cast<int>(buildingData->buildingColor);
-				data.isBuildingColorKnown = buildingData->buildingColor != ColorProperty::Unknown;
-				data.roofColor = static_cast<int>(buildingData->roofColor);
-				data.isRoofColorKnown = buildingData->roofColor != ColorProperty::Unknown;
-				foundBuilding = true;
+		const FLine* mainComponent = mapData.buildings[i]->geometry->GetMainSegment();
+		if (mainComponent != nullptr && mainComponent->GetVertexCount() > 0) {
+			environment->segmentIndex.Assign(static_cast<uint64_t>(mapData.buildings[i]->id), static_cast<uint32_t>(environment->segments.size()));
+			environment->segments.push_back(mainComponent);
+			environment->segmentBuildings.push_back(mapData.buildings[i]);
+		}
+	}
+	size_t segmentCount = environment->segments.size();
+	// The areas of all buildings in one call
+	environment->areas.resize(segmentCount);
+	ShapeUtils::CalculateShapeAreas(environment->segments.data(), static_cast<int>(segmentCount), true, environment->areas.data(), nullptr);
+	std::vector<LatLong>& centroids = environment->centroids;
+	centroids.resize(segmentCount);
+	LatLong low(90, 180);
+	LatLong high(-90, -180);
+	for (size_t segment = 0; segment < segmentCount; ++segment) {
+		environment->areas[segment] = std::abs(environment->areas[segment]) * 1000000;
+		centroids[segment] = GetCentroid(environment->segments[segment]);
+		low = LatLong(std::min(low.latitude, centroids[segment].latitude), std::min(low.longitude, centroids[segment].longitude));
+		high = LatLong(std::max(high.latitude, centroids[segment].latitude), std::max(high.longitude, centroids[segment].longitude));
+	}
+	LatLong origin((low.latitude + high.latitude) / 2, (low.longitude + high.longitude) / 2);
+	double longitudeScale = kMetersPerDegree * std::cos(origin.latitude * kPi / 180.0);
+	environment->gridCentroids.resize(segmentCount);
+	for (size_t segment = 0; segment < segmentCount; ++segment) {
+		environment->gridCentroids[segment] = VECTOR2D((centroids[segment].longitude - origin.longitude) * longitudeScale,
+			(centroids[segment].latitude - origin.latitude) * kMetersPerDegree);
+	}
+	environment->centroidGrid.Build(environment->gridCentroids.data(), static_cast<int>(segmentCount));
+	// East of it the grid stretches the most at the latitude farthest from the equator, with a margin for the curvature
+	if (segmentCount > 0) {
+		double farthestLatitude = std::min(std::max(std::abs(low.latitude), std::abs(high.latitude)), 89.0);
+		environment->gridScale = std::max(1.0, std::cos(origin.latitude * kPi / 180.0) / std::cos(farthestLatitude * kPi / 180.0)) * 1.01;
+	}
+	return environment;
+}
+
+BuildingEnvironmentData query_building_environment(const BuildingEnvironment* environment, int64_t buildingId, double radius) {
+	BuildingEnvironmentData data;
+	uint32_t building = environment->segmentIndex.Find(static_cast<uint64_t>(buildingId));
+	if (building == Osm::OsmIdIndex::kInvalidIndex) {
+		return data;
+	}
+	data.isBuildingFound = true;
+	const FBuildingData* buildingData = environment->segmentBuildings[building];
+	const FLine* mainComponent = environment->segments[building];
+	data.latitude = mainComponent->GetGlobalPosition(0).latitude;
+	data.longitude = mainComponent->GetGlobalPosition(0).longitude;
+	data.buildingArea = environment->areas[building];
+	data.buildingKind = static_cast<int>(buildingData->kind);
+	data.roofShape = static_cast<int>(buildingData->roofShape);
+	data.isRoofShapeKnown = buildingData->roofShape != RoofShape::Unknown;
+	data.isHeightKnown = buildingData->isHeightKnown;
+	data.height = data.isHeightKnown ? buildingData->height : 0;
+	// Buildings outside of every landuse area have the kind of none
+	data.buildingLanduseKind = buildingData->belongingLanduse != nullptr ? static_cast<int>(buildingData->belongingLanduse->kind) : 0;
+	data.buildingColor = static_cast<int>(buildingData->buildingColor);
+	data.isBuildingColorKnown = buildingData->buildingColor != ColorProperty::Unknown;
+	data.roofColor = static_cast<int>(buildingData->roofColor);
+	data.isRoofColorKnown = buildingData->roofColor != ColorProperty::Unknown;
+
+	// Parts of the building with the same id are not its neighbors
+	auto isSameBuilding = [environment, buildingId](int segment) { return environment->segmentBuildings[segment]->id == buildingId; };
+	LatLong centroid = environment->centroids[building];
+	VECTOR2D gridCenter = environment->gridCentroids[building];
+	// Nothing nearer on the earth than the nearest one on the grid can be farther on the grid than the scaled distance to it
+	std::vector<int> candidates;
+	int nearest = environment->centroidGrid.FindNearestPoint(gridCenter, isSameBuilding, nullptr);
+	if (nearest >= 0) {
+		double nearestDistance = GetDistance(centroid, environment->centroids[nearest]);
+		environment->centroidGrid.FindPointsInRadius(gridCenter, nearestDistance * environment->gridScale, candidates);
+		for (int segment : candidates) {
+			if (!isSameBuilding(segment)) {
+				nearestDistance = std::min(nearestDistance, GetDistance(centroid, environment->centroids[segment]));
 			}
 		}
-		else {
-			FLine* mainComponent = buildingData->geometry->GetMainSegment();
-			if (mainComponent != nullptr && SIZE(mainComponent->coordinates) > 0) {
-				averageBuildingAreaNearby += std::abs(ShapeUtils::CalculateShapeArea(mainComponent, true)) * 1000000;
-				++buildingCountNearby;
+		data.nearestBuildingDistance = nearestDistance;
+	}
+
+	std::vector<int> nearby;
+	if (radius > 0) {
+		candidates.clear();
+		environment->centroidGrid.FindPointsInRadius(gridCenter, radius * environment->gridScale, candidates);
+		for (int segment : candidates) {
+			if (GetDistance(centroid, environment->centroids[segment]) <= radius) {
+				nearby.push_back(segment);
 			}
 		}
 	}
-	if (!foundBuilding) {
-		printf("Building not found in query. This should not happen.");
+	else {
+		for (size_t segment = 0; segment < environment->segments.size(); ++segment) {
+			nearby.push_back(static_cast<int>(segment));
+		}
+	}
+	std::vector<double> nearbyAreas;
+	nearbyAreas.reserve(nearby.size());
+	for (int segment : nearby) {
+		if (!isSameBuilding(segment)) {
+			nearbyAreas.push_back(environment->areas[segment]);
+		}
 	}
-	if (buildingCountNearby > 0) {
-		data.averageBuildingAreaNearby = averageBuildingAreaNearby / buildingCountNearby;
-		data.buildingCountNearby = buildingCountNearby;
+	if (!nearbyAreas.empty()) {
+		double totalArea = 0;
+		for (double area : nearbyAreas) {
+			totalArea += area;
+		}
+		size_t middle = nearbyAreas.size() / 2;
+		std::nth_element(nearbyAreas.begin(), nearbyAreas.begin() + middle, nearbyAreas.end());
+		double median = nearbyAreas[middle];
+		if (nearbyAreas.size() % 2 == 0) {
+			median = (median + *std::max_element(nearbyAreas.begin(), nearbyAreas.begin() + middle)) / 2;
+		}
+		data.buildingCountNearby = static_cast<int>(nearbyAreas.size());
+		data.totalBuildingAreaNearby = totalArea;
+		data.averageBuildingAreaNearby = totalArea / nearbyAreas.size();
+		data.medianBuildingAreaNearby = median;
 	}
 
 	return data;
 }
 
+void destroy_building_environment(BuildingEnvironment* environment) {
+	delete environment;
+}
+
 double* get_building_tile_bounds(const char* osmData) {
 	BuildingEnvironmentData data;
 	FTileMapData mapData;
-	std::string osmDataStr(osmData);
-	MapDataUtils::ProcessMapDataFromOsm(osmData, &mapData);
+	MapDataUtils::ProcessMapDataFromOsm(osmData, strlen(osmData), &mapData);
 	double result[4] = { -1, -1, -1, -1 };
 	double latitude = 0;
 	double longitude = 0;
 	if(SIZE(mapData.buildings) > 0 ) {
-		FLine* mainSegment = mapData.buildings[0]->geometry->GetMainSegment();
-		if (mainSegment != nullptr && SIZE(mainSegment->coordinates) > 0) {
-			latitude = mainSegment->coordinates[0]->globalPosition.latitude;
-			longitude = mainSegment->coordinates[0]->globalPosition.longitude;
+		const FLine* mainSegment = mapData.buildings[0]->geometry->GetMainSegment();
+		if (mainSegment != nullptr && mainSegment->GetVertexCount() > 0) {
+			latitude = mainSegment->GetGlobalPosition(0).latitude;
+			longitude = mainSegment->GetGlobalPosition(0).longitude;
 		}
 	}
 	int tileX = TileUtils::LongitudeToTileX(longitude, kZoomLevel);
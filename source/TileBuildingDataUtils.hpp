@@ -24,13 +24,24 @@ struct BuildingEnvironmentData {
     int roofShape;
     bool isRoofColorKnown;
     int roofColor;
+    // The other buildings whose centroid is within the radius of the centroid of the building, or all of them
     int buildingCountNearby;
     double averageBuildingAreaNearby;
+    double medianBuildingAreaNearby;
+    double totalBuildingAreaNearby;
+    // In meters between centroids, regardless of the radius, -1 if there is no other building
+    double nearestBuildingDistance;
+    // False if the data has no building with the id, the other fields are then left at their defaults
+    bool isBuildingFound;
     BuildingEnvironmentData() : latitude(-1), longitude(-1), buildingArea(-1), buildingKind(0), buildingLanduseKind(0),
         isHeightKnown(false), height(0), isBuildingColorKnown(false), buildingColor(0), isRoofShapeKnown(false), roofShape(0), isRoofColorKnown(false), roofColor(0),
-        buildingCountNearby(-1), averageBuildingAreaNearby(-1) {}
+        buildingCountNearby(-1), averageBuildingAreaNearby(-1), medianBuildingAreaNearby(-1), totalBuildingAreaNearby(-1), nearestBuildingDistance(-1),
+        isBuildingFound(false) {}
 };
 
+// The buildings of OSM data parsed once for many queries, see create_building_environment
+struct BuildingEnvironment;
+
 extern "C" {
     // Function to get a latitude/longitude pair for a building ID from its XML data
     EXPORT double* get_building_location(const char* osmData);
@@ -38,6 +49,16 @@ extern "C" {
     // Function to get building count for a tile
     EXPORT BuildingEnvironmentData get_building_environment_data(const char* osmData, int64_t buildingId);
 
+    // The same with the nearby buildings limited to a radius in meters, all buildings of the data if it is not positive
+    EXPORT BuildingEnvironmentData get_building_environment_data_in_radius(const char* osmData, int64_t buildingId, double radius);
+
+    // Parses the data and indexes its buildings once, so that querying many buildings of it does not parse it again.
+    // Free it with destroy_building_environment.
+    EXPORT BuildingEnvironment* create_building_environment(const char* osmData);
+    // The same as get_building_environment_data_in_radius on the data of the environment
+    EXPORT BuildingEnvironmentData query_building_environment(const BuildingEnvironment* environment, int64_t buildingId, double radius);
+    EXPORT void destroy_building_environment(BuildingEnvironment* environment);
+
     // Function to get building tile location
     EXPORT double* get_building_tile_bounds(const char* osmData);
 }
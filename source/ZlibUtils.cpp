@@ -0,0 +1,398 @@
+#include "ZlibUtils.h"
+
+#include <cstring>
+
+namespace ZlibUtils {
+
+	static constexpr int32_t kMaxCodeBits = 15;
+	static constexpr int32_t kFastBits = 10;
+	static constexpr int32_t kMaxLiteralLengthCodes = 288;
+	static constexpr int32_t kMaxDistanceCodes = 30;
+
+	static const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t kLengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t kDistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	static const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Canonical Huffman code. Codes up to kFastBits long are resolved with a single table lookup, longer codes fall
+	// back to walking the code lengths one bit at a time.
+	struct HuffmanTable {
+		uint16_t counts[kMaxCodeBits + 1];
+		uint16_t symbols[kMaxLiteralLengthCodes];
+		uint16_t fast[1 << kFastBits]; // (symbol << 4) | length, 0 if the code is longer than kFastBits
+
+		bool Build(const uint8_t* lengths, int32_t symbolCount) {
+			memset(counts, 0, sizeof(counts));
+			for (int32_t symbol = 0; symbol < symbolCount; ++symbol) {
+				++counts[lengths[symbol]];
+			}
+			counts[0] = 0;
+
+			// Reject over-subscribed codes, incomplete ones are allowed (e.g. a single distance code)
+			int32_t left = 1;
+			for (int32_t length = 1; length <= kMaxCodeBits; ++length) {
+				left <<= 1;
+				left -= counts[length];
+				if (left < 0) {
+					return false;
+				}
+			}
+
+			uint16_t offsets[kMaxCodeBits + 2];
+			offsets[1] = 0;
+			for (int32_t length = 1; length <= kMaxCodeBits; ++length) {
+				offsets[length + 1] = offsets[length] + counts[length];
+			}
+			for (int32_t symbol = 0; symbol < symbolCount; ++symbol) {
+				if (lengths[symbol] != 0) {
+					symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+				}
+			}
+
+			memset(fast, 0, sizeof(fast));
+			uint32_t code = 0;
+			int32_t index = 0;
+			for (int32_t length = 1; length <= kFastBits; ++length) {
+				for (int32_t i = 0; i < counts[length]; ++i, ++index, ++code) {
+					// Deflate stores Huffman codes starting with their most significant bit
+					uint32_t reversed = 0;
+					for (int32_t bit = 0; bit < length; ++bit) {
+						reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+					}
+					uint16_t entry = static_cast<uint16_t>((symbols[index] << 4) | length);
+					for (uint32_t fill = reversed; fill < (1u << kFastBits); fill += 1u << length) {
+						fast[fill] = entry;
+					}
+				}
+				code <<= 1;
+			}
+			return true;
+		}
+	};
+
+	class BitReader {
+	public:
+		BitReader(const uint8_t* input, size_t size) : _input(input), _end(input + size) {}
+
+		uint32_t Peek(int32_t count) {
+			Refill();
+			return static_cast<uint32_t>(_bits & ((1ull << count) - 1));
+		}
+
+		void Consume(int32_t count) {
+			_bits >>= count;
+			_bitCount -= count;
+			if (_bitCount < _paddingBits) {
+				_overrun = true;
+			}
+		}
+
+		uint32_t Read(int32_t count) {
+			if (count == 0) {
+				return 0;
+			}
+			uint32_t value = Peek(count);
+			Consume(count);
+			return value;
+		}
+
+		void AlignToByte() {
+			Consume(_bitCount & 7);
+		}
+
+		// Only valid when aligned to a byte, returns the bytes still buffered to the input first
+		const uint8_t* TakeBytes(size_t count) {
+			// Padding bits still buffered mean the input already ran out, rewinding would then move past its end
+			if (_overrun || _bitCount < _paddingBits) {
+				_overrun = true;
+				return nullptr;
+			}
+			_input -= GetBufferedBytes();
+			_bits = 0;
+			_bitCount = 0;
+			_paddingBits = 0;
+			if (static_cast<size_t>(_end - _input) < count) {
+				_overrun = true;
+				return nullptr;
+			}
+			const uint8_t* bytes = _input;
+			_input += count;
+			return bytes;
+		}
+
+		bool HasOverrun() const { return _overrun; }
+		const uint8_t* GetPosition() const { return _input - GetBufferedBytes(); }
+
+	private:
+		int32_t GetBufferedBytes() const { return (_bitCount - _paddingBits) / 8; }
+
+		void Refill() {
+			while (_bitCount <= 56) {
+				if (_input < _end) {
+					_bits |= static_cast<uint64_t>(*_input++) << _bitCount;
+				}
+				else {
+					// Zero padding past the end of the input, consuming it is reported as an overrun
+					_paddingBits += 8;
+				}
+				_bitCount += 8;
+			}
+		}
+
+		const uint8_t* _input;
+		const uint8_t* _end;
+		uint64_t _bits = 0;
+		int32_t _bitCount = 0;
+		int32_t _paddingBits = 0;
+		bool _overrun = false;
+	};
+
+	class Inflater {
+	public:
+		Inflater(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize)
+			: _reader(input, inputSize), _output(output), _outputSize(outputSize) {}
+
+		bool Run() {
+			bool isLastBlock = false;
+			while (!isLastBlock) {
+				isLastBlock = _reader.Read(1) == 1;
+				uint32_t blockType = _reader.Read(2);
+				if (HasOverrun()) {
+					return false;
+				}
+				bool isValid = false;
+				if (blockType == 0) isValid = InflateStored();
+				else if (blockType == 1) isValid = InflateFixed();
+				else if (blockType == 2) isValid = InflateDynamic();
+				if (!isValid || HasOverrun()) {
+					return false;
+				}
+			}
+			return _outputPosition == _outputSize;
+		}
+
+		// First input byte after the deflate stream, a partially used last byte counts as used
+		const uint8_t* GetEnd() const {
+			return _reader.GetPosition();
+		}
+
+	private:
+		bool HasOverrun() const {
+			return _reader.HasOverrun();
+		}
+
+		int32_t Decode(const HuffmanTable& table) {
+			uint32_t entry = table.fast[_reader.Peek(kFastBits)];
+			if (entry != 0) {
+				_reader.Consume(entry & 15);
+				return entry >> 4;
+			}
+			// Slow path, walks the canonical code one bit at a time
+			int32_t code = 0;
+			int32_t first = 0;
+			int32_t index = 0;
+			for (int32_t length = 1; length <= kMaxCodeBits; ++length) {
+				code |= _reader.Read(1);
+				int32_t count = table.counts[length];
+				if (code - count < first) {
+					return table.symbols[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+
+		bool InflateStored() {
+			_reader.AlignToByte();
+			const uint8_t* header = _reader.TakeBytes(4);
+			if (header == nullptr) {
+				return false;
+			}
+			uint32_t length = header[0] | (header[1] << 8);
+			uint32_t lengthComplement = header[2] | (header[3] << 8);
+			if (length != (~lengthComplement & 0xFFFF) || length > _outputSize - _outputPosition) {
+				return false;
+			}
+			const uint8_t* bytes = _reader.TakeBytes(length);
+			if (bytes == nullptr) {
+				return false;
+			}
+			memcpy(_output + _outputPosition, bytes, length);
+			_outputPosition += length;
+			return true;
+		}
+
+		bool InflateFixed() {
+			uint8_t lengths[kMaxLiteralLengthCodes + kMaxDistanceCodes];
+			int32_t symbol = 0;
+			for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+			for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+			for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+			for (; symbol < kMaxLiteralLengthCodes; ++symbol) lengths[symbol] = 8;
+			for (symbol = 0; symbol < kMaxDistanceCodes; ++symbol) lengths[kMaxLiteralLengthCodes + symbol] = 5;
+			if (!_literalLengthTable.Build(lengths, kMaxLiteralLengthCodes) ||
+				!_distanceTable.Build(lengths + kMaxLiteralLengthCodes, kMaxDistanceCodes)) {
+				return false;
+			}
+			return InflateCodes();
+		}
+
+		bool InflateDynamic() {
+			int32_t literalLengthCount = _reader.Read(5) + 257;
+			int32_t distanceCount = _reader.Read(5) + 1;
+			int32_t codeLengthCount = _reader.Read(4) + 4;
+			if (literalLengthCount > kMaxLiteralLengthCodes || distanceCount > kMaxDistanceCodes) {
+				return false;
+			}
+
+			uint8_t lengths[kMaxLiteralLengthCodes + kMaxDistanceCodes];
+			memset(lengths, 0, sizeof(lengths));
+			for (int32_t i = 0; i < codeLengthCount; ++i) {
+				lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(_reader.Read(3));
+			}
+			HuffmanTable codeLengthTable;
+			if (!codeLengthTable.Build(lengths, 19)) {
+				return false;
+			}
+
+			int32_t index = 0;
+			while (index < literalLengthCount + distanceCount) {
+				int32_t symbol = Decode(codeLengthTable);
+				if (symbol < 0 || HasOverrun()) {
+					return false;
+				}
+				if (symbol < 16) {
+					lengths[index++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+				uint8_t repeatedLength = 0;
+				int32_t repeatCount = 0;
+				if (symbol == 16) {
+					if (index == 0) {
+						return false;
+					}
+					repeatedLength = lengths[index - 1];
+					repeatCount = 3 + _reader.Read(2);
+				}
+				else if (symbol == 17) {
+					repeatCount = 3 + _reader.Read(3);
+				}
+				else {
+					repeatCount = 11 + _reader.Read(7);
+				}
+				if (index + repeatCount > literalLengthCount + distanceCount) {
+					return false;
+				}
+				while (repeatCount-- > 0) {
+					lengths[index++] = repeatedLength;
+				}
+			}
+			if (lengths[256] == 0) {
+				return false; // No end of block code
+			}
+			if (!_literalLengthTable.Build(lengths, literalLengthCount) ||
+				!_distanceTable.Build(lengths + literalLengthCount, distanceCount)) {
+				return false;
+			}
+			return InflateCodes();
+		}
+
+		bool InflateCodes() {
+			for (;;) {
+				int32_t symbol = Decode(_literalLengthTable);
+				if (symbol < 0 || HasOverrun()) {
+					return false;
+				}
+				if (symbol < 256) {
+					if (_outputPosition >= _outputSize) {
+						return false;
+					}
+					_output[_outputPosition++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+				if (symbol == 256) {
+					return true;
+				}
+
+				symbol -= 257;
+				if (symbol >= 29) {
+					return false;
+				}
+				size_t length = kLengthBase[symbol] + _reader.Read(kLengthExtraBits[symbol]);
+				int32_t distanceSymbol = Decode(_distanceTable);
+				if (distanceSymbol < 0 || distanceSymbol >= kMaxDistanceCodes) {
+					return false;
+				}
+				size_t distance = kDistanceBase[distanceSymbol] + _reader.Read(kDistanceExtraBits[distanceSymbol]);
+				if (distance > _outputPosition || length > _outputSize - _outputPosition) {
+					return false;
+				}
+
+				// Byte by byte, the source and destination may overlap
+				uint8_t* target = _output + _outputPosition;
+				const uint8_t* source = target - distance;
+				for (size_t i = 0; i < length; ++i) {
+					target[i] = source[i];
+				}
+				_outputPosition += length;
+			}
+		}
+
+		BitReader _reader;
+		uint8_t* _output;
+		size_t _outputSize;
+		size_t _outputPosition = 0;
+		HuffmanTable _literalLengthTable;
+		HuffmanTable _distanceTable;
+	};
+
+	static uint32_t Adler32(const uint8_t* data, size_t size) {
+		static constexpr uint32_t kModulo = 65521;
+		// The largest block that can not overflow the 32 bit sums
+		static constexpr size_t kBlockSize = 5552;
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0) {
+			size_t blockSize = size < kBlockSize ? size : kBlockSize;
+			size -= blockSize;
+			while (blockSize-- > 0) {
+				a += *data++;
+				b += a;
+			}
+			a %= kModulo;
+			b %= kModulo;
+		}
+		return (b << 16) | a;
+	}
+
+	bool Uncompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize) {
+		if (inputSize < 6) {
+			return false;
+		}
+		uint8_t compressionMethod = input[0];
+		uint8_t flags = input[1];
+		bool isValidHeader = (compressionMethod & 0x0F) == 8 && (compressionMethod >> 4) <= 7 &&
+			((compressionMethod << 8) | flags) % 31 == 0 && (flags & 0x20) == 0; // Preset dictionaries are not used by zlib streams in the wild
+		if (!isValidHeader) {
+			return false;
+		}
+
+		const uint8_t* deflateData = input + 2;
+		size_t deflateSize = inputSize - 2;
+		Inflater inflater(deflateData, deflateSize, output, outputSize);
+		if (!inflater.Run()) {
+			return false;
+		}
+
+		const uint8_t* trailer = inflater.GetEnd();
+		if (trailer + 4 > input + inputSize) {
+			return false;
+		}
+		uint32_t expectedChecksum = (static_cast<uint32_t>(trailer[0]) << 24) | (trailer[1] << 16) | (trailer[2] << 8) | trailer[3];
+		return Adler32(output, outputSize) == expectedChecksum;
+	}
+}
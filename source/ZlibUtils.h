@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ZlibUtils {
+
+// Decompresses a zlib stream (RFC 1950 around RFC 1951 deflate data) whose uncompressed size is known up front.
+// Returns false on corrupt input, a checksum mismatch, or if the output does not exactly fill outputSize bytes.
+bool Uncompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize);
+
+}
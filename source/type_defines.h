@@ -10,6 +10,7 @@
 #define LOG_F(fmt, ...) UE_LOG(LogTemp, Log, TEXT(fmt), __VA_ARGS__) 
 
 #define STRING FString
+#define STRING_VIEW FAnsiStringView
 #define CSTRINGOF(x) StringCast<ANSICHAR>(*(x)).Get()
 #define LENGTH(x) x.Len()
 #define SUBSTRING(x,p,n) x.Mid(p,n)
@@ -20,6 +21,10 @@
 #define ARRAY TArray
 #define SIZE(x) x.Num()
 #define ADD(x, y) x.Add(y)
+#define CLEAR(x) x.Reset()
+#define RESERVE(x, n) x.Reserve(n)
+#define RESIZE(x, n) x.SetNum(n)
+#define DATA(x) x.GetData()
 #define VECTOR2D FVector2D
 
 #define MAX FMath::Max
@@ -31,6 +36,7 @@
 #include <cstdlib>
 #include <math.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "math/Vector.hpp"
 
@@ -38,6 +44,7 @@
 #define LOG_F(fmt, ...)  printf(fmt "\n", __VA_ARGS__);
 
 #define STRING std::string
+#define STRING_VIEW std::string_view
 #define CSTRINGOF(x) x.c_str()
 #define LENGTH(x) x.length()
 #define SUBSTRING(x,p,n) x.substr(p,n)
@@ -48,6 +55,10 @@
 #define ARRAY std::vector
 #define SIZE(x) x.size()
 #define ADD(x, y) x.push_back(y)
+#define CLEAR(x) x.clear()
+#define RESERVE(x, n) x.reserve(n)
+#define RESIZE(x, n) x.resize(n)
+#define DATA(x) x.data()
 #define VECTOR2D Vector2D<double>
 
 #define MAX std::max